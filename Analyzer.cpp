@@ -0,0 +1,619 @@
+#include "Analyzer.h"
+#include <algorithm>
+#include <cstdio>
+
+static bool InRom(size_t size, uint32_t address, uint32_t length) {
+    return address >= ROM_START && address + length <= ROM_START + size;
+}
+
+static uint8_t ByteAt(const uint8_t *rom, size_t size, uint32_t address) {
+    return InRom(size, address, 1) ? rom[address - ROM_START] : 0;
+}
+
+static uint16_t WordAt(const uint8_t *rom, size_t size, uint32_t address) {
+    return (ByteAt(rom, size, address) << 8u) | ByteAt(rom, size, address + 1);
+}
+
+Instruction Decode(const uint8_t *rom, size_t size, uint16_t address) {
+    uint16_t opcode = WordAt(rom, size, address);
+    Instruction instruction{address, opcode, 0, 2, Flow::Next, 0};
+
+    uint16_t nnn = opcode & 0x0FFFu;
+    unsigned int n = opcode & 0x000Fu;
+    unsigned int kk = opcode & 0x00FFu;
+
+    switch (opcode >> 12u) {
+        case 0x0:
+            if (opcode == 0x00EEu) {
+                instruction.flow = Flow::Return;
+            }
+            else if (opcode == 0x00FDu) {
+                instruction.flow = Flow::Exit;
+            }
+            else if (opcode != 0x00E0u && opcode != 0x00FBu && opcode != 0x00FCu && opcode != 0x00FEu &&
+                     opcode != 0x00FFu && (opcode & 0xFFF0u) != 0x00C0u) {
+                instruction.flow = Flow::Invalid;
+            }
+            break;
+        case 0x1:
+            instruction.flow = Flow::Jump;
+            instruction.target = nnn;
+            break;
+        case 0x2:
+            instruction.flow = Flow::Call;
+            instruction.target = nnn;
+            break;
+        case 0x3:
+        case 0x4:
+            instruction.flow = Flow::Skip;
+            break;
+        case 0x5:
+            instruction.flow = n == 0x0 ? Flow::Skip : n == 0x2 || n == 0x3 ? Flow::Next : Flow::Invalid;
+            break;
+        case 0x8:
+            instruction.flow = n <= 0x7 || n == 0xE ? Flow::Next : Flow::Invalid;
+            break;
+        case 0x9:
+            instruction.flow = n == 0x0 ? Flow::Skip : Flow::Invalid;
+            break;
+        case 0xA:
+            instruction.target = nnn;
+            break;
+        case 0xB:
+            instruction.flow = Flow::Indirect;
+            instruction.target = nnn;
+            break;
+        case 0xE:
+            // TableE dispatches on the low nibble alone, so ExNE is SKP and ExN1 is SKNP whatever the middle
+            instruction.flow = n == 0xE || n == 0x1 ? Flow::Skip : Flow::Invalid;
+            break;
+        case 0xF:
+            switch (kk) {
+                case 0x00:
+                    instruction.size = 4;
+                    instruction.operand = WordAt(rom, size, address + 2u);
+                    instruction.target = instruction.operand;
+                    break;
+                case 0x01: case 0x02: case 0x07: case 0x0A: case 0x15: case 0x18: case 0x1E: case 0x29:
+                case 0x30: case 0x33: case 0x3A: case 0x55: case 0x65: case 0x75: case 0x85:
+                    break;
+                default:
+                    instruction.flow = Flow::Invalid;
+                    break;
+            }
+            break;
+        default:
+            break;
+    }
+
+    return instruction;
+}
+
+std::string Disassemble(const Instruction &instruction) {
+    uint16_t opcode = instruction.opcode;
+    unsigned int x = (opcode & 0x0F00u) >> 8u;
+    unsigned int y = (opcode & 0x00F0u) >> 4u;
+    unsigned int n = opcode & 0x000Fu;
+    unsigned int kk = opcode & 0x00FFu;
+    unsigned int nnn = opcode & 0x0FFFu;
+
+    char text[32];
+
+    if (instruction.flow == Flow::Invalid) {
+        snprintf(text, sizeof(text), "DW 0x%04X", opcode);
+        return text;
+    }
+
+    switch (opcode >> 12u) {
+        case 0x0:
+            switch (opcode) {
+                case 0x00E0: return "CLS";
+                case 0x00EE: return "RET";
+                case 0x00FB: return "SCR";
+                case 0x00FC: return "SCL";
+                case 0x00FD: return "EXIT";
+                case 0x00FE: return "LOW";
+                case 0x00FF: return "HIGH";
+                default:
+                    snprintf(text, sizeof(text), "SCD %u", n);
+                    return text;
+            }
+        case 0x1: snprintf(text, sizeof(text), "JP 0x%03X", nnn); break;
+        case 0x2: snprintf(text, sizeof(text), "CALL 0x%03X", nnn); break;
+        case 0x3: snprintf(text, sizeof(text), "SE V%X, 0x%02X", x, kk); break;
+        case 0x4: snprintf(text, sizeof(text), "SNE V%X, 0x%02X", x, kk); break;
+        case 0x5:
+            snprintf(text, sizeof(text), n == 0x0 ? "SE V%X, V%X" : n == 0x2 ? "SAVE V%X - V%X" : "LOAD V%X - V%X", x, y);
+            break;
+        case 0x6: snprintf(text, sizeof(text), "LD V%X, 0x%02X", x, kk); break;
+        case 0x7: snprintf(text, sizeof(text), "ADD V%X, 0x%02X", x, kk); break;
+        case 0x8: {
+            static const char *const names[] = {"LD", "OR", "AND", "XOR", "ADD", "SUB", "SHR", "SUBN"};
+            if (n == 0xE) {
+                snprintf(text, sizeof(text), "SHL V%X", x);
+            }
+            else if (n == 0x6) {
+                snprintf(text, sizeof(text), "SHR V%X", x);
+            }
+            else {
+                snprintf(text, sizeof(text), "%s V%X, V%X", names[n], x, y);
+            }
+            break;
+        }
+        case 0x9: snprintf(text, sizeof(text), "SNE V%X, V%X", x, y); break;
+        case 0xA: snprintf(text, sizeof(text), "LD I, 0x%03X", nnn); break;
+        case 0xB: snprintf(text, sizeof(text), "JP V0, 0x%03X", nnn); break;
+        case 0xC: snprintf(text, sizeof(text), "RND V%X, 0x%02X", x, kk); break;
+        case 0xD: snprintf(text, sizeof(text), "DRW V%X, V%X, %u", x, y, n); break;
+        case 0xE: snprintf(text, sizeof(text), n == 0xE ? "SKP V%X" : "SKNP V%X", x); break;
+        default:
+            switch (kk) {
+                case 0x00: snprintf(text, sizeof(text), "LD I, 0x%04X", instruction.operand); break;
+                case 0x01: snprintf(text, sizeof(text), "PLANE %u", x); break;
+                case 0x02: return "AUDIO";
+                case 0x07: snprintf(text, sizeof(text), "LD V%X, DT", x); break;
+                case 0x0A: snprintf(text, sizeof(text), "LD V%X, K", x); break;
+                case 0x15: snprintf(text, sizeof(text), "LD DT, V%X", x); break;
+                case 0x18: snprintf(text, sizeof(text), "LD ST, V%X", x); break;
+                case 0x1E: snprintf(text, sizeof(text), "ADD I, V%X", x); break;
+                case 0x29: snprintf(text, sizeof(text), "LD F, V%X", x); break;
+                case 0x30: snprintf(text, sizeof(text), "LD HF, V%X", x); break;
+                case 0x33: snprintf(text, sizeof(text), "LD B, V%X", x); break;
+                case 0x3A: snprintf(text, sizeof(text), "PITCH V%X", x); break;
+                case 0x55: snprintf(text, sizeof(text), "LD [I], V%X", x); break;
+                case 0x65: snprintf(text, sizeof(text), "LD V%X, [I]", x); break;
+                case 0x75: snprintf(text, sizeof(text), "LD R, V%X", x); break;
+                default: snprintf(text, sizeof(text), "LD V%X, R", x); break;
+            }
+            break;
+    }
+
+    return text;
+}
+
+const BasicBlock *Analysis::BlockAt(uint16_t address) const {
+    auto after = std::upper_bound(blocks.begin(), blocks.end(), address, [](uint16_t value, const BasicBlock &block) {
+        return value < block.start;
+    });
+    if (after == blocks.begin()) {
+        return nullptr;
+    }
+
+    const BasicBlock &block = *(after - 1);
+    return address < block.end ? &block : nullptr;
+}
+
+uint64_t HashRom(const uint8_t *rom, size_t size) {
+    // FNV-1a: only has to tell ROMs apart for caching, not resist anyone
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ rom[i]) * 0x100000001B3ull;
+    }
+
+    return hash;
+}
+
+/**
+ * Where a skip at address lands when it skips: past the next instruction, which is four bytes if it is F000 nnnn.
+ */
+static uint16_t SkipTarget(const uint8_t *rom, size_t size, uint16_t address) {
+    uint16_t next = address + 2;
+    return next + (WordAt(rom, size, next) == 0xF000u ? 4 : 2);
+}
+
+static int CallDepth(const Analysis &analysis, size_t subroutine, std::vector<int> &depths,
+                     std::vector<uint8_t> &visiting) {
+    if (depths[subroutine] != -2) {
+        return depths[subroutine];
+    }
+    if (visiting[subroutine]) {
+        // Recursion
+        return -1;
+    }
+
+    visiting[subroutine] = 1;
+    int depth = 0;
+
+    for (uint16_t call : analysis.subroutines[subroutine].calls) {
+        auto callee = std::lower_bound(analysis.subroutines.begin(), analysis.subroutines.end(), call,
+                                       [](const Subroutine &s, uint16_t entry) { return s.entry < entry; });
+        if (callee == analysis.subroutines.end() || callee->entry != call) {
+            continue;
+        }
+
+        int calleeDepth = CallDepth(analysis, callee - analysis.subroutines.begin(), depths, visiting);
+        if (calleeDepth < 0) {
+            depth = -1;
+            break;
+        }
+        depth = std::max(depth, calleeDepth + 1);
+    }
+
+    visiting[subroutine] = 0;
+    depths[subroutine] = depth;
+    return depth;
+}
+
+Analysis Analyze(const uint8_t *rom, size_t size) {
+    // Only so much fits above ROM_START
+    size = std::min<size_t>(size, 0x10000 - ROM_START);
+
+    Analysis analysis;
+    analysis.hash = HashRom(rom, size);
+    analysis.romSize = size;
+
+    // 1 where a decoded instruction starts, 2 for its other bytes
+    std::vector<uint8_t> covered(0x10000, 0);
+    std::vector<uint8_t> leaders(0x10000, 0);
+    std::vector<uint16_t> entries{ROM_START};
+    std::vector<uint16_t> work{ROM_START};
+    leaders[ROM_START] = 1;
+
+    auto follow = [&](uint16_t address) {
+        leaders[address] = 1;
+        work.push_back(address);
+    };
+
+    // Recursive descent, with an explicit stack
+    while (!work.empty()) {
+        uint16_t address = work.back();
+        work.pop_back();
+
+        if (!InRom(size, address, 2) || covered[address] == 1) {
+            continue;
+        }
+
+        Instruction instruction = Decode(rom, size, address);
+        if (!InRom(size, address, instruction.size)) {
+            instruction.flow = Flow::Invalid;
+            instruction.size = 2;
+        }
+
+        bool overlap = covered[address] != 0;
+        for (unsigned int i = 1; i < instruction.size; ++i) {
+            overlap |= covered[static_cast<uint16_t>(address + i)] != 0;
+            covered[static_cast<uint16_t>(address + i)] = 2;
+        }
+        covered[address] = 1;
+        if (overlap) {
+            analysis.overlaps.push_back(address);
+        }
+
+        analysis.instructions.push_back(instruction);
+
+        if ((instruction.opcode & 0xF000u) == 0xA000u || instruction.size == 4) {
+            analysis.dataReferences.push_back(instruction.target);
+        }
+
+        uint16_t next = address + instruction.size;
+        switch (instruction.flow) {
+            case Flow::Next:
+                work.push_back(next);
+                break;
+            case Flow::Jump:
+                follow(instruction.target);
+                break;
+            case Flow::Skip:
+                follow(next);
+                follow(SkipTarget(rom, size, address));
+                break;
+            case Flow::Call:
+                entries.push_back(instruction.target);
+                follow(instruction.target);
+                follow(next);
+                break;
+            case Flow::Indirect:
+                analysis.indirectJumps.push_back(address);
+                break;
+            default:
+                break;
+        }
+    }
+
+    std::sort(analysis.instructions.begin(), analysis.instructions.end(),
+              [](const Instruction &a, const Instruction &b) { return a.address < b.address; });
+    std::sort(analysis.indirectJumps.begin(), analysis.indirectJumps.end());
+    std::sort(analysis.overlaps.begin(), analysis.overlaps.end());
+    std::sort(analysis.dataReferences.begin(), analysis.dataReferences.end());
+    analysis.dataReferences.erase(std::unique(analysis.dataReferences.begin(), analysis.dataReferences.end()),
+                                  analysis.dataReferences.end());
+
+    // Basic blocks: a new one starts at every leader, after anything that isn't straight-line, and at gaps
+    for (size_t i = 0; i < analysis.instructions.size(); ++i) {
+        const Instruction &instruction = analysis.instructions[i];
+        bool continues = !analysis.blocks.empty() && !leaders[instruction.address] &&
+                         analysis.blocks.back().end == instruction.address &&
+                         analysis.instructions[i - 1].flow == Flow::Next;
+
+        if (continues) {
+            analysis.blocks.back().end = instruction.address + instruction.size;
+            ++analysis.blocks.back().count;
+        }
+        else {
+            analysis.blocks.push_back(BasicBlock{instruction.address,
+                                                 static_cast<uint16_t>(instruction.address + instruction.size), i, 1});
+        }
+    }
+
+    auto addEdge = [&](uint16_t from, uint16_t to, EdgeKind kind) {
+        const BasicBlock *target = analysis.BlockAt(to);
+        if (target != nullptr && target->start == to) {
+            analysis.edges.push_back(Edge{from, to, kind});
+        }
+    };
+
+    for (const BasicBlock &block : analysis.blocks) {
+        const Instruction &last = analysis.instructions[block.first + block.count - 1];
+        switch (last.flow) {
+            case Flow::Next:
+                addEdge(block.start, block.end, EdgeKind::Fallthrough);
+                break;
+            case Flow::Jump:
+                addEdge(block.start, last.target, EdgeKind::Jump);
+                break;
+            case Flow::Skip:
+                addEdge(block.start, block.end, EdgeKind::Fallthrough);
+                addEdge(block.start, SkipTarget(rom, size, last.address), EdgeKind::Skip);
+                break;
+            case Flow::Call:
+                addEdge(block.start, last.target, EdgeKind::Call);
+                addEdge(block.start, block.end, EdgeKind::Fallthrough);
+                break;
+            default:
+                break;
+        }
+    }
+
+    // Subroutines: everything reachable from each entry without following calls
+    std::sort(entries.begin(), entries.end());
+    entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+
+    // Marks blocks by index with the entry that last reached them, so nothing needs clearing between subroutines
+    std::vector<uint32_t> seen(analysis.blocks.size(), 0);
+    auto blockIndex = [&analysis](uint16_t address) {
+        return static_cast<size_t>(analysis.BlockAt(address) - analysis.blocks.data());
+    };
+
+    for (uint16_t entry : entries) {
+        if (analysis.BlockAt(entry) == nullptr) {
+            continue;
+        }
+
+        Subroutine subroutine{entry, {}, {}, false};
+        std::vector<uint16_t> pending{entry};
+        uint32_t mark = entry + 1u;
+        seen[blockIndex(entry)] = mark;
+
+        while (!pending.empty()) {
+            uint16_t start = pending.back();
+            pending.pop_back();
+            subroutine.blocks.push_back(start);
+
+            const BasicBlock *block = analysis.BlockAt(start);
+            if (analysis.instructions[block->first + block->count - 1].flow == Flow::Return) {
+                subroutine.returns = true;
+            }
+
+            auto edge = std::lower_bound(analysis.edges.begin(), analysis.edges.end(), start,
+                                         [](const Edge &e, uint16_t from) { return e.from < from; });
+            for (; edge != analysis.edges.end() && edge->from == start; ++edge) {
+                if (edge->kind == EdgeKind::Call) {
+                    subroutine.calls.push_back(edge->to);
+                }
+                else if (seen[blockIndex(edge->to)] != mark) {
+                    seen[blockIndex(edge->to)] = mark;
+                    pending.push_back(edge->to);
+                }
+            }
+        }
+
+        std::sort(subroutine.blocks.begin(), subroutine.blocks.end());
+        std::sort(subroutine.calls.begin(), subroutine.calls.end());
+        subroutine.calls.erase(std::unique(subroutine.calls.begin(), subroutine.calls.end()), subroutine.calls.end());
+        analysis.subroutines.push_back(std::move(subroutine));
+    }
+
+    if (!analysis.subroutines.empty()) {
+        std::vector<int> depths(analysis.subroutines.size(), -2);
+        std::vector<uint8_t> visiting(analysis.subroutines.size(), 0);
+        analysis.maxCallDepth = CallDepth(analysis, 0, depths, visiting);
+    }
+
+    // Whatever was never reached is data
+    for (uint32_t address = ROM_START; address < ROM_START + size; ++address) {
+        if (covered[address] != 0) {
+            continue;
+        }
+
+        if (!analysis.data.empty() && analysis.data.back().end == address) {
+            ++analysis.data.back().end;
+        }
+        else {
+            analysis.data.push_back(DataRegion{static_cast<uint16_t>(address), static_cast<uint16_t>(address + 1)});
+        }
+    }
+
+    return analysis;
+}
+
+static bool IsEntry(const Analysis &analysis, uint16_t address) {
+    auto found = std::lower_bound(analysis.subroutines.begin(), analysis.subroutines.end(), address,
+                                  [](const Subroutine &s, uint16_t entry) { return s.entry < entry; });
+    return found != analysis.subroutines.end() && found->entry == address;
+}
+
+std::string ToListing(const Analysis &analysis, const uint8_t *rom) {
+    std::string out;
+    char line[96];
+
+    size_t block = 0;
+    size_t data = 0;
+
+    while (block < analysis.blocks.size() || data < analysis.data.size()) {
+        bool code = data == analysis.data.size() ||
+                    (block < analysis.blocks.size() && analysis.blocks[block].start < analysis.data[data].start);
+
+        if (code) {
+            const BasicBlock &current = analysis.blocks[block++];
+            if (IsEntry(analysis, current.start)) {
+                snprintf(line, sizeof(line), "\nsub_%03X:\n", current.start);
+                out += line;
+            }
+
+            for (size_t i = current.first; i < current.first + current.count; ++i) {
+                const Instruction &instruction = analysis.instructions[i];
+                snprintf(line, sizeof(line), "    %03X  %04X  %s\n", instruction.address, instruction.opcode,
+                         Disassemble(instruction).c_str());
+                out += line;
+            }
+            continue;
+        }
+
+        const DataRegion &region = analysis.data[data++];
+        for (uint32_t address = region.start; address < region.end; address += 8) {
+            int length = snprintf(line, sizeof(line), "    %03X  DB   ", address);
+            for (uint32_t i = address; i < region.end && i < address + 8; ++i) {
+                length += snprintf(line + length, sizeof(line) - length, " %02X", rom[i - ROM_START]);
+            }
+            out += line;
+            out += '\n';
+        }
+    }
+
+    return out;
+}
+
+static const char *EdgeName(EdgeKind kind) {
+    switch (kind) {
+        case EdgeKind::Fallthrough: return "fallthrough";
+        case EdgeKind::Jump: return "jump";
+        case EdgeKind::Skip: return "skip";
+        default: return "call";
+    }
+}
+
+std::string ToDot(const Analysis &analysis) {
+    std::string out = "digraph rom {\n    node [shape=box fontname=\"monospace\"];\n";
+    char line[96];
+
+    for (const BasicBlock &block : analysis.blocks) {
+        snprintf(line, sizeof(line), "    b%03X [label=\"", block.start);
+        out += line;
+
+        if (IsEntry(analysis, block.start)) {
+            snprintf(line, sizeof(line), "sub_%03X:\\l", block.start);
+            out += line;
+        }
+
+        for (size_t i = block.first; i < block.first + block.count; ++i) {
+            snprintf(line, sizeof(line), "%03X  %s\\l", analysis.instructions[i].address,
+                     Disassemble(analysis.instructions[i]).c_str());
+            out += line;
+        }
+        out += "\"];\n";
+    }
+
+    for (const Edge &edge : analysis.edges) {
+        const char *style = edge.kind == EdgeKind::Call ? " [style=dashed]" :
+                            edge.kind == EdgeKind::Skip ? " [label=\"skip\"]" : "";
+        snprintf(line, sizeof(line), "    b%03X -> b%03X%s;\n", edge.from, edge.to, style);
+        out += line;
+    }
+
+    out += "}\n";
+    return out;
+}
+
+static void AppendList(std::string &out, const char *name, const std::vector<uint16_t> &values) {
+    out += ",\"";
+    out += name;
+    out += "\":[";
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (i > 0) {
+            out += ',';
+        }
+        out += std::to_string(values[i]);
+    }
+    out += "]";
+}
+
+std::string ToJson(const Analysis &analysis) {
+    std::string out;
+    char buffer[96];
+
+    snprintf(buffer, sizeof(buffer), "{\"hash\":\"%016llx\",\"size\":%zu,\"maxCallDepth\":%d",
+             static_cast<unsigned long long>(analysis.hash), analysis.romSize, analysis.maxCallDepth);
+    out += buffer;
+
+    out += ",\"blocks\":[";
+    for (size_t b = 0; b < analysis.blocks.size(); ++b) {
+        const BasicBlock &block = analysis.blocks[b];
+        snprintf(buffer, sizeof(buffer), "%s{\"start\":%u,\"end\":%u,\"instructions\":[", b > 0 ? "," : "",
+                 block.start, block.end);
+        out += buffer;
+
+        for (size_t i = block.first; i < block.first + block.count; ++i) {
+            const Instruction &instruction = analysis.instructions[i];
+            snprintf(buffer, sizeof(buffer), "%s{\"address\":%u,\"opcode\":%u,\"text\":\"%s\"}",
+                     i > block.first ? "," : "", instruction.address, instruction.opcode,
+                     Disassemble(instruction).c_str());
+            out += buffer;
+        }
+        out += "]}";
+    }
+    out += "]";
+
+    out += ",\"edges\":[";
+    for (size_t i = 0; i < analysis.edges.size(); ++i) {
+        const Edge &edge = analysis.edges[i];
+        snprintf(buffer, sizeof(buffer), "%s{\"from\":%u,\"to\":%u,\"kind\":\"%s\"}", i > 0 ? "," : "", edge.from,
+                 edge.to, EdgeName(edge.kind));
+        out += buffer;
+    }
+    out += "]";
+
+    out += ",\"subroutines\":[";
+    for (size_t i = 0; i < analysis.subroutines.size(); ++i) {
+        const Subroutine &subroutine = analysis.subroutines[i];
+        snprintf(buffer, sizeof(buffer), "%s{\"entry\":%u,\"returns\":%s", i > 0 ? "," : "", subroutine.entry,
+                 subroutine.returns ? "true" : "false");
+        out += buffer;
+        AppendList(out, "blocks", subroutine.blocks);
+        AppendList(out, "calls", subroutine.calls);
+        out += "}";
+    }
+    out += "]";
+
+    out += ",\"data\":[";
+    for (size_t i = 0; i < analysis.data.size(); ++i) {
+        snprintf(buffer, sizeof(buffer), "%s{\"start\":%u,\"end\":%u}", i > 0 ? "," : "", analysis.data[i].start,
+                 analysis.data[i].end);
+        out += buffer;
+    }
+    out += "]";
+
+    AppendList(out, "indirectJumps", analysis.indirectJumps);
+    AppendList(out, "dataReferences", analysis.dataReferences);
+    AppendList(out, "overlaps", analysis.overlaps);
+    out += "}\n";
+
+    return out;
+}
+
+std::shared_ptr<const Analysis> AnalysisCache::Get(const uint8_t *rom, size_t size) {
+    uint64_t hash = HashRom(rom, size);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = analyses.find(hash);
+        if (found != analyses.end() && found->second->romSize == size) {
+            return found->second;
+        }
+    }
+
+    // Analyse outside the lock; if two threads race on the same ROM the second result is simply dropped
+    auto analysis = std::make_shared<const Analysis>(Analyze(rom, size));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    return analyses.emplace(hash, analysis).first->second;
+}
@@ -0,0 +1,149 @@
+#ifndef ANALYZER_H
+#define ANALYZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Where ROMs are loaded, and so where analysis starts
+const uint16_t ROM_START = 0x200;
+
+enum class Flow {
+    // Carries on with the next instruction
+    Next,
+    // 1nnn
+    Jump,
+    // 3xkk, 4xkk, 5xy0, 9xy0, Ex9E, ExA1: the next instruction or the one after it
+    Skip,
+    // 2nnn
+    Call,
+    // 00EE
+    Return,
+    // 00FD
+    Exit,
+    // Bnnn, whose target depends on V0
+    Indirect,
+    // Nothing the core implements; the core ignores these, but reaching one usually means the analysis has walked
+    // into data, so descent stops there
+    Invalid
+};
+
+struct Instruction {
+    uint16_t address;
+    uint16_t opcode;
+    // The address word of F000 nnnn
+    uint16_t operand;
+    // 2, or 4 for F000 nnnn
+    uint8_t size;
+    Flow flow;
+    // Jump, call or Annn/F000 target
+    uint16_t target;
+};
+
+/**
+ * Decode the instruction at address from a ROM loaded at ROM_START. Anything past the end of the ROM reads as zero.
+ */
+Instruction Decode(const uint8_t *rom, size_t size, uint16_t address);
+
+/**
+ * Mnemonic and operands, in the notation the OP_* handlers are documented with, e.g. "DRW V1, V2, 5".
+ */
+std::string Disassemble(const Instruction &instruction);
+
+enum class EdgeKind {
+    Fallthrough,
+    Jump,
+    // The path where a skip instruction skips
+    Skip,
+    Call
+};
+
+struct Edge {
+    uint16_t from;
+    uint16_t to;
+    EdgeKind kind;
+};
+
+struct BasicBlock {
+    uint16_t start;
+    // One past the last byte of the last instruction
+    uint16_t end;
+    // Index into Analysis::instructions of the first instruction, and how many there are
+    size_t first;
+    size_t count;
+};
+
+struct Subroutine {
+    uint16_t entry;
+    // Start addresses of the blocks reachable from the entry without following calls
+    std::vector<uint16_t> blocks;
+    std::vector<uint16_t> calls;
+    bool returns;
+};
+
+struct DataRegion {
+    uint16_t start;
+    uint16_t end;
+};
+
+/**
+ * Static analysis of a ROM by recursive descent from ROM_START.
+ *
+ * Every instruction reachable by falling through, jumping, skipping or calling is decoded; whatever part of the
+ * ROM is never reached is taken to be data. Bnnn jumps can't be followed statically - their sites are listed in
+ * indirectJumps, and anything reachable only through them shows up as data. The entry point counts as a subroutine
+ * too, so the call depth of the ROM is the depth reached from it; -1 means recursion makes it unbounded.
+ */
+struct Analysis {
+    uint64_t hash = 0;
+    size_t romSize = 0;
+    // In address order, as are all the other lists
+    std::vector<Instruction> instructions;
+    std::vector<BasicBlock> blocks;
+    std::vector<Edge> edges;
+    std::vector<Subroutine> subroutines;
+    std::vector<DataRegion> data;
+    std::vector<uint16_t> indirectJumps;
+    // Addresses loaded into I by Annn or F000 nnnn
+    std::vector<uint16_t> dataReferences;
+    // Decoded instructions that overlap another decoded instruction, a sign of self-modifying code or misanalysis
+    std::vector<uint16_t> overlaps;
+    int maxCallDepth = 0;
+
+    const BasicBlock *BlockAt(uint16_t address) const;
+};
+
+uint64_t HashRom(const uint8_t *rom, size_t size);
+
+Analysis Analyze(const uint8_t *rom, size_t size);
+
+/**
+ * Disassembly listing: code by block, with data regions as bytes.
+ */
+std::string ToListing(const Analysis &analysis, const uint8_t *rom);
+
+/**
+ * Control-flow graph for Graphviz, one node per basic block.
+ */
+std::string ToDot(const Analysis &analysis);
+
+std::string ToJson(const Analysis &analysis);
+
+/**
+ * Analyses shared by ROM hash, so the tools that want one - the analyzer itself, verification, predecoding - only
+ * pay for it once per ROM. Safe to use from several threads.
+ */
+class AnalysisCache {
+public:
+    std::shared_ptr<const Analysis> Get(const uint8_t *rom, size_t size);
+
+private:
+    std::mutex mutex;
+    std::unordered_map<uint64_t, std::shared_ptr<const Analysis>> analyses;
+};
+
+#endif //ANALYZER_H
@@ -0,0 +1,330 @@
+#include "Audio.h"
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include "Trace.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define AUDIO_X86 1
+#endif
+
+// Peak level of the beep, a quarter of full scale
+static const float AMPLITUDE = 0.25f * 32767.0f;
+
+// Samples over which the gate opens or closes, about 1 ms at 48 kHz
+static const float GATE_RAMP_SAMPLES = 48.0f;
+
+static void PutLE(uint8_t *out, uint32_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+WavAudioSink::WavAudioSink(const std::string &path, unsigned int sampleRate) {
+    file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        return;
+    }
+
+    uint8_t header[44] = {'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E',
+                          'f', 'm', 't', ' ', 16, 0, 0, 0, 1, 0, 1, 0};
+    PutLE(&header[24], sampleRate, 4);
+    PutLE(&header[28], sampleRate * 2, 4);
+    PutLE(&header[32], 2, 2);
+    PutLE(&header[34], 16, 2);
+    memcpy(&header[36], "data", 4);
+    fwrite(header, 1, sizeof(header), file);
+}
+
+WavAudioSink::~WavAudioSink() {
+    if (file == nullptr) {
+        return;
+    }
+
+    uint8_t size[4];
+
+    PutLE(size, static_cast<uint32_t>(dataBytes + 36), 4);
+    fseek(file, 4, SEEK_SET);
+    fwrite(size, 1, 4, file);
+
+    PutLE(size, static_cast<uint32_t>(dataBytes), 4);
+    fseek(file, 40, SEEK_SET);
+    fwrite(size, 1, 4, file);
+
+    fclose(file);
+}
+
+void WavAudioSink::Write(const int16_t *samples, size_t count) {
+    if (file == nullptr) {
+        return;
+    }
+
+    // .wav is little-endian
+    uint8_t buffer[2 * AUDIO_BLOCK_SAMPLES];
+    while (count > 0) {
+        size_t chunk = count < AUDIO_BLOCK_SAMPLES ? count : AUDIO_BLOCK_SAMPLES;
+
+        for (size_t i = 0; i < chunk; ++i) {
+            PutLE(&buffer[i * 2], static_cast<uint16_t>(samples[i]), 2);
+        }
+        fwrite(buffer, 2, chunk, file);
+
+        dataBytes += chunk * 2;
+        samples += chunk;
+        count -= chunk;
+    }
+}
+
+AudioOutput::AudioOutput(std::unique_ptr<AudioSink> sink, size_t queueBlocks)
+        : sink(std::move(sink)), queue(queueBlocks) {
+    thread = std::thread(&AudioOutput::Drain, this);
+}
+
+AudioOutput::~AudioOutput() {
+    // The end marker can't be dropped, so this is the one place the producer waits for room
+    AudioBlock end{};
+    end.last = true;
+    while (!queue.TryPush(end)) {
+        std::this_thread::yield();
+    }
+
+    thread.join();
+}
+
+bool AudioOutput::Push(const AudioBlock &block) {
+    TraceSpan span("audio push", "audio", "start", block.start);
+    if (!queue.TryPush(block)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    return true;
+}
+
+void AudioOutput::Drain() {
+    static const int16_t silence[AUDIO_BLOCK_SAMPLES]{};
+    auto block = std::make_unique<AudioBlock>();
+    uint64_t written = 0;
+    Trace::NameThread("audio");
+
+    for (;;) {
+        if (!queue.TryPop(*block)) {
+            queue.WaitForData();
+            continue;
+        }
+
+        if (block->last) {
+            return;
+        }
+
+        TraceSpan span("audio write", "audio", "samples", block->count);
+
+        // Dropped blocks leave a hole in the timeline; keep the stream in time by filling it with silence
+        while (written < block->start) {
+            uint64_t gap = block->start - written;
+            size_t chunk = gap < AUDIO_BLOCK_SAMPLES ? gap : AUDIO_BLOCK_SAMPLES;
+            sink->Write(silence, chunk);
+            written += chunk;
+        }
+
+        sink->Write(block->silent ? silence : block->samples, block->count);
+        written += block->count;
+    }
+}
+
+Beeper::Beeper(AudioOutput &output, unsigned int sampleRate, unsigned int cyclesPerFrame, float frequency)
+        : output(output), sampleRate(sampleRate), cyclesPerFrame(cyclesPerFrame),
+          phaseStep(static_cast<double>(frequency) / sampleRate) {}
+
+uint64_t Beeper::SampleAt(uint64_t cycle) const {
+    // One frame of cycles is exactly 1/60 s; integer maths keeps the mapping identical on every run
+    return cycle * sampleRate / (static_cast<uint64_t>(cyclesPerFrame) * 60);
+}
+
+void Beeper::SetTone(bool on, uint64_t cycle) {
+    edges.push_back(Edge{SampleAt(cycle), on});
+}
+
+void Beeper::SetPattern(const uint8_t (&pattern)[16], uint8_t pitch, uint64_t cycle) {
+    PatternChange change{SampleAt(cycle), {}, 0};
+    memcpy(change.pattern, pattern, sizeof(change.pattern));
+
+    // The phase accumulator covers the 128 bit pattern in 2^32 steps
+    double rate = 4000.0 * std::exp2((pitch - 64) / 48.0);
+    change.step = static_cast<uint32_t>(rate / sampleRate * 33554432.0);
+
+    patternChanges.push_back(change);
+}
+
+/**
+ * Correction for a unit step at phase 0, spread over the samples either side of it.
+ */
+static double PolyBlep(double t, double dt) {
+    if (t < dt) {
+        t /= dt;
+        return t + t - t * t - 1.0;
+    }
+
+    if (t > 1.0 - dt) {
+        t = (t - 1.0) / dt;
+        return t * t + t + t + 1.0;
+    }
+
+    return 0.0;
+}
+
+/**
+ * Play the audio pattern at full level: the top seven bits of the phase select the pattern bit.
+ */
+static uint32_t PatternRunScalar(int16_t *out, uint32_t count, const int32_t *levels, uint32_t phase, uint32_t step) {
+    for (uint32_t i = 0; i < count; ++i) {
+        out[i] = static_cast<int16_t>(levels[phase >> 25u]);
+        phase += step;
+    }
+
+    return phase;
+}
+
+#ifdef AUDIO_X86
+__attribute__((target("avx2")))
+static uint32_t PatternRunAvx2(int16_t *out, uint32_t count, const int32_t *levels, uint32_t phase, uint32_t step) {
+    __m256i phases = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(phase)),
+                                      _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                                         _mm256_set1_epi32(static_cast<int>(step))));
+    __m256i advance = _mm256_set1_epi32(static_cast<int>(step * 8));
+
+    uint32_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i low = _mm256_i32gather_epi32(levels, _mm256_srli_epi32(phases, 25), 4);
+        phases = _mm256_add_epi32(phases, advance);
+        __m256i high = _mm256_i32gather_epi32(levels, _mm256_srli_epi32(phases, 25), 4);
+        phases = _mm256_add_epi32(phases, advance);
+
+        // packs works within 128 bit lanes, so put the quarters back in order afterwards
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(low, high), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), packed);
+    }
+
+    return PatternRunScalar(out + i, count - i, levels, phase + step * i, step);
+}
+#endif
+
+static uint32_t PatternRun(int16_t *out, uint32_t count, const int32_t *levels, uint32_t phase, uint32_t step) {
+#ifdef AUDIO_X86
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+    if (hasAvx2) {
+        return PatternRunAvx2(out, count, levels, phase, step);
+    }
+#endif
+    return PatternRunScalar(out, count, levels, phase, step);
+}
+
+void Beeper::ApplyEvents(uint64_t sample) {
+    while (nextPatternChange < patternChanges.size() && patternChanges[nextPatternChange].sample <= sample) {
+        const PatternChange &change = patternChanges[nextPatternChange];
+        for (unsigned int bit = 0; bit < 128; ++bit) {
+            bool high = (change.pattern[bit / 8] >> (7 - bit % 8)) & 0x1u;
+            levels[bit] = static_cast<int32_t>(high ? AMPLITUDE : -AMPLITUDE);
+        }
+        patternStep = change.step;
+        patternMode = true;
+        ++nextPatternChange;
+    }
+
+    while (nextEdge < edges.size() && edges[nextEdge].sample <= sample) {
+        // Start every beep on the same phase so repeated beeps are identical
+        if (edges[nextEdge].on && !gate && envelope == 0.0f) {
+            phase = 0.0;
+            patternPhase = 0;
+        }
+        gate = edges[nextEdge].on;
+        ++nextEdge;
+    }
+}
+
+uint64_t Beeper::NextEvent() const {
+    uint64_t next = UINT64_MAX;
+    if (nextEdge < edges.size()) {
+        next = edges[nextEdge].sample;
+    }
+    if (nextPatternChange < patternChanges.size() && patternChanges[nextPatternChange].sample < next) {
+        next = patternChanges[nextPatternChange].sample;
+    }
+
+    return next;
+}
+
+void Beeper::Synthesize(int16_t *out, uint64_t start, uint32_t count) {
+    uint32_t i = 0;
+    while (i < count) {
+        ApplyEvents(start + i);
+
+        // A pattern playing at full level needs no per-sample decisions until the next event
+        if (patternMode && gate && envelope == 1.0f) {
+            uint64_t next = NextEvent();
+            uint32_t run = next - (start + i) < count - i ? static_cast<uint32_t>(next - (start + i)) : count - i;
+            patternPhase = PatternRun(out + i, run, levels, patternPhase, patternStep);
+            i += run;
+            continue;
+        }
+
+        if (gate) {
+            envelope = envelope + 1.0f / GATE_RAMP_SAMPLES < 1.0f ? envelope + 1.0f / GATE_RAMP_SAMPLES : 1.0f;
+        }
+        else {
+            envelope = envelope - 1.0f / GATE_RAMP_SAMPLES > 0.0f ? envelope - 1.0f / GATE_RAMP_SAMPLES : 0.0f;
+        }
+
+        if (envelope == 0.0f) {
+            out[i++] = 0;
+            continue;
+        }
+
+        if (patternMode) {
+            out[i++] = static_cast<int16_t>(static_cast<float>(levels[patternPhase >> 25u]) * envelope);
+            patternPhase += patternStep;
+            continue;
+        }
+
+        double value = phase < 0.5 ? 1.0 : -1.0;
+        value += PolyBlep(phase, phaseStep);
+        double falling = phase + 0.5;
+        value -= PolyBlep(falling >= 1.0 ? falling - 1.0 : falling, phaseStep);
+
+        out[i++] = static_cast<int16_t>(value * AMPLITUDE * envelope);
+
+        phase += phaseStep;
+        if (phase >= 1.0) {
+            phase -= 1.0;
+        }
+    }
+}
+
+void Beeper::Render(uint64_t cycle) {
+    uint64_t end = SampleAt(cycle);
+
+    while (cursor < end) {
+        uint32_t count = static_cast<uint32_t>(end - cursor < AUDIO_BLOCK_SAMPLES ? end - cursor : AUDIO_BLOCK_SAMPLES);
+
+        block.start = cursor;
+        block.count = count;
+        block.last = false;
+        // Nothing to play and nothing about to start - skip the synthesis entirely
+        block.silent = !gate && envelope == 0.0f && nextEdge == edges.size() &&
+                       nextPatternChange == patternChanges.size();
+
+        if (!block.silent) {
+            Synthesize(block.samples, cursor, count);
+        }
+
+        output.Push(block);
+        cursor += count;
+    }
+
+    // Edges at or before the cursor have all been applied
+    edges.erase(edges.begin(), edges.begin() + static_cast<ptrdiff_t>(nextEdge));
+    nextEdge = 0;
+    patternChanges.erase(patternChanges.begin(), patternChanges.begin() + static_cast<ptrdiff_t>(nextPatternChange));
+    nextPatternChange = 0;
+}
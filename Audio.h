@@ -0,0 +1,163 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "SpscRing.h"
+
+/**
+ * Where finished audio ends up. Write() is only ever called from the audio thread.
+ */
+class AudioSink {
+public:
+    virtual ~AudioSink() = default;
+
+    virtual void Write(const int16_t *samples, size_t count) = 0;
+};
+
+/**
+ * Discards everything, for headless runs that still want the synthesis cost.
+ */
+class NullAudioSink : public AudioSink {
+public:
+    void Write(const int16_t *, size_t) override {}
+};
+
+/**
+ * 16 bit mono PCM .wav file. The sizes in the header are filled in when the sink is destroyed.
+ */
+class WavAudioSink : public AudioSink {
+public:
+    WavAudioSink(const std::string &path, unsigned int sampleRate);
+
+    ~WavAudioSink() override;
+
+    bool IsOpen() const {
+        return file != nullptr;
+    }
+
+    void Write(const int16_t *samples, size_t count) override;
+
+private:
+    FILE *file = nullptr;
+    uint64_t dataBytes = 0;
+};
+
+// Largest block the emulation thread hands over at once; one frame at up to 96 kHz
+const unsigned int AUDIO_BLOCK_SAMPLES = 1600;
+
+struct AudioBlock {
+    // Position of the first sample on the emulated timeline
+    uint64_t start;
+    uint32_t count;
+    // Nothing but zeros, so samples was never filled in
+    bool silent;
+    bool last;
+    int16_t samples[AUDIO_BLOCK_SAMPLES];
+};
+
+/**
+ * Carries blocks from the emulation thread to a sink on a thread of its own, through a lock-free ring.
+ *
+ * Push() never waits: when the ring is full the block is dropped and counted. The sink still sees a continuous
+ * stream because the audio thread fills any hole in the timeline with silence.
+ */
+class AudioOutput {
+public:
+    explicit AudioOutput(std::unique_ptr<AudioSink> sink, size_t queueBlocks = 64);
+
+    ~AudioOutput();
+
+    bool Push(const AudioBlock &block);
+
+    uint64_t Dropped() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    void Drain();
+
+    std::unique_ptr<AudioSink> sink;
+    SpscRing<AudioBlock> queue;
+    std::thread thread;
+    std::atomic<uint64_t> dropped{0};
+};
+
+/**
+ * Synthesizes the CHIP-8 beep on the emulation thread.
+ *
+ * The emulator reports every change of the sound timer between zero and non-zero together with the cycle count it
+ * happened at. Samples are placed on a timeline derived purely from the cycle count, with one frame's worth of cycles
+ * lasting exactly 1/60 s, so the same ROM and input always produce bit-identical audio no matter how fast the host
+ * ran. The tone is a PolyBLEP square wave, which keeps the harmonics above Nyquist from folding back, and the gate
+ * opens and closes over a short ramp so edges don't click.
+ *
+ * Once an XO-CHIP ROM loads a 128 bit audio pattern the tone is replaced by the pattern, played one bit per step at
+ * 4000 * 2^((pitch - 64) / 48) steps a second. The pattern is resampled with a 32 bit phase accumulator whose top
+ * seven bits pick the bit, eight output samples at a time with an AVX2 gather where the CPU has it.
+ */
+class Beeper {
+public:
+    Beeper(AudioOutput &output, unsigned int sampleRate, unsigned int cyclesPerFrame, float frequency = 440.0f);
+
+    /**
+     * The sound timer became non-zero (on) or reached zero (off) at the given cycle.
+     */
+    void SetTone(bool on, uint64_t cycle);
+
+    /**
+     * An XO-CHIP ROM loaded a new audio pattern or changed its pitch at the given cycle.
+     */
+    void SetPattern(const uint8_t (&pattern)[16], uint8_t pitch, uint64_t cycle);
+
+    /**
+     * Synthesize everything up to the given cycle, normally the end of a frame, and hand it to the output.
+     */
+    void Render(uint64_t cycle);
+
+private:
+    struct Edge {
+        uint64_t sample;
+        bool on;
+    };
+
+    struct PatternChange {
+        uint64_t sample;
+        uint8_t pattern[16];
+        uint32_t step;
+    };
+
+    uint64_t SampleAt(uint64_t cycle) const;
+
+    void ApplyEvents(uint64_t sample);
+
+    uint64_t NextEvent() const;
+
+    void Synthesize(int16_t *out, uint64_t start, uint32_t count);
+
+    AudioOutput &output;
+    unsigned int sampleRate;
+    unsigned int cyclesPerFrame;
+    double phaseStep;
+    double phase = 0.0;
+    float envelope = 0.0f;
+    bool gate = false;
+    uint64_t cursor = 0;
+    std::vector<Edge> edges;
+    size_t nextEdge = 0;
+    std::vector<PatternChange> patternChanges;
+    size_t nextPatternChange = 0;
+    // Pattern playback: each entry is the output level for one bit of the pattern
+    bool patternMode = false;
+    int32_t levels[128]{};
+    uint32_t patternPhase = 0;
+    uint32_t patternStep = 0;
+    AudioBlock block{};
+};
+
+#endif //AUDIO_H
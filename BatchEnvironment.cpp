@@ -0,0 +1,133 @@
+#include "BatchEnvironment.h"
+#include <algorithm>
+#include <cstring>
+#include "Analyzer.h"
+#include "Frame.h"
+#include "Hash.h"
+#include "Verifier.h"
+
+BatchEnvironment::BatchEnvironment(const uint8_t *rom, size_t size, unsigned int count, const BatchConfig &config)
+        : config(config), pristine(std::make_unique<Chip8>()), episodes(count, 0), frames(count, 0),
+          previousReward(count, 0) {
+    pristine->LoadROM(rom, size);
+    verified = Verify(Analyze(rom, size)).safe;
+
+    machines.reserve(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        machines.push_back(std::make_unique<Chip8>());
+        ResetOne(i);
+    }
+
+    pool = ThreadPool::ForThreads(config.threads);
+
+    // A few chunks per thread, so threads that finish early can take more, without a handoff per environment
+    unsigned int threads = pool != nullptr ? pool->Size() : 1;
+    chunk = std::max(1u, count / (threads * 4));
+}
+
+size_t BatchEnvironment::ObservationSize() const {
+    return config.observation == Observation::Packed ? HIRES_VIDEO_HEIGHT * DISPLAY_ROW_BYTES
+                                                     : VIDEO_WIDTH * VIDEO_HEIGHT;
+}
+
+int32_t BatchEnvironment::RewardValue(const Chip8 &chip8) const {
+    if (config.rewardAddress < 0) {
+        return 0;
+    }
+
+    auto address = static_cast<uint16_t>(config.rewardAddress);
+    if (config.rewardBytes == 2) {
+        return (chip8.memory[address] << 8u) | chip8.memory[static_cast<uint16_t>(address + 1)];
+    }
+
+    return chip8.memory[address];
+}
+
+void BatchEnvironment::ResetOne(unsigned int i) {
+    Chip8 &chip8 = *machines[i];
+    memcpy(static_cast<void *>(&chip8), pristine.get(), sizeof(Chip8));
+
+    chip8.randGen.seed(static_cast<uint32_t>(HashMix(HashMix(config.seed, i), episodes[i])));
+    ++episodes[i];
+    frames[i] = 0;
+    previousReward[i] = RewardValue(chip8);
+}
+
+void BatchEnvironment::Observe(const Chip8 &chip8, uint8_t *out) const {
+    if (config.observation == Observation::Packed) {
+        PackDisplayHires(chip8, out);
+        return;
+    }
+
+    // Downsampled: one byte per pixel at 64x32, read from the display planes. In high resolution a pixel covers the
+    // two bits at 2x of rows 2y and 2y + 1.
+    auto row = [&chip8](unsigned int y, unsigned int byte) {
+        return static_cast<unsigned int>(chip8.display[0][y][byte] | chip8.display[1][y][byte]);
+    };
+
+    for (unsigned int y = 0; y < VIDEO_HEIGHT; ++y) {
+        for (unsigned int x = 0; x < VIDEO_WIDTH; ++x) {
+            unsigned int lit;
+            if (chip8.hires) {
+                unsigned int bits = row(2 * y, x / 4) | row(2 * y + 1, x / 4);
+                lit = (bits >> (6 - 2 * (x % 4))) & 0x3u;
+            }
+            else {
+                lit = (row(y, x / 8) >> (7 - x % 8)) & 0x1u;
+            }
+            out[y * VIDEO_WIDTH + x] = lit != 0;
+        }
+    }
+}
+
+void BatchEnvironment::StepRange(unsigned int first, unsigned int last, const uint16_t *actions,
+                                 uint8_t *observations, float *rewards, uint8_t *dones) {
+    size_t observationSize = ObservationSize();
+
+    for (unsigned int i = first; i < last; ++i) {
+        Chip8 &chip8 = *machines[i];
+
+        for (unsigned int key = 0; key < 16; ++key) {
+            chip8.keys[key] = (actions[i] >> key) & 0x1u;
+        }
+
+        chip8.RunFrame(config.cyclesPerFrame, verified);
+        ++frames[i];
+
+        int32_t reward = RewardValue(chip8);
+        rewards[i] = static_cast<float>(reward - previousReward[i]);
+        previousReward[i] = reward;
+
+        bool done = chip8.halted || chip8.trap != Trap::None ||
+                    (config.maxFrames > 0 && frames[i] >= config.maxFrames) ||
+                    (config.doneAddress >= 0 && chip8.memory[static_cast<uint16_t>(config.doneAddress)] == config.doneValue);
+        dones[i] = done;
+
+        if (done) {
+            ResetOne(i);
+        }
+
+        Observe(chip8, observations + i * observationSize);
+    }
+}
+
+void BatchEnvironment::Reset(uint8_t *observations) {
+    size_t observationSize = ObservationSize();
+
+    for (unsigned int i = 0; i < Count(); ++i) {
+        ResetOne(i);
+        Observe(*machines[i], observations + i * observationSize);
+    }
+}
+
+void BatchEnvironment::Step(const uint16_t *actions, uint8_t *observations, float *rewards, uint8_t *dones) {
+    unsigned int count = Count();
+    unsigned int pieces = (count + chunk - 1) / chunk;
+
+    auto stepPiece = [&](unsigned int piece) {
+        unsigned int first = piece * chunk;
+        StepRange(first, std::min(first + chunk, count), actions, observations, rewards, dones);
+    };
+
+    ParallelFor(pool.get(), pieces, stepPiece);
+}
@@ -0,0 +1,99 @@
+#ifndef BATCHENVIRONMENT_H
+#define BATCHENVIRONMENT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Chip8.h"
+#include "ThreadPool.h"
+
+enum class Observation {
+    // The display as 128x64 packed bits, 16 bytes a row with the most significant bit leftmost; low resolution is
+    // pixel-doubled so the geometry never changes
+    Packed,
+    // 64x32, a byte per pixel (0 or 1): low resolution as it is, high resolution with each 2x2 block ORed together
+    Downsampled
+};
+
+struct BatchConfig {
+    unsigned int cyclesPerFrame = 11;
+    // The reward for a step is how much the big-endian value of rewardBytes (1 or 2) bytes at rewardAddress went up;
+    // a negative address means no reward
+    int32_t rewardAddress = -1;
+    unsigned int rewardBytes = 1;
+    // An episode ends when the program halts or traps, after maxFrames frames (0 for no limit), or when the byte at
+    // doneAddress (if not negative) equals doneValue
+    int32_t doneAddress = -1;
+    uint8_t doneValue = 0;
+    uint64_t maxFrames = 0;
+    Observation observation = Observation::Packed;
+    // Environment i of episode e draws its random numbers from a generator seeded with seed, i and e
+    uint64_t seed = 0;
+    // Threads stepping the batch including the caller's; 0 for one per core
+    unsigned int threads = 0;
+};
+
+/**
+ * A batch of environments running the same ROM, for reinforcement learning.
+ *
+ * Step() advances every environment by one frame across the thread pool and writes observations, rewards and done
+ * flags straight into the caller's arrays - one contiguous row per environment - so the only per-step overhead is
+ * one call and one handoff to the pool for the whole batch. An environment whose episode ends is reset at once and
+ * its observation is the first of the new episode, as vectorised environments usually do it.
+ *
+ * Resets are a copy of a pristine machine with the ROM loaded. The ROM is verified once up front; a ROM proven in
+ * bounds runs unchecked, anything else runs checked and a trap ends the episode.
+ */
+class BatchEnvironment {
+public:
+    BatchEnvironment(const uint8_t *rom, size_t size, unsigned int count, const BatchConfig &config);
+
+    BatchEnvironment(const BatchEnvironment &) = delete;
+
+    BatchEnvironment &operator=(const BatchEnvironment &) = delete;
+
+    unsigned int Count() const {
+        return static_cast<unsigned int>(machines.size());
+    }
+
+    /**
+     * Bytes of observation per environment.
+     */
+    size_t ObservationSize() const;
+
+    /**
+     * Start a new episode in every environment and write the first observations.
+     */
+    void Reset(uint8_t *observations);
+
+    /**
+     * actions holds a key mask per environment (bit n for key n), held for the whole frame. observations is
+     * Count() * ObservationSize() bytes; rewards and dones one entry per environment.
+     */
+    void Step(const uint16_t *actions, uint8_t *observations, float *rewards, uint8_t *dones);
+
+private:
+    void ResetOne(unsigned int i);
+
+    void StepRange(unsigned int first, unsigned int last, const uint16_t *actions, uint8_t *observations,
+                   float *rewards, uint8_t *dones);
+
+    void Observe(const Chip8 &chip8, uint8_t *out) const;
+
+    int32_t RewardValue(const Chip8 &chip8) const;
+
+    BatchConfig config;
+    bool verified = false;
+    std::unique_ptr<Chip8> pristine;
+    std::vector<std::unique_ptr<Chip8>> machines;
+    std::vector<uint64_t> episodes;
+    std::vector<uint64_t> frames;
+    std::vector<int32_t> previousReward;
+    // None when stepping on the caller's thread alone
+    std::unique_ptr<ThreadPool> pool;
+    // Environments handed to a worker at a time
+    unsigned int chunk = 1;
+};
+
+#endif //BATCHENVIRONMENT_H
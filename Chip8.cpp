@@ -4,15 +4,27 @@
 
 #include "Chip8.h"
 #include "Font.h"
+#include "Trace.h"
 #include <fstream>
 #include <chrono>
 #include <random>
 #include <string.h>
+#include <type_traits>
 
 const unsigned int START_ADDRESS = 0x200;
 const unsigned int FONTSET_START_ADDRESS = 0x50;
+const unsigned int BIG_FONTSET_START_ADDRESS = 0xA0;
+
+Chip8::Chip8Func Chip8::table[0xF + 1];
+Chip8::Chip8Func Chip8::table8[0xF + 1];
+Chip8::Chip8Func Chip8::tableE[0xF + 1];
+Chip8::Chip8Func Chip8::tableF[0x85 + 1];
 
 Chip8::Chip8() : randGen(std::chrono::system_clock::now().time_since_epoch().count()) {
+    // The dispatch tables are shared by every instance, so only the first one to be constructed fills them in
+    static const bool tablesBuilt = BuildTables();
+    (void) tablesBuilt;
+
     // Initialize
     pc = START_ADDRESS;
 
@@ -22,6 +34,366 @@ Chip8::Chip8() : randGen(std::chrono::system_clock::now().time_since_epoch().cou
     for (unsigned int i = 0; i < FONTSET_SIZE; ++i) {
         memory[FONTSET_START_ADDRESS + i] = fontset[i];
     }
+
+    for (unsigned int i = 0; i < BIG_FONTSET_SIZE; ++i) {
+        memory[BIG_FONTSET_START_ADDRESS + i] = bigFontset[i];
+    }
+}
+
+/**
+ * Display rows are big-endian bit strings. Work on them as two words, left holding pixels 0-63 and right pixels
+ * 64-127, each with its leftmost pixel in the most significant bit.
+ */
+static uint64_t LoadWord(const uint8_t *bytes) {
+    uint64_t word = 0;
+
+    for (unsigned int i = 0; i < 8; ++i) {
+        word = (word << 8u) | bytes[i];
+    }
+
+    return word;
+}
+
+static void StoreWord(uint8_t *bytes, uint64_t word) {
+    for (unsigned int i = 0; i < 8; ++i) {
+        bytes[i] = static_cast<uint8_t>(word >> (56u - 8u * i));
+    }
+}
+
+/**
+ * Place a left-aligned 16 pixel sprite row with its first pixel at x, dropping whatever falls past width.
+ */
+static void SpriteMask(uint16_t sprite, unsigned int x, unsigned int width, uint64_t &left, uint64_t &right) {
+    // Position of the sprite's least significant bit counted from the right-hand end of the 128 pixel row
+    int shift = 112 - static_cast<int>(x);
+
+    if (shift >= 64) {
+        left = static_cast<uint64_t>(sprite) << (shift - 64);
+        right = 0;
+    }
+    else if (shift > 0) {
+        left = static_cast<uint64_t>(sprite) >> (64 - shift);
+        right = static_cast<uint64_t>(sprite) << shift;
+    }
+    else {
+        left = 0;
+        right = static_cast<uint64_t>(sprite) >> -shift;
+    }
+
+    // Low resolution rows end after the left word
+    if (width <= 64) {
+        right = 0;
+    }
+}
+
+/**
+ * Fill in the opcode dispatch tables. The first nibble picks an entry in table; opcodes that share a first nibble go
+ * through Table8/E/F, which index the second level tables by the low nibble or low byte. The 0 family is too sparse
+ * for a table and is decoded by Table0 directly.
+ */
+bool Chip8::BuildTables() {
+    table[0x0] = &Chip8::Table0;
+    table[0x1] = &Chip8::OP_1nnn;
+    table[0x2] = &Chip8::OP_2nnn;
+    table[0x3] = &Chip8::OP_3xkk;
+    table[0x4] = &Chip8::OP_4xkk;
+    table[0x5] = &Chip8::Table5;
+    table[0x6] = &Chip8::OP_6xkk;
+    table[0x7] = &Chip8::OP_7xkk;
+    table[0x8] = &Chip8::Table8;
+    table[0x9] = &Chip8::OP_9xy0;
+    table[0xA] = &Chip8::OP_Annn;
+    table[0xB] = &Chip8::OP_Bnnn;
+    table[0xC] = &Chip8::OP_Cxkk;
+    table[0xD] = &Chip8::OP_Dxyn;
+    table[0xE] = &Chip8::TableE;
+    table[0xF] = &Chip8::TableF;
+
+    for (size_t i = 0; i <= 0xF; ++i) {
+        table8[i] = &Chip8::OP_NULL;
+        tableE[i] = &Chip8::OP_NULL;
+    }
+
+    table8[0x0] = &Chip8::OP_8xy0;
+    table8[0x1] = &Chip8::OP_8xy1;
+    table8[0x2] = &Chip8::OP_8xy2;
+    table8[0x3] = &Chip8::OP_8xy3;
+    table8[0x4] = &Chip8::OP_8xy4;
+    table8[0x5] = &Chip8::OP_8xy5;
+    table8[0x6] = &Chip8::OP_8xy6;
+    table8[0x7] = &Chip8::OP_8xy7;
+    table8[0xE] = &Chip8::OP_8xyE;
+
+    tableE[0x1] = &Chip8::OP_ExA1;
+    tableE[0xE] = &Chip8::OP_Ex9E;
+
+    for (size_t i = 0; i <= 0x85; ++i) {
+        tableF[i] = &Chip8::OP_NULL;
+    }
+
+    tableF[0x00] = &Chip8::OP_F000;
+    tableF[0x01] = &Chip8::OP_Fn01;
+    tableF[0x02] = &Chip8::OP_F002;
+    tableF[0x07] = &Chip8::OP_Fx07;
+    tableF[0x0A] = &Chip8::OP_Fx0A;
+    tableF[0x15] = &Chip8::OP_Fx15;
+    tableF[0x18] = &Chip8::OP_Fx18;
+    tableF[0x1E] = &Chip8::OP_Fx1E;
+    tableF[0x29] = &Chip8::OP_Fx29;
+    tableF[0x30] = &Chip8::OP_Fx30;
+    tableF[0x33] = &Chip8::OP_Fx33;
+    tableF[0x3A] = &Chip8::OP_Fx3A;
+    tableF[0x55] = &Chip8::OP_Fx55;
+    tableF[0x65] = &Chip8::OP_Fx65;
+    tableF[0x75] = &Chip8::OP_Fx75;
+    tableF[0x85] = &Chip8::OP_Fx85;
+
+    return true;
+}
+
+void Chip8::Cycle() {
+    opcode = (memory[pc] << 8u) | memory[static_cast<uint16_t>(pc + 1)];
+
+    trap = Check();
+    if (trap != Trap::None) {
+        return;
+    }
+
+    pc += 2;
+    ((*this).*(table[(opcode & 0xF000u) >> 12u]))();
+
+    ++cycles;
+}
+
+unsigned int Chip8::Run(unsigned int count, unsigned int cyclesPerFrame, bool verified) {
+    uint64_t frameEnd = (cycles / cyclesPerFrame + 1) * cyclesPerFrame;
+    unsigned int executed = 0;
+
+    while (executed < count && !halted && trap == Trap::None) {
+        if (verified) {
+            CycleUnchecked();
+        }
+        else {
+            Cycle();
+            if (trap != Trap::None) {
+                break;
+            }
+        }
+        ++executed;
+
+        if (cycles == frameEnd) {
+            TickTimers();
+            frameEnd += cyclesPerFrame;
+        }
+    }
+
+    return executed;
+}
+
+void Chip8::CycleUnchecked() {
+    // Fetch - instructions are two bytes, stored big-endian. Addresses wrap at the top of memory.
+    opcode = (memory[pc] << 8u) | memory[static_cast<uint16_t>(pc + 1)];
+
+    // Increment the pc before we execute anything so jumps and skips can overwrite it
+    pc += 2;
+
+    // Decode and execute
+    ((*this).*(table[(opcode & 0xF000u) >> 12u]))();
+
+    ++cycles;
+}
+
+/**
+ * The only accesses that can go out of bounds are the stack and the keys; every memory access goes through a 16 bit
+ * address. Only three opcode families touch those, so most instructions pay for a single compare.
+ */
+Trap Chip8::Check() const {
+    switch (opcode >> 12u) {
+        case 0x0:
+            return opcode == 0x00EE && sp == 0 ? Trap::StackUnderflow : Trap::None;
+        case 0x2:
+            return sp >= 16 ? Trap::StackOverflow : Trap::None;
+        case 0xE: {
+            // TableE dispatches on the low nibble alone, so match what it would run rather than the full mnemonic
+            uint8_t low = opcode & 0x000Fu;
+            bool keyOp = low == 0xE || low == 0x1;
+            return keyOp && registers[(opcode & 0x0F00u) >> 8u] > 15 ? Trap::KeyOutOfRange : Trap::None;
+        }
+        default:
+            return Trap::None;
+    }
+}
+
+/**
+ * Decrement the delay and sound timers. Called at 60Hz by whatever is driving the emulator, independent of how
+ * many instructions run per frame.
+ */
+void Chip8::TickTimers() {
+    Trace::Instant("timers", "emulation", "sound", soundTimer);
+
+    if (delayTimer > 0) {
+        --delayTimer;
+    }
+
+    if (soundTimer > 0) {
+        --soundTimer;
+    }
+}
+
+void Chip8::Table0() {
+    switch (opcode) {
+        case 0x00E0: OP_00E0(); return;
+        case 0x00EE: OP_00EE(); return;
+        case 0x00FB: OP_00FB(); return;
+        case 0x00FC: OP_00FC(); return;
+        case 0x00FD: OP_00FD(); return;
+        case 0x00FE: OP_00FE(); return;
+        case 0x00FF: OP_00FF(); return;
+        default: break;
+    }
+
+    if ((opcode & 0xFFF0u) == 0x00C0u) {
+        OP_00Cn();
+    }
+}
+
+/**
+ * Note a store of length bytes at address. Stores are at most 16 bytes, so they touch at most two pages.
+ */
+void Chip8::MarkDirty(uint16_t address, unsigned int length) {
+    uint16_t last = address + length - 1;
+    dirtyPages |= (1ull << (address >> DIRTY_PAGE_BITS)) | (1ull << (last >> DIRTY_PAGE_BITS));
+}
+
+/**
+ * Skip the next instruction, which is four bytes long if it is F000 nnnn.
+ */
+void Chip8::SkipNextInstruction() {
+    if (memory[pc] == 0xF0 && memory[static_cast<uint16_t>(pc + 1)] == 0x00) {
+        pc += 4;
+    }
+    else {
+        pc += 2;
+    }
+}
+
+void Chip8::Table5() {
+    switch (opcode & 0x000Fu) {
+        case 0x0: OP_5xy0(); return;
+        case 0x2: OP_5xy2(); return;
+        case 0x3: OP_5xy3(); return;
+        default: return;
+    }
+}
+
+void Chip8::Table8() {
+    ((*this).*(table8[opcode & 0x000Fu]))();
+}
+
+void Chip8::TableE() {
+    ((*this).*(tableE[opcode & 0x000Fu]))();
+}
+
+void Chip8::TableF() {
+    uint8_t low = opcode & 0x00FFu;
+
+    // Low bytes past the last F opcode would run off the end of the table
+    if (low > 0x85) {
+        return;
+    }
+
+    ((*this).*(tableF[low]))();
+}
+
+/**
+ * Unknown opcodes are ignored.
+ */
+void Chip8::OP_NULL() {}
+
+/**
+ * F000 nnnn - LD I, long addr
+ *
+ * Set I = the 16 bit address in the following two bytes.
+ */
+void Chip8::OP_F000() {
+    index = (memory[pc] << 8u) | memory[static_cast<uint16_t>(pc + 1)];
+    pc += 2;
+}
+
+/**
+ * Fn01 - PLANE n
+ *
+ * Select the bitplanes drawn to, cleared and scrolled by later instructions.
+ */
+void Chip8::OP_Fn01() {
+    selectedPlanes = (opcode & 0x0F00u) >> 8u & 0x3u;
+}
+
+/**
+ * F002 - AUDIO
+ *
+ * Load the 16 byte audio pattern from memory starting at location I.
+ */
+void Chip8::OP_F002() {
+    for (unsigned int i = 0; i < 16; ++i)
+    {
+        audioPattern[i] = memory[static_cast<uint16_t>(index + i)];
+    }
+
+    hasAudioPattern = true;
+    ++audioChanges;
+}
+
+/**
+ * Fx3A - PITCH Vx
+ *
+ * Set the audio pattern playback pitch = Vx.
+ */
+void Chip8::OP_Fx3A() {
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+
+    pitch = registers[Vx];
+    ++audioChanges;
+}
+
+/**
+ * Fx85 - LD Vx, R
+ *
+ * Read registers V0 through Vx from the RPL user flags.
+ */
+void Chip8::OP_Fx85() {
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+
+    for (uint8_t i = 0; i <= Vx; ++i)
+    {
+        registers[i] = flags[i];
+    }
+}
+
+/**
+ * Fx75 - LD R, Vx
+ *
+ * Store registers V0 through Vx in the RPL user flags.
+ */
+void Chip8::OP_Fx75() {
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+
+    for (uint8_t i = 0; i <= Vx; ++i)
+    {
+        flags[i] = registers[i];
+    }
+}
+
+/**
+ * Fx30 - LD HF, Vx
+ *
+ * Set I = location of the 8x10 sprite for digit Vx.
+ */
+void Chip8::OP_Fx30() {
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t digit = registers[Vx] & 0x0Fu;
+
+    index = BIG_FONTSET_START_ADDRESS + (10 * digit);
 }
 
 /**
@@ -35,7 +407,7 @@ void Chip8::OP_Fx65()
 
     for (uint8_t i = 0; i <= Vx; ++i)
     {
-        registers[i] = memory[index + i];
+        registers[i] = memory[static_cast<uint16_t>(index + i)];
     }
 }
 
@@ -49,8 +421,10 @@ void Chip8::OP_Fx55() {
 
     for (uint8_t i = 0; i <= Vx; ++i)
     {
-        memory[index + i] = registers[i];
+        memory[static_cast<uint16_t>(index + i)] = registers[i];
     }
+
+    MarkDirty(index, Vx + 1);
 }
 
 /**
@@ -63,15 +437,17 @@ void Chip8::OP_Fx33() {
     uint8_t value = registers[Vx];
 
     // Ones-place
-    memory[index + 2] = value % 10;
+    memory[static_cast<uint16_t>(index + 2)] = value % 10;
     value /= 10;
 
     // Tens-place
-    memory[index + 1] = value % 10;
+    memory[static_cast<uint16_t>(index + 1)] = value % 10;
     value /= 10;
 
     // Hundreds-place
     memory[index] = value % 10;
+
+    MarkDirty(index, 3);
 }
 
 /**
@@ -204,7 +580,7 @@ void Chip8::OP_ExA1() {
 
     if (!keys[key])
     {
-        pc += 2;
+        SkipNextInstruction();
     }
 }
 
@@ -221,7 +597,7 @@ void Chip8::OP_Ex9E() {
 
     if (keys[key])
     {
-        pc += 2;
+        SkipNextInstruction();
     }
 }
 
@@ -229,43 +605,67 @@ void Chip8::OP_Ex9E() {
 /**
  * Dxyn - DRW Vx, Vy, nibble
  *
- * Display n-byte sprite starting at memory location I at (Vx, Vy), set VF = collision.
+ * Display n-byte sprite starting at memory location I at (Vx, Vy), set VF = collision. Dxy0 draws a 16x16 sprite,
+ * two bytes per row. With both XO-CHIP planes selected the second plane's sprite follows the first's in memory.
  */
 void Chip8::OP_Dxyn() {
+    TraceSpan span("Dxyn", "emulation");
+    displayDirty = true;
+
     uint8_t Vx = (opcode & 0x0F00u) >> 8u;
     uint8_t Vy = (opcode & 0x00F0u) >> 4u;
     uint8_t height = opcode & 0x000Fu;
 
-    // Wrap if going beyond screen boundaries
-    uint8_t xPos = registers[Vx] % VIDEO_WIDTH;
-    uint8_t yPos = registers[Vy] % VIDEO_HEIGHT;
+    unsigned int width = DisplayWidth();
+    unsigned int screenHeight = DisplayHeight();
+
+    // Wrap the starting position if going beyond screen boundaries; the rest of the sprite is clipped at the edges
+    unsigned int xPos = registers[Vx] % width;
+    unsigned int yPos = registers[Vy] % screenHeight;
+
+    bool wide = height == 0;
+    unsigned int rows = wide ? 16 : height;
+    unsigned int rowBytes = wide ? 2 : 1;
 
     registers[0xF] = 0;
 
-    for (unsigned int row = 0; row < height; ++row)
+    uint16_t address = index;
+
+    for (unsigned int plane = 0; plane < DISPLAY_PLANES; ++plane)
     {
-        uint8_t spriteByte = memory[index + row];
+        if (!(selectedPlanes & (1u << plane)))
+        {
+            continue;
+        }
 
-        for (unsigned int col = 0; col < 8; ++col)
+        for (unsigned int row = 0; row < rows && yPos + row < screenHeight; ++row)
         {
-            // This is effectively iterating over each byte in the sprite
-            uint8_t spritePixel = spriteByte & (0x80u >> col);
-            // This is a neat trick to map (x,y) cord to a single dimension array
-            uint32_t* screenPixel = &display[(yPos + row) * VIDEO_WIDTH + (xPos + col)];
+            // Each sprite row is XORed into the screen row as a whole, a word at a time
+            uint16_t spriteAddress = address + row * rowBytes;
+            uint16_t spriteRow = memory[spriteAddress] << 8u;
+            if (wide)
+            {
+                spriteRow |= memory[static_cast<uint16_t>(spriteAddress + 1)];
+            }
 
-            // Sprite pixel is on
-            if (spritePixel)
+            uint64_t spriteLeft, spriteRight;
+            SpriteMask(spriteRow, xPos, width, spriteLeft, spriteRight);
+
+            uint8_t *screenRow = display[plane][yPos + row];
+            uint64_t screenLeft = LoadWord(screenRow);
+            uint64_t screenRight = LoadWord(screenRow + 8);
+
+            // Any sprite pixel landing on a lit screen pixel is a collision
+            if ((screenLeft & spriteLeft) | (screenRight & spriteRight))
             {
-                // Screen pixel also on - collision
-                if (*screenPixel == 0xFFFFFFFF)
-                {
-                    registers[0xF] = 1;
-                }
-
-                // Effectively XOR with the sprite pixel
-                *screenPixel ^= 0xFFFFFFFF;
+                registers[0xF] = 1;
             }
+
+            StoreWord(screenRow, screenLeft ^ spriteLeft);
+            StoreWord(screenRow + 8, screenRight ^ spriteRight);
         }
+
+        address += rows * rowBytes;
     }
 }
 
@@ -314,7 +714,7 @@ void Chip8::OP_9xy0() {
 
     if (registers[Vx] != registers[Vy])
     {
-        pc += 2;
+        SkipNextInstruction();
     }
 }
 
@@ -486,6 +886,42 @@ void Chip8::OP_6xkk() {
     registers[Vx] = byte;
 }
 
+/**
+ * 5xy2 - SAVE Vx - Vy
+ *
+ * Store registers Vx through Vy in memory starting at location I, in reverse order if x > y. I is not changed.
+ */
+void Chip8::OP_5xy2() {
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+    int step = Vx <= Vy ? 1 : -1;
+    unsigned int count = (Vx <= Vy ? Vy - Vx : Vx - Vy) + 1;
+
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        memory[static_cast<uint16_t>(index + i)] = registers[Vx + step * static_cast<int>(i)];
+    }
+
+    MarkDirty(index, count);
+}
+
+/**
+ * 5xy3 - LOAD Vx - Vy
+ *
+ * Read registers Vx through Vy from memory starting at location I, in reverse order if x > y. I is not changed.
+ */
+void Chip8::OP_5xy3() {
+    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+    int step = Vx <= Vy ? 1 : -1;
+    unsigned int count = (Vx <= Vy ? Vy - Vx : Vx - Vy) + 1;
+
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        registers[Vx + step * static_cast<int>(i)] = memory[static_cast<uint16_t>(index + i)];
+    }
+}
+
 /**
  * 5xy0 - SE Vx, Vy
  *
@@ -497,7 +933,7 @@ void Chip8::OP_5xy0() {
 
     if (registers[Vx] == registers[Vy])
     {
-        pc += 2;
+        SkipNextInstruction();
     }
 }
 
@@ -514,7 +950,7 @@ void Chip8::OP_4xkk() {
 
     // If the value at the register is not equal to the passed byte, skip the next instruction.
     if (registers[Vx] != byte) {
-        pc += 2;
+        SkipNextInstruction();
     }
 }
 
@@ -532,7 +968,7 @@ void Chip8::OP_3xkk() {
 
     // If the value in the passed register is equal to the value passed, skip the next instruction.
     if (registers[Vx] == byte) {
-        pc += 2;
+        SkipNextInstruction();
     }
 
 }
@@ -578,20 +1014,137 @@ void Chip8::OP_00EE() {
 /**
  * CLS
  *
- * Clear The Display
+ * Clear The Display (the selected planes of it)
  */
 void Chip8::OP_00E0() {
-    // This is very c. Need to see if there is a better way to do this.
+    displayDirty = true;
+
+    for (unsigned int plane = 0; plane < DISPLAY_PLANES; ++plane) {
+        if (selectedPlanes & (1u << plane)) {
+            memset(display[plane], 0, sizeof(display[plane]));
+        }
+    }
+}
+
+/**
+ * 00Cn - SCD nibble
+ *
+ * Scroll the display down n rows. Rows are contiguous, so this is a single memmove.
+ */
+void Chip8::OP_00Cn() {
+    displayDirty = true;
+
+    unsigned int n = opcode & 0x000Fu;
+    unsigned int screenHeight = DisplayHeight();
+
+    for (unsigned int plane = 0; plane < DISPLAY_PLANES; ++plane) {
+        if (selectedPlanes & (1u << plane)) {
+            memmove(display[plane][n], display[plane][0], (screenHeight - n) * DISPLAY_ROW_BYTES);
+            memset(display[plane][0], 0, n * DISPLAY_ROW_BYTES);
+        }
+    }
+}
+
+/**
+ * 00FB - SCR
+ *
+ * Scroll the display right 4 pixels.
+ */
+void Chip8::OP_00FB() {
+    displayDirty = true;
+
+    for (unsigned int plane = 0; plane < DISPLAY_PLANES; ++plane) {
+        if (!(selectedPlanes & (1u << plane))) {
+            continue;
+        }
+
+        for (unsigned int y = 0; y < DisplayHeight(); ++y) {
+            uint8_t *row = display[plane][y];
+            uint64_t left = LoadWord(row);
+            uint64_t right = LoadWord(row + 8);
+
+            // Shift the whole 128 bit row; in low resolution whatever crosses into the right word is off screen
+            right = hires ? (right >> 4u) | (left << 60u) : 0;
+            left >>= 4u;
+
+            StoreWord(row, left);
+            StoreWord(row + 8, right);
+        }
+    }
+}
+
+/**
+ * 00FC - SCL
+ *
+ * Scroll the display left 4 pixels.
+ */
+void Chip8::OP_00FC() {
+    displayDirty = true;
+
+    for (unsigned int plane = 0; plane < DISPLAY_PLANES; ++plane) {
+        if (!(selectedPlanes & (1u << plane))) {
+            continue;
+        }
+
+        for (unsigned int y = 0; y < DisplayHeight(); ++y) {
+            uint8_t *row = display[plane][y];
+            uint64_t left = LoadWord(row);
+            uint64_t right = LoadWord(row + 8);
+
+            left = (left << 4u) | (right >> 60u);
+            right <<= 4u;
+
+            StoreWord(row, left);
+            StoreWord(row + 8, right);
+        }
+    }
+}
+
+/**
+ * 00FD - EXIT
+ *
+ * Stop the program. The pc stays on this instruction.
+ */
+void Chip8::OP_00FD() {
+    halted = true;
+    pc -= 2;
+}
+
+/**
+ * 00FE - LOW
+ *
+ * Switch to 64x32 and clear the display.
+ */
+void Chip8::OP_00FE() {
+    displayDirty = true;
+
+    hires = false;
     memset(display, 0, sizeof(display));
 }
 
-void Chip8::LoadROM(char const* filename) {
+/**
+ * 00FF - HIGH
+ *
+ * Switch to 128x64 and clear the display.
+ */
+void Chip8::OP_00FF() {
+    displayDirty = true;
+
+    hires = true;
+    memset(display, 0, sizeof(display));
+}
+
+bool Chip8::LoadROM(char const* filename) {
     // Open the file as a stream of binary and move the file pointer to the end
     std::ifstream file(filename, std::ios::binary | std::ios::ate);
 
-    if (!file.is_open()) {
-        // Get size of file and allocate a buffer to hold the contents
+    if (file.is_open()) {
+        // Get size of file and allocate a buffer to hold the contents. Anything that does not fit between the start
+        // address and the end of memory is dropped.
         std::streampos size = file.tellg();
+        if (size > static_cast<std::streampos>(sizeof(memory) - START_ADDRESS)) {
+            size = sizeof(memory) - START_ADDRESS;
+        }
         char* buffer = new char[size];
 
         // Go back to the beginning of the file and fill the buffer
@@ -599,11 +1152,52 @@ void Chip8::LoadROM(char const* filename) {
         file.read(buffer, size);
         file.close();
 
-        // Move the contents we read into the memory of the emulator starting at the correct starting address.
-        for (long i = 0; i < size; ++i) {
-            memory[START_ADDRESS + i] = buffer[i];
-        }
+        LoadROM(reinterpret_cast<const uint8_t *>(buffer), static_cast<size_t>(size));
 
         delete[] buffer;
+
+        return true;
     }
-}
\ No newline at end of file
+
+    return false;
+}
+
+void Chip8::LoadROM(const uint8_t *rom, size_t size) {
+    if (size > sizeof(memory) - START_ADDRESS) {
+        size = sizeof(memory) - START_ADDRESS;
+    }
+
+    // Move the ROM into the memory of the emulator starting at the correct starting address.
+    memcpy(&memory[START_ADDRESS], rom, size);
+    dirtyPages = ~0ull;
+}
+
+static_assert(std::is_trivially_copyable_v<Chip8>, "Chip8State copies a Chip8 bytewise");
+
+void Chip8State::Capture(const Chip8 &chip8) {
+    auto *in = reinterpret_cast<const uint8_t *>(&chip8);
+    memcpy(bytes, in, MEMORY_OFFSET);
+    memcpy(bytes + MEMORY_OFFSET, in + MEMORY_END, sizeof(Chip8) - MEMORY_END);
+}
+
+void Chip8State::Restore(Chip8 &chip8) const {
+    auto *out = reinterpret_cast<uint8_t *>(&chip8);
+    memcpy(out, bytes, MEMORY_OFFSET);
+    memcpy(out + MEMORY_END, bytes + MEMORY_OFFSET, sizeof(Chip8) - MEMORY_END);
+}
+
+/**
+ * Zero the member of size bytes at offset in Chip8, which in bytes sits MEMORY_SIZE earlier if it comes after memory.
+ */
+static void ClearMember(uint8_t *bytes, size_t offset, size_t size) {
+    memset(bytes + (offset < Chip8State::MEMORY_OFFSET ? offset : offset - MEMORY_SIZE), 0, size);
+}
+
+void Chip8State::ClearCounters() {
+    ClearMember(bytes, offsetof(Chip8, cycles), sizeof(Chip8::cycles));
+    ClearMember(bytes, offsetof(Chip8, opcode), sizeof(Chip8::opcode));
+    ClearMember(bytes, offsetof(Chip8, trap), sizeof(Chip8::trap));
+    ClearMember(bytes, offsetof(Chip8, audioChanges), sizeof(Chip8::audioChanges));
+    ClearMember(bytes, offsetof(Chip8, dirtyPages), sizeof(Chip8::dirtyPages));
+    ClearMember(bytes, offsetof(Chip8, displayDirty), sizeof(Chip8::displayDirty));
+}
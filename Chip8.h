@@ -5,18 +5,46 @@
 #ifndef CHIP8_H
 #define CHIP8_H
 
+#include <cstddef>
 #include <cstdint>
 #include <random>
 
 const unsigned int VIDEO_HEIGHT = 32;
 const unsigned int VIDEO_WIDTH = 64;
 
+// SUPER-CHIP high resolution mode
+const unsigned int HIRES_VIDEO_HEIGHT = 64;
+const unsigned int HIRES_VIDEO_WIDTH = 128;
+
+// The display is stored as packed rows wide enough for high resolution: one bit per pixel, most significant bit of
+// the first byte leftmost. In low resolution only the top-left 64x32 is used.
+const unsigned int DISPLAY_ROW_BYTES = HIRES_VIDEO_WIDTH / 8;
+
+// XO-CHIP draws on two bitplanes
+const unsigned int DISPLAY_PLANES = 2;
+
+// XO-CHIP extends memory to the whole 16 bit address space
+const unsigned int MEMORY_SIZE = 0x10000;
+
+// Memory is tracked for changes in 1KiB pages, 64 of them
+const unsigned int DIRTY_PAGE_BITS = 10;
+
+// Why checked execution stopped the program. Memory needs no check: addresses are 16 bits and memory covers them all.
+enum class Trap : uint8_t {
+    None,
+    // 2nnn with all sixteen stack entries in use
+    StackOverflow,
+    // 00EE with nothing on the stack
+    StackUnderflow,
+    // Ex9E or ExA1 on a register holding more than 15
+    KeyOutOfRange
+};
 
 
 class Chip8 {
 public:
     uint8_t registers[16]{};
-    uint8_t memory[4096]{};
+    uint8_t memory[MEMORY_SIZE]{};
     uint16_t index{};
     uint16_t pc{};
     uint16_t stack[16]{};
@@ -24,13 +52,106 @@ public:
     uint8_t delayTimer{};
     uint8_t soundTimer{};
     uint8_t keys[16]{};
-    uint32_t display[VIDEO_WIDTH * VIDEO_HEIGHT]{};
+    uint8_t display[DISPLAY_PLANES][HIRES_VIDEO_HEIGHT][DISPLAY_ROW_BYTES]{};
+    // SUPER-CHIP state: 128x64 mode, the RPL user flags saved by Fx75, and 00FD having stopped the program
+    bool hires{};
+    uint8_t flags[16]{};
+    bool halted{};
+    // XO-CHIP state: bit n set when plane n is drawn to, the 1 bit audio pattern loaded by F002 and its pitch
+    uint8_t selectedPlanes{1};
+    uint8_t audioPattern[16]{};
+    uint8_t pitch{64};
+    bool hasAudioPattern{};
+    // Bumped whenever the pattern or pitch changes, so the audio side can notice without comparing them
+    uint32_t audioChanges{};
     uint16_t opcode{};
+    // Instructions executed since power on
+    uint64_t cycles{};
+    // Set by Cycle() instead of executing an instruction that would go out of bounds
+    Trap trap{};
+    // Bit n set when memory page n has been written, and whether the display has changed, since whoever watches for
+    // changes (the Watchdog) last cleared them. Anything that writes memory or the display from outside sets them too.
+    uint64_t dirtyPages{~0ull};
+    bool displayDirty{true};
     std::default_random_engine randGen;
     std::uniform_int_distribution<uint8_t> randByte;
 
     Chip8();
 
+    unsigned int DisplayWidth() const {
+        return hires ? HIRES_VIDEO_WIDTH : VIDEO_WIDTH;
+    }
+
+    unsigned int DisplayHeight() const {
+        return hires ? HIRES_VIDEO_HEIGHT : VIDEO_HEIGHT;
+    }
+
+    /**
+     * Fetch, decode and execute one instruction, trapping instead of indexing the stack or keys out of bounds. A
+     * trapping instruction is not executed or counted in cycles: pc stays on it, so the program makes no further
+     * progress.
+     */
+    void Cycle();
+
+    /**
+     * Cycle() without the checks, for ROMs the Verifier has proven never need them.
+     */
+    void CycleUnchecked();
+
+    /**
+     * Execute up to count instructions the way every frontend and host runs a program: with CycleUnchecked() for a
+     * ROM the Verifier proved (verified), with Cycle() otherwise, and the timers ticking each time cycles reaches a
+     * multiple of cyclesPerFrame. Stops early once the program has halted or trapped; a stopped machine runs nothing
+     * more and its timers stop with it. Returns the number of instructions executed.
+     */
+    unsigned int Run(unsigned int count, unsigned int cyclesPerFrame, bool verified);
+
+    /**
+     * Run() to the end of the current frame, timer tick included.
+     */
+    unsigned int RunFrame(unsigned int cyclesPerFrame, bool verified) {
+        return Run(cyclesPerFrame - static_cast<unsigned int>(cycles % cyclesPerFrame), cyclesPerFrame, verified);
+    }
+
+    /**
+     * Execute up to count instructions, giving the hook a look before and after each one; either side returning true
+     * stops the run. Returns the number of instructions executed, leaving out one that trapped. Only tools that need
+     * to watch every instruction (the debugger) instantiate this - the plain Run() above carries no instrumentation at
+     * all.
+     */
+    template <typename Hook>
+    unsigned int Run(unsigned int count, Hook &hook) {
+        for (unsigned int i = 0; i < count; ++i) {
+            if (hook.Before(*this)) {
+                return i;
+            }
+
+            Cycle();
+
+            if (hook.After(*this)) {
+                return trap != Trap::None ? i : i + 1;
+            }
+        }
+
+        return count;
+    }
+
+    void TickTimers();
+
+    void OP_F000();
+
+    void OP_Fn01();
+
+    void OP_F002();
+
+    void OP_Fx3A();
+
+    void OP_Fx85();
+
+    void OP_Fx75();
+
+    void OP_Fx30();
+
     void OP_Fx65();
 
     void OP_Fx55();
@@ -87,6 +208,10 @@ public:
 
     void OP_5xy0();
 
+    void OP_5xy2();
+
+    void OP_5xy3();
+
     void OP_4xkk();
 
     void OP_3xkk();
@@ -99,9 +224,77 @@ public:
 
     void OP_00E0();
 
-    void LoadROM(char const *filename);
+    void OP_00Cn();
+
+    void OP_00FB();
+
+    void OP_00FC();
+
+    void OP_00FD();
+
+    void OP_00FE();
+
+    void OP_00FF();
+
+    bool LoadROM(char const *filename);
+
+    /**
+     * Load a ROM already in memory. Like the file version, anything past the end of memory is dropped.
+     */
+    void LoadROM(const uint8_t *rom, size_t size);
+
+private:
+    typedef void (Chip8::*Chip8Func)();
+
+    static Chip8Func table[0xF + 1];
+    static Chip8Func table8[0xF + 1];
+    static Chip8Func tableE[0xF + 1];
+    static Chip8Func tableF[0x85 + 1];
+
+    static bool BuildTables();
+
+    Trap Check() const;
+
+    void MarkDirty(uint16_t address, unsigned int length);
+
+    void SkipNextInstruction();
+
+    void Table0();
+
+    void Table5();
+
+    void Table8();
+
+    void TableE();
+
+    void TableF();
+
+    void OP_NULL();
 };
 
+/**
+ * Everything in a Chip8 but its memory, for snapshots that keep memory their own way (Timeline's keyframes, the
+ * Explorer's states). It is the bytes either side of memory copied whole, so any member added to Chip8 is part of it.
+ */
+struct Chip8State {
+    static const size_t MEMORY_OFFSET = offsetof(Chip8, memory);
+    static const size_t MEMORY_END = MEMORY_OFFSET + MEMORY_SIZE;
+
+    uint8_t bytes[sizeof(Chip8) - MEMORY_SIZE];
+
+    void Capture(const Chip8 &chip8);
+
+    /**
+     * Overwrite all of chip8 but its memory, dirtyPages and displayDirty included.
+     */
+    void Restore(Chip8 &chip8) const;
+
+    /**
+     * Zero what HashState() leaves out besides the keys - cycles, opcode, trap, audioChanges, dirtyPages and
+     * displayDirty - so that two captures cleared this way memcmp equal when the machines outside memory are the same.
+     */
+    void ClearCounters();
+};
 
 
 #endif //CHIP8_H
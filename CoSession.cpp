@@ -0,0 +1,148 @@
+#include "CoSession.h"
+#include <algorithm>
+
+CoSession::CoSession(Executor &executor, std::unique_ptr<Chip8> chip8, bool verified, unsigned int cyclesPerFrame)
+        : executor(executor), chip8(std::move(chip8)), verified(verified), cyclesPerFrame(cyclesPerFrame) {
+    emulation = executor.Spawn(Emulate());
+}
+
+CoSession::~CoSession() {
+    if (emulation) {
+        executor.Cancel(emulation);
+    }
+}
+
+void CoSession::VBlankAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    // A parked session has no frames of its own, but the clock still ticks
+    if (session.parked) {
+        session.executor.WaitFrame(handle);
+    }
+    else {
+        session.vblankWaiters.push_back(handle);
+    }
+}
+
+void CoSession::CyclesAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    session.cycleWaiters.push_back(CycleWaiter{target, handle});
+    // Spinning in Fx0A counts towards the target, so it can't be slept through
+    session.Unpark();
+}
+
+void CoSession::KeyEventAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    session.keyWaiters.push_back(KeyWaiter{handle, &event});
+}
+
+void CoSession::SetKeys(uint16_t newKeys) {
+    uint16_t changed = keys ^ newKeys;
+    keys = newKeys;
+    if (changed == 0) {
+        return;
+    }
+
+    // Several keys changing at once are reported as the lowest of them; Keys() has the rest
+    auto key = static_cast<unsigned int>(__builtin_ctz(changed));
+    KeyEvent event{static_cast<uint8_t>(key), ((newKeys >> key) & 0x1u) != 0};
+    for (KeyWaiter &waiter : keyWaiters) {
+        *waiter.event = event;
+        executor.Schedule(waiter.handle);
+    }
+    keyWaiters.clear();
+
+    Unpark();
+}
+
+void CoSession::Unpark() {
+    if (parked) {
+        executor.Schedule(parked);
+        parked = nullptr;
+    }
+}
+
+bool CoSession::Blocked() const {
+    uint16_t instruction = (chip8->memory[chip8->pc] << 8u) | chip8->memory[static_cast<uint16_t>(chip8->pc + 1)];
+    return keys == 0 && (instruction & 0xF0FFu) == 0xF00Au && cycleWaiters.empty();
+}
+
+bool CoSession::WakeCycleWaiters() {
+    auto due = std::partition(cycleWaiters.begin(), cycleWaiters.end(), [this](const CycleWaiter &waiter) {
+        return waiter.target > chip8->cycles;
+    });
+    if (due == cycleWaiters.end()) {
+        return false;
+    }
+
+    for (auto waiter = due; waiter != cycleWaiters.end(); ++waiter) {
+        executor.Schedule(waiter->handle);
+    }
+    cycleWaiters.erase(due, cycleWaiters.end());
+    return true;
+}
+
+void CoSession::WakeAll() {
+    for (std::coroutine_handle<> handle : vblankWaiters) {
+        executor.Schedule(handle);
+    }
+    for (CycleWaiter &waiter : cycleWaiters) {
+        executor.Schedule(waiter.handle);
+    }
+    for (KeyWaiter &waiter : keyWaiters) {
+        executor.Schedule(waiter.handle);
+    }
+    vblankWaiters.clear();
+    cycleWaiters.clear();
+    keyWaiters.clear();
+}
+
+Task CoSession::Emulate() {
+    while (!Ended()) {
+        for (unsigned int key = 0; key < 16; ++key) {
+            chip8->keys[key] = (keys >> key) & 0x1u;
+        }
+
+        // Run the frame in pieces that end wherever a Cycles() waiter is due, and let it look at the machine there.
+        // Chip8::Run ticks the timers as the frame ends.
+        uint64_t frameEnd = (chip8->cycles / cyclesPerFrame + 1) * cyclesPerFrame;
+        while (chip8->cycles < frameEnd && !Ended()) {
+            uint64_t until = frameEnd;
+            for (const CycleWaiter &waiter : cycleWaiters) {
+                until = std::min(until, std::max(waiter.target, chip8->cycles + 1));
+            }
+
+            chip8->Run(static_cast<unsigned int>(until - chip8->cycles), cyclesPerFrame, verified);
+            if (WakeCycleWaiters()) {
+                co_await executor.Yield();
+            }
+        }
+
+        ++frames;
+        for (std::coroutine_handle<> handle : vblankWaiters) {
+            executor.Schedule(handle);
+        }
+        vblankWaiters.clear();
+
+        if (Ended() || !Blocked()) {
+            co_await executor.NextFrame();
+            continue;
+        }
+
+        // Sleep through the frames that would only have spun in Fx0A, then account for them as if they had
+        uint64_t wakeFrame = executor.Frame() + 1;
+        co_await ParkAwaiter{*this};
+        while (executor.Frame() < wakeFrame) {
+            co_await executor.NextFrame();
+        }
+
+        uint64_t slept = executor.Frame() - wakeFrame;
+        chip8->cycles += slept * cyclesPerFrame;
+        for (uint64_t tick = 0; tick < slept && (chip8->delayTimer > 0 || chip8->soundTimer > 0); ++tick) {
+            chip8->TickTimers();
+        }
+        frames += slept;
+        parkedFrames += slept;
+        WakeCycleWaiters();
+    }
+
+    WakeAll();
+    // Finished tasks are destroyed by the executor, so there is nothing left for the destructor to cancel
+    emulation = nullptr;
+}
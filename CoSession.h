@@ -0,0 +1,203 @@
+#ifndef COSESSION_H
+#define COSESSION_H
+
+#include <coroutine>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Chip8.h"
+#include "Executor.h"
+
+/**
+ * A key going down or up. key is KEY_EVENT_ENDED instead when the session ended while waiting for one.
+ */
+struct KeyEvent {
+    uint8_t key;
+    bool pressed;
+};
+
+const uint8_t KEY_EVENT_ENDED = 0xFF;
+
+/**
+ * An emulator session run as a coroutine on an Executor, for code that is itself written as coroutines.
+ *
+ * The machine runs one frame's worth of instructions for every tick of the executor's clock, applying the keys at
+ * the start of the frame and ticking the timers at the end, like the frontend. Other tasks co_await VBlank(), Cycles(n)
+ * or NextKeyEvent() to be resumed at those points; a Cycles() waiter is resumed with the machine stopped exactly that
+ * many instructions on, even in the middle of a frame.
+ *
+ * A program waiting in Fx0A with no key held would only execute that same instruction until a key arrives, so the
+ * session parks instead: it drops off the executor's clock entirely and costs nothing until Press() or SetKeys()
+ * wakes it. It then catches up the cycle count and timers for the frames it slept through, leaving the machine
+ * exactly as if it had spun. A session with Cycles() waiters doesn't park, so they still come due.
+ *
+ * The session must outlive the tasks waiting on it. Destroying it cancels its own coroutine; anything still waiting
+ * on it stays suspended until the executor is destroyed.
+ */
+class CoSession {
+public:
+    CoSession(Executor &executor, std::unique_ptr<Chip8> chip8, bool verified, unsigned int cyclesPerFrame);
+
+    ~CoSession();
+
+    CoSession(const CoSession &) = delete;
+
+    CoSession &operator=(const CoSession &) = delete;
+
+    struct VBlankAwaiter {
+        CoSession &session;
+
+        bool await_ready() const {
+            return session.Ended();
+        }
+
+        void await_suspend(std::coroutine_handle<> handle);
+
+        void await_resume() const {}
+    };
+
+    struct CyclesAwaiter {
+        CoSession &session;
+        uint64_t target;
+
+        bool await_ready() const {
+            return session.Ended() || session.chip8->cycles >= target;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle);
+
+        void await_resume() const {}
+    };
+
+    struct KeyEventAwaiter {
+        CoSession &session;
+        KeyEvent event{KEY_EVENT_ENDED, false};
+
+        bool await_ready() const {
+            return session.Ended();
+        }
+
+        void await_suspend(std::coroutine_handle<> handle);
+
+        KeyEvent await_resume() const {
+            return event;
+        }
+    };
+
+    /**
+     * co_await to be resumed after the session's next frame.
+     */
+    VBlankAwaiter VBlank() {
+        return VBlankAwaiter{*this};
+    }
+
+    /**
+     * co_await to be resumed once count more instructions have run.
+     */
+    CyclesAwaiter Cycles(uint64_t count) {
+        return CyclesAwaiter{*this, chip8->cycles + count};
+    }
+
+    /**
+     * co_await for the next key pressed or released. When several change at once the lowest is reported.
+     */
+    KeyEventAwaiter NextKeyEvent() {
+        return KeyEventAwaiter{*this};
+    }
+
+    /**
+     * Change the keys held from the start of the next frame.
+     */
+    void SetKeys(uint16_t keys);
+
+    void Press(unsigned int key) {
+        SetKeys(keys | static_cast<uint16_t>(1u << key));
+    }
+
+    void Release(unsigned int key) {
+        SetKeys(keys & static_cast<uint16_t>(~(1u << key)));
+    }
+
+    uint16_t Keys() const {
+        return keys;
+    }
+
+    bool Ended() const {
+        return chip8->halted || chip8->trap != Trap::None;
+    }
+
+    /**
+     * The program is waiting in Fx0A and the session is parked until a key arrives.
+     */
+    bool WaitingForKey() const {
+        return parked != nullptr;
+    }
+
+    const Chip8 &Machine() const {
+        return *chip8;
+    }
+
+    /**
+     * Frames run, counting those slept through while parked.
+     */
+    uint64_t Frames() const {
+        return frames;
+    }
+
+    uint64_t ParkedFrames() const {
+        return parkedFrames;
+    }
+
+private:
+    struct CycleWaiter {
+        uint64_t target;
+        std::coroutine_handle<> handle;
+    };
+
+    struct KeyWaiter {
+        std::coroutine_handle<> handle;
+        KeyEvent *event;
+    };
+
+    struct ParkAwaiter {
+        CoSession &session;
+
+        bool await_ready() const {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            session.parked = handle;
+        }
+
+        void await_resume() const {}
+    };
+
+    Task Emulate();
+
+    bool Blocked() const;
+
+    // Resume every Cycles() waiter now due, returning whether there were any
+    bool WakeCycleWaiters();
+
+    void Unpark();
+
+    void WakeAll();
+
+    Executor &executor;
+    std::unique_ptr<Chip8> chip8;
+    bool verified;
+    unsigned int cyclesPerFrame;
+    uint16_t keys = 0;
+    uint64_t frames = 0;
+    uint64_t parkedFrames = 0;
+
+    std::vector<std::coroutine_handle<>> vblankWaiters;
+    std::vector<CycleWaiter> cycleWaiters;
+    std::vector<KeyWaiter> keyWaiters;
+    // The session's own coroutine while it is parked in Fx0A
+    std::coroutine_handle<> parked;
+    std::coroutine_handle<> emulation;
+};
+
+#endif //COSESSION_H
@@ -0,0 +1,106 @@
+#ifndef CONCURRENTHASHSET_H
+#define CONCURRENTHASHSET_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ * Fixed-capacity lock-free set of 64 bit hashes, with a count of how many times each was added, for many threads
+ * adding at once.
+ *
+ * Open addressing with linear probing: a slot is claimed with a single compare-and-swap and never given back, so
+ * there is nothing to lock and nothing to resize. 0 marks an empty slot; a key of 0 is stored as 1, which for hashes
+ * merges two values out of 2^64. Add() refuses new keys once the table is three quarters full, where probe
+ * sequences start to get long.
+ */
+class ConcurrentHashSet {
+public:
+    /**
+     * Room for at least capacity keys.
+     */
+    explicit ConcurrentHashSet(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity + capacity / 3 + 1) {
+            size <<= 1u;
+        }
+
+        keys = std::make_unique<std::atomic<uint64_t>[]>(size);
+        counts = std::make_unique<std::atomic<uint32_t>[]>(size);
+        for (size_t i = 0; i < size; ++i) {
+            keys[i].store(0, std::memory_order_relaxed);
+            counts[i].store(0, std::memory_order_relaxed);
+        }
+
+        mask = size - 1;
+        limit = size - size / 4;
+    }
+
+    ConcurrentHashSet(const ConcurrentHashSet &) = delete;
+
+    ConcurrentHashSet &operator=(const ConcurrentHashSet &) = delete;
+
+    /**
+     * Count one more sighting of key, adding it if it is new. Returns the count including this one, so 1 means the
+     * key was new - or 0 if it was new and there was no room for it.
+     */
+    uint32_t Add(uint64_t key) {
+        key = key == 0 ? 1 : key;
+
+        for (size_t slot = Mix(key) & mask;; slot = (slot + 1) & mask) {
+            uint64_t found = keys[slot].load(std::memory_order_relaxed);
+
+            if (found == 0) {
+                if (used.load(std::memory_order_relaxed) >= limit) {
+                    return 0;
+                }
+                if (keys[slot].compare_exchange_strong(found, key, std::memory_order_relaxed)) {
+                    used.fetch_add(1, std::memory_order_relaxed);
+                    return counts[slot].fetch_add(1, std::memory_order_relaxed) + 1;
+                }
+                // Lost the race for this slot; found now holds the winner's key
+            }
+
+            if (found == key) {
+                return counts[slot].fetch_add(1, std::memory_order_relaxed) + 1;
+            }
+        }
+    }
+
+    /**
+     * Times key has been added, 0 if never.
+     */
+    uint32_t Count(uint64_t key) const {
+        key = key == 0 ? 1 : key;
+
+        for (size_t slot = Mix(key) & mask;; slot = (slot + 1) & mask) {
+            uint64_t found = keys[slot].load(std::memory_order_relaxed);
+
+            if (found == key) {
+                return counts[slot].load(std::memory_order_relaxed);
+            }
+            if (found == 0) {
+                return 0;
+            }
+        }
+    }
+
+    size_t Size() const {
+        return used.load(std::memory_order_relaxed);
+    }
+
+private:
+    // Keys are usually hashes already, but the low bits pick the slot, so stir the high ones in
+    static size_t Mix(uint64_t key) {
+        return static_cast<size_t>(key ^ (key >> 32u));
+    }
+
+    std::unique_ptr<std::atomic<uint64_t>[]> keys;
+    std::unique_ptr<std::atomic<uint32_t>[]> counts;
+    size_t mask = 0;
+    size_t limit = 0;
+    std::atomic<size_t> used{0};
+};
+
+#endif //CONCURRENTHASHSET_H
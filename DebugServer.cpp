@@ -0,0 +1,598 @@
+#include "DebugServer.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Largest m/M transfer we answer in one packet
+static const unsigned long MAX_TRANSFER = 4096;
+
+// Registers as numbered by p/P: V0-VF, I, PC, SP, DT, ST
+static const unsigned int REGISTER_COUNT = 21;
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+static void AppendHex(std::string &out, uint32_t value, unsigned int bytes) {
+    // Little-endian, a byte at a time, the way GDB expects target values
+    for (unsigned int i = 0; i < bytes; ++i) {
+        uint8_t byte = value >> (8 * i);
+        out += HEX_DIGITS[byte >> 4u];
+        out += HEX_DIGITS[byte & 0xFu];
+    }
+}
+
+static int HexValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+/**
+ * Decode bytes hex-encoded in the same little-endian order AppendHex writes.
+ */
+static bool ParseHexBytes(const std::string &text, size_t pos, unsigned int bytes, uint32_t &value) {
+    if (pos + bytes * 2 > text.size()) {
+        return false;
+    }
+
+    value = 0;
+    for (unsigned int i = 0; i < bytes; ++i) {
+        int high = HexValue(text[pos + i * 2]);
+        int low = HexValue(text[pos + i * 2 + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        value |= static_cast<uint32_t>(high << 4 | low) << (8 * i);
+    }
+
+    return true;
+}
+
+static unsigned int RegisterSize(unsigned int reg) {
+    return reg == 16 || reg == 17 ? 2 : 1;
+}
+
+static uint32_t ReadRegister(const Chip8 &chip8, unsigned int reg) {
+    if (reg < 16) {
+        return chip8.registers[reg];
+    }
+
+    switch (reg) {
+        case 16:
+            return chip8.index;
+        case 17:
+            return chip8.pc;
+        case 18:
+            return chip8.sp;
+        case 19:
+            return chip8.delayTimer;
+        default:
+            return chip8.soundTimer;
+    }
+}
+
+/**
+ * Whether value can go in reg without breaking the machine. Only sp has values it can't take: the stack has 16
+ * entries, so it runs from 0 to 16 (full).
+ */
+static bool RegisterValueValid(unsigned int reg, uint32_t value) {
+    return reg != 18 || value <= 16;
+}
+
+static void WriteRegister(Chip8 &chip8, unsigned int reg, uint32_t value) {
+    if (reg < 16) {
+        chip8.registers[reg] = value;
+        return;
+    }
+
+    switch (reg) {
+        case 16:
+            chip8.index = value;
+            break;
+        case 17:
+            chip8.pc = value;
+            break;
+        case 18:
+            chip8.sp = value;
+            break;
+        case 19:
+            chip8.delayTimer = value;
+            break;
+        default:
+            chip8.soundTimer = value;
+            break;
+    }
+}
+
+/**
+ * Parse "V0".."VF" or "I" into a condition register number.
+ */
+static bool ParseRegisterName(const char *name, uint8_t &reg) {
+    if ((name[0] == 'I' || name[0] == 'i') && name[1] == '\0') {
+        reg = REGISTER_I;
+        return true;
+    }
+
+    if ((name[0] == 'V' || name[0] == 'v') && name[1] != '\0' && name[2] == '\0' && HexValue(name[1]) >= 0) {
+        reg = HexValue(name[1]);
+        return true;
+    }
+
+    return false;
+}
+
+DebugServer::DebugServer(Debugger &debugger, const std::string &path, Timeline *timeline)
+        : debugger(debugger), timeline(timeline), path(path) {
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        return;
+    }
+
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0) {
+        return;
+    }
+
+    // A socket left behind by an earlier run would make bind fail
+    unlink(path.c_str());
+
+    if (bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 || listen(listener, 1) < 0) {
+        close(listener);
+        listener = -1;
+    }
+}
+
+DebugServer::~DebugServer() {
+    Disconnect();
+
+    if (listener >= 0) {
+        close(listener);
+        unlink(path.c_str());
+    }
+}
+
+bool DebugServer::Accept(int timeoutMs) {
+    pollfd descriptor{listener, POLLIN, 0};
+    if (poll(&descriptor, 1, timeoutMs) <= 0) {
+        return false;
+    }
+
+    client = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client < 0) {
+        return false;
+    }
+
+    // Whatever was running stops for the new client to look at it
+    input.clear();
+    stopped = true;
+    return true;
+}
+
+void DebugServer::Disconnect() {
+    if (client >= 0) {
+        close(client);
+        client = -1;
+    }
+    input.clear();
+}
+
+void DebugServer::Poll() {
+    if (listener < 0) {
+        return;
+    }
+
+    if (client < 0) {
+        Accept(0);
+        return;
+    }
+
+    Receive(0);
+}
+
+void DebugServer::WaitWhileStopped(std::atomic<bool> &running) {
+    while (stopped && running && !killed) {
+        if (client < 0) {
+            Accept(100);
+        }
+        else {
+            Receive(100);
+        }
+    }
+
+    if (killed) {
+        running = false;
+    }
+}
+
+void DebugServer::Receive(int timeoutMs) {
+    pollfd descriptor{client, POLLIN, 0};
+    if (poll(&descriptor, 1, timeoutMs) <= 0) {
+        return;
+    }
+
+    char buffer[4096];
+    ssize_t received = read(client, buffer, sizeof(buffer));
+    if (received < 0 && errno == EINTR) {
+        return;
+    }
+    if (received <= 0) {
+        // The client went away without detaching; let the program carry on until another one attaches
+        Disconnect();
+        stopped = false;
+        return;
+    }
+    input.append(buffer, received);
+
+    while (!input.empty() && client >= 0) {
+        if (input[0] == '\x03') {
+            debugger.Interrupt();
+            input.erase(0, 1);
+            continue;
+        }
+
+        if (input[0] != '$') {
+            // Acks and line noise
+            input.erase(0, 1);
+            continue;
+        }
+
+        size_t end = input.find('#');
+        if (end == std::string::npos || end + 2 >= input.size()) {
+            // Wait for the rest of the packet
+            return;
+        }
+
+        std::string packet = input.substr(1, end - 1);
+        uint32_t checksum = 0;
+        for (char c : packet) {
+            checksum += static_cast<uint8_t>(c);
+        }
+        int high = HexValue(input[end + 1]);
+        int low = HexValue(input[end + 2]);
+        input.erase(0, end + 3);
+
+        if (high < 0 || low < 0 || static_cast<uint32_t>(high << 4 | low) != (checksum & 0xFFu)) {
+            write(client, "-", 1);
+            continue;
+        }
+
+        write(client, "+", 1);
+        Handle(packet);
+    }
+}
+
+void DebugServer::Send(const std::string &payload) {
+    if (client < 0) {
+        return;
+    }
+
+    uint32_t checksum = 0;
+    for (char c : payload) {
+        checksum += static_cast<uint8_t>(c);
+    }
+
+    std::string packet = "$" + payload + "#";
+    packet += HEX_DIGITS[(checksum >> 4u) & 0xFu];
+    packet += HEX_DIGITS[checksum & 0xFu];
+
+    const char *data = packet.data();
+    size_t size = packet.size();
+    while (size > 0) {
+        ssize_t written = write(client, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data += written;
+        size -= written;
+    }
+}
+
+void DebugServer::ReportStop() {
+    stopped = true;
+
+    std::string reply;
+    switch (debugger.Reason()) {
+        case StopReason::Interrupt:
+            reply = "T02";
+            break;
+        case StopReason::Trap:
+            // SIGSEGV, the nearest thing GDB has to an out of bounds access
+            reply = "T0b";
+            break;
+        case StopReason::Watchpoint: {
+            reply = debugger.WatchHit() == WatchKind::Write ? "T05watch:" : "T05rwatch:";
+            char address[8];
+            snprintf(address, sizeof(address), "%x;", debugger.WatchAddress());
+            reply += address;
+            break;
+        }
+        default:
+            reply = "T05";
+            break;
+    }
+
+    Send(reply);
+}
+
+void DebugServer::Edited() {
+    // Re-executing can't reproduce an edit, so what ran after it is no longer the program's own history
+    if (timeline != nullptr) {
+        timeline->Truncate();
+    }
+}
+
+void DebugServer::Handle(const std::string &packet) {
+    Chip8 &chip8 = debugger.Target();
+    char command = packet.empty() ? '\0' : packet[0];
+    const char *args = packet.c_str() + 1;
+
+    switch (command) {
+        case '?':
+            Send("S05");
+            return;
+
+        case 'g': {
+            std::string reply;
+            for (unsigned int reg = 0; reg < REGISTER_COUNT; ++reg) {
+                AppendHex(reply, ReadRegister(chip8, reg), RegisterSize(reg));
+            }
+            Send(reply);
+            return;
+        }
+
+        case 'G': {
+            // Every value is checked before any is written, so a rejected packet changes nothing
+            uint32_t values[REGISTER_COUNT];
+            size_t pos = 1;
+            for (unsigned int reg = 0; reg < REGISTER_COUNT; ++reg) {
+                if (!ParseHexBytes(packet, pos, RegisterSize(reg), values[reg]) ||
+                    !RegisterValueValid(reg, values[reg])) {
+                    Send("E01");
+                    return;
+                }
+                pos += RegisterSize(reg) * 2;
+            }
+            for (unsigned int reg = 0; reg < REGISTER_COUNT; ++reg) {
+                WriteRegister(chip8, reg, values[reg]);
+            }
+            Edited();
+            Send("OK");
+            return;
+        }
+
+        case 'p': {
+            unsigned long reg = strtoul(args, nullptr, 16);
+            if (reg >= REGISTER_COUNT) {
+                Send("E01");
+                return;
+            }
+            std::string reply;
+            AppendHex(reply, ReadRegister(chip8, reg), RegisterSize(reg));
+            Send(reply);
+            return;
+        }
+
+        case 'P': {
+            char *end;
+            unsigned long reg = strtoul(args, &end, 16);
+            uint32_t value;
+            if (reg >= REGISTER_COUNT || *end != '=' ||
+                !ParseHexBytes(packet, end + 1 - packet.c_str(), RegisterSize(reg), value) ||
+                !RegisterValueValid(reg, value)) {
+                Send("E01");
+                return;
+            }
+            WriteRegister(chip8, reg, value);
+            Edited();
+            Send("OK");
+            return;
+        }
+
+        case 'm':
+        case 'M': {
+            char *end;
+            unsigned long address = strtoul(args, &end, 16);
+            unsigned long length = *end == ',' ? strtoul(end + 1, &end, 16) : 0;
+            if (length > MAX_TRANSFER) {
+                Send("E01");
+                return;
+            }
+
+            if (command == 'm') {
+                std::string reply;
+                for (unsigned long i = 0; i < length; ++i) {
+                    AppendHex(reply, chip8.memory[static_cast<uint16_t>(address + i)], 1);
+                }
+                Send(reply);
+                return;
+            }
+
+            if (*end != ':') {
+                Send("E01");
+                return;
+            }
+            size_t pos = end + 1 - packet.c_str();
+            for (unsigned long i = 0; i < length; ++i) {
+                uint32_t value;
+                if (!ParseHexBytes(packet, pos + i * 2, 1, value)) {
+                    Send("E01");
+                    return;
+                }
+                chip8.memory[static_cast<uint16_t>(address + i)] = value;
+            }
+            chip8.dirtyPages = ~0ull;
+            Edited();
+            Send("OK");
+            return;
+        }
+
+        case 'c':
+            if (*args != '\0') {
+                chip8.pc = strtoul(args, nullptr, 16);
+                Edited();
+            }
+            stopped = false;
+            return;
+
+        case 's':
+            if (*args != '\0') {
+                chip8.pc = strtoul(args, nullptr, 16);
+                Edited();
+            }
+            debugger.Step();
+            stopped = false;
+            return;
+
+        case 'Z':
+        case 'z': {
+            char *end;
+            unsigned long type = strtoul(args, &end, 16);
+            unsigned long address = *end == ',' ? strtoul(end + 1, &end, 16) : 0;
+            unsigned long length = *end == ',' ? strtoul(end + 1, &end, 16) : 0;
+
+            if (type <= 1) {
+                if (command == 'Z') {
+                    debugger.SetBreakpoint(address);
+                }
+                else {
+                    debugger.ClearBreakpoint(address);
+                }
+                Send("OK");
+                return;
+            }
+
+            if (type > 4) {
+                Send("");
+                return;
+            }
+
+            WatchKind kind = type == 2 ? WatchKind::Write : type == 3 ? WatchKind::Read : WatchKind::Access;
+            if (command == 'Z') {
+                debugger.AddWatchpoint(address, length, kind);
+                Send("OK");
+            }
+            else {
+                Send(debugger.RemoveWatchpoint(address, length, kind) ? "OK" : "E01");
+            }
+            return;
+        }
+
+        case 'b': {
+            if (timeline == nullptr || (packet != "bs" && packet != "bc")) {
+                Send("");
+                return;
+            }
+
+            bool moved;
+            if (packet == "bs") {
+                moved = chip8.cycles > timeline->Oldest() && timeline->Seek(chip8.cycles - 1);
+            }
+            else {
+                moved = timeline->SeekBack([this](const Chip8 &target) {
+                    return debugger.Triggers(target);
+                });
+            }
+
+            // Running into the start of the history is reported the way GDB expects
+            Send(moved ? "T05" : "T05replaylog:begin;");
+            return;
+        }
+
+        case 'D':
+            Send("OK");
+            Disconnect();
+            stopped = false;
+            return;
+
+        case 'k':
+            Disconnect();
+            killed = true;
+            stopped = false;
+            return;
+
+        case 'H':
+            // There is only one thread
+            Send("OK");
+            return;
+
+        default:
+            break;
+    }
+
+    if (packet == "vChip8StepOver") {
+        debugger.StepOver();
+        stopped = false;
+    }
+    else if (packet == "vChip8StepOut") {
+        debugger.StepOut();
+        stopped = false;
+    }
+    else if (packet.rfind("qSupported", 0) == 0) {
+        Send(timeline != nullptr ? "PacketSize=2000;ReverseStep+;ReverseContinue+" : "PacketSize=2000");
+    }
+    else if (packet == "qAttached") {
+        Send("1");
+    }
+    else if (packet.rfind("qRcmd,", 0) == 0) {
+        std::string text;
+        for (size_t pos = 6; pos + 1 < packet.size(); pos += 2) {
+            uint32_t value;
+            if (!ParseHexBytes(packet, pos, 1, value)) {
+                break;
+            }
+            text += static_cast<char>(value);
+        }
+        Send(Monitor(text) ? "OK" : "E01");
+    }
+    else {
+        // The empty reply tells the client we don't support it
+        Send("");
+    }
+}
+
+bool DebugServer::Monitor(const std::string &command) {
+    char name[8];
+    unsigned int value;
+
+    if (sscanf(command.c_str(), "break-if %7s == %x", name, &value) == 2) {
+        uint8_t reg;
+        if (!ParseRegisterName(name, reg)) {
+            return false;
+        }
+        debugger.AddCondition(RegisterCondition{reg, false, static_cast<uint16_t>(value)});
+        return true;
+    }
+
+    if (sscanf(command.c_str(), "break-on-change %7s", name) == 1) {
+        uint8_t reg;
+        if (!ParseRegisterName(name, reg)) {
+            return false;
+        }
+        debugger.AddCondition(RegisterCondition{reg, true, 0});
+        return true;
+    }
+
+    if (command == "clear-conditions") {
+        debugger.ClearConditions();
+        return true;
+    }
+
+    return false;
+}
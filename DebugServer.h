@@ -0,0 +1,89 @@
+#ifndef DEBUGSERVER_H
+#define DEBUGSERVER_H
+
+#include <atomic>
+#include <string>
+#include "Debugger.h"
+#include "Timeline.h"
+
+/**
+ * Lets a tool attach to a Debugger over a Unix domain socket using the GDB remote serial protocol.
+ *
+ * Packet framing, acknowledgements and the standard packets are GDB's: ?, g/G, p/P, m/M, c, s, Z/z 0-4 (breakpoints
+ * and write/read/access watchpoints), D, k and Ctrl-C. The register file is CHIP-8's, in this order: V0-VF one byte
+ * each, I and PC as little-endian 16 bit values, then SP, DT and ST one byte each (registers 0-20 for p/P).
+ *
+ * With a Timeline the reverse packets work too: bs steps back one instruction and bc runs back to the most recent
+ * breakpoint or watchpoint hit, stopping before the instruction that triggered it. Writing registers or memory
+ * drops the history after the current point.
+ *
+ * Extensions:
+ *   vChip8StepOver / vChip8StepOut   resume like s, stopping when the call at PC returns / the current one returns
+ *   qRcmd "break-if Vx == nn"       stop when a register (V0-VF or I) changes to a value
+ *   qRcmd "break-on-change Vx"      stop whenever it changes
+ *   qRcmd "clear-conditions"        drop all register conditions
+ *
+ * Everything runs on the emulation thread: Poll() between frames while the target runs, WaitWhileStopped() while it
+ * doesn't. The target starts stopped and waits for a client to attach.
+ */
+class DebugServer {
+public:
+    DebugServer(Debugger &debugger, const std::string &path, Timeline *timeline = nullptr);
+
+    ~DebugServer();
+
+    DebugServer(const DebugServer &) = delete;
+
+    DebugServer &operator=(const DebugServer &) = delete;
+
+    bool IsOpen() const {
+        return listener >= 0;
+    }
+
+    bool Stopped() const {
+        return stopped;
+    }
+
+    /**
+     * Handle anything the client sent while the target is running (an interrupt, or a new client connecting).
+     * Never blocks.
+     */
+    void Poll();
+
+    /**
+     * Serve the client until it resumes the target. Gives up when running goes false, and clears it if the client
+     * kills the target.
+     */
+    void WaitWhileStopped(std::atomic<bool> &running);
+
+    /**
+     * Tell the client why Debugger::Run stopped, and stop.
+     */
+    void ReportStop();
+
+private:
+    bool Accept(int timeoutMs);
+
+    void Receive(int timeoutMs);
+
+    void Disconnect();
+
+    void Handle(const std::string &packet);
+
+    bool Monitor(const std::string &command);
+
+    void Send(const std::string &payload);
+
+    void Edited();
+
+    Debugger &debugger;
+    Timeline *timeline;
+    std::string path;
+    int listener = -1;
+    int client = -1;
+    std::string input;
+    bool stopped = true;
+    bool killed = false;
+};
+
+#endif //DEBUGSERVER_H
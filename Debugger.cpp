@@ -0,0 +1,240 @@
+#include "Debugger.h"
+#include <algorithm>
+
+static void SetBit(uint64_t *bitmap, uint16_t address) {
+    bitmap[address / 64] |= uint64_t{1} << (address % 64);
+}
+
+static bool TestBit(const uint64_t *bitmap, uint16_t address) {
+    return (bitmap[address / 64] >> (address % 64)) & 0x1u;
+}
+
+MemoryAccess PredictAccess(const Chip8 &chip8) {
+    uint16_t opcode = (chip8.memory[chip8.pc] << 8u) | chip8.memory[static_cast<uint16_t>(chip8.pc + 1)];
+    unsigned int x = (opcode & 0x0F00u) >> 8u;
+    unsigned int y = (opcode & 0x00F0u) >> 4u;
+
+    MemoryAccess access{chip8.index, 0, false};
+
+    switch (opcode & 0xF000u) {
+        case 0x5000u:
+            if ((opcode & 0x000Fu) == 0x2u || (opcode & 0x000Fu) == 0x3u) {
+                access.length = (x <= y ? y - x : x - y) + 1;
+                access.write = (opcode & 0x000Fu) == 0x2u;
+            }
+            break;
+        case 0xD000u: {
+            unsigned int n = opcode & 0x000Fu;
+            unsigned int planes = (chip8.selectedPlanes & 0x1u) + ((chip8.selectedPlanes >> 1u) & 0x1u);
+            access.length = (n == 0 ? 32 : n) * planes;
+            break;
+        }
+        case 0xF000u:
+            switch (opcode & 0x00FFu) {
+                case 0x02u:
+                    access.length = opcode == 0xF002u ? 16 : 0;
+                    break;
+                case 0x33u:
+                    access.length = 3;
+                    access.write = true;
+                    break;
+                case 0x55u:
+                    access.length = x + 1;
+                    access.write = true;
+                    break;
+                case 0x65u:
+                    access.length = x + 1;
+                    break;
+                default:
+                    break;
+            }
+            break;
+        default:
+            break;
+    }
+
+    return access;
+}
+
+Debugger::Debugger(Chip8 &chip8) : chip8(chip8) {}
+
+void Debugger::SetBreakpoint(uint16_t address) {
+    SetBit(breakpoints, address);
+}
+
+void Debugger::ClearBreakpoint(uint16_t address) {
+    breakpoints[address / 64] &= ~(uint64_t{1} << (address % 64));
+}
+
+void Debugger::AddWatchpoint(uint16_t start, uint32_t length, WatchKind kind) {
+    watchpoints.push_back(Watchpoint{start, length, kind});
+    RebuildWatches();
+}
+
+bool Debugger::RemoveWatchpoint(uint16_t start, uint32_t length, WatchKind kind) {
+    auto found = std::find_if(watchpoints.begin(), watchpoints.end(), [&](const Watchpoint &watchpoint) {
+        return watchpoint.start == start && watchpoint.length == length && watchpoint.kind == kind;
+    });
+    if (found == watchpoints.end()) {
+        return false;
+    }
+
+    watchpoints.erase(found);
+    RebuildWatches();
+    return true;
+}
+
+void Debugger::RebuildWatches() {
+    // Overlapping watchpoints share bits, so removing one means starting over from the rest
+    std::fill(std::begin(readWatches), std::end(readWatches), 0);
+    std::fill(std::begin(writeWatches), std::end(writeWatches), 0);
+
+    for (const Watchpoint &watchpoint : watchpoints) {
+        uint32_t length = std::min<uint32_t>(watchpoint.length, MEMORY_SIZE);
+        for (uint32_t i = 0; i < length; ++i) {
+            auto address = static_cast<uint16_t>(watchpoint.start + i);
+            if (static_cast<int>(watchpoint.kind) & static_cast<int>(WatchKind::Read)) {
+                SetBit(readWatches, address);
+            }
+            if (static_cast<int>(watchpoint.kind) & static_cast<int>(WatchKind::Write)) {
+                SetBit(writeWatches, address);
+            }
+        }
+    }
+}
+
+bool Debugger::Watched(const MemoryAccess &memoryAccess, uint16_t &address) const {
+    const uint64_t *watches = memoryAccess.write ? writeWatches : readWatches;
+    for (uint32_t i = 0; i < memoryAccess.length; ++i) {
+        address = static_cast<uint16_t>(memoryAccess.start + i);
+        if (TestBit(watches, address)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool Debugger::Triggers(const Chip8 &target) const {
+    uint16_t address;
+    return HasBreakpoint(target.pc) || Watched(PredictAccess(target), address);
+}
+
+void Debugger::AddCondition(const RegisterCondition &condition) {
+    conditions.push_back(condition);
+}
+
+void Debugger::ClearConditions() {
+    conditions.clear();
+}
+
+void Debugger::Step() {
+    stepMode = StepMode::Into;
+}
+
+void Debugger::StepOver() {
+    uint16_t opcode = (chip8.memory[chip8.pc] << 8u) | chip8.memory[static_cast<uint16_t>(chip8.pc + 1)];
+
+    // Anything but a call is just a step
+    if ((opcode & 0xF000u) != 0x2000u) {
+        stepMode = StepMode::Into;
+        return;
+    }
+
+    stepMode = StepMode::Over;
+    stepSp = chip8.sp;
+    stepPc = chip8.pc + 2;
+}
+
+void Debugger::StepOut() {
+    stepMode = StepMode::Out;
+    stepSp = chip8.sp;
+}
+
+void Debugger::Interrupt() {
+    interrupted.store(true, std::memory_order_relaxed);
+}
+
+unsigned int Debugger::Run(unsigned int budget) {
+    reason = StopReason::None;
+    unsigned int executed = chip8.Run(budget, *this);
+
+    if (reason != StopReason::None) {
+        resuming = true;
+    }
+
+    // Hitting anything else on the way abandons a step in progress, as it would in any debugger
+    if (reason != StopReason::None && reason != StopReason::Step) {
+        stepMode = StepMode::None;
+    }
+
+    return executed;
+}
+
+bool Debugger::Before(Chip8 &target) {
+    if (interrupted.exchange(false, std::memory_order_relaxed)) {
+        reason = StopReason::Interrupt;
+        return true;
+    }
+
+    if (resuming) {
+        resuming = false;
+    }
+    else if (HasBreakpoint(target.pc)) {
+        reason = StopReason::Breakpoint;
+        return true;
+    }
+
+    access = PredictAccess(target);
+
+    if (!conditions.empty()) {
+        std::copy(std::begin(target.registers), std::end(target.registers), registersBefore);
+        indexBefore = target.index;
+    }
+
+    return false;
+}
+
+bool Debugger::After(Chip8 &target) {
+    if (target.trap != ::Trap::None) {
+        reason = StopReason::Trap;
+        return true;
+    }
+
+    if (Watched(access, watchAddress)) {
+        reason = StopReason::Watchpoint;
+        watchHit = access.write ? WatchKind::Write : WatchKind::Read;
+        return true;
+    }
+
+    for (const RegisterCondition &condition : conditions) {
+        uint16_t before = condition.reg == REGISTER_I ? indexBefore : registersBefore[condition.reg];
+        uint16_t after = condition.reg == REGISTER_I ? target.index : target.registers[condition.reg];
+
+        if (after != before && (condition.anyChange || after == condition.value)) {
+            reason = StopReason::Register;
+            return true;
+        }
+    }
+
+    switch (stepMode) {
+        case StepMode::None:
+            return false;
+        case StepMode::Into:
+            break;
+        case StepMode::Over:
+            if (target.sp != stepSp || target.pc != stepPc) {
+                return false;
+            }
+            break;
+        case StepMode::Out:
+            if (target.sp >= stepSp) {
+                return false;
+            }
+            break;
+    }
+
+    stepMode = StepMode::None;
+    reason = StopReason::Step;
+    return true;
+}
@@ -0,0 +1,182 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "Chip8.h"
+
+enum class StopReason {
+    // Ran the whole budget without anything triggering
+    None,
+    Breakpoint,
+    Watchpoint,
+    Register,
+    // A single step, step over or step out finished
+    Step,
+    // Asked to stop from outside, e.g. Ctrl-C in the attached client
+    Interrupt,
+    // The instruction at pc would go out of bounds (Chip8::trap says how) and was not executed
+    Trap
+};
+
+enum class WatchKind {
+    Read = 1,
+    Write = 2,
+    Access = 3
+};
+
+// Register index used in conditions for I; 0x0-0xF are V0-VF
+const uint8_t REGISTER_I = 16;
+
+struct RegisterCondition {
+    uint8_t reg;
+    // Stop when the register changes at all, or only when it changes to value
+    bool anyChange;
+    uint16_t value;
+};
+
+// The bytes an instruction reads or writes through I
+struct MemoryAccess {
+    uint16_t start;
+    uint32_t length;
+    bool write;
+};
+
+/**
+ * Work out from the opcode at PC which bytes the next instruction will access. Instruction fetches aren't counted.
+ */
+MemoryAccess PredictAccess(const Chip8 &chip8);
+
+/**
+ * Breakpoints, watchpoints and stepping over a Chip8.
+ *
+ * The debugger runs the core through Chip8::Run with itself as the hook, so the checks are compiled into that loop
+ * only. PC breakpoints live in a bitmap with one bit per address. The core's memory accesses aren't instrumented:
+ * instead, before each instruction the debugger works out from the opcode which bytes it is about to read or write
+ * (Dxyn, Fx33, Fx55, Fx65, 5xy2, 5xy3 and F002 are the only instructions that touch memory through I) and checks
+ * them against per-address read and write bitmaps. Like hardware watchpoints they report after the instruction
+ * has run. Register conditions are checked after each instruction too.
+ *
+ * Step over and step out use the stack: stepping over a 2nnn runs until the call returns to the same stack depth
+ * at the next instruction, stepping out runs until the stack is shallower than when it started. Both keep
+ * honouring breakpoints on the way, and both survive being split over several Run() calls.
+ */
+class Debugger {
+public:
+    explicit Debugger(Chip8 &chip8);
+
+    Chip8 &Target() {
+        return chip8;
+    }
+
+    void SetBreakpoint(uint16_t address);
+
+    void ClearBreakpoint(uint16_t address);
+
+    bool HasBreakpoint(uint16_t address) const {
+        return (breakpoints[address / 64] >> (address % 64)) & 0x1u;
+    }
+
+    /**
+     * Watch length bytes from start, wrapping at the top of memory.
+     */
+    void AddWatchpoint(uint16_t start, uint32_t length, WatchKind kind);
+
+    /**
+     * Remove a watchpoint added with the same arguments. Returns false if there was none.
+     */
+    bool RemoveWatchpoint(uint16_t start, uint32_t length, WatchKind kind);
+
+    void AddCondition(const RegisterCondition &condition);
+
+    void ClearConditions();
+
+    /**
+     * Arm a single step, step over or step out; it completes during the next Run().
+     */
+    void Step();
+
+    void StepOver();
+
+    void StepOut();
+
+    /**
+     * Stop the current or next Run() before the next instruction. Safe to call from another thread.
+     */
+    void Interrupt();
+
+    /**
+     * Execute up to budget instructions, stopping early if anything triggers. Returns the number executed; Reason()
+     * says why it stopped.
+     */
+    unsigned int Run(unsigned int budget);
+
+    StopReason Reason() const {
+        return reason;
+    }
+
+    // For a Watchpoint stop: the first watched address the instruction touched and how
+    uint16_t WatchAddress() const {
+        return watchAddress;
+    }
+
+    WatchKind WatchHit() const {
+        return watchHit;
+    }
+
+    /**
+     * Whether the instruction about to run would hit a breakpoint or a watchpoint. Has no side effects, so the
+     * timeline can use it to search history.
+     */
+    bool Triggers(const Chip8 &target) const;
+
+    // Hook interface for Chip8::Run
+    bool Before(Chip8 &chip8);
+
+    bool After(Chip8 &chip8);
+
+private:
+    enum class StepMode {
+        None,
+        Into,
+        Over,
+        Out
+    };
+
+    struct Watchpoint {
+        uint16_t start;
+        uint32_t length;
+        WatchKind kind;
+    };
+
+    void RebuildWatches();
+
+    bool Watched(const MemoryAccess &memoryAccess, uint16_t &address) const;
+
+    Chip8 &chip8;
+    uint64_t breakpoints[MEMORY_SIZE / 64]{};
+    uint64_t readWatches[MEMORY_SIZE / 64]{};
+    uint64_t writeWatches[MEMORY_SIZE / 64]{};
+    std::vector<Watchpoint> watchpoints;
+    std::vector<RegisterCondition> conditions;
+
+    StepMode stepMode = StepMode::None;
+    uint8_t stepSp = 0;
+    uint16_t stepPc = 0;
+
+    // The first instruction of a run isn't checked against breakpoints, so continuing from one makes progress
+    bool resuming = true;
+    std::atomic<bool> interrupted{false};
+
+    // What the instruction about to run will access, worked out in Before()
+    MemoryAccess access{};
+    uint8_t registersBefore[16]{};
+    uint16_t indexBefore = 0;
+
+    StopReason reason = StopReason::None;
+    uint16_t watchAddress = 0;
+    WatchKind watchHit = WatchKind::Access;
+};
+
+#endif //DEBUGGER_H
@@ -0,0 +1,83 @@
+#include "Executor.h"
+#include <algorithm>
+#include <thread>
+
+void TaskFinished(Executor &executor, std::coroutine_handle<> handle) {
+    executor.finished.push_back(handle);
+}
+
+Executor::~Executor() {
+    // Whatever is still suspended is destroyed where it stands
+    for (auto &task : tasks) {
+        task.second.destroy();
+    }
+}
+
+std::coroutine_handle<> Executor::Spawn(Task task) {
+    std::coroutine_handle<Task::promise_type> handle = std::exchange(task.handle, nullptr);
+    handle.promise().owner = this;
+    tasks.emplace(handle.address(), handle);
+    ready.push_back(handle);
+    return handle;
+}
+
+void Executor::Cancel(std::coroutine_handle<> handle) {
+    auto found = tasks.find(handle.address());
+    if (found == tasks.end()) {
+        return;
+    }
+
+    // The suspended coroutine is the innermost task the spawned one is awaiting, if any; destroying the spawned one
+    // destroys the tasks it awaits with it
+    std::coroutine_handle<> waiting = found->second.promise().innermost;
+    auto suspended = [handle, waiting](std::coroutine_handle<> queued) {
+        return queued == handle || (waiting && queued == waiting);
+    };
+
+    ready.erase(std::remove_if(ready.begin(), ready.end(), suspended), ready.end());
+    frameWaiters.erase(std::remove_if(frameWaiters.begin(), frameWaiters.end(), suspended), frameWaiters.end());
+    tasks.erase(found);
+    handle.destroy();
+}
+
+void Executor::Drain() {
+    while (!ready.empty()) {
+        std::coroutine_handle<> next = ready.front();
+        ready.pop_front();
+        next.resume();
+
+        for (std::coroutine_handle<> done : finished) {
+            tasks.erase(done.address());
+            done.destroy();
+        }
+        finished.clear();
+    }
+}
+
+void Executor::Run(uint64_t frames) {
+    uint64_t end = frames == 0 ? UINT64_MAX : frame + frames;
+    auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(rate > 0 ? 1.0 / rate : 0));
+    deadline = std::chrono::steady_clock::now();
+
+    for (;;) {
+        Drain();
+        if (frame >= end || frameWaiters.empty()) {
+            break;
+        }
+
+        if (rate > 0) {
+            // Ticks that can't be made up are dropped, rather than run back to back to catch up
+            deadline += period;
+            auto now = std::chrono::steady_clock::now();
+            if (now > deadline + period) {
+                deadline = now;
+            }
+            std::this_thread::sleep_until(deadline);
+        }
+
+        ++frame;
+        ready.insert(ready.end(), frameWaiters.begin(), frameWaiters.end());
+        frameWaiters.clear();
+    }
+}
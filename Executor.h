@@ -0,0 +1,129 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+#include "Task.h"
+
+/**
+ * Runs coroutines on the calling thread against a frame clock.
+ *
+ * Tasks that can run are kept in a queue and resumed in order. A task waiting for the next frame is parked on a list
+ * until Run() ticks the clock; one waiting on anything else (a key, say) isn't on any list of the executor's at all,
+ * so thousands of idle tasks cost nothing but their coroutine frames. Nothing here is thread-safe: tasks, and
+ * whatever wakes them, run on the thread calling Run().
+ */
+class Executor {
+public:
+    /**
+     * Frames a second Run() paces the clock to, or 0 to tick as soon as every task is waiting.
+     */
+    explicit Executor(unsigned int rate = 0) : rate(rate) {}
+
+    ~Executor();
+
+    Executor(const Executor &) = delete;
+
+    Executor &operator=(const Executor &) = delete;
+
+    /**
+     * Start a task that runs on its own, owned by the executor until it finishes. Returns its handle, for Cancel().
+     */
+    std::coroutine_handle<> Spawn(Task task);
+
+    /**
+     * Destroy a spawned task that hasn't finished, along with every task it is awaiting. Whichever of them is
+     * suspended is taken off the executor's queues; anything else holding its handle (a CoSession waiter list, say)
+     * must let go of it first.
+     */
+    void Cancel(std::coroutine_handle<> handle);
+
+    /**
+     * Queue a suspended coroutine to be resumed.
+     */
+    void Schedule(std::coroutine_handle<> handle) {
+        ready.push_back(handle);
+    }
+
+    /**
+     * Resume the coroutine at the next tick of the clock.
+     */
+    void WaitFrame(std::coroutine_handle<> handle) {
+        frameWaiters.push_back(handle);
+    }
+
+    struct FrameAwaiter {
+        Executor &executor;
+
+        bool await_ready() const {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            executor.WaitFrame(handle);
+        }
+
+        void await_resume() const {}
+    };
+
+    struct YieldAwaiter {
+        Executor &executor;
+
+        bool await_ready() const {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            executor.Schedule(handle);
+        }
+
+        void await_resume() const {}
+    };
+
+    /**
+     * co_await to sleep until the next frame.
+     */
+    FrameAwaiter NextFrame() {
+        return FrameAwaiter{*this};
+    }
+
+    /**
+     * co_await to let everything else that is ready run first.
+     */
+    YieldAwaiter Yield() {
+        return YieldAwaiter{*this};
+    }
+
+    uint64_t Frame() const {
+        return frame;
+    }
+
+    /**
+     * Run tasks and tick the clock until frames have passed, or with 0 until no task is waiting for a frame: every
+     * one has finished or is waiting on something only the caller can provide.
+     */
+    void Run(uint64_t frames = 0);
+
+    size_t Tasks() const {
+        return tasks.size();
+    }
+
+private:
+    friend void TaskFinished(Executor &executor, std::coroutine_handle<> handle);
+
+    void Drain();
+
+    unsigned int rate;
+    uint64_t frame = 0;
+    std::deque<std::coroutine_handle<>> ready;
+    std::vector<std::coroutine_handle<>> frameWaiters;
+    std::unordered_map<void *, std::coroutine_handle<Task::promise_type>> tasks;
+    std::vector<std::coroutine_handle<>> finished;
+    std::chrono::steady_clock::time_point deadline;
+};
+
+#endif //EXECUTOR_H
@@ -0,0 +1,482 @@
+#include "Explorer.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include "ConcurrentHashSet.h"
+#include "Hash.h"
+#include "ThreadPool.h"
+
+const unsigned int PAGE_BYTES = 1u << DIRTY_PAGE_BITS;
+const unsigned int PAGES = MEMORY_SIZE / PAGE_BYTES;
+
+// What a state branches on: no key, then each of the sixteen keys held alone
+const unsigned int BRANCHES = 17;
+
+struct Page {
+    uint8_t bytes[PAGE_BYTES];
+    uint64_t hash;
+};
+
+/**
+ * The input that led to a state, chained back to the start. A state is dropped once it has been expanded; its trail
+ * lives on as long as anything found from it does.
+ */
+struct Trail {
+    std::shared_ptr<Trail> parent;
+    uint16_t keys;
+    // Frames the keys were held for: framesPerStep, or fewer if the program halted or trapped on the way
+    uint32_t frames;
+
+    Trail(std::shared_ptr<Trail> parent, uint16_t keys, uint32_t frames)
+            : parent(std::move(parent)), keys(keys), frames(frames) {}
+
+    Trail(const Trail &) = delete;
+
+    Trail &operator=(const Trail &) = delete;
+
+    // Trails run thousands of steps deep; letting each release its parent in turn would recurse that deep
+    ~Trail() {
+        std::shared_ptr<Trail> next = std::move(parent);
+        while (next != nullptr && next.use_count() == 1) {
+            next = std::move(next->parent);
+        }
+    }
+};
+
+/**
+ * A state waiting to be expanded: its memory in pages shared with the state it came from, and the rest of the
+ * machine as it is.
+ */
+struct Node {
+    std::shared_ptr<Trail> trail;
+    uint64_t depth;
+    uint64_t cell;
+    uint64_t memoryHash;
+    uint64_t displayHash;
+    std::shared_ptr<const Page> pages[PAGES];
+    Chip8State state;
+};
+
+/**
+ * The keys are replaced before the program runs again, so they are left out: a step that pressed a key the program
+ * ignored leads nowhere new.
+ */
+static uint64_t StateHash(const Chip8 &chip8, uint64_t memoryHash, uint64_t displayHash) {
+    return HashMachineState(memoryHash ^ displayHash, chip8);
+}
+
+struct Entry {
+    double score;
+    uint64_t depth;
+    std::unique_ptr<Node> node;
+};
+
+// Heap order: the most novel state on top, the deeper one between equally novel states
+static bool Below(double score, uint64_t depth, const Entry &other) {
+    return score != other.score ? score < other.score : depth < other.depth;
+}
+
+static bool HeapOrder(const Entry &a, const Entry &b) {
+    return Below(a.score, a.depth, b);
+}
+
+class Explorer {
+public:
+    Explorer(const Chip8 &start, const ExploreOptions &options);
+
+    ExploreResult Run();
+
+private:
+    struct alignas(64) Worker {
+        std::unique_ptr<Chip8> machine;
+        // The pages the machine's memory was last restored from. Chip8::dirtyPages says which have been written
+        // since, and after a step pageHashes holds the new hashes of those.
+        std::shared_ptr<const Page> loaded[PAGES];
+        uint64_t pageHashes[PAGES]{};
+        std::minstd_rand random;
+        uint64_t duplicates = 0;
+        uint64_t expanded = 0;
+        uint64_t terminal = 0;
+        uint64_t frames = 0;
+    };
+
+    struct alignas(64) Queue {
+        std::mutex mutex;
+        std::vector<Entry> heap;
+    };
+
+    void Work(unsigned int index);
+
+    std::unique_ptr<Node> Take(unsigned int index);
+
+    std::unique_ptr<Node> TakeFrom(Queue &queue);
+
+    void Push(unsigned int index, std::unique_ptr<Node> node);
+
+    double Score(uint64_t cell) const {
+        return 1.0 / std::sqrt(static_cast<double>(std::max(1u, cells.Count(cell))));
+    }
+
+    void Expand(unsigned int index, const Node &node);
+
+    void Restore(Worker &worker, const Node &node);
+
+    unsigned int Step(Worker &worker, uint16_t keys);
+
+    uint64_t Cell(const Chip8 &chip8) const;
+
+    std::unique_ptr<Node> Capture(Worker &worker, const Node &from, uint64_t memoryHash, uint64_t displayHash);
+
+    void Found(const std::shared_ptr<Trail> &trail, uint64_t depth, bool goal);
+
+    bool ReachedGoal(const Chip8 &chip8) const {
+        return options.goalAddress >= 0 &&
+               chip8.memory[static_cast<uint16_t>(options.goalAddress)] == options.goalValue;
+    }
+
+    const ExploreOptions &options;
+    ConcurrentHashSet seen;
+    ConcurrentHashSet cells;
+    std::unique_ptr<ThreadPool> pool;
+    std::vector<Worker> workers;
+    std::unique_ptr<Queue[]> queues;
+    std::unique_ptr<Node> root;
+    bool rootIsGoal = false;
+
+    // States pushed and not yet expanded; once it reaches zero with every queue empty, the search is over
+    std::atomic<uint64_t> pending{0};
+    std::atomic<bool> stop{false};
+    std::chrono::steady_clock::time_point begin;
+
+    // The deepest state so far, or the goal
+    std::mutex bestMutex;
+    std::atomic<uint64_t> bestDepth{0};
+    std::shared_ptr<Trail> best;
+    bool reachedGoal = false;
+};
+
+Explorer::Explorer(const Chip8 &start, const ExploreOptions &options)
+        : options(options), seen(options.maxStates), cells(options.maxStates), root(std::make_unique<Node>()) {
+    pool = ThreadPool::ForThreads(options.threads);
+    unsigned int threads = pool != nullptr ? pool->Size() : 1;
+    workers.resize(threads);
+    queues = std::make_unique<Queue[]>(threads);
+    for (unsigned int i = 0; i < threads; ++i) {
+        workers[i].machine = std::make_unique<Chip8>();
+        workers[i].random.seed(i + 1);
+    }
+
+    uint64_t memoryHash = 0;
+    for (unsigned int page = 0; page < PAGES; ++page) {
+        auto copy = std::make_shared<Page>();
+        memcpy(copy->bytes, &start.memory[page * PAGE_BYTES], PAGE_BYTES);
+        copy->hash = HashBytes(page, copy->bytes, PAGE_BYTES);
+        memoryHash ^= HashMix(page, copy->hash);
+        root->pages[page] = std::move(copy);
+    }
+
+    root->state.Capture(start);
+    root->depth = 0;
+    root->cell = Cell(start);
+    root->memoryHash = memoryHash;
+    root->displayHash = HashDisplay(start);
+    rootIsGoal = ReachedGoal(start);
+
+    seen.Add(StateHash(start, root->memoryHash, root->displayHash));
+    cells.Add(root->cell);
+}
+
+/**
+ * The screen in 8x8 blocks, each reduced to how much of it is lit in quarters, plus the cell memory. Small moves of
+ * a sprite stay in the same cell; a new screen or a changed counter makes a new one.
+ */
+uint64_t Explorer::Cell(const Chip8 &chip8) const {
+    uint64_t cell = HashMix(0, chip8.hires);
+    unsigned int columns = chip8.DisplayWidth() / 8;
+
+    for (unsigned int top = 0; top < chip8.DisplayHeight(); top += 8) {
+        for (unsigned int column = 0; column < columns; ++column) {
+            unsigned int lit = 0;
+            for (unsigned int y = top; y < top + 8; ++y) {
+                lit += __builtin_popcount(chip8.display[0][y][column] | chip8.display[1][y][column]);
+            }
+            cell = HashMix(cell, (lit + 15) / 16);
+        }
+    }
+
+    if (options.cellAddress >= 0) {
+        for (unsigned int i = 0; i < options.cellBytes; ++i) {
+            cell = HashMix(cell, chip8.memory[static_cast<uint16_t>(options.cellAddress + i)]);
+        }
+    }
+
+    return cell;
+}
+
+/**
+ * Only pages that differ from what the machine holds are copied: those written by the last step, and those where
+ * the node has its own copy. Siblings share nearly all their pages, so expanding a node copies little memory.
+ */
+void Explorer::Restore(Worker &worker, const Node &node) {
+    Chip8 &chip8 = *worker.machine;
+
+    for (unsigned int page = 0; page < PAGES; ++page) {
+        bool written = (chip8.dirtyPages >> page) & 0x1u;
+        if (written || worker.loaded[page] != node.pages[page]) {
+            memcpy(&chip8.memory[page * PAGE_BYTES], node.pages[page]->bytes, PAGE_BYTES);
+            worker.loaded[page] = node.pages[page];
+        }
+    }
+
+    node.state.Restore(chip8);
+    chip8.dirtyPages = 0;
+    chip8.displayDirty = false;
+}
+
+/**
+ * Hold keys for up to framesPerStep frames, the way the frontend runs them: keys at the start of each frame, timers
+ * at the end. Returns the frames run, fewer if the program halted or trapped.
+ */
+unsigned int Explorer::Step(Worker &worker, uint16_t keys) {
+    Chip8 &chip8 = *worker.machine;
+
+    for (unsigned int key = 0; key < 16; ++key) {
+        chip8.keys[key] = (keys >> key) & 0x1u;
+    }
+
+    for (unsigned int frame = 0; frame < options.framesPerStep; ++frame) {
+        chip8.RunFrame(options.cyclesPerFrame, options.unchecked);
+        if (chip8.halted || chip8.trap != Trap::None) {
+            return frame;
+        }
+    }
+
+    return options.framesPerStep;
+}
+
+std::unique_ptr<Node> Explorer::Capture(Worker &worker, const Node &from, uint64_t memoryHash,
+                                        uint64_t displayHash) {
+    const Chip8 &chip8 = *worker.machine;
+    auto node = std::make_unique<Node>();
+
+    for (unsigned int page = 0; page < PAGES; ++page) {
+        bool written = (chip8.dirtyPages >> page) & 0x1u;
+        if (written && worker.pageHashes[page] != from.pages[page]->hash) {
+            auto copy = std::make_shared<Page>();
+            memcpy(copy->bytes, &chip8.memory[page * PAGE_BYTES], PAGE_BYTES);
+            copy->hash = worker.pageHashes[page];
+            node->pages[page] = std::move(copy);
+        }
+        else {
+            node->pages[page] = from.pages[page];
+        }
+    }
+
+    node->state.Capture(chip8);
+    node->memoryHash = memoryHash;
+    node->displayHash = displayHash;
+    return node;
+}
+
+void Explorer::Found(const std::shared_ptr<Trail> &trail, uint64_t depth, bool goal) {
+    std::lock_guard<std::mutex> lock(bestMutex);
+
+    if (reachedGoal || (!goal && depth <= bestDepth.load(std::memory_order_relaxed))) {
+        return;
+    }
+
+    best = trail;
+    bestDepth.store(depth, std::memory_order_relaxed);
+    reachedGoal = goal;
+}
+
+void Explorer::Expand(unsigned int index, const Node &node) {
+    Worker &worker = workers[index];
+    Chip8 &chip8 = *worker.machine;
+    ++worker.expanded;
+
+    for (unsigned int branch = 0; branch < BRANCHES && !stop.load(std::memory_order_relaxed); ++branch) {
+        auto keys = static_cast<uint16_t>(branch == 0 ? 0 : 1u << (branch - 1));
+
+        Restore(worker, node);
+        unsigned int frames = Step(worker, keys);
+        worker.frames += frames;
+
+        // Memory is hashed a page at a time, so only the pages the step wrote need hashing again
+        uint64_t memoryHash = node.memoryHash;
+        for (uint64_t dirty = chip8.dirtyPages; dirty != 0; dirty &= dirty - 1) {
+            unsigned int page = __builtin_ctzll(dirty);
+            uint64_t pageHash = HashBytes(page, &chip8.memory[page * PAGE_BYTES], PAGE_BYTES);
+            memoryHash ^= HashMix(page, node.pages[page]->hash) ^ HashMix(page, pageHash);
+            worker.pageHashes[page] = pageHash;
+        }
+        uint64_t displayHash = chip8.displayDirty ? HashDisplay(chip8) : node.displayHash;
+
+        uint32_t sightings = seen.Add(StateHash(chip8, memoryHash, displayHash));
+        if (sightings != 1) {
+            if (sightings == 0) {
+                stop = true;
+            }
+            ++worker.duplicates;
+            continue;
+        }
+        if (seen.Size() >= options.maxStates) {
+            stop = true;
+        }
+
+        uint64_t depth = node.depth + frames;
+        auto trail = [&]() {
+            return std::make_shared<Trail>(node.trail, keys, frames);
+        };
+
+        if (ReachedGoal(chip8)) {
+            Found(trail(), depth, true);
+            stop = true;
+            return;
+        }
+        if (depth > bestDepth.load(std::memory_order_relaxed)) {
+            Found(trail(), depth, false);
+        }
+
+        if (chip8.halted || chip8.trap != Trap::None) {
+            ++worker.terminal;
+            continue;
+        }
+
+        uint64_t cell = Cell(chip8);
+        uint32_t count = cells.Add(cell);
+        if (count == 0) {
+            stop = true;
+        }
+        if (count == 0 || count > options.statesPerCell) {
+            continue;
+        }
+
+        std::unique_ptr<Node> child = Capture(worker, node, memoryHash, displayHash);
+        child->trail = trail();
+        child->depth = depth;
+        child->cell = cell;
+        Push(index, std::move(child));
+    }
+}
+
+void Explorer::Push(unsigned int index, std::unique_ptr<Node> node) {
+    pending.fetch_add(1, std::memory_order_relaxed);
+
+    Queue &queue = queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    double score = Score(node->cell);
+    uint64_t depth = node->depth;
+    queue.heap.push_back(Entry{score, depth, std::move(node)});
+    std::push_heap(queue.heap.begin(), queue.heap.end(), HeapOrder);
+}
+
+/**
+ * Scores only fall as cells fill up, so the top of a heap may be stale. It is scored again when taken, and put back
+ * if it is no longer the best.
+ */
+std::unique_ptr<Node> Explorer::TakeFrom(Queue &queue) {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+
+    while (!queue.heap.empty()) {
+        std::pop_heap(queue.heap.begin(), queue.heap.end(), HeapOrder);
+        Entry entry = std::move(queue.heap.back());
+        queue.heap.pop_back();
+
+        double score = Score(entry.node->cell);
+        if (score < entry.score && !queue.heap.empty() && Below(score, entry.depth, queue.heap.front())) {
+            entry.score = score;
+            queue.heap.push_back(std::move(entry));
+            std::push_heap(queue.heap.begin(), queue.heap.end(), HeapOrder);
+            continue;
+        }
+
+        return std::move(entry.node);
+    }
+
+    return nullptr;
+}
+
+/**
+ * The thread's own queue first, then the others starting from a random one, so thieves spread out.
+ */
+std::unique_ptr<Node> Explorer::Take(unsigned int index) {
+    std::unique_ptr<Node> node = TakeFrom(queues[index]);
+    if (node != nullptr || workers.size() == 1) {
+        return node;
+    }
+
+    auto count = static_cast<unsigned int>(workers.size());
+    unsigned int first = workers[index].random() % count;
+    for (unsigned int i = 0; i < count && node == nullptr; ++i) {
+        unsigned int victim = (first + i) % count;
+        if (victim != index) {
+            node = TakeFrom(queues[victim]);
+        }
+    }
+
+    return node;
+}
+
+void Explorer::Work(unsigned int index) {
+    while (!stop.load(std::memory_order_relaxed)) {
+        std::unique_ptr<Node> node = Take(index);
+
+        if (node == nullptr) {
+            // Nothing to take, but a state being expanded elsewhere may still push more
+            if (pending.load(std::memory_order_acquire) == 0) {
+                return;
+            }
+            std::this_thread::yield();
+            continue;
+        }
+
+        Expand(index, *node);
+        pending.fetch_sub(1, std::memory_order_acq_rel);
+
+        if (options.seconds > 0 &&
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count() >= options.seconds) {
+            stop = true;
+        }
+    }
+}
+
+ExploreResult Explorer::Run() {
+    ExploreResult result;
+    begin = std::chrono::steady_clock::now();
+
+    if (!rootIsGoal) {
+        Push(0, std::move(root));
+
+        ParallelFor(pool.get(), static_cast<unsigned int>(workers.size()), [this](unsigned int i) { Work(i); });
+    }
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    result.states = seen.Size();
+    result.cells = cells.Size();
+    for (const Worker &worker : workers) {
+        result.duplicates += worker.duplicates;
+        result.expanded += worker.expanded;
+        result.terminal += worker.terminal;
+        result.frames += worker.frames;
+    }
+
+    result.reachedGoal = rootIsGoal || reachedGoal;
+    for (const Trail *trail = best.get(); trail != nullptr; trail = trail->parent.get()) {
+        result.keys.insert(result.keys.end(), trail->frames, trail->keys);
+    }
+    std::reverse(result.keys.begin(), result.keys.end());
+
+    return result;
+}
+
+ExploreResult Explore(const Chip8 &start, const ExploreOptions &options) {
+    Explorer explorer(start, options);
+    return explorer.Run();
+}
@@ -0,0 +1,65 @@
+#ifndef EXPLORER_H
+#define EXPLORER_H
+
+#include <cstdint>
+#include <vector>
+#include "Chip8.h"
+
+struct ExploreOptions {
+    unsigned int cyclesPerFrame = 11;
+    // Frames each branch holds its input for before branching again
+    unsigned int framesPerStep = 8;
+    // Stop after this many distinct states, or this many seconds (0 for no limit)
+    uint64_t maxStates = 1000000;
+    double seconds = 0;
+    // Distinct states explored further per cell; the rest are remembered as seen but not expanded
+    unsigned int statesPerCell = 32;
+    // Memory folded into the cell as well as the screen, e.g. a level counter; a negative address for none
+    int32_t cellAddress = -1;
+    unsigned int cellBytes = 1;
+    // Stop as soon as the byte at goalAddress (if not negative) equals goalValue
+    int32_t goalAddress = -1;
+    uint8_t goalValue = 0;
+    // Run CycleUnchecked(), for ROMs the Verifier has proven
+    bool unchecked = false;
+    // Threads exploring including the caller's; 0 for one per core
+    unsigned int threads = 0;
+};
+
+struct ExploreResult {
+    // Distinct states reached, branches that landed on a state already seen, and states expanded
+    uint64_t states = 0;
+    uint64_t duplicates = 0;
+    uint64_t expanded = 0;
+    uint64_t cells = 0;
+    // States where the program halted or trapped, which end their branch
+    uint64_t terminal = 0;
+    uint64_t frames = 0;
+    double seconds = 0;
+    bool reachedGoal = false;
+    // Keys held in each frame (bit n for key n) from the start to the goal, or if it was never reached to the
+    // deepest state found
+    std::vector<uint16_t> keys;
+};
+
+/**
+ * Search the states a program can reach from start, for finding later levels and game-over screens without
+ * scripting the play.
+ *
+ * Every state is expanded by branching on the input: no key, and each of the sixteen keys held alone, for
+ * framesPerStep frames. Resulting states are deduplicated through a shared lock-free set of state hashes. A state
+ * also falls in a cell - the screen in coarse 8x8 blocks plus optional memory bytes - and, as in Go-Explore, the
+ * states to expand next are those whose cell has been seen least, with deeper states first among equals. Only the
+ * first statesPerCell distinct states in a cell are expanded at all, which keeps the search from drowning in
+ * states that differ only in a frame counter.
+ *
+ * Each thread keeps its own queue of states to expand, ordered by novelty, and pushes the states it finds there;
+ * a thread whose queue runs dry steals the best state from another's. States share unchanged 1KiB memory pages with
+ * the state they came from, so one typically costs a few KiB.
+ *
+ * The core is deterministic given its state, so the keys in the result replay the path from start exactly (e.g.
+ * with chip8-lockstep --keys).
+ */
+ExploreResult Explore(const Chip8 &start, const ExploreOptions &options);
+
+#endif //EXPLORER_H
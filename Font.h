@@ -8,4 +8,7 @@
 extern uint8_t fontset[];
 extern const unsigned int FONTSET_SIZE;
 
+extern uint8_t bigFontset[];
+extern const unsigned int BIG_FONTSET_SIZE;
+
 #endif //FONT_H
@@ -0,0 +1,89 @@
+#include "Frame.h"
+#include <array>
+#include <cstring>
+
+/**
+ * Each bit of a byte repeated twice, so 8 low resolution pixels become 16 high resolution ones.
+ */
+static constexpr std::array<uint16_t, 256> MakeDoubledBits() {
+    std::array<uint16_t, 256> doubled{};
+
+    for (unsigned int value = 0; value < 256; ++value) {
+        uint16_t bits = 0;
+
+        for (unsigned int bit = 0; bit < 8; ++bit) {
+            if (value & (1u << bit)) {
+                bits |= 0x3u << (bit * 2);
+            }
+        }
+
+        doubled[value] = bits;
+    }
+
+    return doubled;
+}
+
+static constexpr std::array<uint16_t, 256> DOUBLED_BITS = MakeDoubledBits();
+
+void PackDisplay(const Chip8 &chip8, Frame &frame) {
+    // The display already has the frame's layout; a pixel is lit if it is set on any plane
+    const uint8_t *first = &chip8.display[0][0][0];
+    const uint8_t *second = &chip8.display[1][0][0];
+    uint8_t *out = &frame.pixels[0][0];
+
+    for (size_t i = 0; i < sizeof(frame.pixels); ++i) {
+        out[i] = first[i] | second[i];
+    }
+
+    frame.width = chip8.DisplayWidth();
+    frame.height = chip8.DisplayHeight();
+}
+
+void PackDisplayHires(const Chip8 &chip8, uint8_t *out) {
+    if (chip8.hires) {
+        for (unsigned int y = 0; y < HIRES_VIDEO_HEIGHT; ++y) {
+            for (unsigned int byte = 0; byte < DISPLAY_ROW_BYTES; ++byte) {
+                out[y * DISPLAY_ROW_BYTES + byte] = chip8.display[0][y][byte] | chip8.display[1][y][byte];
+            }
+        }
+        return;
+    }
+
+    for (unsigned int y = 0; y < VIDEO_HEIGHT; ++y) {
+        uint8_t *row = out + y * 2 * DISPLAY_ROW_BYTES;
+
+        for (unsigned int byte = 0; byte < VIDEO_WIDTH / 8; ++byte) {
+            uint16_t bits = DOUBLED_BITS[chip8.display[0][y][byte] | chip8.display[1][y][byte]];
+            row[byte * 2] = static_cast<uint8_t>(bits >> 8u);
+            row[byte * 2 + 1] = static_cast<uint8_t>(bits);
+        }
+
+        memcpy(row + DISPLAY_ROW_BYTES, row, DISPLAY_ROW_BYTES);
+    }
+}
+
+void ExpandToHires(const Frame &in, Frame &out) {
+    if (in.width == HIRES_VIDEO_WIDTH) {
+        out = in;
+        return;
+    }
+
+    for (unsigned int y = 0; y < VIDEO_HEIGHT; ++y) {
+        uint8_t *row = out.pixels[y * 2];
+
+        for (unsigned int byte = 0; byte < VIDEO_WIDTH / 8; ++byte) {
+            uint16_t bits = DOUBLED_BITS[in.pixels[y][byte]];
+            row[byte * 2] = static_cast<uint8_t>(bits >> 8u);
+            row[byte * 2 + 1] = static_cast<uint8_t>(bits);
+        }
+
+        memcpy(out.pixels[y * 2 + 1], row, FRAME_ROW_BYTES);
+    }
+
+    out.width = HIRES_VIDEO_WIDTH;
+    out.height = HIRES_VIDEO_HEIGHT;
+    out.number = in.number;
+    out.publishedNs = in.publishedNs;
+    out.emulationNs = in.emulationNs;
+    out.inputNs = in.inputNs;
+}
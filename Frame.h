@@ -0,0 +1,55 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <cstdint>
+#include "Chip8.h"
+
+const unsigned int FRAME_ROW_BYTES = DISPLAY_ROW_BYTES;
+
+/**
+ * A finished frame as handed from the emulation thread to the presentation thread.
+ *
+ * Pixels are packed one bit per pixel, eight to a byte with the most significant bit leftmost - the same layout
+ * sprites use in memory and the emulator uses for its display. Rows are always FRAME_ROW_BYTES apart; only the top
+ * left width x height pixels are meaningful. A pixel is lit when it is set on either XO-CHIP plane.
+ */
+struct Frame {
+    uint8_t pixels[HIRES_VIDEO_HEIGHT][FRAME_ROW_BYTES]{};
+    uint16_t width = VIDEO_WIDTH;
+    uint16_t height = VIDEO_HEIGHT;
+    // Number of frames emulated before this one
+    uint64_t number{};
+    // steady_clock time, in nanoseconds, at which the emulation thread published the frame
+    int64_t publishedNs{};
+    // Time spent executing instructions for this frame, in nanoseconds
+    int64_t emulationNs{};
+    // steady_clock time of the key event whose effect first showed in this frame's display or an earlier one, while
+    // no newer key event has; 0 when not measured
+    int64_t inputNs{};
+
+    bool Pixel(unsigned int x, unsigned int y) const {
+        return (pixels[y][x / 8] >> (7u - x % 8)) & 0x1u;
+    }
+
+    unsigned int RowBytes() const {
+        return width / 8u;
+    }
+};
+
+/**
+ * Copy the emulator's display and resolution into the frame.
+ */
+void PackDisplay(const Chip8 &chip8, Frame &frame);
+
+/**
+ * Convert a frame to 128x64, doubling every pixel of a low resolution one. High resolution frames are copied as they
+ * are. For consumers that want one fixed geometry whatever mode the program is in.
+ */
+void ExpandToHires(const Frame &in, Frame &out);
+
+/**
+ * PackDisplay() and ExpandToHires() in one pass, straight into out: HIRES_VIDEO_HEIGHT rows of DISPLAY_ROW_BYTES.
+ */
+void PackDisplayHires(const Chip8 &chip8, uint8_t *out);
+
+#endif //FRAME_H
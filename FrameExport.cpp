@@ -0,0 +1,296 @@
+#include "FrameExport.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+// Slots start on their own cache line and are padded to whole lines, so writers to neighbouring slots don't contend
+static const size_t SLOTS_OFFSET = 64;
+static const size_t FRAME_WORDS = sizeof(ExportedFrame) / 8;
+static const size_t DISPLAY_WORD = offsetof(ExportedFrame, display) / 8;
+
+template <typename T>
+static size_t SlotSize() {
+    return (sizeof(T) + 63) / 64 * 64;
+}
+
+static std::string SegmentName(const std::string &name) {
+    return name.empty() || name[0] != '/' ? "/" + name : name;
+}
+
+static int64_t SteadyNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int64_t WallNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static bool Alive(uint32_t pid) {
+    return kill(static_cast<pid_t>(pid), 0) == 0 || errno != ESRCH;
+}
+
+FrameExport::FrameExport(const std::string &name, unsigned int slots) : name(SegmentName(name)) {
+    size_t slotSize = SlotSize<Slot>();
+
+    int fd = shm_open(this->name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    created = fd >= 0;
+    if (fd < 0 && errno == EEXIST) {
+        fd = shm_open(this->name.c_str(), O_RDWR | O_CLOEXEC, 0);
+    }
+    if (fd < 0 || slots == 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return;
+    }
+
+    if (created) {
+        size = SLOTS_OFFSET + slots * slotSize;
+        if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            close(fd);
+            shm_unlink(this->name.c_str());
+            return;
+        }
+    }
+    else {
+        // The creator may not have finished sizing the segment and writing its header yet
+        struct stat status{};
+        for (int attempt = 0; attempt < 100; ++attempt) {
+            if (fstat(fd, &status) == 0 && static_cast<size_t>(status.st_size) > SLOTS_OFFSET) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        size = static_cast<size_t>(status.st_size);
+        if (size <= SLOTS_OFFSET) {
+            close(fd);
+            return;
+        }
+    }
+
+    void *mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        if (created) {
+            shm_unlink(this->name.c_str());
+        }
+        return;
+    }
+
+    auto *mappedHeader = static_cast<Header *>(mapped);
+    std::atomic_ref<uint32_t> magic(mappedHeader->magic);
+
+    if (created) {
+        mappedHeader->version = FRAME_EXPORT_VERSION;
+        mappedHeader->slots = slots;
+        mappedHeader->slotSize = static_cast<uint32_t>(slotSize);
+        // A fresh segment is zeroed, which is every slot free; the magic goes last so others see a finished header
+        magic.store(FRAME_EXPORT_MAGIC, std::memory_order_release);
+    }
+    else {
+        for (int attempt = 0; attempt < 100 && magic.load(std::memory_order_acquire) != FRAME_EXPORT_MAGIC;
+             ++attempt) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        if (magic.load(std::memory_order_acquire) != FRAME_EXPORT_MAGIC ||
+            mappedHeader->version != FRAME_EXPORT_VERSION || mappedHeader->slotSize != slotSize ||
+            SLOTS_OFFSET + static_cast<size_t>(mappedHeader->slots) * slotSize > size) {
+            munmap(mapped, size);
+            return;
+        }
+    }
+
+    header = mappedHeader;
+}
+
+FrameExport::FrameExport(const std::string &name) : name(SegmentName(name)) {
+    int fd = shm_open(this->name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return;
+    }
+
+    struct stat status{};
+    if (fstat(fd, &status) != 0 || static_cast<size_t>(status.st_size) <= SLOTS_OFFSET) {
+        close(fd);
+        return;
+    }
+    size = static_cast<size_t>(status.st_size);
+
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return;
+    }
+
+    auto *mappedHeader = static_cast<Header *>(mapped);
+    if (std::atomic_ref<uint32_t>(mappedHeader->magic).load(std::memory_order_acquire) != FRAME_EXPORT_MAGIC ||
+        mappedHeader->version != FRAME_EXPORT_VERSION || mappedHeader->slotSize != SlotSize<Slot>() ||
+        SLOTS_OFFSET + static_cast<size_t>(mappedHeader->slots) * mappedHeader->slotSize > size) {
+        munmap(mapped, size);
+        return;
+    }
+
+    header = mappedHeader;
+}
+
+FrameExport::~FrameExport() {
+    if (header == nullptr) {
+        return;
+    }
+
+    while (!claimed.empty()) {
+        Release(claimed.back());
+    }
+
+    munmap(header, size);
+    if (created) {
+        shm_unlink(name.c_str());
+    }
+}
+
+bool FrameExport::Remove(const std::string &name) {
+    return shm_unlink(SegmentName(name).c_str()) == 0;
+}
+
+unsigned int FrameExport::Slots() const {
+    return header != nullptr ? header->slots : 0;
+}
+
+FrameExport::Slot &FrameExport::SlotAt(unsigned int slot) const {
+    return *reinterpret_cast<Slot *>(reinterpret_cast<uint8_t *>(header) + SLOTS_OFFSET +
+                                     static_cast<size_t>(slot) * header->slotSize);
+}
+
+uint32_t FrameExport::Owner(unsigned int slot) const {
+    return slot < Slots() ? SlotAt(slot).owner.load(std::memory_order_acquire) : 0;
+}
+
+int FrameExport::Claim(uint32_t session) {
+    auto pid = static_cast<uint32_t>(getpid());
+
+    for (unsigned int index = 0; index < Slots(); ++index) {
+        Slot &slot = SlotAt(index);
+        uint32_t owner = slot.owner.load(std::memory_order_relaxed);
+
+        // Free, or left behind by a process that died without releasing it
+        if ((owner == 0 || (owner != pid && !Alive(owner))) &&
+            slot.owner.compare_exchange_strong(owner, pid, std::memory_order_acquire)) {
+            uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+            // A dead writer may have stopped half way, leaving the sequence odd
+            sequence += sequence & 1;
+
+            slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            slot.published.store(0, std::memory_order_relaxed);
+            slot.session.store(session, std::memory_order_relaxed);
+            slot.sequence.store(sequence + 2, std::memory_order_release);
+
+            claimed.push_back(static_cast<int>(index));
+            return static_cast<int>(index);
+        }
+    }
+
+    return -1;
+}
+
+void FrameExport::Release(int slot) {
+    auto found = std::find(claimed.begin(), claimed.end(), slot);
+    if (found == claimed.end()) {
+        return;
+    }
+    claimed.erase(found);
+
+    Slot &released = SlotAt(static_cast<unsigned int>(slot));
+    released.published.store(0, std::memory_order_relaxed);
+    released.owner.store(0, std::memory_order_release);
+}
+
+void FrameExport::Publish(int slot, const Chip8 &chip8, uint64_t frame, int64_t emulatedNs, bool displayChanged) {
+    if (header == nullptr || slot < 0) {
+        return;
+    }
+
+    Slot &target = SlotAt(static_cast<unsigned int>(slot));
+
+    ExportedFrame counters;
+    counters.session = target.session.load(std::memory_order_relaxed);
+    counters.flags = (chip8.hires ? FRAME_EXPORT_HIRES : 0) | (chip8.soundTimer > 0 ? FRAME_EXPORT_SOUND : 0) |
+                     (chip8.halted ? FRAME_EXPORT_HALTED : 0) |
+                     (chip8.trap != Trap::None ? FRAME_EXPORT_TRAPPED : 0);
+    counters.frame = frame;
+    counters.cycles = chip8.cycles;
+    counters.emulatedNs = emulatedNs;
+    counters.publishedNs = SteadyNs();
+    counters.wallNs = WallNs();
+
+    uint64_t words[DISPLAY_WORD];
+    memcpy(words, &counters, sizeof(words));
+
+    uint32_t sequence = target.sequence.load(std::memory_order_relaxed);
+    target.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for (size_t i = 0; i < DISPLAY_WORD; ++i) {
+        std::atomic_ref<uint64_t>(target.words[i]).store(words[i], std::memory_order_relaxed);
+    }
+
+    if (displayChanged || target.published.load(std::memory_order_relaxed) == 0) {
+        const uint8_t *display = &chip8.display[0][0][0];
+        for (size_t i = DISPLAY_WORD; i < FRAME_WORDS; ++i, display += 8) {
+            uint64_t word;
+            memcpy(&word, display, 8);
+            std::atomic_ref<uint64_t>(target.words[i]).store(word, std::memory_order_relaxed);
+        }
+    }
+
+    target.published.store(1, std::memory_order_relaxed);
+    target.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool FrameExport::Read(unsigned int slot, ExportedFrame &frame) const {
+    if (slot >= Slots()) {
+        return false;
+    }
+
+    Slot &source = SlotAt(slot);
+    uint64_t words[FRAME_WORDS];
+
+    for (int attempt = 0;; ++attempt) {
+        if (attempt == 1000) {
+            return false;
+        }
+
+        uint32_t before = source.sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        for (size_t i = 0; i < FRAME_WORDS; ++i) {
+            words[i] = std::atomic_ref<uint64_t>(source.words[i]).load(std::memory_order_relaxed);
+        }
+        uint32_t published = source.published.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (source.sequence.load(std::memory_order_relaxed) == before) {
+            if (published == 0) {
+                return false;
+            }
+            break;
+        }
+    }
+
+    memcpy(&frame, words, sizeof(frame));
+    return true;
+}
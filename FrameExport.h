@@ -0,0 +1,134 @@
+#ifndef FRAMEEXPORT_H
+#define FRAMEEXPORT_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Chip8.h"
+
+const uint32_t FRAME_EXPORT_MAGIC = 0x58453843; // "C8EX"
+const uint32_t FRAME_EXPORT_VERSION = 1;
+const unsigned int FRAME_EXPORT_DEFAULT_SLOTS = 64;
+
+const uint32_t FRAME_EXPORT_HIRES = 0x01;
+const uint32_t FRAME_EXPORT_SOUND = 0x02;
+const uint32_t FRAME_EXPORT_HALTED = 0x04;
+const uint32_t FRAME_EXPORT_TRAPPED = 0x08;
+
+/**
+ * One session's latest frame as a reader sees it. Times are steady_clock (CLOCK_MONOTONIC) nanoseconds, which every
+ * process on the machine shares, except wallNs, which is system_clock for lining frames up with logs.
+ */
+struct ExportedFrame {
+    uint32_t session;
+    // FRAME_EXPORT_* bits
+    uint32_t flags;
+    uint64_t frame;
+    uint64_t cycles;
+    // When the frame finished emulating, and when it was written to the segment
+    int64_t emulatedNs;
+    int64_t publishedNs;
+    int64_t wallNs;
+    uint8_t display[DISPLAY_PLANES][HIRES_VIDEO_HEIGHT][DISPLAY_ROW_BYTES];
+};
+
+/**
+ * Publishes sessions' displays to other processes through a POSIX shared memory segment.
+ *
+ * The segment is a small header followed by a fixed number of slots, one per session. A process claims a free slot by
+ * swapping its pid into the slot's owner field, so any number of sessions in any number of processes can share one
+ * segment; slots whose owner has died are reclaimed. Each slot is guarded by a seqlock: the writer makes the sequence
+ * odd, writes, and makes it even again, and a reader copies the slot and retries if the sequence moved meanwhile.
+ * Writers never wait for readers and readers never write, so attaching a viewer costs the emulation nothing. When the
+ * display hasn't changed only the counters are rewritten.
+ *
+ * The process that creates the segment removes its name when done; readers that already have it mapped keep it.
+ * Within a process, Claim, Release and Publish are for one thread at a time.
+ */
+class FrameExport {
+public:
+    /**
+     * Attach to the segment for writing, creating it with the given number of slots if it doesn't exist.
+     */
+    FrameExport(const std::string &name, unsigned int slots);
+
+    /**
+     * Attach to an existing segment for reading only.
+     */
+    explicit FrameExport(const std::string &name);
+
+    ~FrameExport();
+
+    FrameExport(const FrameExport &) = delete;
+
+    FrameExport &operator=(const FrameExport &) = delete;
+
+    bool IsOpen() const {
+        return header != nullptr;
+    }
+
+    unsigned int Slots() const;
+
+    /**
+     * Take a free slot for a session, returning its index, or -1 if every slot is in use.
+     */
+    int Claim(uint32_t session);
+
+    void Release(int slot);
+
+    /**
+     * Write the machine's state to a slot this process claimed. Cheap enough to call every frame from the emulation
+     * thread; the display is only copied if displayChanged.
+     */
+    void Publish(int slot, const Chip8 &chip8, uint64_t frame, int64_t emulatedNs, bool displayChanged);
+
+    /**
+     * The process holding a slot, or 0 if it is free.
+     */
+    uint32_t Owner(unsigned int slot) const;
+
+    /**
+     * Copy a slot's latest frame. False if nothing has been published there since it was claimed, or if its writer
+     * died part way through writing it.
+     */
+    bool Read(unsigned int slot, ExportedFrame &frame) const;
+
+    /**
+     * Remove a segment's name, e.g. one left behind by a process that was killed.
+     */
+    static bool Remove(const std::string &name);
+
+private:
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t slots;
+        uint32_t slotSize;
+    };
+
+    struct Slot {
+        // Odd while the slot is being written
+        std::atomic<uint32_t> sequence;
+        std::atomic<uint32_t> owner;
+        std::atomic<uint32_t> session;
+        // 0 until the current owner first publishes
+        std::atomic<uint32_t> published;
+        // An ExportedFrame, copied a word at a time so readers racing the writer only ever see torn words, which the
+        // sequence check throws away
+        uint64_t words[sizeof(ExportedFrame) / 8];
+    };
+
+    static_assert(sizeof(ExportedFrame) % 8 == 0, "slots are copied a word at a time");
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared between processes");
+
+    Slot &SlotAt(unsigned int slot) const;
+
+    std::string name;
+    Header *header = nullptr;
+    size_t size = 0;
+    bool created = false;
+    std::vector<int> claimed;
+};
+
+#endif //FRAMEEXPORT_H
@@ -0,0 +1,73 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "Chip8.h"
+
+/**
+ * Fast non-cryptographic hashing of machine state, for telling states apart - lockstep comparison, hang detection -
+ * not for resisting anyone.
+ */
+inline uint64_t HashMix(uint64_t hash, uint64_t value) {
+    hash ^= value;
+    hash *= 0x9E3779B97F4A7C15ull;
+    return hash ^ (hash >> 29u);
+}
+
+/**
+ * Large buffers (memory) dominate the cost, so they are read a word at a time into four independent lanes that the
+ * CPU can work on in parallel.
+ */
+inline uint64_t HashBytes(uint64_t hash, const uint8_t *bytes, size_t size) {
+    uint64_t lanes[4] = {hash, hash + 1, hash + 2, hash + 3};
+    size_t i = 0;
+
+    for (; i + 32 <= size; i += 32) {
+        for (unsigned int lane = 0; lane < 4; ++lane) {
+            uint64_t word;
+            memcpy(&word, bytes + i + 8 * lane, sizeof(word));
+            lanes[lane] = HashMix(lanes[lane], word);
+        }
+    }
+
+    for (; i < size; ++i) {
+        lanes[0] = HashMix(lanes[0], bytes[i]);
+    }
+
+    return HashMix(HashMix(HashMix(lanes[0], lanes[1]), lanes[2]), lanes[3]);
+}
+
+inline uint64_t HashDisplay(const Chip8 &chip8) {
+    return HashBytes(chip8.hires, &chip8.display[0][0][0], sizeof(chip8.display));
+}
+
+/**
+ * Everything outside memory and the display that decides what the program does next, mixed into hash - typically
+ * the hashes of memory and the display, which the watchdog and the explorer keep up to date a page at a time. The
+ * keys are input rather than state. cycles, opcode, audioChanges, dirtyPages and displayDirty are bookkeeping that
+ * differs between paths to the same state, and trap says how Cycle() stopped, which engines that don't check never
+ * set; callers that care about any of these mix them in themselves.
+ */
+inline uint64_t HashMachineState(uint64_t hash, const Chip8 &chip8) {
+    hash = HashBytes(hash, chip8.registers, sizeof(chip8.registers));
+    hash = HashBytes(hash, reinterpret_cast<const uint8_t *>(chip8.stack), sizeof(chip8.stack));
+    hash = HashBytes(hash, chip8.flags, sizeof(chip8.flags));
+    hash = HashBytes(hash, chip8.audioPattern, sizeof(chip8.audioPattern));
+    hash = HashBytes(hash, reinterpret_cast<const uint8_t *>(&chip8.randGen), sizeof(chip8.randGen));
+    hash = HashMix(hash, chip8.index | (static_cast<uint64_t>(chip8.pc) << 16u) |
+                         (static_cast<uint64_t>(chip8.sp) << 32u) | (static_cast<uint64_t>(chip8.delayTimer) << 40u) |
+                         (static_cast<uint64_t>(chip8.soundTimer) << 48u) |
+                         (static_cast<uint64_t>(chip8.selectedPlanes) << 56u));
+    return HashMix(hash, chip8.halted | (chip8.hasAudioPattern << 1u) | (chip8.hires << 2u) | (chip8.pitch << 8u));
+}
+
+/**
+ * The whole machine state, memory and display included, for telling two machines apart outright.
+ */
+inline uint64_t HashState(const Chip8 &chip8) {
+    return HashMachineState(HashBytes(HashDisplay(chip8), chip8.memory, sizeof(chip8.memory)), chip8);
+}
+
+#endif //HASH_H
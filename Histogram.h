@@ -0,0 +1,122 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Counts of values in buckets of about 6% of their size, for latency percentiles without keeping every sample.
+ *
+ * Values below 16 get a bucket each; above that every power of two is split into 16 buckets, up to 2^40 (about 18
+ * minutes in nanoseconds), past which values are counted in the last bucket. Buckets are relaxed atomics, so any
+ * thread may record while another reads; a percentile read during recording is a little stale, never torn.
+ */
+class Histogram {
+public:
+    static const unsigned int SUB_BUCKET_BITS = 4;
+    static const unsigned int MAX_BITS = 40;
+    static const size_t BUCKETS = (MAX_BITS - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS;
+
+    Histogram() = default;
+
+    Histogram(const Histogram &) = delete;
+
+    Histogram &operator=(const Histogram &) = delete;
+
+    void Record(uint64_t value) {
+        buckets[Bucket(value)].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(value, std::memory_order_relaxed);
+        uint64_t seen = max.load(std::memory_order_relaxed);
+        while (value > seen && !max.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {}
+    }
+
+    /**
+     * Add other's counts into this one.
+     */
+    void Add(const Histogram &other) {
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            uint64_t n = other.buckets[i].load(std::memory_order_relaxed);
+            if (n > 0) {
+                buckets[i].fetch_add(n, std::memory_order_relaxed);
+            }
+        }
+        count.fetch_add(other.Count(), std::memory_order_relaxed);
+        sum.fetch_add(other.Sum(), std::memory_order_relaxed);
+        uint64_t otherMax = other.Max();
+        uint64_t seen = max.load(std::memory_order_relaxed);
+        while (otherMax > seen && !max.compare_exchange_weak(seen, otherMax, std::memory_order_relaxed)) {}
+    }
+
+    uint64_t Count() const {
+        return count.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Total of every value recorded, exactly, for a mean.
+     */
+    uint64_t Sum() const {
+        return sum.load(std::memory_order_relaxed);
+    }
+
+    uint64_t Max() const {
+        return max.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * The value below which a fraction p of the values fall, as the top of its bucket (but no more than Max()).
+     */
+    uint64_t Percentile(double p) const {
+        uint64_t total = Count();
+        if (total == 0) {
+            return 0;
+        }
+
+        auto rank = static_cast<uint64_t>(p * static_cast<double>(total));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            seen += buckets[i].load(std::memory_order_relaxed);
+            if (seen > rank) {
+                uint64_t top = BucketTop(i);
+                return top < Max() ? top : Max();
+            }
+        }
+        return Max();
+    }
+
+    static size_t Bucket(uint64_t value) {
+        if (value < (1ull << SUB_BUCKET_BITS)) {
+            return static_cast<size_t>(value);
+        }
+
+        auto bits = static_cast<unsigned int>(63 - __builtin_clzll(value));
+        if (bits >= MAX_BITS) {
+            return BUCKETS - 1;
+        }
+        unsigned int shift = bits - SUB_BUCKET_BITS;
+        auto mantissa = static_cast<size_t>((value >> shift) & ((1u << SUB_BUCKET_BITS) - 1));
+        return (static_cast<size_t>(shift + 1) << SUB_BUCKET_BITS) + mantissa;
+    }
+
+    /**
+     * The largest value counted in bucket i.
+     */
+    static uint64_t BucketTop(size_t i) {
+        if (i < (1u << SUB_BUCKET_BITS)) {
+            return i;
+        }
+
+        auto shift = static_cast<unsigned int>((i >> SUB_BUCKET_BITS) - 1);
+        uint64_t mantissa = (1u << SUB_BUCKET_BITS) | (i & ((1u << SUB_BUCKET_BITS) - 1));
+        return ((mantissa + 1) << shift) - 1;
+    }
+
+private:
+    std::atomic<uint64_t> buckets[BUCKETS]{};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> max{0};
+};
+
+#endif //HISTOGRAM_H
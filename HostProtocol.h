@@ -0,0 +1,100 @@
+#ifndef HOSTPROTOCOL_H
+#define HOSTPROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Wire format between chip8-host and its clients, over a Unix stream socket.
+ *
+ * Every message is a 4 byte length, then a type byte, then the payload; the length counts the type and the payload.
+ * Integers are little-endian. Messages longer than HOST_MAX_MESSAGE are a protocol error and close the connection.
+ *
+ * Client to host:
+ *   CREATE       u16 cycles per frame, u32 random seed, ROM bytes   answered by CREATED or ERROR
+ *   KEYS         u32 session, u16 key mask (bit n for key n)
+ *   SUBSCRIBE    u32 session                                        frame deltas follow, the first a full frame
+ *   UNSUBSCRIBE  u32 session
+ *   DESTROY      u32 session
+ *
+ * Host to client:
+ *   CREATED      u32 session
+ *   FRAME        u32 session, u64 frame, u8 flags (HOST_FRAME_*), u16 rows, then per changed row: u8 plane, u8 row,
+ *                DISPLAY_ROW_BYTES bytes of packed pixels as in Chip8::display
+ *   ENDED        u32 session, u8 status (1 halted, 2 trapped, 3 destroyed)
+ *   ERROR        u32 session (0 if none), then a message
+ *
+ * A FRAME lists the rows that differ from the last frame sent to that connection for that session, so a client keeps
+ * one copy of the display and patches it. A connection that isn't reading keeps falling behind rather than being
+ * buffered without limit: frames are skipped for it until its output drains, and the next delta covers everything
+ * it missed. Sessions belong to the connection that created them and are destroyed when it closes; any connection
+ * may subscribe to or send keys to any session.
+ */
+const uint8_t HOST_CREATE = 0x01;
+const uint8_t HOST_KEYS = 0x02;
+const uint8_t HOST_SUBSCRIBE = 0x03;
+const uint8_t HOST_UNSUBSCRIBE = 0x04;
+const uint8_t HOST_DESTROY = 0x05;
+
+const uint8_t HOST_CREATED = 0x81;
+const uint8_t HOST_FRAME = 0x82;
+const uint8_t HOST_ENDED = 0x83;
+const uint8_t HOST_ERROR = 0xFF;
+
+const uint8_t HOST_FRAME_HIRES = 0x01;
+const uint8_t HOST_FRAME_SOUND = 0x02;
+
+const uint8_t HOST_ENDED_HALTED = 1;
+const uint8_t HOST_ENDED_TRAPPED = 2;
+const uint8_t HOST_ENDED_DESTROYED = 3;
+
+const size_t HOST_HEADER_SIZE = 5;
+const uint32_t HOST_MAX_MESSAGE = 1u << 20u;
+
+inline void Put16(std::string &out, uint16_t value) {
+    out.push_back(static_cast<char>(value));
+    out.push_back(static_cast<char>(value >> 8u));
+}
+
+inline void Put32(std::string &out, uint32_t value) {
+    Put16(out, static_cast<uint16_t>(value));
+    Put16(out, static_cast<uint16_t>(value >> 16u));
+}
+
+inline void Put64(std::string &out, uint64_t value) {
+    Put32(out, static_cast<uint32_t>(value));
+    Put32(out, static_cast<uint32_t>(value >> 32u));
+}
+
+inline uint16_t Get16(const uint8_t *in) {
+    return static_cast<uint16_t>(in[0] | (in[1] << 8u));
+}
+
+inline uint32_t Get32(const uint8_t *in) {
+    return Get16(in) | (static_cast<uint32_t>(Get16(in + 2)) << 16u);
+}
+
+inline uint64_t Get64(const uint8_t *in) {
+    return Get32(in) | (static_cast<uint64_t>(Get32(in + 4)) << 32u);
+}
+
+/**
+ * Start a message of the given type; FinishMessage() fills in its length once the payload has been appended.
+ * Returns where the message starts in out.
+ */
+inline size_t BeginMessage(std::string &out, uint8_t type) {
+    size_t start = out.size();
+    Put32(out, 0);
+    out.push_back(static_cast<char>(type));
+    return start;
+}
+
+inline void FinishMessage(std::string &out, size_t start) {
+    auto length = static_cast<uint32_t>(out.size() - start - 4);
+    for (unsigned int i = 0; i < 4; ++i) {
+        out[start + i] = static_cast<char>(length >> (8 * i));
+    }
+}
+
+#endif //HOSTPROTOCOL_H
@@ -0,0 +1,194 @@
+#include "Lockstep.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include "Hash.h"
+#include "Watchdog.h"
+
+static unsigned int RunChecked(Chip8 &chip8, unsigned int count) {
+    for (unsigned int i = 0; i < count; ++i) {
+        chip8.Cycle();
+        if (chip8.trap != Trap::None) {
+            // A trapping Cycle() leaves the architectural state alone, so this is where the reference stops
+            return i;
+        }
+    }
+
+    return count;
+}
+
+static unsigned int RunUnchecked(Chip8 &chip8, unsigned int count) {
+    for (unsigned int i = 0; i < count; ++i) {
+        chip8.CycleUnchecked();
+    }
+
+    return count;
+}
+
+const std::vector<EngineInfo> &Engines() {
+    static const std::vector<EngineInfo> engines{
+            {"checked", RunChecked},
+            {"unchecked", RunUnchecked},
+    };
+
+    return engines;
+}
+
+const EngineInfo *FindEngine(const std::string &name) {
+    for (const EngineInfo &engine : Engines()) {
+        if (name == engine.name) {
+            return &engine;
+        }
+    }
+
+    return nullptr;
+}
+
+uint64_t StateHash(const Chip8 &chip8) {
+    return HashState(chip8);
+}
+
+std::string StateDifference(const Chip8 &a, const Chip8 &b) {
+    std::string difference;
+    auto note = [&difference](bool differs, const char *name) {
+        if (differs) {
+            if (!difference.empty()) {
+                difference += ' ';
+            }
+            difference += name;
+        }
+    };
+
+    note(memcmp(a.registers, b.registers, sizeof(a.registers)) != 0, "registers");
+    note(a.index != b.index, "index");
+    note(a.pc != b.pc, "pc");
+    note(a.sp != b.sp || memcmp(a.stack, b.stack, sizeof(a.stack)) != 0, "stack");
+    note(a.delayTimer != b.delayTimer || a.soundTimer != b.soundTimer, "timers");
+    note(a.hires != b.hires, "hires");
+    note(memcmp(a.flags, b.flags, sizeof(a.flags)) != 0, "flags");
+    note(a.halted != b.halted, "halted");
+    note(a.selectedPlanes != b.selectedPlanes, "planes");
+    note(a.hasAudioPattern != b.hasAudioPattern || a.pitch != b.pitch ||
+         memcmp(a.audioPattern, b.audioPattern, sizeof(a.audioPattern)) != 0, "audio");
+    note(a.randGen != b.randGen, "random");
+    note(memcmp(a.display, b.display, sizeof(a.display)) != 0, "display");
+    note(memcmp(a.memory, b.memory, sizeof(a.memory)) != 0, "memory");
+    return difference;
+}
+
+/**
+ * Run count instructions with the frontend's frame structure, stopping early where the engine does or where the
+ * watchdog, fed every frame once the keys have run out, finds a loop. Frames are counted from Chip8::cycles, which
+ * both engines keep in step while they agree.
+ */
+static uint64_t Advance(Chip8 &chip8, Engine engine, const std::vector<uint16_t> &keys, unsigned int cyclesPerFrame,
+                        uint64_t count, Watchdog *watchdog = nullptr) {
+    uint64_t executed = 0;
+
+    while (executed < count) {
+        uint64_t frame = chip8.cycles / cyclesPerFrame;
+        if (chip8.cycles % cyclesPerFrame == 0) {
+            uint16_t held = frame < keys.size() ? keys[frame] : 0;
+            for (unsigned int key = 0; key < 16; ++key) {
+                chip8.keys[key] = (held >> key) & 0x1u;
+            }
+        }
+
+        uint64_t frameEnd = (frame + 1) * cyclesPerFrame;
+        auto step = static_cast<unsigned int>(std::min<uint64_t>(frameEnd - chip8.cycles, count - executed));
+        unsigned int ran = engine(chip8, step);
+        executed += ran;
+
+        if (ran < step) {
+            break;
+        }
+        if (chip8.cycles == frameEnd) {
+            chip8.TickTimers();
+
+            if (watchdog != nullptr && frame + 1 >= keys.size() && watchdog->Frame(chip8)) {
+                break;
+            }
+        }
+    }
+
+    return executed;
+}
+
+LockstepResult RunLockstep(const Chip8 &start, const std::vector<uint16_t> &keys, Engine reference, Engine candidate,
+                           const LockstepOptions &options) {
+    // Two live machines and the last state they agreed on, each far too big for the stack
+    auto a = std::make_unique<Chip8>(start);
+    auto b = std::make_unique<Chip8>(start);
+    auto agreed = std::make_unique<Chip8>(start);
+    std::unique_ptr<Watchdog> watchdog = options.watchdog ? std::make_unique<Watchdog>() : nullptr;
+
+    LockstepResult result;
+    unsigned int cpf = options.cyclesPerFrame;
+
+    while (result.agreed < options.instructions) {
+        uint64_t count = std::min<uint64_t>(options.interval, options.instructions - result.agreed);
+
+        // The reference decides how far is safe to go; the candidate is never asked to run past that
+        uint64_t ran = Advance(*a, reference, keys, cpf, count, watchdog.get());
+        Advance(*b, candidate, keys, cpf, ran);
+
+        if (StateHash(*a) == StateHash(*b)) {
+            result.agreed += ran;
+            if (watchdog != nullptr && watchdog->Period() > 0) {
+                // Go round the loop once more to see where it is
+                PcRange range;
+                for (uint64_t i = 0; i < watchdog->Period() * cpf; ++i) {
+                    range.Before(*a);
+                    Advance(*a, reference, keys, cpf, 1);
+                }
+
+                result.status = LockstepStatus::Hung;
+                result.period = watchdog->Period();
+                result.low = range.low;
+                result.high = range.high;
+                return result;
+            }
+            if (ran < count) {
+                result.status = LockstepStatus::Trapped;
+                return result;
+            }
+            memcpy(static_cast<void *>(agreed.get()), a.get(), sizeof(Chip8));
+            continue;
+        }
+
+        // The states agree after low instructions from the checkpoint and differ after high
+        uint64_t low = 0;
+        uint64_t high = ran;
+        while (high - low > 1) {
+            uint64_t middle = low + (high - low) / 2;
+            memcpy(static_cast<void *>(a.get()), agreed.get(), sizeof(Chip8));
+            memcpy(static_cast<void *>(b.get()), agreed.get(), sizeof(Chip8));
+            Advance(*a, reference, keys, cpf, middle);
+            Advance(*b, candidate, keys, cpf, middle);
+
+            if (StateHash(*a) == StateHash(*b)) {
+                low = middle;
+            }
+            else {
+                high = middle;
+            }
+        }
+
+        memcpy(static_cast<void *>(a.get()), agreed.get(), sizeof(Chip8));
+        memcpy(static_cast<void *>(b.get()), agreed.get(), sizeof(Chip8));
+        Advance(*a, reference, keys, cpf, low);
+        Advance(*b, candidate, keys, cpf, low);
+
+        result.status = LockstepStatus::Diverged;
+        result.agreed += low;
+        result.pc = a->pc;
+        result.opcode = (a->memory[a->pc] << 8u) | a->memory[static_cast<uint16_t>(a->pc + 1)];
+
+        Advance(*a, reference, keys, cpf, 1);
+        Advance(*b, candidate, keys, cpf, 1);
+        result.difference = StateDifference(*a, *b);
+        return result;
+    }
+
+    return result;
+}
@@ -0,0 +1,81 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Chip8.h"
+
+/**
+ * An execution strategy: run up to count instructions and return how many ran. An engine stops early rather than
+ * run an instruction that would go out of bounds.
+ */
+typedef unsigned int (*Engine)(Chip8 &chip8, unsigned int count);
+
+struct EngineInfo {
+    const char *name;
+    Engine run;
+};
+
+/**
+ * The engines lockstep testing knows about. The first is the reference: the OP_* handlers through Cycle().
+ */
+const std::vector<EngineInfo> &Engines();
+
+const EngineInfo *FindEngine(const std::string &name);
+
+/**
+ * Hash of the whole architectural state (HashState: memory, display, CPU, SUPER-CHIP and XO-CHIP state and the random
+ * generator). Bookkeeping that engines are free to keep differently (cycles, opcode, trap) is left out.
+ */
+uint64_t StateHash(const Chip8 &chip8);
+
+/**
+ * Names of the state fields that differ between a and b, space separated.
+ */
+std::string StateDifference(const Chip8 &a, const Chip8 &b);
+
+struct LockstepOptions {
+    unsigned int cyclesPerFrame = 11;
+    uint64_t instructions = 1000000;
+    // Instructions between hash comparisons
+    unsigned int interval = 4096;
+    // Stop early once the reference is stuck in a loop after the key log has run out
+    bool watchdog = true;
+};
+
+enum class LockstepStatus {
+    // Both engines agreed for every instruction
+    Agreed,
+    // The reference stopped before an out of bounds instruction; the engines agreed up to there
+    Trapped,
+    // The engines agreed up to the point the reference started repeating itself
+    Hung,
+    Diverged
+};
+
+struct LockstepResult {
+    LockstepStatus status = LockstepStatus::Agreed;
+    // Instructions both engines ran and agreed on
+    uint64_t agreed = 0;
+    // For a divergence, the instruction after which the states first differ, and how
+    uint16_t pc = 0;
+    uint16_t opcode = 0;
+    std::string difference;
+    // For a hang, the length of the loop in frames and the pc range it runs in
+    uint64_t period = 0;
+    uint16_t low = 0;
+    uint16_t high = 0;
+};
+
+/**
+ * Run two engines from the same state with the same keys (one mask per frame, none once the log runs out), the way
+ * the frontend does: keys at the start of each frame and timers at the end. Their state hashes are compared every
+ * interval instructions; on a mismatch both are rewound to the last agreeing comparison and the first diverging
+ * instruction is found by bisection. Once the keys have run out, a Watchdog on the reference ends the run as soon as
+ * it is going round in circles.
+ */
+LockstepResult RunLockstep(const Chip8 &start, const std::vector<uint16_t> &keys, Engine reference, Engine candidate,
+                           const LockstepOptions &options);
+
+#endif //LOCKSTEP_H
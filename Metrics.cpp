@@ -0,0 +1,59 @@
+#include "Metrics.h"
+#include <cstdio>
+
+// The quantiles every histogram is summarised by
+static const double QUANTILES[] = {0.5, 0.99, 0.999};
+
+Counter &MetricsRegistry::AddCounter(const std::string &name, const std::string &help) {
+    metrics.push_back(Metric{name, help, Type::Counter, std::make_unique<Counter>(), nullptr, nullptr});
+    return *metrics.back().counter;
+}
+
+Gauge &MetricsRegistry::AddGauge(const std::string &name, const std::string &help) {
+    metrics.push_back(Metric{name, help, Type::Gauge, nullptr, std::make_unique<Gauge>(), nullptr});
+    return *metrics.back().gauge;
+}
+
+Histogram &MetricsRegistry::AddHistogram(const std::string &name, const std::string &help, double scale) {
+    metrics.push_back(Metric{name, help, Type::Histogram, nullptr, nullptr, std::make_unique<Histogram>(), scale});
+    return *metrics.back().histogram;
+}
+
+std::string MetricsRegistry::Render() const {
+    std::string text;
+    char line[256];
+
+    for (const Metric &metric : metrics) {
+        text += "# HELP " + metric.name + " " + metric.help + "\n";
+
+        switch (metric.type) {
+            case Type::Counter:
+                snprintf(line, sizeof(line), "# TYPE %s counter\n%s %llu\n", metric.name.c_str(), metric.name.c_str(),
+                         static_cast<unsigned long long>(metric.counter->Value()));
+                text += line;
+                break;
+            case Type::Gauge:
+                snprintf(line, sizeof(line), "# TYPE %s gauge\n%s %.9g\n", metric.name.c_str(), metric.name.c_str(),
+                         metric.gauge->Value());
+                text += line;
+                break;
+            case Type::Histogram: {
+                const Histogram &histogram = *metric.histogram;
+                snprintf(line, sizeof(line), "# TYPE %s summary\n", metric.name.c_str());
+                text += line;
+                for (double quantile : QUANTILES) {
+                    snprintf(line, sizeof(line), "%s{quantile=\"%g\"} %.9g\n", metric.name.c_str(), quantile,
+                             static_cast<double>(histogram.Percentile(quantile)) * metric.scale);
+                    text += line;
+                }
+                snprintf(line, sizeof(line), "%s_sum %.9g\n%s_count %llu\n", metric.name.c_str(),
+                         static_cast<double>(histogram.Sum()) * metric.scale, metric.name.c_str(),
+                         static_cast<unsigned long long>(histogram.Count()));
+                text += line;
+                break;
+            }
+        }
+    }
+
+    return text;
+}
@@ -0,0 +1,91 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Histogram.h"
+
+/**
+ * A count that only goes up, such as instructions executed.
+ */
+class Counter {
+public:
+    void Add(uint64_t n = 1) {
+        value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t Value() const {
+        return value.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> value{0};
+};
+
+/**
+ * A value that is set rather than counted, such as the current frame rate.
+ */
+class Gauge {
+public:
+    void Set(double newValue) {
+        value.store(newValue, std::memory_order_relaxed);
+    }
+
+    double Value() const {
+        return value.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<double> value{0};
+};
+
+/**
+ * Named counters, gauges and histograms, rendered in the Prometheus text exposition format.
+ *
+ * Metrics are added while setting up, before the threads that update them start, and live as long as the registry.
+ * Updating one is a relaxed atomic operation and never takes a lock, so the emulation thread can update them every
+ * frame. Rendering reads them from any thread while they change; each value is read whole, but the values of one
+ * render needn't all be from the same instant.
+ *
+ * A histogram is exposed as a Prometheus summary: its p50, p99 and p999 since the start, with its sum and count.
+ * Values are recorded in whole units (nanoseconds, say) and multiplied by the histogram's scale when rendered, so
+ * that exposed times are in seconds as Prometheus expects.
+ */
+class MetricsRegistry {
+public:
+    /**
+     * Add a metric. Names should follow Prometheus conventions: chip8_ prefixed, counters ending in _total and
+     * times in _seconds.
+     */
+    Counter &AddCounter(const std::string &name, const std::string &help);
+
+    Gauge &AddGauge(const std::string &name, const std::string &help);
+
+    Histogram &AddHistogram(const std::string &name, const std::string &help, double scale);
+
+    std::string Render() const;
+
+private:
+    enum class Type {
+        Counter,
+        Gauge,
+        Histogram
+    };
+
+    struct Metric {
+        std::string name;
+        std::string help;
+        Type type;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+        double scale = 1;
+    };
+
+    std::vector<Metric> metrics;
+};
+
+#endif //METRICS_H
@@ -0,0 +1,148 @@
+#include "MetricsExporter.h"
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using Clock = std::chrono::steady_clock;
+
+// How long a client has to send its request
+static const int REQUEST_TIMEOUT_MS = 1000;
+
+MetricsExporter::MetricsExporter(const MetricsRegistry &registry, uint16_t port, const std::string &file,
+                                 unsigned int intervalMs)
+        : registry(registry), file(file), intervalMs(intervalMs) {
+    if (port != 0) {
+        listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listener < 0) {
+            return;
+        }
+
+        // A restarted emulator can take the port back straight away
+        int reuse = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || listen(listener, 4) != 0) {
+            close(listener);
+            listener = -1;
+            return;
+        }
+    }
+
+    // Find out now, rather than every interval from then on, that the file can't be written
+    if ((!file.empty() && !Dump()) || pipe2(wake, O_CLOEXEC) != 0) {
+        if (listener >= 0) {
+            close(listener);
+            listener = -1;
+        }
+        return;
+    }
+
+    open = true;
+    thread = std::thread(&MetricsExporter::Run, this);
+}
+
+MetricsExporter::~MetricsExporter() {
+    if (open) {
+        close(wake[1]);
+        thread.join();
+        close(wake[0]);
+
+        if (!file.empty()) {
+            Dump();
+        }
+    }
+
+    if (listener >= 0) {
+        close(listener);
+    }
+}
+
+void MetricsExporter::Run() {
+    Clock::time_point nextDump = Clock::now() + std::chrono::milliseconds(intervalMs);
+
+    while (true) {
+        int timeoutMs = -1;
+        if (!file.empty()) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(nextDump - Clock::now()).count();
+            timeoutMs = remaining > 0 ? static_cast<int>(remaining) : 0;
+        }
+
+        pollfd descriptors[2] = {{wake[0], POLLIN, 0}, {listener, POLLIN, 0}};
+        int ready = poll(descriptors, listener >= 0 ? 2 : 1, timeoutMs);
+
+        if (ready > 0 && descriptors[0].revents != 0) {
+            return;
+        }
+
+        if (ready > 0 && descriptors[1].revents != 0) {
+            int client = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client >= 0) {
+                Serve(client);
+                close(client);
+            }
+        }
+
+        if (!file.empty() && Clock::now() >= nextDump) {
+            Dump();
+            nextDump += std::chrono::milliseconds(intervalMs);
+        }
+    }
+}
+
+void MetricsExporter::Serve(int client) {
+    // Any request gets the metrics, but it has to be read first: closing a socket with unread data resets the
+    // connection, which can lose the response
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < sizeof(buffer) * 8) {
+        pollfd descriptor{client, POLLIN, 0};
+        if (poll(&descriptor, 1, REQUEST_TIMEOUT_MS) <= 0) {
+            return;
+        }
+        ssize_t size = recv(client, buffer, sizeof(buffer), 0);
+        if (size <= 0) {
+            return;
+        }
+        request.append(buffer, static_cast<size_t>(size));
+    }
+
+    std::string body = registry.Render();
+    std::string response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                           std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+
+    size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t size = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (size <= 0) {
+            return;
+        }
+        sent += static_cast<size_t>(size);
+    }
+}
+
+bool MetricsExporter::Dump() {
+    std::string temporary = file + ".tmp";
+    FILE *out = fopen(temporary.c_str(), "w");
+    if (out == nullptr) {
+        return false;
+    }
+
+    std::string text = registry.Render();
+    bool written = fwrite(text.data(), 1, text.size(), out) == text.size();
+    written = fclose(out) == 0 && written;
+
+    if (!written || rename(temporary.c_str(), file.c_str()) != 0) {
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
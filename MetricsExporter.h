@@ -0,0 +1,55 @@
+#ifndef METRICSEXPORTER_H
+#define METRICSEXPORTER_H
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include "Metrics.h"
+
+/**
+ * Makes a registry's metrics available outside the process, from a thread of its own.
+ *
+ * With a port, it serves the Prometheus text format over HTTP on 127.0.0.1:port, whatever the path asked for, so
+ * Prometheus can scrape it directly; only the local machine can connect. With a file, it rewrites the file every
+ * interval in the same format, for node_exporter's textfile collector or for anyone reading it by hand. The file is
+ * written beside itself and renamed into place, so a reader never sees half of it. It is written one last time when
+ * the exporter is destroyed, so it ends with the final totals.
+ *
+ * Clients are served one at a time; a client that doesn't send its request within a second is dropped.
+ */
+class MetricsExporter {
+public:
+    /**
+     * port 0 serves nothing and an empty file writes nothing.
+     */
+    MetricsExporter(const MetricsRegistry &registry, uint16_t port, const std::string &file, unsigned int intervalMs);
+
+    ~MetricsExporter();
+
+    MetricsExporter(const MetricsExporter &) = delete;
+
+    MetricsExporter &operator=(const MetricsExporter &) = delete;
+
+    bool IsOpen() const {
+        return open;
+    }
+
+private:
+    void Run();
+
+    void Serve(int client);
+
+    bool Dump();
+
+    const MetricsRegistry &registry;
+    std::string file;
+    unsigned int intervalMs;
+    int listener = -1;
+    bool open = false;
+
+    // The write end is closed when the exporter is destroyed, which wakes its thread from poll
+    int wake[2] = {-1, -1};
+    std::thread thread;
+};
+
+#endif //METRICSEXPORTER_H
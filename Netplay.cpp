@@ -0,0 +1,348 @@
+#include "Netplay.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+#include "Hash.h"
+#include "HostProtocol.h"
+#include "Trace.h"
+
+// Settled states are hashed and compared this often, in frames
+static const uint64_t HASH_INTERVAL = 30;
+static const size_t HASHES_KEPT = 16;
+// Unacknowledged input is sent again at least this often while waiting
+static const std::chrono::milliseconds RESEND_INTERVAL(8);
+static const uint32_t NO_HASH = UINT32_MAX;
+
+// Snapshots copy memory by page, and everything else a Chip8 holds in one piece either side of it
+static const size_t PAGE_SIZE = 1u << DIRTY_PAGE_BITS;
+
+static_assert(std::is_trivially_copyable_v<Chip8>, "snapshots are copied bytewise");
+static_assert(MEMORY_SIZE / PAGE_SIZE == 64, "dirty pages are one bit each of a uint64_t");
+
+static void CopyState(Chip8 &to, const Chip8 &from, uint64_t pages) {
+    auto *out = reinterpret_cast<uint8_t *>(&to);
+    auto *in = reinterpret_cast<const uint8_t *>(&from);
+    memcpy(out, in, Chip8State::MEMORY_OFFSET);
+    memcpy(out + Chip8State::MEMORY_END, in + Chip8State::MEMORY_END, sizeof(Chip8) - Chip8State::MEMORY_END);
+
+    while (pages != 0) {
+        unsigned int page = __builtin_ctzll(pages);
+        pages &= pages - 1;
+        memcpy(to.memory + page * PAGE_SIZE, from.memory + page * PAGE_SIZE, PAGE_SIZE);
+    }
+}
+
+Netplay::Netplay(Chip8 &chip8, bool verified, UdpLink &link, const NetplayOptions &options)
+        : chip8(chip8), verified(verified), link(link), options(options),
+          localMask(options.wholeKeypad ? 0xFFFF : options.player == 0 ? NETPLAY_LEFT_KEYS : NETPLAY_RIGHT_KEYS),
+          remoteMask(options.wholeKeypad ? 0xFFFF : options.player == 0 ? NETPLAY_RIGHT_KEYS : NETPLAY_LEFT_KEYS),
+          localInputs(options.inputDelay, 0), snapshots(options.maxRollback + 1) {
+    for (Snapshot &snapshot : snapshots) {
+        snapshot.state = std::make_unique<Chip8>();
+    }
+}
+
+Netplay::~Netplay() = default;
+
+void Netplay::RunFrame(Chip8 &chip8, uint16_t keys, unsigned int cyclesPerFrame, bool verified) {
+    TraceSpan span("frame", "emulation");
+    for (unsigned int key = 0; key < 16; ++key) {
+        chip8.keys[key] = (keys >> key) & 0x1u;
+    }
+
+    chip8.RunFrame(cyclesPerFrame, verified);
+}
+
+uint64_t Netplay::StateHash(const Chip8 &chip8) {
+    // Both peers run the same engine, so a trap or a cycle count that differs is a desync as well
+    return HashMix(HashMix(HashState(chip8), chip8.cycles), static_cast<uint64_t>(chip8.trap));
+}
+
+bool Netplay::Connect(uint64_t romHash, std::chrono::milliseconds timeout, std::string &error) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    bool heard = false;
+    bool heardBack = false;
+    uint32_t seed = options.seed;
+    std::string packet;
+
+    while (!(heard && heardBack)) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            error = "timed out waiting for the other player";
+            return false;
+        }
+
+        std::string hello(1, static_cast<char>(NETPLAY_HELLO));
+        hello.push_back(static_cast<char>(options.player));
+        hello.push_back(static_cast<char>(heard));
+        Put64(hello, romHash);
+        Put32(hello, options.seed);
+        Put16(hello, static_cast<uint16_t>(options.cyclesPerFrame));
+        hello.push_back(static_cast<char>(options.inputDelay));
+        hello.push_back(static_cast<char>(options.wholeKeypad));
+        link.Send(hello);
+
+        auto resend = std::chrono::steady_clock::now() + std::chrono::milliseconds(50);
+        while (std::chrono::steady_clock::now() < resend && !(heard && heardBack)) {
+            if (!link.Receive(packet)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+
+            auto bytes = reinterpret_cast<const uint8_t *>(packet.data());
+            if (packet.size() >= 19 && bytes[0] == NETPLAY_HELLO) {
+                if (bytes[1] == options.player) {
+                    error = "both sides are player " + std::to_string(options.player);
+                    return false;
+                }
+                if (Get64(bytes + 3) != romHash) {
+                    error = "the other player is running a different ROM";
+                    return false;
+                }
+                if (Get16(bytes + 15) != options.cyclesPerFrame || (bytes[18] != 0) != options.wholeKeypad) {
+                    error = "the other player is running with different settings";
+                    return false;
+                }
+
+                heard = true;
+                heardBack = heardBack || bytes[2] != 0;
+                if (bytes[1] == 0) {
+                    seed = Get32(bytes + 11);
+                }
+            }
+            else if (heard && !packet.empty() && bytes[0] == NETPLAY_INPUT) {
+                // The other side only starts sending input once it has heard us, even if that hello was lost
+                heardBack = true;
+            }
+        }
+    }
+
+    chip8.randGen.seed(seed);
+    SendInput();
+    return true;
+}
+
+uint64_t Netplay::Confirmed() const {
+    return std::min<uint64_t>(frame, remoteInputs.size());
+}
+
+int64_t Netplay::FramesAhead() const {
+    auto ahead = static_cast<int64_t>(frame) - static_cast<int64_t>(peerFrame);
+    return (ahead - peerAhead) / 2;
+}
+
+void Netplay::Poll() {
+    std::string packet;
+    while (link.Receive(packet)) {
+        Receive(packet);
+    }
+
+    RollBack();
+    SettleHashes();
+
+    if (std::chrono::steady_clock::now() - lastSent >= RESEND_INTERVAL) {
+        SendInput();
+    }
+}
+
+bool Netplay::Advance(uint16_t keys) {
+    std::string packet;
+    while (link.Receive(packet)) {
+        Receive(packet);
+    }
+
+    RollBack();
+    SettleHashes();
+
+    // Running on would mean guessing further back than the snapshots go
+    if (frame >= remoteInputs.size() + options.maxRollback) {
+        ++stats.stalls;
+        if (std::chrono::steady_clock::now() - lastSent >= RESEND_INTERVAL) {
+            SendInput();
+        }
+        return false;
+    }
+
+    localInputs.push_back(keys & localMask);
+
+    Save(frame);
+    Simulate(frame);
+    ++frame;
+    ++stats.frames;
+    SettleHashes();
+
+    SendInput();
+    return true;
+}
+
+/**
+ * INPUT: u8 type, u32 inputs of ours the sender has, u32 sender's frame, i16 sender's lead over us, u32 first frame,
+ * u8 count, u16 keys for each, then u32 frame and u64 hash of the sender's newest settled state (frame NO_HASH if
+ * none yet).
+ */
+void Netplay::SendInput() {
+    uint64_t first = std::min<uint64_t>(peerAck, localInputs.size());
+    auto count = static_cast<unsigned int>(std::min<uint64_t>(localInputs.size() - first, 255));
+    int64_t lead = std::clamp<int64_t>(static_cast<int64_t>(frame) - static_cast<int64_t>(peerFrame), -32768, 32767);
+
+    std::string packet(1, static_cast<char>(NETPLAY_INPUT));
+    Put32(packet, static_cast<uint32_t>(remoteInputs.size()));
+    Put32(packet, static_cast<uint32_t>(frame));
+    Put16(packet, static_cast<uint16_t>(static_cast<int16_t>(lead)));
+    Put32(packet, static_cast<uint32_t>(first));
+    packet.push_back(static_cast<char>(count));
+    for (unsigned int i = 0; i < count; ++i) {
+        Put16(packet, localInputs[first + i]);
+    }
+
+    if (hashes.empty()) {
+        Put32(packet, NO_HASH);
+        Put64(packet, 0);
+    }
+    else {
+        Put32(packet, static_cast<uint32_t>(hashes.back().first));
+        Put64(packet, hashes.back().second);
+    }
+
+    link.Send(packet);
+    lastSent = std::chrono::steady_clock::now();
+}
+
+void Netplay::Receive(const std::string &packet) {
+    auto bytes = reinterpret_cast<const uint8_t *>(packet.data());
+    if (packet.size() < 16 || bytes[0] != NETPLAY_INPUT) {
+        // Late hellos, or anything else that isn't for us
+        return;
+    }
+
+    unsigned int count = bytes[15];
+    if (packet.size() != 16 + 2 * count + 12) {
+        return;
+    }
+
+    peerAck = std::max<uint64_t>(peerAck, Get32(bytes + 1));
+    uint64_t sentFrame = Get32(bytes + 5);
+    if (sentFrame >= peerFrame) {
+        peerFrame = sentFrame;
+        peerAhead = static_cast<int16_t>(Get16(bytes + 9));
+    }
+
+    uint64_t first = Get32(bytes + 11);
+    for (uint64_t input = remoteInputs.size(); input >= first && input < first + count; ++input) {
+        uint16_t keys = Get16(bytes + 16 + 2 * (input - first)) & remoteMask;
+
+        if (input < frame && usedRemote[input] != keys) {
+            rollbackTo = std::min(rollbackTo, input);
+        }
+        remoteInputs.push_back(keys);
+    }
+
+    uint32_t hashFrame = Get32(bytes + 16 + 2 * count);
+    if (hashFrame != NO_HASH && (peerHashFrame == UINT64_MAX || hashFrame > peerHashFrame)) {
+        peerHashFrame = hashFrame;
+        peerHash = Get64(bytes + 20 + 2 * count);
+
+        for (const auto &hash : hashes) {
+            if (hash.first == peerHashFrame) {
+                ++stats.checks;
+                stats.desyncs += hash.second != peerHash;
+            }
+        }
+    }
+}
+
+void Netplay::Save(uint64_t saved) {
+    TraceSpan span("snapshot", "state", "frame", saved);
+    Snapshot &snapshot = snapshots[saved % snapshots.size()];
+    CopyState(*snapshot.state, chip8, snapshot.stale);
+    snapshot.frame = saved;
+    snapshot.stale = 0;
+}
+
+void Netplay::Restore(uint64_t restored) {
+    TraceSpan span("restore", "state", "frame", restored);
+    Snapshot &snapshot = snapshots[restored % snapshots.size()];
+    uint64_t changed = snapshot.stale;
+    CopyState(chip8, *snapshot.state, changed);
+    chip8.dirtyPages = 0;
+    chip8.displayDirty = true;
+
+    // The pages just put back differ from what the other snapshots were compared against
+    for (Snapshot &other : snapshots) {
+        other.stale |= changed;
+    }
+    snapshot.stale = 0;
+}
+
+void Netplay::Simulate(uint64_t simulated) {
+    bool known = simulated < remoteInputs.size();
+    uint16_t remote = known ? remoteInputs[simulated] : remoteInputs.empty() ? 0 : remoteInputs.back();
+
+    if (usedRemote.size() <= simulated) {
+        usedRemote.resize(simulated + 1);
+    }
+    usedRemote[simulated] = remote;
+
+    RunFrame(chip8, localInputs[simulated] | remote, options.cyclesPerFrame, verified);
+
+    for (Snapshot &snapshot : snapshots) {
+        snapshot.stale |= chip8.dirtyPages;
+    }
+    chip8.dirtyPages = 0;
+
+    // Hashed now, while this is the live state, but only sent once every input before it is known and it can no
+    // longer be rolled back
+    if ((simulated + 1) % HASH_INTERVAL == 0) {
+        unsettledHashes.erase(std::remove_if(unsettledHashes.begin(), unsettledHashes.end(), [&](const auto &hash) {
+            return hash.first == simulated + 1;
+        }), unsettledHashes.end());
+        unsettledHashes.emplace_back(simulated + 1, StateHash(chip8));
+    }
+}
+
+void Netplay::RollBack() {
+    if (rollbackTo >= frame) {
+        rollbackTo = UINT64_MAX;
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t from = rollbackTo;
+    rollbackTo = UINT64_MAX;
+    TraceSpan span("rollback", "netplay", "frames", frame - from);
+
+    Restore(from);
+    for (uint64_t replayed = from; replayed < frame; ++replayed) {
+        Save(replayed);
+        Simulate(replayed);
+    }
+
+    int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    ++stats.rollbacks;
+    stats.resimulated += frame - from;
+    stats.deepestRollback = std::max(stats.deepestRollback, static_cast<unsigned int>(frame - from));
+    stats.slowestRollbackNs = std::max(stats.slowestRollbackNs, elapsed);
+}
+
+void Netplay::SettleHashes() {
+    uint64_t confirmed = Confirmed();
+
+    while (!unsettledHashes.empty() && unsettledHashes.front().first <= confirmed) {
+        RecordHash(unsettledHashes.front().first, unsettledHashes.front().second);
+        unsettledHashes.erase(unsettledHashes.begin());
+    }
+}
+
+void Netplay::RecordHash(uint64_t hashed, uint64_t hash) {
+    hashes.emplace_back(hashed, hash);
+    if (hashes.size() > HASHES_KEPT) {
+        hashes.erase(hashes.begin());
+    }
+
+    if (hashed == peerHashFrame) {
+        ++stats.checks;
+        stats.desyncs += hash != peerHash;
+    }
+}
@@ -0,0 +1,193 @@
+#ifndef NETPLAY_H
+#define NETPLAY_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Chip8.h"
+#include "UdpLink.h"
+
+// Each player's half of the keypad: the left two columns (1 2 / 4 5 / 7 8 / A 0) and the right two (3 C / 6 D / 9 E /
+// B F), which covers the two-player ROMs that split the keypad, such as Pong's 1/4 and C/D
+const uint16_t NETPLAY_LEFT_KEYS = 0x05B7;
+const uint16_t NETPLAY_RIGHT_KEYS = 0xFA48;
+
+const uint8_t NETPLAY_HELLO = 1;
+const uint8_t NETPLAY_INPUT = 2;
+
+struct NetplayOptions {
+    // 0 or 1; player 0's seed is the one both sides use
+    unsigned int player = 0;
+    unsigned int cyclesPerFrame = 11;
+    // Frames between a key being sampled and the frame it is applied in, hiding that much latency without rollback
+    unsigned int inputDelay = 2;
+    // Frames this side may run ahead of the last input heard from the other before it waits
+    unsigned int maxRollback = 8;
+    // Let both players use every key instead of half the keypad each
+    bool wholeKeypad = false;
+    uint32_t seed = 0;
+};
+
+struct NetplayStats {
+    uint64_t frames = 0;
+    // Frames not run because the other side's input was too far behind
+    uint64_t stalls = 0;
+    uint64_t rollbacks = 0;
+    uint64_t resimulated = 0;
+    unsigned int deepestRollback = 0;
+    int64_t slowestRollbackNs = 0;
+    // State hashes compared with the other side, and how many differed
+    uint64_t checks = 0;
+    uint64_t desyncs = 0;
+};
+
+/**
+ * Two-player netplay with input delay and rollback, between two processes (or threads) exchanging UDP packets.
+ *
+ * Each side runs its own copy of the machine. Every frame it records its player's keys for inputDelay frames later
+ * and sends every input the other side hasn't acknowledged yet, so a lost packet is repaired by the next one. When
+ * the other side's input for a frame hasn't arrived, its last known input is assumed, which is usually right since
+ * keys are held for many frames. A snapshot is taken before every frame; when an input arrives that differs from
+ * the guess, the machine is restored to the frame it belongs to and the frames since are run again with it. A side
+ * that gets maxRollback frames ahead of the other's input stops advancing until it catches up.
+ *
+ * Snapshots only copy the memory pages written since the snapshot slot was last used, as Chip8::dirtyPages reports
+ * them, so taking one every frame costs a few kilobytes of copying rather than the whole 64K. The core has to be
+ * deterministic for any of this to work: Connect() agrees a seed for the random number generator, and every few
+ * frames both sides send a hash of a state whose inputs are settled so a divergence is caught.
+ */
+class Netplay {
+public:
+    Netplay(Chip8 &chip8, bool verified, UdpLink &link, const NetplayOptions &options);
+
+    ~Netplay();
+
+    Netplay(const Netplay &) = delete;
+
+    Netplay &operator=(const Netplay &) = delete;
+
+    /**
+     * Wait for the other side, check it is running the same ROM the same way as the other player, and seed the
+     * machine. On failure error says why.
+     */
+    bool Connect(uint64_t romHash, std::chrono::milliseconds timeout, std::string &error);
+
+    /**
+     * Run the next frame with this player's keys. False, without running anything, when this side is too far ahead
+     * of the other's input.
+     */
+    bool Advance(uint16_t keys);
+
+    /**
+     * Take in the other side's packets and roll back if they change the past, and resend anything unacknowledged.
+     * Advance() does this too; call it while waiting.
+     */
+    void Poll();
+
+    /**
+     * Frames run so far; the machine is at the start of this frame.
+     */
+    uint64_t Frame() const {
+        return frame;
+    }
+
+    /**
+     * Frames whose input from both players is known, and which will therefore never be run again.
+     */
+    uint64_t Confirmed() const;
+
+    /**
+     * Whether the other side has every input this side has recorded.
+     */
+    bool Acknowledged() const {
+        return peerAck >= localInputs.size();
+    }
+
+    /**
+     * About how many frames this side is ahead of the other, from both sides' view of the gap; the caller should
+     * slow down when it's more than one.
+     */
+    int64_t FramesAhead() const;
+
+    /**
+     * Every input each player has been confirmed to have made, frame by frame, with the delay frames first.
+     */
+    const std::vector<uint16_t> &Inputs(unsigned int player) const {
+        return player == options.player ? localInputs : remoteInputs;
+    }
+
+    NetplayStats Stats() const {
+        return stats;
+    }
+
+    /**
+     * One frame as Netplay runs it: the keys held for its instructions, then the timers tick.
+     */
+    static void RunFrame(Chip8 &chip8, uint16_t keys, unsigned int cyclesPerFrame, bool verified);
+
+    /**
+     * HashState (everything that decides what the machine does next, random number generator included) with the
+     * cycle count and trap.
+     */
+    static uint64_t StateHash(const Chip8 &chip8);
+
+private:
+    struct Snapshot {
+        uint64_t frame = UINT64_MAX;
+        std::unique_ptr<Chip8> state;
+        // Pages the live machine has written since this snapshot was taken, which are the ones that differ
+        uint64_t stale = ~0ull;
+    };
+
+    void Receive(const std::string &packet);
+
+    void SendInput();
+
+    void Save(uint64_t frame);
+
+    void Restore(uint64_t frame);
+
+    void Simulate(uint64_t frame);
+
+    void RollBack();
+
+    void SettleHashes();
+
+    void RecordHash(uint64_t frame, uint64_t hash);
+
+    Chip8 &chip8;
+    bool verified;
+    UdpLink &link;
+    NetplayOptions options;
+    uint16_t localMask;
+    uint16_t remoteMask;
+
+    uint64_t frame = 0;
+    // Indexed by frame. The other player's inputs are the contiguous run received so far.
+    std::vector<uint16_t> localInputs;
+    std::vector<uint16_t> remoteInputs;
+    // What was assumed for the other player when each frame was last run
+    std::vector<uint16_t> usedRemote;
+    // Earliest frame run on a wrong guess, or UINT64_MAX
+    uint64_t rollbackTo = UINT64_MAX;
+    // How many of our inputs the other side has
+    uint64_t peerAck = 0;
+    uint64_t peerFrame = 0;
+    int64_t peerAhead = 0;
+
+    std::vector<Snapshot> snapshots;
+
+    // Hashes of states that may yet be rolled back, oldest first; our recent settled ones; and the newest one the
+    // other side sent that we couldn't check yet
+    std::vector<std::pair<uint64_t, uint64_t>> unsettledHashes;
+    std::vector<std::pair<uint64_t, uint64_t>> hashes;
+    uint64_t peerHashFrame = UINT64_MAX;
+    uint64_t peerHash = 0;
+
+    std::chrono::steady_clock::time_point lastSent;
+    NetplayStats stats;
+};
+
+#endif //NETPLAY_H
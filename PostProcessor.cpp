@@ -0,0 +1,253 @@
+#include "PostProcessor.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define POSTPROCESSOR_X86 1
+#endif
+
+// Output rows handed to the pool at a time
+static const unsigned int BAND_ROWS = 32;
+
+PostProcessor::PostProcessor(PixelFormat format, unsigned int scale, const PostProcessSettings &settings,
+                             ThreadPool *pool)
+        : scale(std::max(scale, 1u)), pool(pool), masked(settings.mask > 0.0f),
+          decay(static_cast<uint16_t>(std::clamp(settings.persistence, 0.0f, 1.0f) * 256.0f)) {
+    bool bgra = format == PixelFormat::BGRA8888;
+
+    auto channel = [](uint32_t colour, unsigned int shift) {
+        return static_cast<float>((colour >> shift) & 0xFFu);
+    };
+
+    ramps.resize(static_cast<size_t>(this->scale) * 256);
+
+    for (unsigned int row = 0; row < this->scale; ++row) {
+        // Brightest through the middle of each pixel row, falling off quadratically to the edges
+        float t = (row + 0.5f) / this->scale;
+        float edge = 2.0f * std::fabs(t - 0.5f);
+        float lineFactor = 1.0f - std::clamp(settings.scanlines, 0.0f, 1.0f) * edge * edge;
+
+        for (unsigned int level = 0; level < 256; ++level) {
+            float mix = level / 255.0f;
+            uint8_t rgb[3];
+
+            for (unsigned int c = 0; c < 3; ++c) {
+                unsigned int shift = 16 - 8 * c;
+                float value = channel(settings.offColour, shift) * (1.0f - mix) + channel(settings.onColour, shift) * mix;
+                rgb[c] = static_cast<uint8_t>(std::lround(value * lineFactor));
+            }
+
+            uint8_t bytes[4] = {bgra ? rgb[2] : rgb[0], rgb[1], bgra ? rgb[0] : rgb[2], 0xFF};
+            memcpy(&ramps[row * 256 + level], bytes, 4);
+        }
+    }
+
+    if (masked) {
+        auto dim = static_cast<uint16_t>(256.0f * (1.0f - std::clamp(settings.mask, 0.0f, 1.0f)));
+        maskRow.resize(static_cast<size_t>(Width()) * 4);
+
+        for (unsigned int x = 0; x < Width(); ++x) {
+            // Columns cycle red, green, blue; the other two channels are dimmed. Alpha is left alone.
+            unsigned int lit = x % 3;
+            uint16_t rgb[3] = {dim, dim, dim};
+            rgb[lit] = 256;
+
+            maskRow[x * 4 + 0] = bgra ? rgb[2] : rgb[0];
+            maskRow[x * 4 + 1] = rgb[1];
+            maskRow[x * 4 + 2] = bgra ? rgb[0] : rgb[2];
+            maskRow[x * 4 + 3] = 256;
+        }
+    }
+
+    lines.resize(static_cast<size_t>(Width()) * (pool != nullptr ? pool->Size() : 1));
+}
+
+void PostProcessor::Reset() {
+    memset(glow, 0, sizeof(glow));
+}
+
+/**
+ * glow = max(lit ? 255 : 0, glow * decay / 256)
+ */
+void PostProcessor::Decay(const Frame &frame) {
+    ExpandToHires(frame, hiresFrame);
+
+    for (unsigned int y = 0; y < HIRES_VIDEO_HEIGHT; ++y) {
+        uint8_t *row = glow[y];
+
+        for (unsigned int byte = 0; byte < FRAME_ROW_BYTES; ++byte) {
+            uint8_t bits = hiresFrame.pixels[y][byte];
+            uint8_t *px = &row[byte * 8];
+
+#ifdef POSTPROCESSOR_X86
+            // Spread the 8 bits over 8 bytes, then scale the old brightness in 16 bit lanes
+            __m128i select = _mm_set_epi8(0, 0, 0, 0, 0, 0, 0, 0,
+                                          1, 2, 4, 8, 16, 32, 64, static_cast<char>(128));
+            __m128i lit = _mm_cmpeq_epi8(_mm_and_si128(_mm_set1_epi8(static_cast<char>(bits)), select), select);
+            __m128i old = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(px)),
+                                            _mm_setzero_si128());
+            __m128i faded = _mm_srli_epi16(_mm_mullo_epi16(old, _mm_set1_epi16(static_cast<int16_t>(decay))), 8);
+            __m128i result = _mm_max_epu8(_mm_packus_epi16(faded, faded), lit);
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(px), result);
+#else
+            for (unsigned int bit = 0; bit < 8; ++bit) {
+                uint8_t faded = static_cast<uint8_t>((px[bit] * decay) >> 8u);
+                px[bit] = (bits & (0x80u >> bit)) ? 0xFF : faded;
+            }
+#endif
+        }
+    }
+}
+
+#ifdef POSTPROCESSOR_X86
+
+/**
+ * row[x] = row[x] * mask[x] / 256 per channel, 8 pixels at a time.
+ */
+__attribute__((target("avx2")))
+static void ApplyMaskAvx2(uint8_t *row, const uint16_t *mask, unsigned int pixels) {
+    unsigned int x = 0;
+
+    for (; x + 8 <= pixels; x += 8) {
+        __m256i px = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + x * 4));
+        __m256i lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(px));
+        __m256i hi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(px, 1));
+        lo = _mm256_srli_epi16(_mm256_mullo_epi16(lo, _mm256_loadu_si256(
+                reinterpret_cast<const __m256i *>(mask + x * 4))), 8);
+        hi = _mm256_srli_epi16(_mm256_mullo_epi16(hi, _mm256_loadu_si256(
+                reinterpret_cast<const __m256i *>(mask + x * 4 + 16))), 8);
+        // packus works within 128 bit lanes, so put the halves back in order afterwards
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(row + x * 4), packed);
+    }
+
+    for (unsigned int i = x * 4; i < pixels * 4; ++i) {
+        row[i] = static_cast<uint8_t>((row[i] * mask[i]) >> 8u);
+    }
+}
+
+/**
+ * Copy a finished row out with non-temporal stores. The image is far bigger than the cache and nothing reads it back
+ * soon, so this saves reading every destination line in before overwriting it.
+ */
+__attribute__((target("avx2")))
+static void StreamRowAvx2(uint32_t *dst, const uint32_t *src, unsigned int pixels) {
+    unsigned int x = 0;
+
+    for (; x + 8 <= pixels; x += 8) {
+        _mm256_stream_si256(reinterpret_cast<__m256i *>(dst + x),
+                            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + x)));
+    }
+
+    for (; x < pixels; ++x) {
+        dst[x] = src[x];
+    }
+}
+
+/**
+ * Fill `count` pixels with one colour. count is at least 8.
+ */
+__attribute__((target("avx2")))
+static void FillAvx2(uint32_t *dst, uint32_t colour, unsigned int count) {
+    __m256i fill = _mm256_set1_epi32(static_cast<int32_t>(colour));
+
+    for (unsigned int offset = 0; offset + 8 < count; offset += 8) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + offset), fill);
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + count - 8), fill);
+}
+
+#endif
+
+static void ApplyMaskScalar(uint8_t *row, const uint16_t *mask, unsigned int pixels) {
+    for (unsigned int i = 0; i < pixels * 4; ++i) {
+        row[i] = static_cast<uint8_t>((row[i] * mask[i]) >> 8u);
+    }
+}
+
+void PostProcessor::RenderRows(unsigned int firstRow, unsigned int lastRow, uint8_t *out, size_t pitch,
+                               uint32_t *line) const {
+#ifdef POSTPROCESSOR_X86
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+#else
+    const bool hasAvx2 = false;
+#endif
+
+    // Each row is shaded in a cache-resident buffer and then written out in one pass
+    unsigned int width = Width();
+
+    for (unsigned int y = firstRow; y < lastRow; ++y) {
+        uint32_t *dst = line;
+        const uint32_t *ramp = &ramps[(y % scale) * 256];
+        const uint8_t *source = glow[y / scale];
+
+        // Rows within a scaled pixel differ only in their ramp, but the ramp lookup is per source pixel and cheaper
+        // than copying the row above and re-shading it
+        for (unsigned int x = 0; x < HIRES_VIDEO_WIDTH; ++x) {
+            uint32_t colour = ramp[source[x]];
+            uint32_t *run = dst + x * scale;
+
+#ifdef POSTPROCESSOR_X86
+            if (hasAvx2 && scale >= 8) {
+                FillAvx2(run, colour, scale);
+                continue;
+            }
+#endif
+            for (unsigned int i = 0; i < scale; ++i) {
+                run[i] = colour;
+            }
+        }
+
+        if (masked) {
+#ifdef POSTPROCESSOR_X86
+            if (hasAvx2) {
+                ApplyMaskAvx2(reinterpret_cast<uint8_t *>(dst), maskRow.data(), width);
+            }
+            else
+#endif
+            {
+                ApplyMaskScalar(reinterpret_cast<uint8_t *>(dst), maskRow.data(), width);
+            }
+        }
+
+        auto *target = reinterpret_cast<uint32_t *>(out + y * pitch);
+
+#ifdef POSTPROCESSOR_X86
+        if (hasAvx2 && reinterpret_cast<uintptr_t>(target) % 32 == 0) {
+            StreamRowAvx2(target, dst, width);
+            continue;
+        }
+#endif
+        memcpy(target, dst, width * sizeof(uint32_t));
+    }
+
+#ifdef POSTPROCESSOR_X86
+    // Make the streamed rows visible before the pool reports the band as done
+    _mm_sfence();
+#endif
+}
+
+void PostProcessor::Process(const Frame &frame, void *dst, size_t pitch) {
+    Decay(frame);
+
+    auto *out = static_cast<uint8_t *>(dst);
+    unsigned int height = Height();
+    unsigned int bands = (height + BAND_ROWS - 1) / BAND_ROWS;
+
+    if (pool == nullptr) {
+        RenderRows(0, height, out, pitch, lines.data());
+        return;
+    }
+
+    // One piece per thread, so each has a line buffer to itself, taking bands from a counter so fast threads take more
+    nextBand.store(0, std::memory_order_relaxed);
+    pool->ParallelFor(pool->Size(), [this, out, pitch, height, bands](unsigned int piece) {
+        uint32_t *line = &lines[static_cast<size_t>(piece) * Width()];
+
+        for (unsigned int band = nextBand.fetch_add(1); band < bands; band = nextBand.fetch_add(1)) {
+            RenderRows(band * BAND_ROWS, std::min((band + 1) * BAND_ROWS, height), out, pitch, line);
+        }
+    });
+}
@@ -0,0 +1,88 @@
+#ifndef POSTPROCESSOR_H
+#define POSTPROCESSOR_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Frame.h"
+#include "ThreadPool.h"
+#include "Upscaler.h"
+
+struct PostProcessSettings {
+    // Fraction of a pixel's brightness left after one frame once it is switched off. 0 disables persistence.
+    float persistence = 0.6f;
+    // How much darker the edges of each pixel row get than its centre, 0 to 1
+    float scanlines = 0.35f;
+    // Strength of an RGB aperture grille over the columns, 0 to 1
+    float mask = 0.0f;
+    // 0xRRGGBB
+    uint32_t offColour = 0x000000;
+    uint32_t onColour = 0x33FF66;
+};
+
+/**
+ * CRT-style post-processing from packed frames to a scaled 4 byte per pixel image.
+ *
+ * Sprites are drawn by XOR, so games erase and redraw them every frame and they flicker. Each source pixel keeps an
+ * 8 bit brightness that jumps to full when lit and decays exponentially afterwards, which blends the history of the
+ * last few frames the way a slow phosphor does. Brightness then goes through a colour ramp per scanline row, so
+ * scanline darkening costs nothing extra, and an optional aperture grille multiplies each row by a per-column
+ * pattern.
+ *
+ * Everything works at the 128x64 high resolution geometry, so the output size and the phosphor history carry on
+ * unchanged when a program switches mode; low resolution frames simply light 2x2 blocks. The decay works on that
+ * 128x64 source and is done before the output, split into bands of rows, goes to the thread pool if one is given.
+ * Each thread shades its rows in a line buffer of its own, allocated up front.
+ */
+class PostProcessor {
+public:
+    /**
+     * format must be RGBA8888 or BGRA8888. The output is HIRES_VIDEO_WIDTH * scale by HIRES_VIDEO_HEIGHT * scale
+     * pixels, so 1920x960 for a scale of 15.
+     */
+    PostProcessor(PixelFormat format, unsigned int scale, const PostProcessSettings &settings,
+                  ThreadPool *pool = nullptr);
+
+    /**
+     * Fold frame into the phosphor history and write the result to dst, whose rows are pitch bytes apart.
+     */
+    void Process(const Frame &frame, void *dst, size_t pitch);
+
+    /**
+     * Forget the phosphor history, e.g. after loading a snapshot.
+     */
+    void Reset();
+
+    unsigned int Width() const {
+        return HIRES_VIDEO_WIDTH * scale;
+    }
+
+    unsigned int Height() const {
+        return HIRES_VIDEO_HEIGHT * scale;
+    }
+
+private:
+    void Decay(const Frame &frame);
+
+    void RenderRows(unsigned int firstRow, unsigned int lastRow, uint8_t *out, size_t pitch, uint32_t *line) const;
+
+    unsigned int scale;
+    ThreadPool *pool;
+    bool masked;
+    uint16_t decay;
+    // Brightness of each source pixel
+    alignas(32) uint8_t glow[HIRES_VIDEO_HEIGHT][HIRES_VIDEO_WIDTH]{};
+    // The incoming frame at high resolution
+    Frame hiresFrame;
+    // Colour for every brightness, one ramp per row within a scaled pixel: ramps[row * 256 + brightness]
+    std::vector<uint32_t> ramps;
+    // Per-channel multipliers out of 256 for each output column, for the aperture grille
+    std::vector<uint16_t> maskRow;
+    // A row of output pixels for every thread that renders, Width() apart
+    std::vector<uint32_t> lines;
+    // Next band for a thread to take during Process()
+    std::atomic<unsigned int> nextBand{0};
+};
+
+#endif //POSTPROCESSOR_H
@@ -0,0 +1,208 @@
+#include "Recorder.h"
+#include <algorithm>
+#include <cstring>
+#include "Trace.h"
+
+// Bytes handed to stdio at a time by the writer thread
+static const size_t WRITE_BUFFER_SIZE = 1 << 20;
+
+static void PutLE(uint8_t *out, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+Recorder::Recorder(const std::string &path, RecordFormat format, unsigned int scale,
+                   const PostProcessSettings *postProcess, size_t queueFrames)
+        : format(format), scale(format == RecordFormat::Y4M ? std::max(scale, 1u) : 1), queue(queueFrames),
+          upscaler(PixelFormat::GRAY8, 0x000000, 0xFFFFFF) {
+    file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        return;
+    }
+    setvbuf(file, nullptr, _IOFBF, WRITE_BUFFER_SIZE);
+
+    if (format == RecordFormat::RAW) {
+        index = fopen((path + ".idx").c_str(), "wb");
+        if (index == nullptr) {
+            fclose(file);
+            file = nullptr;
+            return;
+        }
+
+        uint8_t header[16] = {'C', 'H', '8', 'R', 'A', 'W', 0, 0};
+        PutLE(&header[8], HIRES_VIDEO_WIDTH, 4);
+        PutLE(&header[12], HIRES_VIDEO_HEIGHT, 4);
+        fwrite(header, 1, sizeof(header), file);
+    }
+    else {
+        size_t pixels = static_cast<size_t>(HIRES_VIDEO_WIDTH) * HIRES_VIDEO_HEIGHT * this->scale * this->scale;
+        fprintf(file, "YUV4MPEG2 W%u H%u F60:1 Ip A1:1 %s\n", HIRES_VIDEO_WIDTH * this->scale,
+                HIRES_VIDEO_HEIGHT * this->scale, postProcess != nullptr ? "C444" : "Cmono");
+
+        if (postProcess != nullptr) {
+            postProcessor = std::make_unique<PostProcessor>(PixelFormat::RGBA8888, this->scale, *postProcess);
+            rgba.resize(pixels);
+            picture.resize(pixels * 3);
+        }
+        else {
+            picture.resize(pixels);
+        }
+    }
+
+    writer = std::thread(&Recorder::Write, this);
+}
+
+Recorder::~Recorder() {
+    if (file == nullptr) {
+        return;
+    }
+
+    if (havePending) {
+        Flush();
+    }
+
+    // The end marker can't be dropped, so this is the one place the producer waits for room
+    pending.last = true;
+    while (!queue.TryPush(pending)) {
+        std::this_thread::yield();
+    }
+
+    writer.join();
+
+    fclose(file);
+    if (index != nullptr) {
+        fclose(index);
+    }
+}
+
+void Recorder::Flush() {
+    if (!queue.TryPush(pending)) {
+        dropped.fetch_add(pending.count, std::memory_order_relaxed);
+    }
+    havePending = false;
+}
+
+bool Recorder::Submit(const Frame &frame) {
+    if (file == nullptr) {
+        return false;
+    }
+
+    // Same picture as the previous frame - extend its run instead of queueing another copy
+    if (havePending && pending.number + pending.count == frame.number && pending.width == frame.width &&
+        pending.height == frame.height && memcmp(pending.pixels, frame.pixels, sizeof(pending.pixels)) == 0) {
+        ++pending.count;
+        return true;
+    }
+
+    uint64_t droppedBefore = Dropped();
+
+    if (havePending) {
+        Flush();
+    }
+
+    memcpy(pending.pixels, frame.pixels, sizeof(pending.pixels));
+    pending.width = frame.width;
+    pending.height = frame.height;
+    pending.number = frame.number;
+    pending.count = 1;
+    pending.last = false;
+    havePending = true;
+
+    return Dropped() == droppedBefore;
+}
+
+void Recorder::Write() {
+    Entry entry{};
+    Trace::NameThread("recorder");
+
+    for (;;) {
+        if (!queue.TryPop(entry)) {
+            queue.WaitForData();
+            continue;
+        }
+
+        if (entry.last) {
+            break;
+        }
+
+        TraceSpan span("record write", "io", "frame", entry.number);
+        WriteEntry(entry);
+    }
+
+    fflush(file);
+}
+
+void Recorder::WriteY4MFrame() {
+    fputs("FRAME\n", file);
+    fwrite(picture.data(), 1, picture.size(), file);
+}
+
+/**
+ * Fold frame into the post-processor's phosphor and convert the result to BT.601 studio range Y, Cb and Cr planes.
+ */
+void Recorder::PostProcess(const Frame &frame) {
+    postProcessor->Process(frame, rgba.data(), postProcessor->Width() * sizeof(uint32_t));
+
+    size_t pixels = rgba.size();
+    uint8_t *y = picture.data();
+    uint8_t *cb = y + pixels;
+    uint8_t *cr = cb + pixels;
+
+    for (size_t i = 0; i < pixels; ++i) {
+        uint8_t bytes[4];
+        memcpy(bytes, &rgba[i], sizeof(bytes));
+        int r = bytes[0];
+        int g = bytes[1];
+        int b = bytes[2];
+
+        y[i] = static_cast<uint8_t>(16 + ((66 * r + 129 * g + 25 * b + 128) >> 8));
+        cb[i] = static_cast<uint8_t>(128 + ((-38 * r - 74 * g + 112 * b + 128) >> 8));
+        cr[i] = static_cast<uint8_t>(128 + ((112 * r - 94 * g - 18 * b + 128) >> 8));
+    }
+}
+
+void Recorder::WriteEntry(const Entry &entry) {
+    if (format == RecordFormat::RAW) {
+        uint8_t record[16]{};
+        PutLE(&record[0], entry.number, 8);
+        PutLE(&record[8], entry.count, 4);
+        PutLE(&record[12], entry.width, 2);
+        PutLE(&record[14], entry.height, 2);
+        fwrite(record, 1, sizeof(record), index);
+
+        for (unsigned int y = 0; y < entry.height; ++y) {
+            fwrite(entry.pixels[y], 1, entry.width / 8, file);
+        }
+        return;
+    }
+
+    // Y4M has no timestamps, so keep time right by showing the previous picture again for frames that were dropped
+    if (nextNumber != 0 && entry.number > nextNumber) {
+        for (uint64_t gap = nextNumber; gap < entry.number; ++gap) {
+            if (postProcessor != nullptr) {
+                PostProcess(shown);
+            }
+            WriteY4MFrame();
+        }
+    }
+
+    memcpy(shown.pixels, entry.pixels, sizeof(shown.pixels));
+    shown.width = entry.width;
+    shown.height = entry.height;
+
+    if (postProcessor == nullptr) {
+        Frame hires;
+        ExpandToHires(shown, hires);
+        upscaler.Scale(hires, scale, picture.data(), HIRES_VIDEO_WIDTH * scale);
+    }
+
+    for (uint32_t i = 0; i < entry.count; ++i) {
+        if (postProcessor != nullptr) {
+            PostProcess(shown);
+        }
+        WriteY4MFrame();
+    }
+
+    nextNumber = entry.number + entry.count;
+}
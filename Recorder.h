@@ -0,0 +1,108 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Frame.h"
+#include "PostProcessor.h"
+#include "SpscRing.h"
+#include "Upscaler.h"
+
+enum class RecordFormat {
+    // YUV4MPEG2, monochrome 8 bit luma at 60 fps and 128x64 times the scale, low resolution frames doubled. Plays in
+    // ffmpeg/mpv; repeated frames are written out in full. Through a PostProcessor it is 4:4:4 colour instead.
+    Y4M,
+    // Packed 1 bit per pixel frames, each distinct frame written once, plus an index file (see Recorder)
+    RAW
+};
+
+/**
+ * Streams frames to disk without ever blocking the thread that submits them.
+ *
+ * Submit() only compares the frame with the previous one and, if it differs, copies its packed pixels into a
+ * bounded lock-free queue. A background thread owns the file and does all the formatting and I/O. A run of identical
+ * frames travels through the queue as a single entry with a repeat count. If the writer falls so far behind that
+ * the queue fills, the frame is dropped and counted rather than waited for.
+ *
+ * RAW recordings are two files. `path` holds a 16 byte header ("CH8RAW\0\0", then the largest width and height as
+ * little-endian uint32) followed by the distinct frames back to back, each height rows of width / 8 bytes. `path.idx`
+ * has one 16 byte little-endian record per distinct frame: the uint64 number of the first emulated frame it was
+ * shown on, the uint32 number of consecutive frames it stayed up, and the frame's uint16 width and height. Gaps in
+ * the frame numbers are dropped frames.
+ */
+class Recorder {
+public:
+    /**
+     * scale and postProcess only apply to Y4M. With postProcess, the writer thread runs every frame through a
+     * PostProcessor with those settings, repeated and dropped frames included so the phosphor fades as it would on
+     * screen.
+     */
+    Recorder(const std::string &path, RecordFormat format, unsigned int scale = 1,
+             const PostProcessSettings *postProcess = nullptr, size_t queueFrames = 256);
+
+    ~Recorder();
+
+    Recorder(const Recorder &) = delete;
+
+    Recorder &operator=(const Recorder &) = delete;
+
+    bool IsOpen() const {
+        return file != nullptr;
+    }
+
+    /**
+     * Queue a frame for writing. Returns false if it had to be dropped.
+     */
+    bool Submit(const Frame &frame);
+
+    uint64_t Dropped() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Entry {
+        uint8_t pixels[HIRES_VIDEO_HEIGHT][FRAME_ROW_BYTES];
+        uint16_t width;
+        uint16_t height;
+        uint64_t number;
+        uint32_t count;
+        bool last;
+    };
+
+    void Flush();
+
+    void Write();
+
+    void WriteEntry(const Entry &entry);
+
+    void WriteY4MFrame();
+
+    void PostProcess(const Frame &frame);
+
+    RecordFormat format;
+    unsigned int scale;
+    FILE *file = nullptr;
+    FILE *index = nullptr;
+    SpscRing<Entry> queue;
+    std::thread writer;
+
+    // The frame being held back to see whether the next ones repeat it. Producer only.
+    Entry pending{};
+    bool havePending = false;
+    std::atomic<uint64_t> dropped{0};
+
+    // Writer only. picture holds the Y4M planes of the last frame written.
+    Upscaler upscaler;
+    std::unique_ptr<PostProcessor> postProcessor;
+    std::vector<uint32_t> rgba;
+    std::vector<uint8_t> picture;
+    Frame shown;
+    uint64_t nextNumber = 0;
+};
+
+#endif //RECORDER_H
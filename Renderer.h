@@ -0,0 +1,24 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include "Frame.h"
+
+/**
+ * Presentation backend. Present() is called from the presentation thread only, with the newest finished frame.
+ */
+class Renderer {
+public:
+    virtual ~Renderer() = default;
+
+    virtual void Present(const Frame &frame) = 0;
+};
+
+/**
+ * Renderer that draws nothing, for headless runs and for measuring emulation cost on its own.
+ */
+class NullRenderer : public Renderer {
+public:
+    void Present(const Frame &) override {}
+};
+
+#endif //RENDERER_H
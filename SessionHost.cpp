@@ -0,0 +1,443 @@
+#include "SessionHost.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "Analyzer.h"
+#include "HostProtocol.h"
+#include "Verifier.h"
+
+SessionHost::SessionHost(const std::string &path, const HostOptions &options) : path(path), options(options) {
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        return;
+    }
+
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listener < 0) {
+        return;
+    }
+
+    // A socket left behind by an earlier run would make bind fail
+    unlink(path.c_str());
+
+    if (bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 || listen(listener, 64) < 0) {
+        close(listener);
+        listener = -1;
+        return;
+    }
+
+    epoll = epoll_create1(EPOLL_CLOEXEC);
+    updatesReady = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    stopRequested = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll < 0 || updatesReady < 0 || stopRequested < 0) {
+        return;
+    }
+
+    for (int fd : {listener, updatesReady, stopRequested}) {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event);
+    }
+
+    int ready = updatesReady;
+    scheduler = std::make_unique<SessionScheduler>(options.scheduler, [ready]() {
+        uint64_t one = 1;
+        (void) !write(ready, &one, sizeof(one));
+    });
+}
+
+SessionHost::~SessionHost() {
+    // Stop the scheduler before closing the eventfd it writes to
+    scheduler.reset();
+
+    for (auto &entry : connections) {
+        close(entry.first);
+    }
+
+    for (int fd : {epoll, updatesReady, stopRequested}) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    if (listener >= 0) {
+        close(listener);
+        unlink(path.c_str());
+    }
+}
+
+void SessionHost::Stop() {
+    uint64_t one = 1;
+    (void) !write(stopRequested, &one, sizeof(one));
+}
+
+void SessionHost::Run() {
+    epoll_event events[64];
+
+    for (;;) {
+        int count = epoll_wait(epoll, events, 64, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            int fd = events[i].data.fd;
+
+            if (fd == stopRequested) {
+                return;
+            }
+            if (fd == listener) {
+                Accept();
+                continue;
+            }
+            if (fd == updatesReady) {
+                uint64_t signalled;
+                (void) !read(updatesReady, &signalled, sizeof(signalled));
+                DeliverUpdates();
+                continue;
+            }
+
+            // Closed by an earlier event in this batch
+            auto found = connections.find(fd);
+            if (found == connections.end()) {
+                continue;
+            }
+            Connection &connection = *found->second;
+
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                Close(fd);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) {
+                Flush(connection);
+            }
+            if (events[i].events & EPOLLIN) {
+                Receive(connection);
+            }
+        }
+    }
+}
+
+void SessionHost::Accept() {
+    for (;;) {
+        int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event) < 0) {
+            close(fd);
+            continue;
+        }
+
+        auto connection = std::make_unique<Connection>();
+        connection->fd = fd;
+        connections[fd] = std::move(connection);
+        ++stats.connections;
+    }
+}
+
+void SessionHost::Receive(Connection &connection) {
+    char buffer[16384];
+    int fd = connection.fd;
+
+    for (;;) {
+        ssize_t received = read(fd, buffer, sizeof(buffer));
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (received <= 0) {
+            Close(fd);
+            return;
+        }
+        connection.input.append(buffer, static_cast<size_t>(received));
+    }
+
+    size_t offset = 0;
+    while (connection.input.size() - offset >= 4) {
+        auto bytes = reinterpret_cast<const uint8_t *>(connection.input.data()) + offset;
+        uint32_t length = Get32(bytes);
+
+        if (length == 0 || length > HOST_MAX_MESSAGE) {
+            Close(fd);
+            return;
+        }
+        if (connection.input.size() - offset - 4 < length) {
+            break;
+        }
+
+        if (!Handle(connection, bytes[4], bytes + HOST_HEADER_SIZE, length - 1)) {
+            Close(fd);
+            return;
+        }
+        offset += 4 + length;
+    }
+    connection.input.erase(0, offset);
+
+    Flush(connection);
+}
+
+bool SessionHost::Handle(Connection &connection, uint8_t type, const uint8_t *payload, size_t size) {
+    if (type == HOST_CREATE) {
+        if (size < 6) {
+            return false;
+        }
+        Create(connection, payload, size);
+        return true;
+    }
+
+    if (size != (type == HOST_KEYS ? 6u : 4u)) {
+        return false;
+    }
+
+    uint32_t id = Get32(payload);
+    auto found = sessions.find(id);
+    if (found == sessions.end()) {
+        SendError(connection, id, "no such session");
+        return true;
+    }
+    SessionInfo &session = found->second;
+
+    switch (type) {
+        case HOST_KEYS:
+            scheduler->SetKeys(id, Get16(payload + 4));
+            return true;
+
+        case HOST_SUBSCRIBE: {
+            for (const auto &subscription : session.subscribers) {
+                if (subscription->fd == connection.fd) {
+                    return true;
+                }
+            }
+            // The first frame is sent whole
+            auto subscription = std::make_unique<Subscription>();
+            subscription->fd = connection.fd;
+            session.subscribers.push_back(std::move(subscription));
+            scheduler->Republish(id);
+            return true;
+        }
+
+        case HOST_UNSUBSCRIBE:
+            session.subscribers.erase(
+                    std::remove_if(session.subscribers.begin(), session.subscribers.end(),
+                                   [&](const std::unique_ptr<Subscription> &subscription) {
+                                       return subscription->fd == connection.fd;
+                                   }), session.subscribers.end());
+            return true;
+
+        case HOST_DESTROY:
+            if (session.owner != connection.fd) {
+                SendError(connection, id, "session belongs to another connection");
+                return true;
+            }
+            // The session goes once the scheduler confirms with an ENDED update
+            scheduler->Destroy(id);
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+void SessionHost::Create(Connection &connection, const uint8_t *payload, size_t size) {
+    unsigned int cyclesPerFrame = Get16(payload);
+    uint32_t seed = Get32(payload + 2);
+    const uint8_t *rom = payload + 6;
+    size_t romSize = size - 6;
+
+    if (cyclesPerFrame == 0 || romSize == 0 || romSize > MEMORY_SIZE - ROM_START) {
+        SendError(connection, 0, "bad session parameters");
+        return;
+    }
+    if (sessions.size() >= options.maxSessions) {
+        SendError(connection, 0, "too many sessions");
+        return;
+    }
+
+    auto chip8 = std::make_unique<Chip8>();
+    chip8->LoadROM(rom, romSize);
+    chip8->randGen.seed(seed);
+    bool verified = Verify(Analyze(rom, romSize)).safe;
+
+    uint32_t id = nextSession++;
+    sessions[id] = SessionInfo{connection.fd, {}};
+    connection.owned.push_back(id);
+    scheduler->Create(id, std::move(chip8), verified, cyclesPerFrame);
+    ++stats.created;
+
+    std::string &out = connection.output;
+    size_t start = BeginMessage(out, HOST_CREATED);
+    Put32(out, id);
+    FinishMessage(out, start);
+}
+
+void SessionHost::DeliverUpdates() {
+    scheduler->TakeUpdates(updates);
+
+    for (const FrameUpdate &update : updates) {
+        auto found = sessions.find(update.session);
+        if (found == sessions.end()) {
+            continue;
+        }
+        SessionInfo &session = found->second;
+
+        for (auto &subscription : session.subscribers) {
+            Connection &connection = *connections[subscription->fd];
+
+            if (update.ended != HOST_ENDED_DESTROYED) {
+                SendFrame(connection, *subscription, update);
+            }
+            if (update.ended != 0) {
+                std::string &out = connection.output;
+                size_t start = BeginMessage(out, HOST_ENDED);
+                Put32(out, update.session);
+                out.push_back(static_cast<char>(update.ended));
+                FinishMessage(out, start);
+            }
+        }
+
+        if (update.ended != 0) {
+            auto owner = connections.find(session.owner);
+            if (owner != connections.end()) {
+                std::vector<uint32_t> &owned = owner->second->owned;
+                owned.erase(std::remove(owned.begin(), owned.end(), update.session), owned.end());
+            }
+            sessions.erase(found);
+        }
+    }
+
+    for (auto &entry : connections) {
+        Flush(*entry.second);
+    }
+}
+
+void SessionHost::SendFrame(Connection &connection, Subscription &subscription, const FrameUpdate &update) {
+    // A client that isn't keeping up misses frames; the next one it gets is a delta from the last it got
+    if (connection.output.size() - connection.written > options.maxQueuedBytes) {
+        ++stats.framesSkipped;
+        return;
+    }
+
+    std::string &out = connection.output;
+    size_t start = BeginMessage(out, HOST_FRAME);
+    Put32(out, update.session);
+    Put64(out, update.frame);
+    out.push_back(static_cast<char>(update.flags));
+    size_t rowCount = out.size();
+    Put16(out, 0);
+
+    uint16_t rows = 0;
+    for (unsigned int plane = 0; plane < DISPLAY_PLANES; ++plane) {
+        for (unsigned int row = 0; row < HIRES_VIDEO_HEIGHT; ++row) {
+            if (subscription.sent &&
+                memcmp(subscription.display[plane][row], update.display[plane][row], DISPLAY_ROW_BYTES) == 0) {
+                continue;
+            }
+
+            out.push_back(static_cast<char>(plane));
+            out.push_back(static_cast<char>(row));
+            out.append(reinterpret_cast<const char *>(update.display[plane][row]), DISPLAY_ROW_BYTES);
+            memcpy(subscription.display[plane][row], update.display[plane][row], DISPLAY_ROW_BYTES);
+            ++rows;
+        }
+    }
+
+    out[rowCount] = static_cast<char>(rows);
+    out[rowCount + 1] = static_cast<char>(rows >> 8u);
+    FinishMessage(out, start);
+    subscription.sent = true;
+    ++stats.framesSent;
+}
+
+void SessionHost::SendError(Connection &connection, uint32_t session, const char *message) {
+    std::string &out = connection.output;
+    size_t start = BeginMessage(out, HOST_ERROR);
+    Put32(out, session);
+    out.append(message);
+    FinishMessage(out, start);
+}
+
+void SessionHost::Flush(Connection &connection) {
+    while (connection.written < connection.output.size()) {
+        ssize_t sent = send(connection.fd, connection.output.data() + connection.written,
+                            connection.output.size() - connection.written, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (sent <= 0) {
+            // Errors show up again as EPOLLERR or on the next read, which closes the connection
+            connection.output.clear();
+            connection.written = 0;
+            return;
+        }
+        connection.written += static_cast<size_t>(sent);
+        stats.bytesSent += static_cast<uint64_t>(sent);
+    }
+
+    bool pending = connection.written < connection.output.size();
+    if (!pending) {
+        connection.output.clear();
+        connection.written = 0;
+    }
+    else if (connection.written > connection.output.size() / 2) {
+        // Don't let the sent part grow without bound while a slow client trickles
+        connection.output.erase(0, connection.written);
+        connection.written = 0;
+    }
+
+    if (pending != connection.waitingToWrite) {
+        epoll_event event{};
+        event.events = EPOLLIN | (pending ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+        event.data.fd = connection.fd;
+        epoll_ctl(epoll, EPOLL_CTL_MOD, connection.fd, &event);
+        connection.waitingToWrite = pending;
+    }
+}
+
+void SessionHost::Close(int fd) {
+    auto found = connections.find(fd);
+    if (found == connections.end()) {
+        return;
+    }
+
+    for (uint32_t id : found->second->owned) {
+        scheduler->Destroy(id);
+    }
+
+    for (auto &entry : sessions) {
+        auto &subscribers = entry.second.subscribers;
+        subscribers.erase(std::remove_if(subscribers.begin(), subscribers.end(),
+                                         [fd](const std::unique_ptr<Subscription> &subscription) {
+                                             return subscription->fd == fd;
+                                         }), subscribers.end());
+        // Nobody is left to tell when an orphan goes
+        if (entry.second.owner == fd) {
+            entry.second.owner = -1;
+        }
+    }
+
+    epoll_ctl(epoll, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections.erase(found);
+}
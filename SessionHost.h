@@ -0,0 +1,129 @@
+#ifndef SESSIONHOST_H
+#define SESSIONHOST_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "SessionScheduler.h"
+
+struct HostOptions {
+    SchedulerOptions scheduler;
+    unsigned int maxSessions = 1024;
+    // Output a connection may have waiting before its frames are skipped
+    size_t maxQueuedBytes = 256 * 1024;
+};
+
+struct HostStats {
+    uint64_t connections = 0;
+    uint64_t created = 0;
+    uint64_t framesSent = 0;
+    uint64_t framesSkipped = 0;
+    uint64_t bytesSent = 0;
+};
+
+/**
+ * Serves many emulator sessions to clients on a Unix domain socket (HostProtocol.h).
+ *
+ * All socket I/O happens on the thread calling Run(), in one epoll loop over the listening socket, every client, and
+ * two eventfds: one the SessionScheduler signals when it has published frames and one Stop() signals. Sockets are
+ * non-blocking; output that can't be written at once is queued and sent as the socket drains. The emulation itself
+ * runs on the scheduler's threads, so a slow client never holds it up.
+ *
+ * For every subscription the host keeps the last display it sent, and each new frame goes out as the rows that
+ * differ from it.
+ */
+class SessionHost {
+public:
+    SessionHost(const std::string &path, const HostOptions &options);
+
+    ~SessionHost();
+
+    SessionHost(const SessionHost &) = delete;
+
+    SessionHost &operator=(const SessionHost &) = delete;
+
+    bool IsOpen() const {
+        return listener >= 0 && epoll >= 0;
+    }
+
+    /**
+     * Serve until Stop() is called.
+     */
+    void Run();
+
+    /**
+     * Make Run() return. Safe to call from a signal handler.
+     */
+    void Stop();
+
+    HostStats Stats() const {
+        return stats;
+    }
+
+    SchedulerStats SchedulerStatistics() const {
+        return scheduler->Stats();
+    }
+
+private:
+    struct Connection {
+        int fd;
+        std::string input;
+        std::string output;
+        // Bytes of output already written
+        size_t written = 0;
+        bool waitingToWrite = false;
+        std::vector<uint32_t> owned;
+    };
+
+    struct Subscription {
+        int fd;
+        // Whether a frame has gone out yet; until then every row is sent, whatever display holds
+        bool sent = false;
+        uint8_t display[DISPLAY_PLANES][HIRES_VIDEO_HEIGHT][DISPLAY_ROW_BYTES]{};
+    };
+
+    struct SessionInfo {
+        int owner;
+        std::vector<std::unique_ptr<Subscription>> subscribers;
+    };
+
+    void Accept();
+
+    void Receive(Connection &connection);
+
+    // Returns false if the message was malformed and the connection should be dropped
+    bool Handle(Connection &connection, uint8_t type, const uint8_t *payload, size_t size);
+
+    void Create(Connection &connection, const uint8_t *payload, size_t size);
+
+    void DeliverUpdates();
+
+    void SendFrame(Connection &connection, Subscription &subscription, const FrameUpdate &update);
+
+    void SendError(Connection &connection, uint32_t session, const char *message);
+
+    void Flush(Connection &connection);
+
+    void Close(int fd);
+
+    std::string path;
+    HostOptions options;
+    int listener = -1;
+    int epoll = -1;
+    // Signalled by the scheduler when it has updates, and by Stop()
+    int updatesReady = -1;
+    int stopRequested = -1;
+
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+    std::unordered_map<uint32_t, SessionInfo> sessions;
+    uint32_t nextSession = 1;
+    std::vector<FrameUpdate> updates;
+    HostStats stats;
+
+    // Last, so it is stopped before anything it notifies goes away
+    std::unique_ptr<SessionScheduler> scheduler;
+};
+
+#endif //SESSIONHOST_H
@@ -0,0 +1,236 @@
+#include "SessionScheduler.h"
+#include <algorithm>
+#include <cstring>
+#include "HostProtocol.h"
+
+SessionScheduler::SessionScheduler(const SchedulerOptions &options, std::function<void()> notify)
+        : options(options), notify(std::move(notify)) {
+    pool = ThreadPool::ForThreads(options.threads);
+    thread = std::thread(&SessionScheduler::Loop, this);
+}
+
+SessionScheduler::~SessionScheduler() {
+    stopping = true;
+    thread.join();
+}
+
+void SessionScheduler::Create(uint32_t id, std::unique_ptr<Chip8> chip8, bool verified,
+                              unsigned int cyclesPerFrame) {
+    auto session = std::make_unique<Session>();
+    session->id = id;
+    session->chip8 = std::move(chip8);
+    session->verified = verified;
+    session->cyclesPerFrame = cyclesPerFrame;
+
+    std::lock_guard<std::mutex> lock(commandMutex);
+    commands.push_back(Command{Command::Create, id, 0, std::move(session)});
+}
+
+void SessionScheduler::SetKeys(uint32_t id, uint16_t keys) {
+    std::lock_guard<std::mutex> lock(commandMutex);
+    commands.push_back(Command{Command::Keys, id, keys, nullptr});
+}
+
+void SessionScheduler::Destroy(uint32_t id) {
+    std::lock_guard<std::mutex> lock(commandMutex);
+    commands.push_back(Command{Command::Destroy, id, 0, nullptr});
+}
+
+void SessionScheduler::Republish(uint32_t id) {
+    std::lock_guard<std::mutex> lock(commandMutex);
+    commands.push_back(Command{Command::Republish, id, 0, nullptr});
+}
+
+void SessionScheduler::TakeUpdates(std::vector<FrameUpdate> &taken) {
+    taken.clear();
+
+    std::lock_guard<std::mutex> lock(updateMutex);
+    taken.swap(updates);
+}
+
+SchedulerStats SessionScheduler::Stats() const {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    return stats;
+}
+
+void SessionScheduler::Loop() {
+    auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(
+            1.0 / options.rate));
+    auto next = std::chrono::steady_clock::now();
+
+    while (!stopping) {
+        next += period;
+
+        bool destroyed = ApplyCommands();
+        Tick(next);
+        if (Publish() || destroyed) {
+            notify();
+        }
+
+        // Ticks that can't be made up are dropped, rather than run back to back to catch up
+        auto now = std::chrono::steady_clock::now();
+        if (now > next + period) {
+            next = now;
+        }
+        std::this_thread::sleep_until(next);
+    }
+}
+
+bool SessionScheduler::ApplyCommands() {
+    bool destroyed = false;
+
+    std::vector<Command> pending;
+    {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        pending.swap(commands);
+    }
+
+    for (Command &command : pending) {
+        auto found = sessions.find(command.id);
+
+        switch (command.kind) {
+            case Command::Create:
+                if (options.frameExport != nullptr) {
+                    command.session->exportSlot = options.frameExport->Claim(command.id);
+                }
+                sessions[command.id] = std::move(command.session);
+                break;
+            case Command::Keys:
+                if (found != sessions.end()) {
+                    for (unsigned int key = 0; key < 16; ++key) {
+                        found->second->chip8->keys[key] = (command.keys >> key) & 0x1u;
+                    }
+                }
+                break;
+            case Command::Destroy:
+                if (found != sessions.end()) {
+                    FrameUpdate update{};
+                    update.session = command.id;
+                    update.ended = HOST_ENDED_DESTROYED;
+
+                    if (options.frameExport != nullptr) {
+                        options.frameExport->Release(found->second->exportSlot);
+                    }
+
+                    std::lock_guard<std::mutex> lock(updateMutex);
+                    updates.push_back(update);
+                    sessions.erase(found);
+                    destroyed = true;
+                }
+                break;
+            case Command::Republish:
+                if (found != sessions.end()) {
+                    found->second->chip8->displayDirty = true;
+                }
+                break;
+        }
+    }
+
+    return destroyed;
+}
+
+void SessionScheduler::Tick(std::chrono::steady_clock::time_point deadline) {
+    order.clear();
+    for (auto &entry : sessions) {
+        Session &session = *entry.second;
+        session.owed = std::min<uint64_t>(session.owed + session.cyclesPerFrame,
+                                          static_cast<uint64_t>(session.cyclesPerFrame) * options.maxBacklog);
+        order.push_back(&session);
+    }
+
+    // Whoever went first last time goes a little later this time
+    if (!order.empty()) {
+        rotation = (rotation + 1) % order.size();
+        std::rotate(order.begin(), order.begin() + static_cast<std::ptrdiff_t>(rotation), order.end());
+    }
+
+    std::atomic<uint64_t> instructions{0};
+    bool overran = false;
+
+    while (!order.empty()) {
+        unsigned int threads = pool != nullptr ? pool->Size() : 1;
+        auto count = static_cast<unsigned int>(order.size());
+        unsigned int chunk = std::max(1u, count / (threads * 4));
+        unsigned int pieces = (count + chunk - 1) / chunk;
+
+        auto runPiece = [&](unsigned int piece) {
+            uint64_t ran = 0;
+            for (unsigned int i = piece * chunk; i < std::min(count, (piece + 1) * chunk); ++i) {
+                Session &session = *order[i];
+                auto slice = static_cast<unsigned int>(std::min<uint64_t>(session.owed, options.quantum));
+                unsigned int executed = session.chip8->Run(slice, session.cyclesPerFrame, session.verified);
+                // A session that has stopped owes nothing more
+                session.owed = executed < slice ? 0 : session.owed - executed;
+                ran += executed;
+            }
+            instructions.fetch_add(ran, std::memory_order_relaxed);
+        };
+
+        ParallelFor(pool.get(), pieces, runPiece);
+
+        order.erase(std::remove_if(order.begin(), order.end(), [](const Session *session) {
+            return session->owed == 0;
+        }), order.end());
+
+        if (!order.empty() && std::chrono::steady_clock::now() >= deadline) {
+            overran = true;
+            break;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(statsMutex);
+    ++stats.ticks;
+    stats.overruns += overran;
+    stats.instructions += instructions.load(std::memory_order_relaxed);
+}
+
+bool SessionScheduler::Publish() {
+    std::vector<FrameUpdate> published;
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    for (auto it = sessions.begin(); it != sessions.end();) {
+        Session &session = *it->second;
+        Chip8 &chip8 = *session.chip8;
+        bool sound = chip8.soundTimer > 0;
+        uint8_t ended = chip8.trap != Trap::None ? HOST_ENDED_TRAPPED : chip8.halted ? HOST_ENDED_HALTED : 0;
+
+        if (options.frameExport != nullptr) {
+            options.frameExport->Publish(session.exportSlot, chip8, chip8.cycles / session.cyclesPerFrame, now,
+                                         chip8.displayDirty);
+        }
+
+        if (chip8.displayDirty || sound != session.sound || ended != 0) {
+            published.emplace_back();
+            FrameUpdate &update = published.back();
+            update.session = session.id;
+            update.frame = chip8.cycles / session.cyclesPerFrame;
+            update.flags = (chip8.hires ? HOST_FRAME_HIRES : 0) | (sound ? HOST_FRAME_SOUND : 0);
+            update.ended = ended;
+            memcpy(update.display, chip8.display, sizeof(update.display));
+
+            chip8.displayDirty = false;
+            session.sound = sound;
+        }
+
+        if (ended != 0 && options.frameExport != nullptr) {
+            options.frameExport->Release(session.exportSlot);
+        }
+        it = ended != 0 ? sessions.erase(it) : std::next(it);
+    }
+
+    if (published.empty()) {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(updateMutex);
+        updates.insert(updates.end(), published.begin(), published.end());
+    }
+    {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        stats.updates += published.size();
+    }
+
+    return true;
+}
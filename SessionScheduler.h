@@ -0,0 +1,144 @@
+#ifndef SESSIONSCHEDULER_H
+#define SESSIONSCHEDULER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Chip8.h"
+#include "FrameExport.h"
+#include "ThreadPool.h"
+
+struct SchedulerOptions {
+    // Ticks a second, each owing every session one frame
+    unsigned int rate = 60;
+    // Instructions a session runs before every other session with work left has had a turn
+    unsigned int quantum = 1000;
+    // Frames a session may fall behind before it gives up on catching up
+    unsigned int maxBacklog = 4;
+    // Threads emulating including the scheduler's own; 0 for one per core
+    unsigned int threads = 0;
+    // Shared memory every session's frames are also written to each tick, or null; must outlive the scheduler
+    FrameExport *frameExport = nullptr;
+};
+
+/**
+ * A session's display after a tick in which it changed, or the news that the session has ended.
+ */
+struct FrameUpdate {
+    uint32_t session;
+    uint64_t frame;
+    // HOST_FRAME_* bits
+    uint8_t flags;
+    // 0 while running, otherwise a HOST_ENDED_* status; an ended session sends nothing more
+    uint8_t ended;
+    uint8_t display[DISPLAY_PLANES][HIRES_VIDEO_HEIGHT][DISPLAY_ROW_BYTES];
+};
+
+struct SchedulerStats {
+    uint64_t ticks = 0;
+    // Ticks that ran out of time before every session had run its frame
+    uint64_t overruns = 0;
+    uint64_t instructions = 0;
+    uint64_t updates = 0;
+};
+
+/**
+ * Runs many sessions at once on a thread pool, at a fixed frame rate.
+ *
+ * Each tick owes every session the instructions for one frame (its own cycles per frame). They are paid out in
+ * rounds: every session with cycles owed runs at most a quantum of them per round, spread over the pool, so one
+ * session running thousands of instructions a frame can't hold up the hundreds running eleven. A tick stops at its
+ * deadline; the cycles still owed carry over, up to maxBacklog frames' worth, so an overloaded host slows every
+ * session down a little instead of some a lot. The order sessions are visited in rotates every tick.
+ *
+ * Commands from other threads (Create, SetKeys, Destroy, Republish) are queued and applied at the start of the next
+ * tick. After each tick the sessions whose display or sound changed are published as FrameUpdates and notify is
+ * called, from the scheduler thread, for the consumer to TakeUpdates(). With a FrameExport, every session's frame
+ * counter (and display, when it changed) is also written to its slot each tick, for viewers in other processes.
+ */
+class SessionScheduler {
+public:
+    SessionScheduler(const SchedulerOptions &options, std::function<void()> notify);
+
+    ~SessionScheduler();
+
+    SessionScheduler(const SessionScheduler &) = delete;
+
+    SessionScheduler &operator=(const SessionScheduler &) = delete;
+
+    void Create(uint32_t id, std::unique_ptr<Chip8> chip8, bool verified, unsigned int cyclesPerFrame);
+
+    void SetKeys(uint32_t id, uint16_t keys);
+
+    void Destroy(uint32_t id);
+
+    /**
+     * Publish the session's display after the next tick even if it hasn't changed, e.g. for a new subscriber.
+     */
+    void Republish(uint32_t id);
+
+    /**
+     * Move the updates published since the last call into updates, replacing what was there.
+     */
+    void TakeUpdates(std::vector<FrameUpdate> &updates);
+
+    SchedulerStats Stats() const;
+
+private:
+    struct Session {
+        uint32_t id;
+        std::unique_ptr<Chip8> chip8;
+        bool verified;
+        unsigned int cyclesPerFrame;
+        // Instructions owed from this and earlier ticks
+        uint64_t owed = 0;
+        bool sound = false;
+        // -1 when not exported, e.g. every slot was taken
+        int exportSlot = -1;
+    };
+
+    struct Command {
+        enum Kind { Create, Keys, Destroy, Republish } kind;
+        uint32_t id;
+        uint16_t keys;
+        std::unique_ptr<Session> session;
+    };
+
+    void Loop();
+
+    // Both return whether they published anything
+    bool ApplyCommands();
+
+    void Tick(std::chrono::steady_clock::time_point deadline);
+
+    bool Publish();
+
+    SchedulerOptions options;
+    std::function<void()> notify;
+    std::unique_ptr<ThreadPool> pool;
+
+    // Only the scheduler thread touches the sessions
+    std::unordered_map<uint32_t, std::unique_ptr<Session>> sessions;
+    std::vector<Session *> order;
+    size_t rotation = 0;
+
+    std::mutex commandMutex;
+    std::vector<Command> commands;
+
+    std::mutex updateMutex;
+    std::vector<FrameUpdate> updates;
+
+    mutable std::mutex statsMutex;
+    SchedulerStats stats;
+
+    std::atomic<bool> stopping{false};
+    std::thread thread;
+};
+
+#endif //SESSIONSCHEDULER_H
@@ -0,0 +1,84 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/**
+ * Bounded lock-free single producer, single consumer queue.
+ *
+ * Neither side ever blocks unless it asks to: TryPush fails when the ring is full and TryPop fails when it is empty.
+ * The consumer may WaitForData() to sleep until the producer pushes something.
+ */
+template <typename T>
+class SpscRing {
+public:
+    /**
+     * capacity is rounded up to a power of two.
+     */
+    explicit SpscRing(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1u;
+        }
+
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    bool TryPush(const T &value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+
+        if (t - head.load(std::memory_order_acquire) > mask) {
+            return false;
+        }
+
+        slots[t & mask] = value;
+        tail.store(t + 1, std::memory_order_release);
+        tail.notify_one();
+        return true;
+    }
+
+    bool TryPop(T &value) {
+        size_t h = head.load(std::memory_order_relaxed);
+
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        value = slots[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Block the consumer until the ring is not empty.
+     */
+    void WaitForData() const {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t t = tail.load(std::memory_order_acquire);
+
+        if (h == t) {
+            tail.wait(t, std::memory_order_acquire);
+        }
+    }
+
+    size_t Size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    size_t Capacity() const {
+        return mask + 1;
+    }
+
+private:
+    std::vector<T> slots;
+    size_t mask;
+    // Next slot to pop, written only by the consumer
+    alignas(64) std::atomic<size_t> head{0};
+    // Next slot to push, written only by the producer
+    alignas(64) std::atomic<size_t> tail{0};
+};
+
+#endif //SPSCRING_H
@@ -0,0 +1,157 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+class Executor;
+
+/**
+ * Defined with Executor: hands it a spawned task that has finished, to destroy once it has stopped running.
+ */
+void TaskFinished(Executor &executor, std::coroutine_handle<> handle);
+
+/**
+ * A coroutine that returns nothing, for Executor and CoSession.
+ *
+ * Tasks start suspended. Either hand one to Executor::Spawn() to run on its own, or co_await it from another task,
+ * which runs it to the end before carrying on. An exception escaping a task ends the program. A spawned task keeps
+ * track of which task in its chain of awaits is the one actually suspended, so Executor::Cancel() can find it.
+ *
+ * Coroutine frames are counted as they are allocated, so the cost of many suspended tasks can be measured.
+ */
+class Task {
+public:
+    struct promise_type {
+        // Resumed when this task finishes, if it was awaited
+        std::coroutine_handle<> continuation;
+        // Told when this task finishes, if it was spawned
+        Executor *owner = nullptr;
+        // For an awaited task, the task at the outermost end of its chain of awaits
+        std::coroutine_handle<promise_type> root;
+        // For the outermost task, the innermost one of the tasks it is awaiting, or null when it awaits none
+        std::coroutine_handle<> innermost;
+
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+
+        struct FinalAwaiter {
+            bool await_ready() noexcept {
+                return false;
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                promise_type &promise = handle.promise();
+                if (promise.continuation) {
+                    if (promise.root) {
+                        promise_type &root = promise.root.promise();
+                        root.innermost = promise.continuation == promise.root ? nullptr : promise.continuation;
+                    }
+                    return promise.continuation;
+                }
+                if (promise.owner != nullptr) {
+                    TaskFinished(*promise.owner, handle);
+                }
+                return std::noop_coroutine();
+            }
+
+            void await_resume() noexcept {}
+        };
+
+        FinalAwaiter final_suspend() noexcept {
+            return {};
+        }
+
+        void return_void() {}
+
+        void unhandled_exception() {
+            std::terminate();
+        }
+
+        static void *operator new(size_t size) {
+            liveFrames += 1;
+            liveBytes += size;
+            return ::operator new(size);
+        }
+
+        static void operator delete(void *frame, size_t size) {
+            liveFrames -= 1;
+            liveBytes -= size;
+            ::operator delete(frame);
+        }
+    };
+
+    Task() = default;
+
+    Task(Task &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+    Task &operator=(Task &&other) noexcept {
+        if (this != &other) {
+            if (handle) {
+                handle.destroy();
+            }
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+
+    ~Task() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    Task(const Task &) = delete;
+
+    Task &operator=(const Task &) = delete;
+
+    bool await_ready() const {
+        return !handle || handle.done();
+    }
+
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> awaiting) {
+        promise_type &promise = handle.promise();
+        promise.continuation = awaiting;
+        if constexpr (std::is_same_v<Promise, promise_type>) {
+            promise_type &parent = awaiting.promise();
+            promise.root = parent.root ? parent.root : awaiting;
+            promise.root.promise().innermost = handle;
+        }
+        return handle;
+    }
+
+    void await_resume() {}
+
+    /**
+     * Coroutine frames of every task alive, and the bytes they take. Only counted on the thread running the tasks.
+     */
+    static size_t LiveFrames() {
+        return liveFrames;
+    }
+
+    static size_t LiveBytes() {
+        return liveBytes;
+    }
+
+private:
+    friend class Executor;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+
+    static inline thread_local size_t liveFrames = 0;
+    static inline thread_local size_t liveBytes = 0;
+};
+
+#endif //TASK_H
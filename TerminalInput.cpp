@@ -0,0 +1,100 @@
+#include "TerminalInput.h"
+#include <poll.h>
+#include <thread>
+#include <unistd.h>
+
+static int KeyFor(char c) {
+    switch (c) {
+        case '1': return 0x1;
+        case '2': return 0x2;
+        case '3': return 0x3;
+        case '4': return 0xC;
+        case 'q': return 0x4;
+        case 'w': return 0x5;
+        case 'e': return 0x6;
+        case 'r': return 0xD;
+        case 'a': return 0x7;
+        case 's': return 0x8;
+        case 'd': return 0x9;
+        case 'f': return 0xE;
+        case 'z': return 0xA;
+        case 'x': return 0x0;
+        case 'c': return 0xB;
+        case 'v': return 0xF;
+        default: return -1;
+    }
+}
+
+TerminalInput::TerminalInput(int fd) : fd(fd) {
+    if (!isatty(fd) || tcgetattr(fd, &saved) != 0) {
+        return;
+    }
+
+    // No line buffering and no echo, so each key press arrives as soon as it is typed
+    termios rawMode = saved;
+    rawMode.c_lflag &= ~(ICANON | ECHO);
+    rawMode.c_cc[VMIN] = 0;
+    rawMode.c_cc[VTIME] = 0;
+    raw = tcsetattr(fd, TCSANOW, &rawMode) == 0;
+}
+
+TerminalInput::~TerminalInput() {
+    if (raw) {
+        tcsetattr(fd, TCSANOW, &saved);
+    }
+}
+
+bool TerminalInput::Poll(int timeoutMs) {
+    // Once input has ended poll() would report it as readable forever, so just wait out the timeout instead
+    if (closed) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+        return true;
+    }
+
+    pollfd pfd{fd, POLLIN, 0};
+
+    if (poll(&pfd, 1, timeoutMs) <= 0 || !(pfd.revents & POLLIN)) {
+        return true;
+    }
+
+    char buffer[64];
+    ssize_t count = read(fd, buffer, sizeof(buffer));
+
+    // End of input on a pipe or closed terminal is not a request to quit, there is just nothing more to read
+    if (count <= 0) {
+        closed = count == 0;
+        return true;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+
+    for (ssize_t i = 0; i < count; ++i) {
+        if (buffer[i] == 0x1B) {
+            return false;
+        }
+
+        int key = KeyFor(buffer[i]);
+        if (key >= 0) {
+            releaseAt[key] = now + HOLD_TIME;
+        }
+    }
+
+    return true;
+}
+
+uint16_t TerminalInput::Keys() const {
+    auto now = std::chrono::steady_clock::now();
+    uint16_t mask = 0;
+
+    for (unsigned int key = 0; key < 16; ++key) {
+        if (releaseAt[key] > now) {
+            mask |= 1u << key;
+        }
+    }
+
+    return mask;
+}
+
+bool TerminalInput::Ended() const {
+    return closed && Keys() == 0;
+}
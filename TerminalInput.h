@@ -0,0 +1,52 @@
+#ifndef TERMINALINPUT_H
+#define TERMINALINPUT_H
+
+#include <chrono>
+#include <cstdint>
+#include <termios.h>
+
+/**
+ * Reads the keypad from a terminal in raw mode.
+ *
+ * The keypad is mapped onto the left of a QWERTY keyboard:
+ *
+ *   1 2 3 C      1 2 3 4
+ *   4 5 6 D  <-  Q W E R
+ *   7 8 9 E      A S D F
+ *   A 0 B F      Z X C V
+ *
+ * Terminals only report key presses, never releases, so a key counts as held until HOLD_TIME has passed without it
+ * repeating.
+ */
+class TerminalInput {
+public:
+    explicit TerminalInput(int fd);
+
+    ~TerminalInput();
+
+    /**
+     * Wait up to timeoutMs for input and update the held keys. Returns false once the user asks to quit (Escape).
+     */
+    bool Poll(int timeoutMs);
+
+    /**
+     * Held keys as a bitmask, bit n set when key n is down.
+     */
+    uint16_t Keys() const;
+
+    /**
+     * Input has ended and every key has been released, so Keys() will never change again.
+     */
+    bool Ended() const;
+
+private:
+    static constexpr std::chrono::milliseconds HOLD_TIME{150};
+
+    int fd;
+    bool raw = false;
+    bool closed = false;
+    termios saved{};
+    std::chrono::steady_clock::time_point releaseAt[16]{};
+};
+
+#endif //TERMINALINPUT_H
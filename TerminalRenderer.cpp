@@ -0,0 +1,139 @@
+#include "TerminalRenderer.h"
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+// Glyph for each cell, indexed by (top pixel << 1) | bottom pixel
+static const char *const GLYPHS[4] = {" ", "▄", "▀", "█"};
+
+// A cursor move ("\x1b[row;colH") is at least six bytes and usually seven or eight, a glyph at most three
+static const unsigned int MAX_GAP_TO_FILL = 2;
+
+/**
+ * write() the whole buffer, retrying after partial writes and signals.
+ */
+static void WriteAll(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+
+        data += written;
+        size -= written;
+    }
+}
+
+static unsigned int Cell(const uint8_t rows[][FRAME_ROW_BYTES], unsigned int x, unsigned int cellY) {
+    unsigned int shift = 7u - x % 8;
+    unsigned int top = (rows[cellY * 2][x / 8] >> shift) & 0x1u;
+    unsigned int bottom = (rows[cellY * 2 + 1][x / 8] >> shift) & 0x1u;
+
+    return (top << 1u) | bottom;
+}
+
+TerminalRenderer::TerminalRenderer(int fd) : fd(fd) {
+    // A cleared screen is an all-off frame, so the first frame only draws its lit cells
+    memset(shown, 0, sizeof(shown));
+
+    // Clear the screen and hide the cursor
+    Write("\x1b[2J\x1b[?25l");
+}
+
+TerminalRenderer::~TerminalRenderer() {
+    // Put the cursor back below the picture
+    out.clear();
+    MoveTo(0, shownHeight / 2);
+    out += "\x1b[?25h\n";
+    Write(out);
+}
+
+void TerminalRenderer::Write(const std::string &data) {
+    WriteAll(fd, data.data(), data.size());
+    bytesWritten += data.size();
+}
+
+void TerminalRenderer::MoveTo(unsigned int x, unsigned int y) {
+    if (cursorX == static_cast<int>(x) && cursorY == static_cast<int>(y)) {
+        return;
+    }
+
+    out += "\x1b[";
+    out += std::to_string(y + 1);
+    out += ';';
+    out += std::to_string(x + 1);
+    out += 'H';
+
+    cursorX = x;
+    cursorY = y;
+}
+
+void TerminalRenderer::Present(const Frame &frame) {
+    out.clear();
+
+    // Switching resolution changes every cell; start again from a cleared screen
+    if (frame.width != shownWidth || frame.height != shownHeight) {
+        out += "\x1b[2J";
+        memset(shown, 0, sizeof(shown));
+        shownWidth = frame.width;
+        shownHeight = frame.height;
+        cursorX = -1;
+        cursorY = -1;
+    }
+
+    unsigned int rowBytes = frame.RowBytes();
+
+    for (unsigned int cellY = 0; cellY < shownHeight / 2; ++cellY) {
+        const uint8_t *top = frame.pixels[cellY * 2];
+        const uint8_t *bottom = frame.pixels[cellY * 2 + 1];
+
+        // Most rows don't change from one frame to the next
+        if (memcmp(top, shown[cellY * 2], rowBytes) == 0 &&
+            memcmp(bottom, shown[cellY * 2 + 1], rowBytes) == 0) {
+            continue;
+        }
+
+        // Column just past the last cell written on this row, used to decide whether to bridge a gap
+        int runEnd = -1;
+
+        for (unsigned int x = 0; x < shownWidth; ++x) {
+            // Skip whole unchanged bytes, eight cells at a time
+            if (x % 8 == 0 && top[x / 8] == shown[cellY * 2][x / 8] &&
+                bottom[x / 8] == shown[cellY * 2 + 1][x / 8]) {
+                x += 7;
+                continue;
+            }
+
+            unsigned int cell = Cell(frame.pixels, x, cellY);
+
+            if (cell == Cell(shown, x, cellY)) {
+                continue;
+            }
+
+            // Rewrite a short run of unchanged cells rather than paying for a cursor move over them
+            if (runEnd >= 0 && x - runEnd <= MAX_GAP_TO_FILL) {
+                for (unsigned int gap = runEnd; gap < x; ++gap) {
+                    out += GLYPHS[Cell(frame.pixels, gap, cellY)];
+                }
+                cursorX = x;
+            }
+
+            MoveTo(x, cellY);
+            out += GLYPHS[cell];
+            runEnd = x + 1;
+
+            // The cursor doesn't reliably advance past the last column, so forget where it is
+            cursorX = x + 1 < shownWidth ? static_cast<int>(x + 1) : -1;
+        }
+    }
+
+    memcpy(shown, frame.pixels, sizeof(shown));
+
+    if (!out.empty()) {
+        Write(out);
+    }
+}
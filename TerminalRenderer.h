@@ -0,0 +1,48 @@
+#ifndef TERMINALRENDERER_H
+#define TERMINALRENDERER_H
+
+#include <cstdint>
+#include <string>
+#include "Renderer.h"
+
+/**
+ * Draws frames on an ANSI terminal using Unicode half blocks, so each character cell shows two vertically stacked
+ * pixels and the 64x32 display fits in 64x16 cells (128x32 in high resolution).
+ *
+ * Only cells that changed since the previous frame are redrawn. Runs of changed cells are written back to back, and
+ * short gaps between them are filled by rewriting the unchanged glyphs when that is cheaper than moving the cursor.
+ * Everything for one frame goes out in a single write(), and a frame with no changes writes nothing at all.
+ */
+class TerminalRenderer : public Renderer {
+public:
+    explicit TerminalRenderer(int fd);
+
+    ~TerminalRenderer() override;
+
+    void Present(const Frame &frame) override;
+
+    /**
+     * Total bytes written to the terminal so far, including setup.
+     */
+    uint64_t BytesWritten() const {
+        return bytesWritten;
+    }
+
+private:
+    void Write(const std::string &data);
+
+    void MoveTo(unsigned int x, unsigned int y);
+
+    int fd;
+    std::string out;
+    // What the terminal is showing, as packed rows like the frame
+    uint8_t shown[HIRES_VIDEO_HEIGHT][FRAME_ROW_BYTES];
+    unsigned int shownWidth = VIDEO_WIDTH;
+    unsigned int shownHeight = VIDEO_HEIGHT;
+    // Where the terminal's cursor is, or -1 when we don't know
+    int cursorX = -1;
+    int cursorY = -1;
+    uint64_t bytesWritten = 0;
+};
+
+#endif //TERMINALRENDERER_H
@@ -0,0 +1,90 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int threads) {
+    if (threads == 0) {
+        unsigned int cores = std::thread::hardware_concurrency();
+        threads = cores > 1 ? cores - 1 : 0;
+    }
+
+    for (unsigned int i = 0; i < threads; ++i) {
+        workers.emplace_back(&ThreadPool::Work, this);
+    }
+}
+
+std::unique_ptr<ThreadPool> ThreadPool::ForThreads(unsigned int threads) {
+    // The pool itself counts helpers besides the calling thread
+    if (threads == 1) {
+        return nullptr;
+    }
+    return std::make_unique<ThreadPool>(threads == 0 ? 0 : threads - 1);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::ParallelFor(unsigned int pieces, const std::function<void(unsigned int)> &job) {
+    // Nothing to share the work with
+    if (workers.empty() || pieces <= 1) {
+        for (unsigned int i = 0; i < pieces; ++i) {
+            job(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        task = &job;
+        count = pieces;
+        next = 0;
+        checkedIn = 0;
+        ++generation;
+    }
+    wake.notify_all();
+
+    RunPieces();
+
+    // Every worker takes part in every generation, so once they have all checked in none of them can still be
+    // touching the counter when the next ParallelFor resets it
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return checkedIn == workers.size(); });
+    task = nullptr;
+}
+
+void ThreadPool::RunPieces() {
+    for (unsigned int i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+        (*task)(i);
+    }
+}
+
+void ThreadPool::Work() {
+    uint64_t seen = 0;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this, seen] { return stopping || generation != seen; });
+
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+        }
+
+        RunPieces();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++checkedIn;
+        }
+        done.notify_one();
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Small fixed-size pool for splitting one job into independent pieces, e.g. the tiles of a frame.
+ *
+ * ParallelFor hands out indices from a shared counter, so fast workers simply take more pieces. The calling thread
+ * works too, and only one ParallelFor may be in flight at a time.
+ */
+class ThreadPool {
+public:
+    /**
+     * threads is the number of helper threads besides the caller; 0 picks one less than the number of cores.
+     */
+    explicit ThreadPool(unsigned int threads = 0);
+
+    /**
+     * A pool for a job split over threads threads in all, the caller included, as the tools' --threads options
+     * count them: 0 for one per core, and nullptr for 1, where the caller does everything itself.
+     */
+    static std::unique_ptr<ThreadPool> ForThreads(unsigned int threads);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * Run task(i) for every i in [0, count) and return once all of them have finished.
+     */
+    void ParallelFor(unsigned int count, const std::function<void(unsigned int)> &task);
+
+    /**
+     * Number of threads that work on a ParallelFor, including the caller.
+     */
+    unsigned int Size() const {
+        return static_cast<unsigned int>(workers.size()) + 1;
+    }
+
+private:
+    void Work();
+
+    void RunPieces();
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    uint64_t generation = 0;
+    // Workers that have finished with the current generation
+    size_t checkedIn = 0;
+    bool stopping = false;
+
+    const std::function<void(unsigned int)> *task = nullptr;
+    unsigned int count = 0;
+    std::atomic<unsigned int> next{0};
+};
+
+/**
+ * pool->ParallelFor, or every piece in order on the calling thread when there is no pool.
+ */
+inline void ParallelFor(ThreadPool *pool, unsigned int count, const std::function<void(unsigned int)> &task) {
+    if (pool != nullptr) {
+        pool->ParallelFor(count, task);
+        return;
+    }
+
+    for (unsigned int i = 0; i < count; ++i) {
+        task(i);
+    }
+}
+
+#endif //THREADPOOL_H
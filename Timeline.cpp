@@ -0,0 +1,146 @@
+#include "Timeline.h"
+#include <cstring>
+#include "Trace.h"
+
+Timeline::Timeline(Chip8 &chip8, unsigned int cyclesPerFrame, unsigned int keyframeFrames)
+        : chip8(chip8), cyclesPerFrame(cyclesPerFrame), keyframeFrames(keyframeFrames) {}
+
+void Timeline::BeginFrame(uint16_t liveKeys) {
+    uint64_t frame = chip8.cycles / cyclesPerFrame;
+    if (horizon < chip8.cycles) {
+        horizon = chip8.cycles;
+    }
+
+    if (frame % keyframeFrames == 0 && (keyframes.empty() || keyframes.back()->frame < frame)) {
+        Capture(frame);
+    }
+
+    if (frame >= frameKeys.size()) {
+        frameKeys.resize(frame, frameKeys.empty() ? 0 : frameKeys.back());
+        frameKeys.push_back(liveKeys);
+    }
+
+    uint16_t keys = frameKeys[frame];
+    for (unsigned int key = 0; key < 16; ++key) {
+        chip8.keys[key] = (keys >> key) & 0x1u;
+    }
+}
+
+void Timeline::Capture(uint64_t frame) {
+    TraceSpan span("snapshot", "state", "frame", frame);
+    auto keyframe = std::make_unique<Keyframe>();
+    const Keyframe *previous = keyframes.empty() ? nullptr : keyframes.back().get();
+
+    keyframe->frame = frame;
+
+    // Most of memory is the ROM and never changes, so most pages are the previous keyframe's
+    for (size_t page = 0; page < MEMORY_SIZE / PAGE_SIZE; ++page) {
+        const uint8_t *bytes = &chip8.memory[page * PAGE_SIZE];
+
+        if (previous != nullptr && memcmp(previous->pages[page]->data(), bytes, PAGE_SIZE) == 0) {
+            keyframe->pages[page] = previous->pages[page];
+        }
+        else {
+            auto copy = std::make_shared<Page>();
+            memcpy(copy->data(), bytes, PAGE_SIZE);
+            keyframe->pages[page] = std::move(copy);
+        }
+    }
+
+    keyframe->state.Capture(chip8);
+
+    keyframes.push_back(std::move(keyframe));
+}
+
+void Timeline::Restore(const Keyframe &keyframe) {
+    TraceSpan span("restore", "state", "frame", keyframe.frame);
+    for (size_t page = 0; page < MEMORY_SIZE / PAGE_SIZE; ++page) {
+        memcpy(&chip8.memory[page * PAGE_SIZE], keyframe.pages[page]->data(), PAGE_SIZE);
+    }
+
+    keyframe.state.Restore(chip8);
+
+    // Restoring rewrites memory and the display wholesale
+    chip8.dirtyPages = ~0ull;
+    chip8.displayDirty = true;
+}
+
+size_t Timeline::KeyframeFor(uint64_t cycle) const {
+    uint64_t frame = cycle / cyclesPerFrame;
+
+    // Keyframes are in frame order
+    size_t low = 0;
+    size_t high = keyframes.size();
+    while (high - low > 1) {
+        size_t middle = (low + high) / 2;
+        if (keyframes[middle]->frame <= frame) {
+            low = middle;
+        }
+        else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+uint16_t Timeline::KeysFor(uint64_t frame) const {
+    if (frame < frameKeys.size()) {
+        return frameKeys[frame];
+    }
+
+    // Only reachable at the very end of the history, on the boundary of a frame that hasn't begun yet
+    return frameKeys.empty() ? 0 : frameKeys.back();
+}
+
+bool Timeline::Seek(uint64_t cycle) {
+    if (horizon < chip8.cycles) {
+        horizon = chip8.cycles;
+    }
+
+    if (keyframes.empty() || cycle < Oldest() || cycle > horizon) {
+        return false;
+    }
+
+    NoHook hook;
+    Restore(*keyframes[KeyframeFor(cycle)]);
+    Replay(cycle, hook);
+    return true;
+}
+
+void Timeline::Truncate() {
+    uint64_t frame = chip8.cycles / cyclesPerFrame;
+
+    while (!keyframes.empty() && keyframes.back()->frame * cyclesPerFrame > chip8.cycles) {
+        keyframes.pop_back();
+    }
+
+    if (frameKeys.size() > frame + 1) {
+        frameKeys.resize(frame + 1);
+    }
+
+    horizon = chip8.cycles;
+}
+
+uint64_t Timeline::Oldest() const {
+    return keyframes.empty() ? 0 : keyframes.front()->frame * cyclesPerFrame;
+}
+
+size_t Timeline::MemoryUsage() const {
+    size_t bytes = frameKeys.capacity() * sizeof(uint16_t);
+    const Keyframe *previous = nullptr;
+
+    for (const auto &keyframe : keyframes) {
+        bytes += sizeof(Keyframe);
+
+        // A page is only ever shared with the neighbouring keyframes, so counting changes counts every copy once
+        for (size_t page = 0; page < MEMORY_SIZE / PAGE_SIZE; ++page) {
+            if (previous == nullptr || previous->pages[page] != keyframe->pages[page]) {
+                bytes += PAGE_SIZE;
+            }
+        }
+        previous = keyframe.get();
+    }
+
+    return bytes;
+}
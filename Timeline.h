@@ -0,0 +1,182 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Chip8.h"
+
+/**
+ * Execution history for the debugger: lets it step backwards and search back in time.
+ *
+ * Given the state at the start of a frame and the keys held during each frame, the core is deterministic - the
+ * random number generator is part of the state - so any earlier point can be rebuilt by re-executing from the
+ * nearest earlier snapshot. The timeline keeps a keyframe of the whole machine every few frames and the keypad
+ * mask for every frame. Memory is stored in pages shared with the previous keyframe when they haven't changed,
+ * which for a typical ROM leaves a keyframe at little more than the display and the registers.
+ *
+ * Positions are instruction counts (Chip8::cycles); frame n covers cycles [n * cyclesPerFrame, (n + 1) *
+ * cyclesPerFrame). Re-execution follows the frontend's frame loop exactly: keys applied at the start of a frame,
+ * timers ticked at the end.
+ *
+ * Seeking back only goes as far as the oldest keyframe and forward only up to the furthest point the program has
+ * run to. Changes made to the state from outside (the debugger writing registers or memory) aren't part of the
+ * history: they are forgotten when seeking back past them, and the history after them is dropped by Truncate().
+ */
+class Timeline {
+public:
+    Timeline(Chip8 &chip8, unsigned int cyclesPerFrame, unsigned int keyframeFrames = 60);
+
+    /**
+     * Called at the start of every frame, before any of its instructions run. Takes a keyframe when one is due and
+     * applies the keys for the frame: the recorded ones if this frame has run before, otherwise the live ones,
+     * which are recorded.
+     */
+    void BeginFrame(uint16_t liveKeys);
+
+    /**
+     * Put the machine in the state it was in just before instruction number cycle ran. Returns false if that's
+     * outside the history.
+     */
+    bool Seek(uint64_t cycle);
+
+    /**
+     * Seek to just before the most recent earlier instruction for which predicate(chip8) was true, checked before
+     * each instruction ran. If there was none, seeks to the start of the history and returns false.
+     */
+    template <typename Predicate>
+    bool SeekBack(Predicate predicate);
+
+    /**
+     * The state was changed from outside: forget everything after the current point.
+     */
+    void Truncate();
+
+    uint64_t Oldest() const;
+
+    uint64_t Newest() const {
+        return horizon;
+    }
+
+    /**
+     * Bytes held by keyframes and recorded keys.
+     */
+    size_t MemoryUsage() const;
+
+private:
+    static const unsigned int PAGE_SIZE = 256;
+    using Page = std::array<uint8_t, PAGE_SIZE>;
+
+    // The whole machine: memory in pages, everything else as it is
+    struct Keyframe {
+        uint64_t frame;
+        std::shared_ptr<const Page> pages[MEMORY_SIZE / PAGE_SIZE];
+        Chip8State state;
+    };
+
+    void Capture(uint64_t frame);
+
+    void Restore(const Keyframe &keyframe);
+
+    // Latest keyframe at or before cycle
+    size_t KeyframeFor(uint64_t cycle) const;
+
+    uint16_t KeysFor(uint64_t frame) const;
+
+    /**
+     * Run on from a Restore()d keyframe to just before instruction number cycle, exactly as the frontend would.
+     */
+    template <typename Hook>
+    void Replay(uint64_t cycle, Hook &hook);
+
+    struct NoHook {
+        bool Before(Chip8 &) {
+            return false;
+        }
+
+        bool After(Chip8 &) {
+            return false;
+        }
+    };
+
+    Chip8 &chip8;
+    unsigned int cyclesPerFrame;
+    unsigned int keyframeFrames;
+    std::vector<std::unique_ptr<Keyframe>> keyframes;
+    std::vector<uint16_t> frameKeys;
+    uint64_t horizon = 0;
+};
+
+template <typename Hook>
+void Timeline::Replay(uint64_t cycle, Hook &hook) {
+    for (;;) {
+        if (chip8.cycles % cyclesPerFrame == 0) {
+            uint16_t keys = KeysFor(chip8.cycles / cyclesPerFrame);
+            for (unsigned int key = 0; key < 16; ++key) {
+                chip8.keys[key] = (keys >> key) & 0x1u;
+            }
+        }
+
+        if (chip8.cycles >= cycle) {
+            return;
+        }
+
+        uint64_t frameEnd = (chip8.cycles / cyclesPerFrame + 1) * cyclesPerFrame;
+        uint64_t stop = frameEnd < cycle ? frameEnd : cycle;
+        chip8.Run(static_cast<unsigned int>(stop - chip8.cycles), hook);
+
+        if (chip8.cycles == frameEnd) {
+            chip8.TickTimers();
+        }
+    }
+}
+
+/**
+ * Replays from the keyframe at or before the current point, tracking the last instruction the predicate matched;
+ * if it wasn't in that stretch, moves on to the one before.
+ */
+template <typename Predicate>
+bool Timeline::SeekBack(Predicate predicate) {
+    struct Search {
+        Predicate &predicate;
+        uint64_t found;
+        bool any;
+
+        bool Before(Chip8 &target) {
+            if (predicate(static_cast<const Chip8 &>(target))) {
+                found = target.cycles;
+                any = true;
+            }
+            return false;
+        }
+
+        bool After(Chip8 &) {
+            return false;
+        }
+    };
+
+    uint64_t end = chip8.cycles;
+    if (horizon < end) {
+        horizon = end;
+    }
+
+    for (size_t i = KeyframeFor(end == 0 ? 0 : end - 1) + 1; i-- > 0 && !keyframes.empty();) {
+        Search search{predicate, 0, false};
+
+        Restore(*keyframes[i]);
+        Replay(end, search);
+
+        if (search.any) {
+            Seek(search.found);
+            return true;
+        }
+
+        end = keyframes[i]->frame * cyclesPerFrame;
+    }
+
+    Seek(Oldest());
+    return false;
+}
+
+#endif //TIMELINE_H
@@ -0,0 +1,151 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "SpscRing.h"
+
+/**
+ * A span (or, with phase 'i', an instant) recorded on some thread. name, category and argName must be string
+ * literals: only the pointers are kept.
+ */
+struct TraceEvent {
+    const char *name;
+    const char *category;
+    uint64_t startNs;
+    uint64_t durationNs;
+    const char *argName;
+    uint64_t arg;
+    char phase;
+};
+
+// Events a thread can have waiting for the Tracer before it starts dropping them
+const size_t TRACE_RING_EVENTS = 1u << 14u;
+
+/**
+ * One thread's events on their way to the Tracer.
+ */
+struct TraceBuffer {
+    explicit TraceBuffer(uint32_t thread) : ring(TRACE_RING_EVENTS), thread(thread) {}
+
+    SpscRing<TraceEvent> ring;
+    uint32_t thread;
+    std::atomic<uint64_t> dropped{0};
+    // Set by NameThread(); read by the Tracer under Trace's mutex
+    std::string name;
+};
+
+/**
+ * The recording side of tracing, cheap enough to leave in the hot paths, the core's included.
+ *
+ * Nothing is recorded unless a Tracer is running. Until then a TraceSpan costs a relaxed load and a branch that is
+ * never taken when it begins, and a test of the start it kept when it ends. Each thread records into a ring of its
+ * own, created the first time it records anything, which only it pushes to and only the Tracer pops from, so
+ * recording never takes a lock. A full ring drops the event and counts it.
+ *
+ * All of this lives in the header so that every target compiling the core gets it without linking anything; only
+ * the tools that write traces link the Tracer.
+ */
+class Trace {
+public:
+    static bool Enabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    static uint64_t NowNs() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    static void Record(const char *name, const char *category, uint64_t startNs, uint64_t endNs,
+                       const char *argName = nullptr, uint64_t arg = 0) {
+        Push(TraceEvent{name, category, startNs, endNs - startNs, argName, arg, 'X'});
+    }
+
+    static void Instant(const char *name, const char *category, const char *argName = nullptr, uint64_t arg = 0) {
+        if (Enabled()) [[unlikely]] {
+            Push(TraceEvent{name, category, NowNs(), 0, argName, arg, 'i'});
+        }
+    }
+
+    /**
+     * Name the calling thread in the trace, if tracing.
+     */
+    static void NameThread(const char *name) {
+        if (Enabled()) {
+            TraceBuffer &buffer = Buffer();
+            std::lock_guard<std::mutex> lock(mutex);
+            buffer.name = name;
+        }
+    }
+
+private:
+    friend class Tracer;
+
+    static void Push(const TraceEvent &event) {
+        TraceBuffer &buffer = Buffer();
+        if (!buffer.ring.TryPush(event)) {
+            buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    static TraceBuffer &Buffer() {
+        if (local == nullptr) [[unlikely]] {
+            // Buffers outlive their threads, so the Tracer can still drain what a thread left behind
+            std::lock_guard<std::mutex> lock(mutex);
+            buffers.push_back(std::make_unique<TraceBuffer>(static_cast<uint32_t>(buffers.size() + 1)));
+            local = buffers.back().get();
+        }
+        return *local;
+    }
+
+    static inline std::atomic<bool> enabled{false};
+    static inline std::mutex mutex;
+    static inline std::vector<std::unique_ptr<TraceBuffer>> buffers;
+    static inline thread_local TraceBuffer *local = nullptr;
+};
+
+/**
+ * Records the time from its construction to its destruction as a span, if tracing.
+ */
+class TraceSpan {
+public:
+    TraceSpan(const char *name, const char *category, const char *argName = nullptr, uint64_t arg = 0)
+            : name(name), category(category), argName(argName), arg(arg) {
+        if (Trace::Enabled()) [[unlikely]] {
+            start = Trace::NowNs();
+        }
+    }
+
+    ~TraceSpan() {
+        if (start != 0) [[unlikely]] {
+            Trace::Record(name, category, start, Trace::NowNs(), argName, arg);
+        }
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+    /**
+     * Attach a value learnt during the span, e.g. how much it did.
+     */
+    void SetArg(const char *newArgName, uint64_t value) {
+        argName = newArgName;
+        arg = value;
+    }
+
+private:
+    const char *name;
+    const char *category;
+    const char *argName;
+    uint64_t arg;
+    uint64_t start = 0;
+};
+
+#endif //TRACE_H
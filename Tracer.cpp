@@ -0,0 +1,147 @@
+#include "Tracer.h"
+#include <cstring>
+#include <unistd.h>
+
+// How often the flusher empties the rings: often enough that a ring of TRACE_RING_EVENTS doesn't fill at 60 frames
+// a second of even a busy frame
+static const std::chrono::milliseconds FLUSH_INTERVAL(10);
+
+// Dxyn spans closer together than this are one burst
+static const uint64_t BURST_GAP_NS = 1000;
+
+static const size_t WRITE_BUFFER_SIZE = 1 << 20;
+
+Tracer::Tracer(const std::string &path) : pid(getpid()), originNs(Trace::NowNs()) {
+    file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        return;
+    }
+    setvbuf(file, nullptr, _IOFBF, WRITE_BUFFER_SIZE);
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+
+    Trace::enabled.store(true, std::memory_order_relaxed);
+    flusher = std::thread(&Tracer::Flush, this);
+}
+
+Tracer::~Tracer() {
+    if (file == nullptr) {
+        return;
+    }
+
+    Trace::enabled.store(false, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    stop.notify_one();
+    flusher.join();
+
+    // A thread that saw tracing on just before it went off may still push; whatever it had is drained here
+    Drain();
+    for (size_t thread = 0; thread < bursts.size(); ++thread) {
+        EndBurst(static_cast<uint32_t>(thread), bursts[thread]);
+    }
+
+    std::lock_guard<std::mutex> lock(Trace::mutex);
+    for (const auto &buffer : Trace::buffers) {
+        if (!buffer->name.empty()) {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",\n", pid, buffer->thread, buffer->name.c_str());
+            first = false;
+        }
+    }
+    fputs("\n]}\n", file);
+    fclose(file);
+}
+
+uint64_t Tracer::Dropped() const {
+    uint64_t dropped = 0;
+    std::lock_guard<std::mutex> lock(Trace::mutex);
+    for (const auto &buffer : Trace::buffers) {
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
+void Tracer::Flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        lock.unlock();
+        Drain();
+        lock.lock();
+        stop.wait_for(lock, FLUSH_INTERVAL, [this]() {
+            return stopping;
+        });
+    }
+}
+
+void Tracer::Drain() {
+    std::vector<TraceBuffer *> buffers;
+    {
+        std::lock_guard<std::mutex> lock(Trace::mutex);
+        for (const auto &buffer : Trace::buffers) {
+            buffers.push_back(buffer.get());
+        }
+    }
+
+    TraceEvent event{};
+    for (TraceBuffer *buffer : buffers) {
+        // Only what is there now, so a thread recording flat out can't keep the flusher here forever
+        for (size_t n = buffer->ring.Size(); n > 0 && buffer->ring.TryPop(event); --n) {
+            Write(buffer->thread, event);
+        }
+    }
+}
+
+void Tracer::Write(uint32_t thread, const TraceEvent &event) {
+    if (bursts.size() <= thread) {
+        bursts.resize(thread + 1);
+    }
+    Burst &burst = bursts[thread];
+
+    if (strcmp(event.name, "Dxyn") == 0 && event.phase == 'X') {
+        if (burst.sprites > 0 && event.startNs > burst.endNs + BURST_GAP_NS) {
+            EndBurst(thread, burst);
+        }
+        if (burst.sprites == 0) {
+            burst.startNs = event.startNs;
+        }
+        burst.endNs = event.startNs + event.durationNs;
+        ++burst.sprites;
+        return;
+    }
+    EndBurst(thread, burst);
+
+    // Events from before the tracer started, recorded by a thread that saw it turn on, are clamped to its start
+    double ts = static_cast<double>(event.startNs > originNs ? event.startNs - originNs : 0) / 1000.0;
+    fprintf(file, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,", first ? "" : ",\n", event.name,
+            event.category, event.phase, ts);
+    if (event.phase == 'X') {
+        fprintf(file, "\"dur\":%.3f,", static_cast<double>(event.durationNs) / 1000.0);
+    }
+    else {
+        fputs("\"s\":\"t\",", file);
+    }
+    fprintf(file, "\"pid\":%d,\"tid\":%u", pid, thread);
+    if (event.argName != nullptr) {
+        fprintf(file, ",\"args\":{\"%s\":%llu}", event.argName, static_cast<unsigned long long>(event.arg));
+    }
+    fputc('}', file);
+    first = false;
+    written.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Tracer::EndBurst(uint32_t thread, Burst &burst) {
+    if (burst.sprites == 0) {
+        return;
+    }
+
+    double ts = static_cast<double>(burst.startNs > originNs ? burst.startNs - originNs : 0) / 1000.0;
+    fprintf(file, "%s{\"name\":\"Dxyn burst\",\"cat\":\"emulation\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                  "\"pid\":%d,\"tid\":%u,\"args\":{\"sprites\":%llu}}", first ? "" : ",\n", ts,
+            static_cast<double>(burst.endNs - burst.startNs) / 1000.0, pid, thread,
+            static_cast<unsigned long long>(burst.sprites));
+    first = false;
+    written.fetch_add(1, std::memory_order_relaxed);
+    burst = Burst();
+}
@@ -0,0 +1,79 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Trace.h"
+
+/**
+ * Writes what Trace records to a Chrome trace-event JSON file, for chrome://tracing or ui.perfetto.dev.
+ *
+ * Constructing one turns tracing on; destroying it turns tracing off, drains what is left and finishes the file.
+ * Only one may exist at a time. A background thread wakes every few milliseconds to empty every thread's ring and
+ * format the events, so the threads being traced never format or write anything themselves.
+ *
+ * Consecutive Dxyn spans on a thread are merged into one "Dxyn burst" span, with the number of sprites drawn, as
+ * they are written: a frame that draws dozens of sprites would otherwise bury everything else around it. A burst
+ * ends at a gap of more than a microsecond or at any other event on the same thread.
+ */
+class Tracer {
+public:
+    explicit Tracer(const std::string &path);
+
+    ~Tracer();
+
+    Tracer(const Tracer &) = delete;
+
+    Tracer &operator=(const Tracer &) = delete;
+
+    bool IsOpen() const {
+        return file != nullptr;
+    }
+
+    /**
+     * Events written so far, and those dropped because a thread's ring was full.
+     */
+    uint64_t Written() const {
+        return written.load(std::memory_order_relaxed);
+    }
+
+    uint64_t Dropped() const;
+
+private:
+    struct Burst {
+        uint64_t startNs = 0;
+        uint64_t endNs = 0;
+        uint64_t sprites = 0;
+    };
+
+    void Flush();
+
+    // Write out what every ring holds now
+    void Drain();
+
+    void Write(uint32_t thread, const TraceEvent &event);
+
+    void EndBurst(uint32_t thread, Burst &burst);
+
+    std::FILE *file = nullptr;
+    int pid;
+    // Timestamps are written relative to this, so the trace starts at 0
+    uint64_t originNs;
+    bool first = true;
+    std::atomic<uint64_t> written{0};
+    // Indexed by TraceBuffer::thread; only the flushing thread touches these
+    std::vector<Burst> bursts;
+
+    std::mutex mutex;
+    std::condition_variable stop;
+    bool stopping = false;
+    std::thread flusher;
+};
+
+#endif //TRACER_H
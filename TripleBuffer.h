@@ -0,0 +1,76 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Lock-free single producer, single consumer triple buffer.
+ *
+ * The producer always owns one slot to write into and the consumer always owns one slot to read from. The third
+ * slot sits in the middle and is swapped atomically with whichever side is done with its own. Neither side ever
+ * waits for the other, so a slow consumer only ever drops frames, it never stalls the producer.
+ */
+template <typename T>
+class TripleBuffer {
+public:
+    /**
+     * The slot the producer is free to write. Only valid on the producer thread until the next Publish().
+     */
+    T &WriteBuffer() {
+        return buffers[back];
+    }
+
+    /**
+     * Hand the write slot to the consumer and take the middle slot to write the next value into.
+     */
+    void Publish() {
+        uint8_t previous = middle.exchange(back | FRESH, std::memory_order_acq_rel);
+        back = previous & INDEX_MASK;
+        middle.notify_one();
+    }
+
+    /**
+     * Swap in the most recently published value, if there is one newer than the current read slot.
+     */
+    bool Consume() {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) {
+            return false;
+        }
+
+        uint8_t previous = middle.exchange(front, std::memory_order_acq_rel);
+        front = previous & INDEX_MASK;
+        return true;
+    }
+
+    /**
+     * Block the consumer until something has been published since its last Consume().
+     */
+    void Wait() const {
+        uint8_t current = middle.load(std::memory_order_acquire);
+
+        if (!(current & FRESH)) {
+            middle.wait(current, std::memory_order_acquire);
+        }
+    }
+
+    /**
+     * The slot the consumer is reading. Only valid on the consumer thread until the next Consume().
+     */
+    const T &ReadBuffer() const {
+        return buffers[front];
+    }
+
+private:
+    static const uint8_t INDEX_MASK = 0x3u;
+    static const uint8_t FRESH = 0x4u;
+
+    T buffers[3]{};
+
+    // Keep the shared word and each side's private index on their own cache lines
+    alignas(64) std::atomic<uint8_t> middle{1};
+    alignas(64) uint8_t back = 0;
+    alignas(64) uint8_t front = 2;
+};
+
+#endif //TRIPLEBUFFER_H
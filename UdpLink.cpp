@@ -0,0 +1,78 @@
+#include "UdpLink.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static sockaddr_in Loopback(uint16_t port) {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return address;
+}
+
+UdpLink::UdpLink(uint16_t port, uint16_t peerPort, const LinkFaults &faults)
+        : peerPort(peerPort), faults(faults), random(faults.seed) {
+    fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return;
+    }
+
+    sockaddr_in address = Loopback(port);
+    if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+UdpLink::~UdpLink() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+void UdpLink::Send(const std::string &packet) {
+    if (faults.loss > 0 && std::uniform_real_distribution<double>(0, 1)(random) < faults.loss) {
+        ++stats.dropped;
+    }
+    else if (faults.latencyMs == 0 && faults.jitterMs == 0) {
+        Transmit(packet);
+    }
+    else {
+        unsigned int delay = faults.latencyMs + std::uniform_int_distribution<unsigned int>(0, faults.jitterMs)(random);
+        delayed.push(Delayed{Clock::now() + std::chrono::milliseconds(delay), queued++, packet});
+    }
+
+    Flush();
+}
+
+bool UdpLink::Receive(std::string &packet) {
+    Flush();
+
+    char buffer[2048];
+    ssize_t size = recv(fd, buffer, sizeof(buffer), 0);
+    if (size < 0) {
+        return false;
+    }
+
+    packet.assign(buffer, static_cast<size_t>(size));
+    ++stats.received;
+    return true;
+}
+
+void UdpLink::Flush() {
+    Clock::time_point now = Clock::now();
+
+    while (!delayed.empty() && delayed.top().due <= now) {
+        Transmit(delayed.top().packet);
+        delayed.pop();
+    }
+}
+
+void UdpLink::Transmit(const std::string &packet) {
+    sockaddr_in address = Loopback(peerPort);
+    // A full socket buffer loses the packet, which the protocol has to survive anyway
+    sendto(fd, packet.data(), packet.size(), 0, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+    ++stats.sent;
+}
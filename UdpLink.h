@@ -0,0 +1,86 @@
+#ifndef UDPLINK_H
+#define UDPLINK_H
+
+#include <chrono>
+#include <cstdint>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * Faults to inject into outgoing packets, for trying netplay on one machine as if it were over a real network.
+ */
+struct LinkFaults {
+    unsigned int latencyMs = 0;
+    // Extra delay drawn uniformly from [0, jitterMs]; enough of it reorders packets
+    unsigned int jitterMs = 0;
+    // Fraction of packets dropped
+    double loss = 0;
+    uint32_t seed = 1;
+};
+
+struct LinkStats {
+    uint64_t sent = 0;
+    uint64_t dropped = 0;
+    uint64_t received = 0;
+};
+
+/**
+ * A non-blocking UDP socket bound to 127.0.0.1 that exchanges datagrams with one peer port.
+ *
+ * Outgoing packets go through the fault injection first: dropped ones are counted and forgotten, delayed ones wait in
+ * a queue that Send() and Receive() flush as their time comes.
+ */
+class UdpLink {
+public:
+    UdpLink(uint16_t port, uint16_t peerPort, const LinkFaults &faults = LinkFaults());
+
+    ~UdpLink();
+
+    UdpLink(const UdpLink &) = delete;
+
+    UdpLink &operator=(const UdpLink &) = delete;
+
+    bool IsOpen() const {
+        return fd >= 0;
+    }
+
+    void Send(const std::string &packet);
+
+    /**
+     * Take the next datagram from the peer into packet. False if none is waiting.
+     */
+    bool Receive(std::string &packet);
+
+    LinkStats Stats() const {
+        return stats;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Delayed {
+        Clock::time_point due;
+        uint64_t order;
+        std::string packet;
+
+        bool operator>(const Delayed &other) const {
+            return due != other.due ? due > other.due : order > other.order;
+        }
+    };
+
+    void Flush();
+
+    void Transmit(const std::string &packet);
+
+    int fd = -1;
+    uint16_t peerPort;
+    LinkFaults faults;
+    std::minstd_rand random;
+    std::priority_queue<Delayed, std::vector<Delayed>, std::greater<>> delayed;
+    uint64_t queued = 0;
+    LinkStats stats;
+};
+
+#endif //UDPLINK_H
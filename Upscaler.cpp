@@ -0,0 +1,281 @@
+#include "Upscaler.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define UPSCALER_X86 1
+#endif
+
+// Up to this scale rows are built from shuffles of the table entry, past it from per-pixel broadcast stores
+static const unsigned int MAX_SHUFFLE_SCALE = 16;
+
+size_t BytesPerPixel(PixelFormat format) {
+    switch (format) {
+        case PixelFormat::RGBA8888:
+        case PixelFormat::BGRA8888:
+            return 4;
+        case PixelFormat::RGB565:
+            return 2;
+        case PixelFormat::GRAY8:
+            return 1;
+    }
+
+    return 4;
+}
+
+/**
+ * Convert 0xRRGGBB to one pixel's worth of bytes in the given format.
+ */
+static void EncodeColour(PixelFormat format, uint32_t colour, uint8_t *out) {
+    uint8_t r = (colour >> 16u) & 0xFFu;
+    uint8_t g = (colour >> 8u) & 0xFFu;
+    uint8_t b = colour & 0xFFu;
+
+    switch (format) {
+        case PixelFormat::RGBA8888:
+            out[0] = r;
+            out[1] = g;
+            out[2] = b;
+            out[3] = 0xFF;
+            break;
+        case PixelFormat::BGRA8888:
+            out[0] = b;
+            out[1] = g;
+            out[2] = r;
+            out[3] = 0xFF;
+            break;
+        case PixelFormat::RGB565: {
+            uint16_t packed = ((r >> 3u) << 11u) | ((g >> 2u) << 5u) | (b >> 3u);
+            memcpy(out, &packed, sizeof(packed));
+            break;
+        }
+        case PixelFormat::GRAY8:
+            // BT.601 luma
+            out[0] = (r * 77u + g * 150u + b * 29u) >> 8u;
+            break;
+    }
+}
+
+Upscaler::Upscaler(PixelFormat format, uint32_t offColour, uint32_t onColour)
+        : format(format), pixelBytes(BytesPerPixel(format)) {
+    uint8_t off[4];
+    uint8_t on[4];
+    EncodeColour(format, offColour, off);
+    EncodeColour(format, onColour, on);
+
+    for (unsigned int value = 0; value < 256; ++value) {
+        for (unsigned int bit = 0; bit < 8; ++bit) {
+            const uint8_t *pixel = (value & (0x80u >> bit)) ? on : off;
+            memcpy(&lut[value][bit * pixelBytes], pixel, pixelBytes);
+        }
+    }
+}
+
+/**
+ * Every destination row after the first one for a source row is a copy of it.
+ */
+static void ReplicateRow(uint8_t *first, size_t rowBytes, unsigned int scale, size_t pitch) {
+    for (unsigned int copy = 1; copy < scale; ++copy) {
+        memcpy(first + copy * pitch, first, rowBytes);
+    }
+}
+
+/**
+ * Scale a frame of any format without vector instructions.
+ */
+static void ScaleScalar(const Frame &frame, const uint8_t lut[256][32], size_t pixelBytes, unsigned int scale,
+                        uint8_t *out, size_t pitch) {
+    for (unsigned int y = 0; y < frame.height; ++y) {
+        uint8_t *first = out + y * scale * pitch;
+        uint8_t *dst = first;
+
+        for (unsigned int byte = 0; byte < frame.RowBytes(); ++byte) {
+            const uint8_t *pixels = lut[frame.pixels[y][byte]];
+
+            for (unsigned int bit = 0; bit < 8; ++bit) {
+                for (unsigned int copy = 0; copy < scale; ++copy) {
+                    memcpy(dst, &pixels[bit * pixelBytes], pixelBytes);
+                    dst += pixelBytes;
+                }
+            }
+        }
+
+        ReplicateRow(first, frame.width * scale * pixelBytes, scale, pitch);
+    }
+}
+
+#ifdef UPSCALER_X86
+
+/**
+ * Scale a frame of 4 byte pixels. Each source byte becomes exactly `scale` vectors of 8 pixels; vector k takes pixel
+ * (k * 8 + lane) / scale from the table entry.
+ */
+__attribute__((target("avx2")))
+static void Scale32Avx2(const Frame &frame, const uint8_t lut[256][32], unsigned int scale, uint8_t *out,
+                        size_t pitch) {
+    size_t rowBytes = frame.width * scale * 4;
+
+    if (scale <= MAX_SHUFFLE_SCALE) {
+        __m256i select[MAX_SHUFFLE_SCALE];
+
+        for (unsigned int k = 0; k < scale; ++k) {
+            alignas(32) int32_t lanes[8];
+            for (unsigned int lane = 0; lane < 8; ++lane) {
+                lanes[lane] = static_cast<int32_t>((k * 8 + lane) / scale);
+            }
+            select[k] = _mm256_load_si256(reinterpret_cast<const __m256i *>(lanes));
+        }
+
+        for (unsigned int y = 0; y < frame.height; ++y) {
+            uint8_t *first = out + y * scale * pitch;
+            uint8_t *dst = first;
+
+            for (unsigned int byte = 0; byte < frame.RowBytes(); ++byte) {
+                __m256i pixels = _mm256_load_si256(reinterpret_cast<const __m256i *>(lut[frame.pixels[y][byte]]));
+
+                for (unsigned int k = 0; k < scale; ++k) {
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst),
+                                        _mm256_permutevar8x32_epi32(pixels, select[k]));
+                    dst += 32;
+                }
+            }
+
+            ReplicateRow(first, rowBytes, scale, pitch);
+        }
+        return;
+    }
+
+    // Each pixel covers more than 8 destination pixels, so fill it with whole vectors and let the last one overlap
+    for (unsigned int y = 0; y < frame.height; ++y) {
+        uint8_t *first = out + y * scale * pitch;
+        uint8_t *dst = first;
+
+        for (unsigned int x = 0; x < frame.width; ++x) {
+            int32_t colour;
+            memcpy(&colour, &lut[frame.pixels[y][x / 8]][(x % 8) * 4], 4);
+            __m256i fill = _mm256_set1_epi32(colour);
+
+            for (unsigned int offset = 0; offset + 8 < scale; offset += 8) {
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + offset * 4), fill);
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + (scale - 8) * 4), fill);
+            dst += scale * 4;
+        }
+
+        ReplicateRow(first, rowBytes, scale, pitch);
+    }
+}
+
+/**
+ * Scale a frame of 1 or 2 byte pixels. The 8 * scale output pixels of a source byte are written as whole 16 byte
+ * vectors plus, for odd scales of 1 byte pixels, one 8 byte half; each is a pshufb of the table entry.
+ */
+__attribute__((target("ssse3")))
+static void ScaleSmallSsse3(const Frame &frame, const uint8_t lut[256][32], size_t pixelBytes, unsigned int scale,
+                            uint8_t *out, size_t pitch) {
+    size_t rowBytes = frame.width * scale * pixelBytes;
+
+    if (scale <= MAX_SHUFFLE_SCALE) {
+        size_t outBytes = 8 * scale * pixelBytes;
+        size_t vectors = (outBytes + 15) / 16;
+        size_t whole = outBytes / 16;
+        __m128i select[MAX_SHUFFLE_SCALE + 1];
+
+        for (size_t k = 0; k < vectors; ++k) {
+            alignas(16) uint8_t lanes[16];
+            for (size_t lane = 0; lane < 16; ++lane) {
+                size_t byte = k * 16 + lane;
+                size_t pixel = (byte / pixelBytes) / scale;
+                lanes[lane] = static_cast<uint8_t>(pixel < 8 ? pixel * pixelBytes + byte % pixelBytes : 0);
+            }
+            select[k] = _mm_load_si128(reinterpret_cast<const __m128i *>(lanes));
+        }
+
+        for (unsigned int y = 0; y < frame.height; ++y) {
+            uint8_t *first = out + y * scale * pitch;
+            uint8_t *dst = first;
+
+            for (unsigned int byte = 0; byte < frame.RowBytes(); ++byte) {
+                __m128i pixels = _mm_load_si128(reinterpret_cast<const __m128i *>(lut[frame.pixels[y][byte]]));
+
+                for (size_t k = 0; k < whole; ++k) {
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_shuffle_epi8(pixels, select[k]));
+                    dst += 16;
+                }
+
+                if (whole < vectors) {
+                    _mm_storel_epi64(reinterpret_cast<__m128i *>(dst), _mm_shuffle_epi8(pixels, select[whole]));
+                    dst += 8;
+                }
+            }
+
+            ReplicateRow(first, rowBytes, scale, pitch);
+        }
+        return;
+    }
+
+    // Every pixel covers more than one whole vector
+    size_t runBytes = scale * pixelBytes;
+
+    for (unsigned int y = 0; y < frame.height; ++y) {
+        uint8_t *first = out + y * scale * pitch;
+        uint8_t *dst = first;
+
+        for (unsigned int x = 0; x < frame.width; ++x) {
+            const uint8_t *pixel = &lut[frame.pixels[y][x / 8]][(x % 8) * pixelBytes];
+            __m128i fill;
+
+            if (pixelBytes == 2) {
+                uint16_t colour;
+                memcpy(&colour, pixel, 2);
+                fill = _mm_set1_epi16(static_cast<int16_t>(colour));
+            }
+            else {
+                fill = _mm_set1_epi8(static_cast<char>(*pixel));
+            }
+
+            for (size_t offset = 0; offset + 16 < runBytes; offset += 16) {
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + offset), fill);
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + runBytes - 16), fill);
+            dst += runBytes;
+        }
+
+        ReplicateRow(first, rowBytes, scale, pitch);
+    }
+}
+
+#endif
+
+void Upscaler::Scale(const Frame &frame, unsigned int scale, void *dst, size_t pitch) const {
+    if (scale == 0) {
+        return;
+    }
+
+    auto *out = static_cast<uint8_t *>(dst);
+
+#ifdef UPSCALER_X86
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+    static const bool hasSsse3 = __builtin_cpu_supports("ssse3");
+
+    if (pixelBytes == 4 && hasAvx2) {
+        Scale32Avx2(frame, lut, scale, out, pitch);
+        return;
+    }
+
+    if (pixelBytes < 4 && hasSsse3) {
+        ScaleSmallSsse3(frame, lut, pixelBytes, scale, out, pitch);
+        return;
+    }
+#endif
+
+    ScaleScalar(frame, lut, pixelBytes, scale, out, pitch);
+}
+
+void Upscaler::ScaleReference(const Frame &frame, unsigned int scale, void *dst, size_t pitch) const {
+    if (scale == 0) {
+        return;
+    }
+
+    ScaleScalar(frame, lut, pixelBytes, scale, static_cast<uint8_t *>(dst), pitch);
+}
@@ -0,0 +1,58 @@
+#ifndef UPSCALER_H
+#define UPSCALER_H
+
+#include <cstddef>
+#include <cstdint>
+#include "Frame.h"
+
+/**
+ * Destination pixel formats. The names give the byte order in memory, so RGBA8888 is R, G, B, A regardless of host
+ * endianness. RGB565 is a native-endian 16 bit word and GRAY8 is one byte of luma per pixel.
+ */
+enum class PixelFormat {
+    RGBA8888,
+    BGRA8888,
+    RGB565,
+    GRAY8
+};
+
+size_t BytesPerPixel(PixelFormat format);
+
+/**
+ * Nearest-neighbour upscaler from a packed frame into a caller-provided pixel buffer.
+ *
+ * Every possible frame byte is expanded once, up front, into its eight destination pixels. Scaling a row is then a
+ * table load and a few shuffled SSE/AVX2 stores per byte, or broadcast stores for large scales, and every other row of
+ * the same source row is a memcpy of the first. CPUs without SSSE3/AVX2 fall back to plain loops over the same table.
+ */
+class Upscaler {
+public:
+    /**
+     * Colours are 0xRRGGBB.
+     */
+    Upscaler(PixelFormat format, uint32_t offColour, uint32_t onColour);
+
+    /**
+     * Write frame at scale times its size to dst, whose rows are pitch bytes apart. dst must hold
+     * frame.height * scale rows of at least frame.width * scale pixels.
+     */
+    void Scale(const Frame &frame, unsigned int scale, void *dst, size_t pitch) const;
+
+    /**
+     * Scale() through the plain loops it falls back to without SSSE3/AVX2, for checking and timing the vector paths
+     * against.
+     */
+    void ScaleReference(const Frame &frame, unsigned int scale, void *dst, size_t pitch) const;
+
+    PixelFormat Format() const {
+        return format;
+    }
+
+private:
+    PixelFormat format;
+    size_t pixelBytes;
+    // 8 pixels for every byte value, at most 4 bytes a pixel
+    alignas(32) uint8_t lut[256][32]{};
+};
+
+#endif //UPSCALER_H
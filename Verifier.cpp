@@ -0,0 +1,407 @@
+#include "Verifier.h"
+#include <algorithm>
+#include <vector>
+
+// How many times I's range at a block entry may grow before it is given up on as anything at all
+const unsigned int INDEX_WIDENING = 16;
+
+/**
+ * What is known at a point in the program: an upper bound for each register and the range I lies in.
+ */
+struct State {
+    uint8_t bounds[16];
+    uint32_t indexLow;
+    uint32_t indexHigh;
+    bool reached;
+};
+
+static bool Join(State &into, const State &from) {
+    if (!from.reached) {
+        return false;
+    }
+    if (!into.reached) {
+        into = from;
+        return true;
+    }
+
+    bool changed = false;
+    for (unsigned int i = 0; i < 16; ++i) {
+        if (from.bounds[i] > into.bounds[i]) {
+            into.bounds[i] = from.bounds[i];
+            changed = true;
+        }
+    }
+    if (from.indexLow < into.indexLow) {
+        into.indexLow = from.indexLow;
+        changed = true;
+    }
+    if (from.indexHigh > into.indexHigh) {
+        into.indexHigh = from.indexHigh;
+        changed = true;
+    }
+
+    return changed;
+}
+
+/**
+ * Smallest all-ones value at least as large as bound, which bounds OR and XOR of anything up to bound.
+ */
+static uint8_t Smear(uint8_t bound) {
+    bound |= bound >> 1u;
+    bound |= bound >> 2u;
+    bound |= bound >> 4u;
+    return bound;
+}
+
+static uint8_t AddBound(unsigned int a, unsigned int b) {
+    // Past 255 the sum wraps, and then it could be anything
+    return a + b > 255 ? 255 : static_cast<uint8_t>(a + b);
+}
+
+static void SetIndex(State &state, uint32_t low, uint32_t high) {
+    state.indexLow = low;
+    state.indexHigh = high;
+}
+
+class Verifier {
+public:
+    explicit Verifier(const Analysis &analysis) : analysis(analysis), codeBefore(0x10000 + 1, 0) {
+        std::vector<uint8_t> code(0x10000, 0);
+        for (const Instruction &instruction : analysis.instructions) {
+            for (unsigned int i = 0; i < instruction.size; ++i) {
+                code[static_cast<uint16_t>(instruction.address + i)] = 1;
+            }
+        }
+
+        for (uint32_t address = 0; address < 0x10000; ++address) {
+            codeBefore[address + 1] = codeBefore[address] + code[address];
+        }
+    }
+
+    Verification Run();
+
+private:
+    bool Fail(const char *reason, uint16_t address) {
+        result.safe = false;
+        result.reason = reason;
+        result.address = address;
+        return false;
+    }
+
+    size_t BlockIndex(uint16_t address) const {
+        return static_cast<size_t>(analysis.BlockAt(address) - analysis.blocks.data());
+    }
+
+    bool WritesCode(uint32_t low, uint32_t high) const;
+
+    bool CheckFlow();
+
+    bool Step(const Instruction &instruction, State &state);
+
+    void Forward(size_t block, const State &exit);
+
+    void Propagate(uint16_t to, const State &state);
+
+    const Analysis &analysis;
+    // Number of code bytes below each address, so a store can be checked against the code in constant time
+    std::vector<uint32_t> codeBefore;
+    std::vector<State> entries;
+    std::vector<unsigned int> indexChanges;
+    std::vector<size_t> work;
+    std::vector<uint8_t> queued;
+    // Blocks that a 00EE can land at the start of, and what any 00EE can leave behind
+    std::vector<uint16_t> returnSites;
+    State returned{};
+    Verification result;
+};
+
+bool Verifier::WritesCode(uint32_t low, uint32_t high) const {
+    // A store that runs off the top of memory wraps around to the bottom
+    if (high > 0xFFFF) {
+        return WritesCode(low, 0xFFFF) || WritesCode(0, std::min<uint32_t>(high - 0x10000, 0xFFFF));
+    }
+
+    return codeBefore[high + 1] != codeBefore[low];
+}
+
+/**
+ * Everything that can run must have been decoded: each block has to end in a way the analysis could follow, with
+ * every successor it has at runtime present as a block.
+ */
+bool Verifier::CheckFlow() {
+    if (analysis.blocks.empty() || analysis.subroutines.empty() || analysis.subroutines[0].entry != ROM_START) {
+        return Fail("no code at the entry point", ROM_START);
+    }
+    if (!analysis.indirectJumps.empty()) {
+        return Fail("indirect jump", analysis.indirectJumps[0]);
+    }
+    if (!analysis.overlaps.empty()) {
+        return Fail("overlapping instructions", analysis.overlaps[0]);
+    }
+    if (analysis.maxCallDepth < 0) {
+        return Fail("recursion", ROM_START);
+    }
+    if (analysis.maxCallDepth > 16) {
+        return Fail("calls nested more than 16 deep", ROM_START);
+    }
+    if (analysis.subroutines[0].returns) {
+        return Fail("returns with nothing on the stack", ROM_START);
+    }
+
+    for (const BasicBlock &block : analysis.blocks) {
+        const Instruction &last = analysis.instructions[block.first + block.count - 1];
+
+        size_t expected;
+        switch (last.flow) {
+            case Flow::Next:
+            case Flow::Jump:
+                expected = 1;
+                break;
+            case Flow::Skip:
+            case Flow::Call:
+                expected = 2;
+                break;
+            case Flow::Return:
+            case Flow::Exit:
+                expected = 0;
+                break;
+            default:
+                return Fail("reaches an instruction it can't follow", last.address);
+        }
+
+        auto edge = std::lower_bound(analysis.edges.begin(), analysis.edges.end(), block.start,
+                                     [](const Edge &e, uint16_t from) { return e.from < from; });
+        size_t found = 0;
+        for (; edge != analysis.edges.end() && edge->from == block.start; ++edge) {
+            ++found;
+        }
+
+        if (found != expected) {
+            return Fail("flows outside the decoded code", last.address);
+        }
+
+        if (last.flow == Flow::Call) {
+            returnSites.push_back(block.end);
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Apply one instruction to the state, failing if it could go out of bounds.
+ */
+bool Verifier::Step(const Instruction &instruction, State &state) {
+    uint16_t opcode = instruction.opcode;
+    unsigned int x = (opcode & 0x0F00u) >> 8u;
+    unsigned int y = (opcode & 0x00F0u) >> 4u;
+    unsigned int n = opcode & 0x000Fu;
+    uint8_t kk = opcode & 0x00FFu;
+    uint8_t *bounds = state.bounds;
+
+    uint32_t stored = 0;
+
+    switch (opcode >> 12u) {
+        case 0x5:
+            if (n == 0x2) {
+                stored = (x > y ? x - y : y - x) + 1;
+            }
+            else if (n == 0x3) {
+                for (unsigned int i = std::min(x, y); i <= std::max(x, y); ++i) {
+                    bounds[i] = 255;
+                }
+            }
+            break;
+        case 0x6:
+            bounds[x] = kk;
+            break;
+        case 0x7:
+            bounds[x] = AddBound(bounds[x], kk);
+            break;
+        case 0x8: {
+            uint8_t value;
+            switch (n) {
+                case 0x0: bounds[x] = bounds[y]; return true;
+                case 0x1: bounds[x] = Smear(bounds[x] | bounds[y]); return true;
+                case 0x2: bounds[x] = std::min(bounds[x], bounds[y]); return true;
+                case 0x3: bounds[x] = Smear(bounds[x] | bounds[y]); return true;
+                case 0x4: value = AddBound(bounds[x], bounds[y]); break;
+                case 0x6: value = bounds[x] >> 1u; break;
+                default: value = 255; break;
+            }
+            // VF gets the carry, borrow or shifted out bit; when x is F too either write could be the last
+            bounds[x] = value;
+            bounds[0xF] = x == 0xF ? std::max<uint8_t>(value, 1) : 1;
+            break;
+        }
+        case 0xA:
+            SetIndex(state, instruction.target, instruction.target);
+            break;
+        case 0xC:
+            bounds[x] = kk;
+            break;
+        case 0xD:
+            bounds[0xF] = 1;
+            break;
+        case 0xE:
+            if (bounds[x] > 15) {
+                return Fail("key instruction on a register that may be above 15", instruction.address);
+            }
+            break;
+        case 0xF:
+            switch (kk) {
+                case 0x00:
+                    SetIndex(state, instruction.operand, instruction.operand);
+                    break;
+                case 0x07:
+                    bounds[x] = 255;
+                    break;
+                case 0x0A:
+                    bounds[x] = 15;
+                    break;
+                case 0x1E:
+                    state.indexHigh += bounds[x];
+                    if (state.indexHigh > 0xFFFF) {
+                        SetIndex(state, 0, 0xFFFF);
+                    }
+                    break;
+                case 0x29:
+                    SetIndex(state, 0x50, 0x50 + 5u * bounds[x]);
+                    break;
+                case 0x30:
+                    SetIndex(state, 0xA0, 0xA0 + 10u * std::min<uint8_t>(bounds[x], 15));
+                    break;
+                case 0x33:
+                    stored = 3;
+                    break;
+                case 0x55:
+                    stored = x + 1;
+                    break;
+                case 0x65:
+                case 0x85:
+                    for (unsigned int i = 0; i <= x; ++i) {
+                        bounds[i] = 255;
+                    }
+                    break;
+                default:
+                    break;
+            }
+            break;
+        default:
+            break;
+    }
+
+    if (stored > 0 && WritesCode(state.indexLow, state.indexHigh + stored - 1)) {
+        return Fail("store that may overwrite code", instruction.address);
+    }
+
+    return true;
+}
+
+void Verifier::Propagate(uint16_t to, const State &state) {
+    size_t block = BlockIndex(to);
+    State &entry = entries[block];
+    uint32_t low = entry.indexLow;
+    uint32_t high = entry.indexHigh;
+
+    if (!Join(entry, state)) {
+        return;
+    }
+
+    // I stepping through memory in a loop would otherwise take one round per address
+    if (entry.indexLow != low || entry.indexHigh != high) {
+        if (++indexChanges[block] > INDEX_WIDENING) {
+            SetIndex(entry, 0, 0xFFFF);
+        }
+    }
+
+    if (!queued[block]) {
+        queued[block] = 1;
+        work.push_back(block);
+    }
+}
+
+/**
+ * Pass the state at the end of a block on to its successors, narrowing register bounds along the two sides of
+ * 3xkk and 4xkk where that says something.
+ */
+void Verifier::Forward(size_t block, const State &exit) {
+    const BasicBlock &current = analysis.blocks[block];
+    const Instruction &last = analysis.instructions[current.first + current.count - 1];
+
+    if (last.flow == Flow::Return) {
+        if (Join(returned, exit)) {
+            for (uint16_t site : returnSites) {
+                Propagate(site, returned);
+            }
+        }
+        return;
+    }
+
+    auto edge = std::lower_bound(analysis.edges.begin(), analysis.edges.end(), current.start,
+                                 [](const Edge &e, uint16_t from) { return e.from < from; });
+    for (; edge != analysis.edges.end() && edge->from == current.start; ++edge) {
+        State next = exit;
+
+        if (last.flow == Flow::Call && edge->kind == EdgeKind::Fallthrough) {
+            // The callee decides what the return site sees
+            Propagate(edge->to, returned);
+            continue;
+        }
+
+        unsigned int family = last.opcode >> 12u;
+        if (family == 0x3 || family == 0x4) {
+            unsigned int x = (last.opcode & 0x0F00u) >> 8u;
+            uint8_t kk = last.opcode & 0x00FFu;
+            // 3xkk skips when Vx == kk, 4xkk when it doesn't
+            bool equal = (edge->kind == EdgeKind::Skip) == (family == 0x3);
+
+            if (equal) {
+                next.bounds[x] = std::min(next.bounds[x], kk);
+            }
+            else if (next.bounds[x] == kk && kk > 0) {
+                next.bounds[x] = kk - 1;
+            }
+        }
+
+        Propagate(edge->to, next);
+    }
+}
+
+Verification Verifier::Run() {
+    if (!CheckFlow()) {
+        return result;
+    }
+
+    entries.assign(analysis.blocks.size(), State{});
+    indexChanges.assign(analysis.blocks.size(), 0);
+    queued.assign(analysis.blocks.size(), 0);
+
+    // Power on: every register and I are zero
+    State start{};
+    start.reached = true;
+    Propagate(ROM_START, start);
+
+    while (!work.empty()) {
+        size_t block = work.back();
+        work.pop_back();
+        queued[block] = 0;
+
+        State state = entries[block];
+        const BasicBlock &current = analysis.blocks[block];
+        for (size_t i = current.first; i < current.first + current.count; ++i) {
+            if (!Step(analysis.instructions[i], state)) {
+                return result;
+            }
+        }
+
+        Forward(block, state);
+    }
+
+    result.safe = true;
+    return result;
+}
+
+Verification Verify(const Analysis &analysis) {
+    return Verifier(analysis).Run();
+}
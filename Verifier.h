@@ -0,0 +1,30 @@
+#ifndef VERIFIER_H
+#define VERIFIER_H
+
+#include <cstdint>
+#include <string>
+#include "Analyzer.h"
+
+struct Verification {
+    // Every execution of the ROM stays in bounds, so Chip8::CycleUnchecked() is as good as Cycle()
+    bool safe = false;
+    // Why not, and the address of the instruction responsible
+    std::string reason;
+    uint16_t address = 0;
+};
+
+/**
+ * Try to prove from the analysis of a ROM that nothing it can execute needs the checks in Chip8::Cycle():
+ *
+ *  - the stack: call depth from the entry point is at most 16 and the entry point never returns
+ *  - the keys: Ex9E and ExA1 only ever see a register holding 0-15
+ *  - the proof itself: every instruction that can run is one the analysis decoded, so there are no indirect jumps,
+ *    no flow into data or out of the ROM, and no stores (Fx55, Fx33, 5xy2) that can land on code
+ *
+ * Register values are tracked as upper bounds and I as a range, with calls handled context-insensitively - every
+ * return site sees what any 00EE can leave behind. That is sound but coarse, so a ROM that isn't proven safe may
+ * well be; it just runs checked.
+ */
+Verification Verify(const Analysis &analysis);
+
+#endif //VERIFIER_H
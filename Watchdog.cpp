@@ -0,0 +1,75 @@
+#include "Watchdog.h"
+#include <cstring>
+#include "Hash.h"
+
+const unsigned int PAGE_BYTES = 1u << DIRTY_PAGE_BITS;
+
+Watchdog::Watchdog() : tortoise(std::make_unique<Chip8>()) {}
+
+/**
+ * Memory and the display are hashed again only where Chip8 marked them dirty. The keys are mixed in as well: with the
+ * input fixed they are part of what decides the next frame.
+ */
+uint64_t Watchdog::Hash(Chip8 &chip8) {
+    uint64_t dirty = hashed ? chip8.dirtyPages : ~0ull;
+    while (dirty != 0) {
+        unsigned int page = __builtin_ctzll(dirty);
+        dirty &= dirty - 1;
+
+        uint64_t pageHash = HashBytes(page, &chip8.memory[page * PAGE_BYTES], PAGE_BYTES);
+        memoryHash ^= HashMix(page, pageHashes[page]) ^ HashMix(page, pageHash);
+        pageHashes[page] = pageHash;
+    }
+
+    if (!hashed || chip8.displayDirty) {
+        displayHash = HashDisplay(chip8);
+    }
+
+    chip8.dirtyPages = 0;
+    chip8.displayDirty = false;
+    hashed = true;
+
+    return HashBytes(HashMachineState(memoryHash ^ displayHash, chip8), chip8.keys, sizeof(chip8.keys));
+}
+
+/**
+ * Everything the hash covers, compared outright: both machines' bytes with the counters cleared, then memory.
+ */
+bool Watchdog::SameState(const Chip8 &a, const Chip8 &b) {
+    Chip8State stateA;
+    Chip8State stateB;
+    stateA.Capture(a);
+    stateB.Capture(b);
+    stateA.ClearCounters();
+    stateB.ClearCounters();
+    return memcmp(stateA.bytes, stateB.bytes, sizeof(stateA.bytes)) == 0 &&
+           memcmp(a.memory, b.memory, sizeof(a.memory)) == 0;
+}
+
+bool Watchdog::Frame(Chip8 &chip8) {
+    uint64_t hash = Hash(chip8);
+
+    if (started) {
+        ++distance;
+        if (hash == tortoiseHash && SameState(*tortoise, chip8)) {
+            period = distance;
+            return true;
+        }
+    }
+
+    // Brent: move the tortoise up to the hare whenever the distance between them reaches the next power of two
+    if (!started || distance == power) {
+        memcpy(static_cast<void *>(tortoise.get()), &chip8, sizeof(Chip8));
+        tortoiseHash = hash;
+        power = started ? power * 2 : 1;
+        distance = 0;
+        started = true;
+    }
+
+    return false;
+}
+
+void Watchdog::Reset() {
+    started = false;
+    period = 0;
+}
@@ -0,0 +1,78 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <cstdint>
+#include <memory>
+#include "Chip8.h"
+
+/**
+ * Notices when a program has stopped making progress: the machine returning to exactly the state it was in some
+ * frames ago. With the input fixed from then on (a key script that has run out, or no input at all) the core is
+ * deterministic, so the program will go round the same loop forever - a crash into a tight loop, Fx0A waiting for a
+ * key that will never come, or just a title screen.
+ *
+ * Call Frame() at the end of every frame, after the timers tick. States are compared by hash with Brent's cycle
+ * detection, so a loop of p frames entered after m frames is found within about 2(m + p) frames, and only one
+ * earlier state is kept. Hashing is incremental: only memory pages and the display that Chip8 marked dirty since
+ * the last frame are hashed again. A matching hash is confirmed against the kept state, so a hang is never reported
+ * by a collision.
+ *
+ * The watchdog takes over Chip8::dirtyPages and displayDirty, clearing them each frame.
+ */
+class Watchdog {
+public:
+    Watchdog();
+
+    /**
+     * Returns true once the state at the end of this frame has been seen before; Period() is then the loop length.
+     */
+    bool Frame(Chip8 &chip8);
+
+    /**
+     * Forget the states seen so far, e.g. because the input is about to change.
+     */
+    void Reset();
+
+    uint64_t Period() const {
+        return period;
+    }
+
+private:
+    uint64_t Hash(Chip8 &chip8);
+
+    static bool SameState(const Chip8 &a, const Chip8 &b);
+
+    // Hash of each memory page, and of the display, as of the last frame
+    uint64_t pageHashes[64]{};
+    uint64_t memoryHash = 0;
+    uint64_t displayHash = 0;
+    bool hashed = false;
+
+    // Brent's algorithm: the state it compares against, how long ago that was and when to move it on
+    std::unique_ptr<Chip8> tortoise;
+    uint64_t tortoiseHash = 0;
+    bool started = false;
+    uint64_t power = 1;
+    uint64_t distance = 0;
+    uint64_t period = 0;
+};
+
+/**
+ * Chip8::Run hook that records the lowest and highest pc executed, to say where a hung program is looping.
+ */
+struct PcRange {
+    uint16_t low = 0xFFFF;
+    uint16_t high = 0;
+
+    bool Before(Chip8 &chip8) {
+        low = chip8.pc < low ? chip8.pc : low;
+        high = chip8.pc > high ? chip8.pc : high;
+        return false;
+    }
+
+    static bool After(Chip8 &) {
+        return false;
+    }
+};
+
+#endif //WATCHDOG_H
@@ -0,0 +1,362 @@
+#include "WorkStealingScheduler.h"
+#include <algorithm>
+#include <cstring>
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Whether the frame just run, starting from before with these keys held, left the machine only able to repeat it.
+ */
+static bool Blocked(const Chip8 &chip8, const Chip8State &before, uint16_t keys) {
+    uint16_t instruction = (chip8.memory[chip8.pc] << 8u) | chip8.memory[static_cast<uint16_t>(chip8.pc + 1)];
+    if (keys == 0 && (instruction & 0xF0FFu) == 0xF00Au) {
+        return true;
+    }
+
+    // A frame that ends where it started, with the timers stopped, does the same again for as long as the keys stay
+    if (chip8.dirtyPages != 0 || chip8.displayDirty || chip8.delayTimer != 0 || chip8.soundTimer != 0) {
+        return false;
+    }
+    Chip8State after;
+    after.Capture(chip8);
+    after.ClearCounters();
+    return memcmp(after.bytes, before.bytes, sizeof(before.bytes)) == 0;
+}
+
+WorkStealingScheduler::WorkStealingScheduler(const WorkStealingOptions &options) : options(options) {
+    period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / options.rate));
+    start = Clock::now();
+
+    unsigned int count = options.workers != 0 ? options.workers : std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned int i = 0; i < count; ++i) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (unsigned int i = 0; i < count; ++i) {
+        workers[i]->thread = std::thread(&WorkStealingScheduler::Work, this, i);
+    }
+    clock = std::thread(&WorkStealingScheduler::Loop, this);
+}
+
+WorkStealingScheduler::~WorkStealingScheduler() {
+    Stop();
+}
+
+uint32_t WorkStealingScheduler::Add(std::unique_ptr<Chip8> chip8, bool verified, unsigned int cyclesPerFrame,
+                                    SessionClass kind) {
+    auto session = std::make_unique<Session>();
+    session->kind = kind;
+    session->chip8 = std::move(chip8);
+    session->verified = verified;
+    session->cyclesPerFrame = cyclesPerFrame;
+    Session &added = *session;
+
+    {
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        added.id = static_cast<uint32_t>(sessions.size());
+        added.home = added.id % static_cast<unsigned int>(workers.size());
+        sessions.push_back(std::move(session));
+    }
+
+    // Real-time sessions wait for the clock to release their first frame
+    if (kind == SessionClass::Batch) {
+        std::lock_guard<std::mutex> lock(added.mutex);
+        added.queued = true;
+        Push(added.home, added);
+    }
+    return added.id;
+}
+
+void WorkStealingScheduler::SetKeys(uint32_t id, uint16_t keys) {
+    Session *session;
+    {
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        if (id >= sessions.size()) {
+            return;
+        }
+        session = sessions[id].get();
+    }
+
+    std::lock_guard<std::mutex> lock(session->mutex);
+    if (session->keys.load(std::memory_order_relaxed) == keys) {
+        return;
+    }
+    session->keys.store(keys, std::memory_order_relaxed);
+    if (!session->parked) {
+        return;
+    }
+    session->parked = false;
+
+    if (session->kind == SessionClass::Batch) {
+        session->queued = true;
+        Push(session->home, *session);
+        return;
+    }
+
+    // No worker touches a parked machine, so it can be caught up here; the clock releases its next frame as usual
+    Chip8 &chip8 = *session->chip8;
+    uint64_t slept = session->skippedThrough + 1 - session->sleepFrom;
+    chip8.cycles += slept * session->cyclesPerFrame;
+    for (uint64_t tick = 0; tick < slept && (chip8.delayTimer > 0 || chip8.soundTimer > 0); ++tick) {
+        chip8.TickTimers();
+    }
+    session->frames.fetch_add(slept, std::memory_order_relaxed);
+    session->parkedFrames.fetch_add(slept, std::memory_order_relaxed);
+}
+
+void WorkStealingScheduler::Stop() {
+    if (stopping.exchange(true)) {
+        return;
+    }
+
+    clock.join();
+    Wake();
+    for (auto &worker : workers) {
+        worker->thread.join();
+    }
+    stopped = Clock::now();
+}
+
+const Chip8 &WorkStealingScheduler::Machine(uint32_t id) const {
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    return *sessions[id]->chip8;
+}
+
+std::vector<WorkerReport> WorkStealingScheduler::Workers() const {
+    Clock::time_point end = stopping ? stopped : Clock::now();
+    double elapsed = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+
+    std::vector<WorkerReport> reports;
+    for (const auto &worker : workers) {
+        reports.push_back(WorkerReport{worker->frames.load(std::memory_order_relaxed),
+                                       worker->steals.load(std::memory_order_relaxed),
+                                       static_cast<double>(worker->busyNs.load(std::memory_order_relaxed)) / elapsed});
+    }
+    return reports;
+}
+
+std::vector<SessionReport> WorkStealingScheduler::Sessions() const {
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+
+    std::vector<SessionReport> reports;
+    for (const auto &session : sessions) {
+        bool parked;
+        {
+            std::lock_guard<std::mutex> sessionLock(session->mutex);
+            parked = session->parked;
+        }
+
+        const Histogram &latency = session->latency;
+        reports.push_back(SessionReport{session->kind, session->ended.load(), parked,
+                                        session->frames.load(std::memory_order_relaxed),
+                                        session->parkedFrames.load(std::memory_order_relaxed),
+                                        session->missed.load(std::memory_order_relaxed),
+                                        session->dropped.load(std::memory_order_relaxed), latency.Percentile(0.5),
+                                        latency.Percentile(0.99), latency.Percentile(0.999), latency.Max()});
+    }
+    return reports;
+}
+
+void WorkStealingScheduler::MergeLatency(Histogram &total) const {
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    for (const auto &session : sessions) {
+        total.Add(session->latency);
+    }
+}
+
+Clock::time_point WorkStealingScheduler::TickTime(uint64_t tick) const {
+    return start + static_cast<Clock::duration::rep>(tick) * period;
+}
+
+void WorkStealingScheduler::Loop() {
+    for (uint64_t tick = 0; !stopping; ++tick) {
+        std::this_thread::sleep_until(TickTime(tick));
+
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        for (auto &entry : sessions) {
+            Session &session = *entry;
+            if (session.kind != SessionClass::RealTime || session.ended.load(std::memory_order_relaxed)) {
+                continue;
+            }
+
+            std::lock_guard<std::mutex> sessionLock(session.mutex);
+            if (session.parked) {
+                session.skippedThrough = tick;
+                continue;
+            }
+
+            if (session.owed == 0) {
+                session.oldestTick = tick;
+            }
+            if (++session.owed > options.maxBacklog) {
+                --session.owed;
+                ++session.oldestTick;
+                session.dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (!session.queued) {
+                session.queued = true;
+                Push(session.home, session);
+            }
+        }
+    }
+}
+
+void WorkStealingScheduler::Push(unsigned int index, Session &session) {
+    Worker &worker = *workers[index];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (session.kind == SessionClass::RealTime) {
+            worker.realTime.push_back(&session);
+            worker.realTimeSize.store(worker.realTime.size(), std::memory_order_relaxed);
+        }
+        else {
+            worker.batch.push_back(&session);
+            worker.batchSize.store(worker.batch.size(), std::memory_order_relaxed);
+        }
+    }
+
+    // A worker counts itself sleeping before it checks queued, so one of the two always sees the other
+    queued.fetch_add(1);
+    if (sleeping.load() > 0) {
+        Wake();
+    }
+}
+
+void WorkStealingScheduler::Wake() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_all();
+}
+
+WorkStealingScheduler::Session *WorkStealingScheduler::Pop(Worker &worker, SessionClass kind, bool back) {
+    bool realTime = kind == SessionClass::RealTime;
+    if ((realTime ? worker.realTimeSize : worker.batchSize).load(std::memory_order_relaxed) == 0) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    std::deque<Session *> &deque = realTime ? worker.realTime : worker.batch;
+    if (deque.empty()) {
+        return nullptr;
+    }
+
+    Session *session;
+    if (back) {
+        session = deque.back();
+        deque.pop_back();
+    }
+    else {
+        session = deque.front();
+        deque.pop_front();
+    }
+    (realTime ? worker.realTimeSize : worker.batchSize).store(deque.size(), std::memory_order_relaxed);
+    queued.fetch_sub(1);
+    return session;
+}
+
+WorkStealingScheduler::Session *WorkStealingScheduler::Take(unsigned int index, std::minstd_rand &random) {
+    auto count = static_cast<unsigned int>(workers.size());
+
+    for (SessionClass kind : {SessionClass::RealTime, SessionClass::Batch}) {
+        if (Session *session = Pop(*workers[index], kind, false)) {
+            return session;
+        }
+
+        // Start at a random victim so thieves don't all pile onto the same one
+        unsigned int first = static_cast<unsigned int>(random() % count);
+        for (unsigned int i = 0; i < count; ++i) {
+            unsigned int victim = (first + i) % count;
+            if (victim == index) {
+                continue;
+            }
+            if (Session *session = Pop(*workers[victim], kind, true)) {
+                workers[index]->steals.fetch_add(1, std::memory_order_relaxed);
+                return session;
+            }
+        }
+    }
+
+    return nullptr;
+}
+
+void WorkStealingScheduler::Work(unsigned int index) {
+    std::minstd_rand random(index + 1);
+
+    while (!stopping) {
+        if (Session *session = Take(index, random)) {
+            RunFrame(index, *session);
+            continue;
+        }
+
+        sleeping.fetch_add(1);
+        {
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this]() {
+                return queued.load() > 0 || stopping;
+            });
+        }
+        sleeping.fetch_sub(1);
+    }
+}
+
+void WorkStealingScheduler::RunFrame(unsigned int index, Session &session) {
+    Worker &worker = *workers[index];
+    Chip8 &chip8 = *session.chip8;
+    Clock::time_point began = Clock::now();
+
+    uint16_t keys = session.keys.load(std::memory_order_relaxed);
+    for (unsigned int key = 0; key < 16; ++key) {
+        chip8.keys[key] = (keys >> key) & 0x1u;
+    }
+
+    Chip8State before;
+    before.Capture(chip8);
+    before.ClearCounters();
+    chip8.dirtyPages = 0;
+    chip8.displayDirty = false;
+
+    chip8.RunFrame(session.cyclesPerFrame, session.verified);
+
+    Clock::time_point finished = Clock::now();
+    session.frames.fetch_add(1, std::memory_order_relaxed);
+    worker.frames.fetch_add(1, std::memory_order_relaxed);
+    worker.busyNs.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            finished - began).count()), std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(session.mutex);
+    session.home = index;
+
+    if (session.kind == SessionClass::RealTime) {
+        auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(finished - TickTime(session.oldestTick));
+        session.latency.Record(static_cast<uint64_t>(std::max<int64_t>(0, latency.count())));
+        if (latency > period) {
+            session.missed.fetch_add(1, std::memory_order_relaxed);
+        }
+        ++session.oldestTick;
+        --session.owed;
+    }
+
+    if (chip8.halted || chip8.trap != Trap::None) {
+        session.ended = true;
+        session.queued = false;
+        return;
+    }
+
+    // Keys changed during the frame wake the session anyway, so it only parks if they haven't
+    if (session.keys.load(std::memory_order_relaxed) == keys && Blocked(chip8, before, keys)) {
+        // Frames already released would only have repeated this one, so they are slept through too
+        session.parked = true;
+        session.queued = false;
+        session.sleepFrom = session.oldestTick;
+        session.skippedThrough = session.oldestTick + session.owed - 1;
+        session.owed = 0;
+        return;
+    }
+
+    if (session.kind == SessionClass::Batch || session.owed > 0) {
+        Push(index, session);
+    }
+    else {
+        session.queued = false;
+    }
+}
@@ -0,0 +1,190 @@
+#ifndef WORKSTEALINGSCHEDULER_H
+#define WORKSTEALINGSCHEDULER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "Chip8.h"
+#include "Histogram.h"
+
+struct WorkStealingOptions {
+    // Frames a second real-time sessions are released at
+    unsigned int rate = 60;
+    // Worker threads; 0 for one per core
+    unsigned int workers = 0;
+    // Frames a real-time session may owe before the oldest are dropped, slowing it down instead
+    unsigned int maxBacklog = 4;
+};
+
+enum class SessionClass {
+    // Released a frame every tick, each due by the next; always run before batch work
+    RealTime,
+    // Runs frames back to back on whatever time the real-time sessions leave over
+    Batch
+};
+
+struct WorkerReport {
+    uint64_t frames;
+    uint64_t steals;
+    // Fraction of the time since the scheduler started spent running frames
+    double utilization;
+};
+
+struct SessionReport {
+    SessionClass kind;
+    bool ended;
+    bool parked;
+    uint64_t frames;
+    // Frames slept through parked, included in frames
+    uint64_t parkedFrames;
+    // Real-time frames finished after their deadline, and those dropped for exceeding the backlog
+    uint64_t missed;
+    uint64_t dropped;
+    // Real-time frames: nanoseconds from the tick releasing them until they finished
+    uint64_t latencyP50;
+    uint64_t latencyP99;
+    uint64_t latencyP999;
+    uint64_t latencyMax;
+};
+
+/**
+ * Runs thousands of sessions on a fixed set of worker threads, a frame at a time.
+ *
+ * Every worker has a deque of real-time sessions and one of batch sessions. A worker takes from the front of its own
+ * deques, real-time first, and when they are empty steals from the back of another worker's, again real-time first,
+ * so batch work only runs when no real-time frame is waiting anywhere. A session runs one frame per turn, then goes
+ * back on the deque of the worker that ran it while it has frames left, keeping its machine in that core's cache.
+ * The clock thread releases a frame of every real-time session each tick onto the worker that last ran it; all of
+ * them are due by the next tick, so first in first out is earliest deadline first.
+ *
+ * A session that can only repeat itself is parked: it leaves the deques until SetKeys() changes its keys. That is
+ * one waiting in Fx0A with no key held, or one whose last frame changed nothing at all - no memory or display
+ * writes, the registers, stack and random generator where they were and the timers stopped. A parked real-time
+ * session catches up the cycles and timer ticks of the frames it slept through when it wakes, so its machine ends
+ * up exactly as if it had spun. The scheduler clears each machine's dirty page and display flags every frame.
+ */
+class WorkStealingScheduler {
+public:
+    explicit WorkStealingScheduler(const WorkStealingOptions &options);
+
+    ~WorkStealingScheduler();
+
+    WorkStealingScheduler(const WorkStealingScheduler &) = delete;
+
+    WorkStealingScheduler &operator=(const WorkStealingScheduler &) = delete;
+
+    /**
+     * Start running a session, returning its id for SetKeys(), Machine() and Sessions(); ids count up from 0.
+     */
+    uint32_t Add(std::unique_ptr<Chip8> chip8, bool verified, unsigned int cyclesPerFrame, SessionClass kind);
+
+    /**
+     * Change the keys held from the session's next frame, waking it if parked. Any thread may call this.
+     */
+    void SetKeys(uint32_t id, uint16_t keys);
+
+    /**
+     * Stop the clock and the workers, after which the sessions' machines may be looked at.
+     */
+    void Stop();
+
+    const Chip8 &Machine(uint32_t id) const;
+
+    std::vector<WorkerReport> Workers() const;
+
+    std::vector<SessionReport> Sessions() const;
+
+    /**
+     * Add the frame latencies of every real-time session into total.
+     */
+    void MergeLatency(Histogram &total) const;
+
+private:
+    struct Session {
+        uint32_t id;
+        SessionClass kind;
+        std::unique_ptr<Chip8> chip8;
+        bool verified;
+        unsigned int cyclesPerFrame;
+        // Keys are also read without the lock at the start of each frame
+        std::atomic<uint16_t> keys{0};
+
+        // The rest of the scheduling state is guarded by mutex
+        std::mutex mutex;
+        // On a deque or being run
+        bool queued = false;
+        bool parked = false;
+        unsigned int home = 0;
+        // Real-time frames released and not yet run, the oldest released by tick oldestTick
+        unsigned int owed = 0;
+        uint64_t oldestTick = 0;
+        // While parked: the first tick slept through and the last the clock has passed it by
+        uint64_t sleepFrom = 0;
+        uint64_t skippedThrough = 0;
+
+        std::atomic<bool> ended{false};
+        std::atomic<uint64_t> frames{0};
+        std::atomic<uint64_t> parkedFrames{0};
+        std::atomic<uint64_t> missed{0};
+        std::atomic<uint64_t> dropped{0};
+        Histogram latency;
+    };
+
+    struct alignas(64) Worker {
+        std::mutex mutex;
+        std::deque<Session *> realTime;
+        std::deque<Session *> batch;
+        // Sizes of the deques, for thieves to skip empty ones without taking the lock
+        std::atomic<size_t> realTimeSize{0};
+        std::atomic<size_t> batchSize{0};
+        std::atomic<uint64_t> frames{0};
+        std::atomic<uint64_t> steals{0};
+        std::atomic<uint64_t> busyNs{0};
+        std::thread thread;
+    };
+
+    // The clock thread: releases a frame of every real-time session each tick
+    void Loop();
+
+    void Work(unsigned int index);
+
+    Session *Take(unsigned int index, std::minstd_rand &random);
+
+    // Take a session off the front of the worker's deque of that kind, or the back for a thief
+    Session *Pop(Worker &worker, SessionClass kind, bool back);
+
+    void Push(unsigned int index, Session &session);
+
+    void Wake();
+
+    void RunFrame(unsigned int index, Session &session);
+
+    std::chrono::steady_clock::time_point TickTime(uint64_t tick) const;
+
+    WorkStealingOptions options;
+    std::chrono::steady_clock::duration period;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point stopped;
+
+    mutable std::mutex sessionsMutex;
+    std::vector<std::unique_ptr<Session>> sessions;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    // Sessions on any deque; workers sleep while there are none
+    std::atomic<size_t> queued{0};
+    std::atomic<unsigned int> sleeping{0};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+
+    std::atomic<bool> stopping{false};
+    std::thread clock;
+};
+
+#endif //WORKSTEALINGSCHEDULER_H
@@ -0,0 +1,186 @@
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "Analyzer.h"
+#include "ThreadPool.h"
+
+struct Options {
+    std::vector<const char *> roms;
+    const char *dot = nullptr;
+    const char *json = nullptr;
+    const char *out = nullptr;
+    unsigned int threads = 0;
+};
+
+static void Usage(const char *program) {
+    std::cerr << "Usage: " << program << " [options] <ROM>...\n"
+              << "  --dot FILE     write the control-flow graph of one ROM for Graphviz\n"
+              << "  --json FILE    write the analysis of one ROM as JSON\n"
+              << "  --out DIR      analyse every ROM into DIR/<hash>.json and DIR/<hash>.dot, skipping ROMs whose\n"
+              << "                 analysis is already there\n"
+              << "  --threads N    worker threads for several ROMs (default: one per core)\n"
+              << "With one ROM and no output files the disassembly is printed; with several, one summary line each.\n";
+}
+
+static bool ParseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--dot") == 0 && i + 1 < argc) {
+            options.dot = argv[++i];
+        }
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            options.json = argv[++i];
+        }
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            options.out = argv[++i];
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.threads = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (argv[i][0] != '-') {
+            options.roms.push_back(argv[i]);
+        }
+        else {
+            return false;
+        }
+    }
+
+    bool single = options.dot != nullptr || options.json != nullptr;
+    return !options.roms.empty() && (!single || options.roms.size() == 1);
+}
+
+static bool ReadFile(const char *path, std::vector<uint8_t> &bytes) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+/**
+ * Write to a temporary name and rename it into place, so a reader - or another worker writing the same analysis for a
+ * duplicate ROM - never sees a half-written file.
+ */
+static bool WriteFile(const std::string &path, const std::string &contents) {
+    static std::atomic<unsigned int> serial{0};
+    std::string temporary = path + ".tmp" + std::to_string(getpid()) + "." + std::to_string(serial++);
+
+    FILE *file = fopen(temporary.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    bool written = fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+    if (fclose(file) != 0 || !written || rename(temporary.c_str(), path.c_str()) != 0) {
+        remove(temporary.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+static std::string Summary(const char *path, const Analysis &analysis) {
+    size_t dataBytes = 0;
+    for (const DataRegion &region : analysis.data) {
+        dataBytes += region.end - region.start;
+    }
+
+    char line[128];
+    snprintf(line, sizeof(line), "%016llx  size %5zu  blocks %4zu  subs %3zu  depth %2d  data %5zu  indirect %zu  ",
+             static_cast<unsigned long long>(analysis.hash), analysis.romSize, analysis.blocks.size(),
+             analysis.subroutines.size(), analysis.maxCallDepth, dataBytes, analysis.indirectJumps.size());
+
+    return line + std::string(path);
+}
+
+int main(int argc, char **argv) {
+    Options options;
+
+    if (!ParseOptions(argc, argv, options)) {
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (options.roms.size() == 1 && options.out == nullptr) {
+        std::vector<uint8_t> rom;
+        if (!ReadFile(options.roms[0], rom)) {
+            std::cerr << "Could not open ROM " << options.roms[0] << "\n";
+            return EXIT_FAILURE;
+        }
+
+        Analysis analysis = Analyze(rom.data(), rom.size());
+
+        if (options.dot != nullptr && !WriteFile(options.dot, ToDot(analysis))) {
+            std::cerr << "Could not write " << options.dot << "\n";
+            return EXIT_FAILURE;
+        }
+
+        if (options.json != nullptr && !WriteFile(options.json, ToJson(analysis))) {
+            std::cerr << "Could not write " << options.json << "\n";
+            return EXIT_FAILURE;
+        }
+
+        if (options.dot == nullptr && options.json == nullptr) {
+            std::cout << ToListing(analysis, rom.data());
+        }
+        std::cerr << Summary(options.roms[0], analysis) << "\n";
+
+        return EXIT_SUCCESS;
+    }
+
+    // A corpus: ROMs are independent, so spread them over the cores. Identical ROMs are analysed once.
+    AnalysisCache cache;
+    std::vector<std::string> lines(options.roms.size());
+    std::atomic<unsigned int> failures{0};
+
+    auto analyzeOne = [&](unsigned int i) {
+        std::vector<uint8_t> rom;
+        if (!ReadFile(options.roms[i], rom)) {
+            lines[i] = std::string("could not open ") + options.roms[i];
+            ++failures;
+            return;
+        }
+
+        if (options.out != nullptr) {
+            char name[32];
+            snprintf(name, sizeof(name), "/%016llx", static_cast<unsigned long long>(HashRom(rom.data(), rom.size())));
+            std::string base = options.out + std::string(name);
+
+            if (access((base + ".json").c_str(), F_OK) == 0) {
+                lines[i] = std::string(name + 1) + "  cached  " + options.roms[i];
+                return;
+            }
+
+            std::shared_ptr<const Analysis> analysis = cache.Get(rom.data(), rom.size());
+            // Write the JSON last: its presence is what marks the ROM as done
+            if (!WriteFile(base + ".dot", ToDot(*analysis)) || !WriteFile(base + ".json", ToJson(*analysis))) {
+                lines[i] = std::string("could not write ") + base;
+                ++failures;
+                return;
+            }
+            lines[i] = Summary(options.roms[i], *analysis);
+            return;
+        }
+
+        lines[i] = Summary(options.roms[i], *cache.Get(rom.data(), rom.size()));
+    };
+
+    auto count = static_cast<unsigned int>(options.roms.size());
+    std::unique_ptr<ThreadPool> pool = ThreadPool::ForThreads(options.threads);
+    ParallelFor(pool.get(), count, analyzeOne);
+
+    for (const std::string &line : lines) {
+        std::cout << line << "\n";
+    }
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
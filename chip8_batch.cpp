@@ -0,0 +1,69 @@
+#include "chip8_batch.h"
+#include <exception>
+#include "Analyzer.h"
+#include "BatchEnvironment.h"
+
+// The C handle is the environment itself
+struct chip8_batch : BatchEnvironment {
+    using BatchEnvironment::BatchEnvironment;
+};
+
+void chip8_batch_default_config(chip8_batch_config *config) {
+    BatchConfig defaults;
+
+    config->cycles_per_frame = defaults.cyclesPerFrame;
+    config->reward_address = defaults.rewardAddress;
+    config->reward_bytes = defaults.rewardBytes;
+    config->done_address = defaults.doneAddress;
+    config->done_value = defaults.doneValue;
+    config->max_frames = defaults.maxFrames;
+    config->observation = CHIP8_OBSERVATION_PACKED;
+    config->seed = defaults.seed;
+    config->threads = defaults.threads;
+}
+
+chip8_batch *chip8_batch_create(const uint8_t *rom, size_t size, unsigned int count,
+                                const chip8_batch_config *config) {
+    if (count == 0 || size > MEMORY_SIZE - ROM_START || config->cycles_per_frame == 0 ||
+        (config->reward_bytes != 1 && config->reward_bytes != 2) ||
+        (config->observation != CHIP8_OBSERVATION_PACKED && config->observation != CHIP8_OBSERVATION_DOWNSAMPLED)) {
+        return nullptr;
+    }
+
+    BatchConfig batchConfig;
+    batchConfig.cyclesPerFrame = config->cycles_per_frame;
+    batchConfig.rewardAddress = config->reward_address;
+    batchConfig.rewardBytes = config->reward_bytes;
+    batchConfig.doneAddress = config->done_address;
+    batchConfig.doneValue = config->done_value;
+    batchConfig.maxFrames = config->max_frames;
+    batchConfig.observation = config->observation == CHIP8_OBSERVATION_PACKED ? Observation::Packed
+                                                                              : Observation::Downsampled;
+    batchConfig.seed = config->seed;
+    batchConfig.threads = config->threads;
+
+    // Exceptions (running out of memory for a big batch) must not cross the C boundary
+    try {
+        return new chip8_batch(rom, size, count, batchConfig);
+    }
+    catch (const std::exception &) {
+        return nullptr;
+    }
+}
+
+void chip8_batch_destroy(chip8_batch *batch) {
+    delete batch;
+}
+
+size_t chip8_batch_observation_size(const chip8_batch *batch) {
+    return batch->ObservationSize();
+}
+
+void chip8_batch_reset(chip8_batch *batch, uint8_t *observations) {
+    batch->Reset(observations);
+}
+
+void chip8_batch_step(chip8_batch *batch, const uint16_t *actions, uint8_t *observations, float *rewards,
+                      uint8_t *dones) {
+    batch->Step(actions, observations, rewards, dones);
+}
@@ -0,0 +1,63 @@
+/*
+ * C interface to BatchEnvironment, for loading from Python (ctypes, cffi) or anything else that speaks the C ABI.
+ *
+ * All arrays are owned by the caller and written in place: observations is count * chip8_batch_observation_size()
+ * bytes, one row per environment; rewards and dones have one entry per environment. See BatchEnvironment.h for
+ * what a step does.
+ */
+#ifndef CHIP8_BATCH_H
+#define CHIP8_BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define CHIP8_BATCH_API __attribute__((visibility("default")))
+#else
+#define CHIP8_BATCH_API
+#endif
+
+enum {
+    CHIP8_OBSERVATION_PACKED = 0,
+    CHIP8_OBSERVATION_DOWNSAMPLED = 1
+};
+
+typedef struct chip8_batch_config {
+    unsigned int cycles_per_frame;
+    int32_t reward_address;
+    unsigned int reward_bytes;
+    int32_t done_address;
+    uint8_t done_value;
+    uint64_t max_frames;
+    int observation;
+    uint64_t seed;
+    unsigned int threads;
+} chip8_batch_config;
+
+typedef struct chip8_batch chip8_batch;
+
+/* Fill in the defaults: 11 cycles a frame, no reward or done address, packed observations, one thread per core. */
+CHIP8_BATCH_API void chip8_batch_default_config(chip8_batch_config *config);
+
+/* Returns NULL if count is 0, the ROM doesn't fit in memory or the configuration makes no sense. The ROM is copied. */
+CHIP8_BATCH_API chip8_batch *chip8_batch_create(const uint8_t *rom, size_t size, unsigned int count,
+                                                const chip8_batch_config *config);
+
+CHIP8_BATCH_API void chip8_batch_destroy(chip8_batch *batch);
+
+CHIP8_BATCH_API size_t chip8_batch_observation_size(const chip8_batch *batch);
+
+CHIP8_BATCH_API void chip8_batch_reset(chip8_batch *batch, uint8_t *observations);
+
+CHIP8_BATCH_API void chip8_batch_step(chip8_batch *batch, const uint16_t *actions, uint8_t *observations,
+                                      float *rewards, uint8_t *dones);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CHIP8_BATCH_H */
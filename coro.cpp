@@ -0,0 +1,335 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+#include "Analyzer.h"
+#include "CoSession.h"
+#include "Executor.h"
+#include "Task.h"
+#include "Verifier.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    const char *rom = nullptr;
+    unsigned int sessions = 1000;
+    uint64_t frames = 600;
+    unsigned int cyclesPerFrame = 11;
+    uint32_t seed = 1;
+    bool realtime = false;
+    bool check = false;
+    bool checked = false;
+};
+
+/**
+ * What one session's bot did, and with --check the keys it held from each frame on.
+ */
+struct BotLog {
+    uint64_t presses = 0;
+    uint64_t keyEvents = 0;
+    uint64_t cycleWaits = 0;
+    std::vector<std::pair<uint64_t, uint16_t>> keys;
+};
+
+static void Usage(const char *program) {
+    std::cerr << "Usage: " << program << " [options] <ROM>\n"
+              << "  --sessions N   sessions to run side by side (default 1000)\n"
+              << "  --frames N     frames to run them for (default 600)\n"
+              << "  --cycles N     instructions per frame (default 11)\n"
+              << "  --seed N       seed for the bots and the machines (default 1)\n"
+              << "  --realtime     pace the frames at 60 a second instead of running flat out\n"
+              << "  --check        rerun every session in a plain frame loop and compare the machines, and check that\n"
+              << "                 cancelling a task frees the tasks it awaits\n"
+              << "  --checked      always run with stack and key checks\n";
+}
+
+static bool ParseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--sessions") == 0 && i + 1 < argc) {
+            options.sessions = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            options.frames = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+            options.cyclesPerFrame = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            options.seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--realtime") == 0) {
+            options.realtime = true;
+        }
+        else if (strcmp(argv[i], "--check") == 0) {
+            options.check = true;
+        }
+        else if (strcmp(argv[i], "--checked") == 0) {
+            options.checked = true;
+        }
+        else if (argv[i][0] == '-') {
+            return false;
+        }
+        else {
+            options.rom = argv[i];
+        }
+    }
+
+    return options.rom != nullptr && options.sessions > 0 && options.cyclesPerFrame > 0;
+}
+
+/**
+ * Play a session with random keys. Keys only change right after a frame, so --check can replay them: the frame
+ * they apply from is the next one the session runs, or when it is parked, the next tick of the clock.
+ */
+static Task Bot(Executor &executor, CoSession &session, uint32_t seed, unsigned int cyclesPerFrame, BotLog &log,
+                bool record) {
+    std::minstd_rand random(seed);
+    unsigned int held = 0;
+    unsigned int holdFrames = 0;
+
+    while (!session.Ended()) {
+        // Now and then stop the machine part way into a frame to look at it
+        if (random() % 8 == 0) {
+            co_await session.Cycles(1 + random() % (3 * cyclesPerFrame));
+            ++log.cycleWaits;
+        }
+        co_await session.VBlank();
+        if (session.Ended()) {
+            break;
+        }
+
+        uint16_t keys = session.Keys();
+        if (holdFrames > 0) {
+            if (--holdFrames == 0) {
+                keys &= static_cast<uint16_t>(~(1u << held));
+            }
+        }
+        else if (random() % (session.WaitingForKey() ? 16 : 64) == 0) {
+            held = random() % 16;
+            holdFrames = 1 + random() % 6;
+            keys |= static_cast<uint16_t>(1u << held);
+            ++log.presses;
+        }
+
+        if (keys != session.Keys()) {
+            if (record) {
+                log.keys.emplace_back(std::max(session.Frames(), executor.Frame()), keys);
+            }
+            session.SetKeys(keys);
+        }
+    }
+}
+
+/**
+ * Count the session's key events until it ends, costing nothing but a coroutine frame in between.
+ */
+static Task Listen(CoSession &session, BotLog &log) {
+    for (;;) {
+        KeyEvent event = co_await session.NextKeyEvent();
+        if (event.key == KEY_EVENT_ENDED) {
+            break;
+        }
+        ++log.keyEvents;
+    }
+}
+
+/**
+ * Count clock ticks forever, yielding to everything else after each one.
+ */
+static Task Tick(Executor &executor, uint64_t &ticks) {
+    for (;;) {
+        co_await executor.NextFrame();
+        ++ticks;
+        co_await executor.Yield();
+    }
+}
+
+static Task Nest(Executor &executor, uint64_t &ticks, unsigned int depth) {
+    if (depth == 0) {
+        co_await Tick(executor, ticks);
+    }
+    else {
+        co_await Nest(executor, ticks, depth - 1);
+    }
+}
+
+static Task CancelAfter(Executor &executor, std::coroutine_handle<> &target, uint64_t frames, const uint64_t &ticks,
+                        uint64_t &atCancel) {
+    for (uint64_t i = 0; i < frames; ++i) {
+        co_await executor.NextFrame();
+    }
+    atCancel = ticks;
+    executor.Cancel(target);
+}
+
+/**
+ * Cancel a spawned task while a task it awaits two levels down is queued: on the clock from outside Run(), and ready
+ * to run from inside it. Either way the inner task must be taken off the queue, never run again and be freed.
+ */
+static bool CheckNestedCancel() {
+    size_t framesBefore = Task::LiveFrames();
+    bool good = true;
+
+    {
+        Executor executor;
+        uint64_t ticks = 0;
+        std::coroutine_handle<> outer = executor.Spawn(Nest(executor, ticks, 2));
+        executor.Run(3);
+        executor.Cancel(outer);
+        uint64_t atCancel = ticks;
+        executor.Run(3);
+        good = good && ticks > 0 && ticks == atCancel && executor.Tasks() == 0;
+    }
+
+    {
+        Executor executor;
+        uint64_t ticks = 0;
+        std::coroutine_handle<> outer = executor.Spawn(Nest(executor, ticks, 2));
+        // Each tick moves both tasks to the ready queue, so the inner task is queued when this cancels
+        uint64_t atCancel = 0;
+        executor.Spawn(CancelAfter(executor, outer, 4, ticks, atCancel));
+        executor.Run(8);
+        good = good && atCancel > 0 && ticks == atCancel && executor.Tasks() == 0;
+    }
+
+    return good && Task::LiveFrames() == framesBefore;
+}
+
+static std::unique_ptr<Chip8> Boot(const std::vector<uint8_t> &rom, uint32_t seed) {
+    auto chip8 = std::make_unique<Chip8>();
+    chip8->LoadROM(rom.data(), rom.size());
+    chip8->randGen.seed(seed);
+    return chip8;
+}
+
+static bool SameMachine(const Chip8 &a, const Chip8 &b) {
+    return memcmp(a.registers, b.registers, sizeof(a.registers)) == 0 && a.index == b.index && a.pc == b.pc &&
+           memcmp(a.stack, b.stack, sizeof(a.stack)) == 0 && a.sp == b.sp && a.delayTimer == b.delayTimer &&
+           a.soundTimer == b.soundTimer && a.hires == b.hires && a.halted == b.halted && a.trap == b.trap &&
+           a.cycles == b.cycles && a.randGen == b.randGen && memcmp(a.display, b.display, sizeof(a.display)) == 0 &&
+           memcmp(a.memory, b.memory, sizeof(a.memory)) == 0;
+}
+
+/**
+ * Run the session's frames again the plain way, with the keys its bot held, and compare where the machines end up.
+ */
+static bool Replay(const std::vector<uint8_t> &rom, uint32_t seed, bool verified, unsigned int cyclesPerFrame,
+                   const CoSession &session, const BotLog &log) {
+    std::unique_ptr<Chip8> chip8 = Boot(rom, seed);
+    uint16_t keys = 0;
+    size_t next = 0;
+
+    for (uint64_t frame = 0; frame < session.Frames(); ++frame) {
+        while (next < log.keys.size() && log.keys[next].first <= frame) {
+            keys = log.keys[next++].second;
+        }
+        for (unsigned int key = 0; key < 16; ++key) {
+            chip8->keys[key] = (keys >> key) & 0x1u;
+        }
+        for (unsigned int i = 0; i < cyclesPerFrame && !chip8->halted && chip8->trap == Trap::None; ++i) {
+            if (verified) {
+                chip8->CycleUnchecked();
+            }
+            else {
+                chip8->Cycle();
+            }
+        }
+        chip8->TickTimers();
+    }
+
+    return SameMachine(*chip8, session.Machine());
+}
+
+int main(int argc, char **argv) {
+    Options options;
+
+    if (!ParseOptions(argc, argv, options)) {
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::ifstream file(options.rom, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Could not open " << options.rom << "\n";
+        return EXIT_FAILURE;
+    }
+    std::vector<uint8_t> rom((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    bool verified = false;
+    if (!options.checked) {
+        std::unique_ptr<Chip8> probe = Boot(rom, 0);
+        verified = Verify(Analyze(probe->memory + ROM_START, MEMORY_SIZE - ROM_START)).safe;
+    }
+
+    // Declared first so it outlives the sessions, which cancel their coroutines on it
+    Executor executor(options.realtime ? 60 : 0);
+    std::vector<std::unique_ptr<CoSession>> sessions;
+    std::vector<BotLog> logs(options.sessions);
+
+    size_t bytesBefore = Task::LiveBytes();
+    for (unsigned int i = 0; i < options.sessions; ++i) {
+        uint32_t seed = options.seed + i;
+        sessions.push_back(std::make_unique<CoSession>(executor, Boot(rom, seed), verified, options.cyclesPerFrame));
+        executor.Spawn(Bot(executor, *sessions.back(), seed, options.cyclesPerFrame, logs[i], options.check));
+        executor.Spawn(Listen(*sessions.back(), logs[i]));
+    }
+    size_t frames = Task::LiveFrames();
+    size_t bytes = Task::LiveBytes() - bytesBefore;
+
+    auto start = Clock::now();
+    executor.Run(options.frames);
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    uint64_t sessionFrames = 0;
+    uint64_t parkedFrames = 0;
+    uint64_t instructions = 0;
+    uint64_t waiting = 0;
+    uint64_t ended = 0;
+    BotLog total;
+    for (unsigned int i = 0; i < options.sessions; ++i) {
+        sessionFrames += sessions[i]->Frames();
+        parkedFrames += sessions[i]->ParkedFrames();
+        instructions += sessions[i]->Machine().cycles;
+        waiting += sessions[i]->WaitingForKey();
+        ended += sessions[i]->Ended();
+        total.presses += logs[i].presses;
+        total.keyEvents += logs[i].keyEvents;
+        total.cycleWaits += logs[i].cycleWaits;
+    }
+
+    printf("%u sessions (%s), %llu frames in %.3fs: %.0f session frames/s\n", options.sessions,
+           verified ? "verified" : "checked", static_cast<unsigned long long>(executor.Frame()), seconds,
+           static_cast<double>(sessionFrames) / seconds);
+    printf("%llu instructions, %.1f%% of frames parked in Fx0A, %llu waiting for a key and %llu ended at the end\n",
+           static_cast<unsigned long long>(instructions),
+           sessionFrames > 0 ? 100.0 * static_cast<double>(parkedFrames) / static_cast<double>(sessionFrames) : 0.0,
+           static_cast<unsigned long long>(waiting), static_cast<unsigned long long>(ended));
+    printf("%llu key presses, %llu key events heard, %llu mid-frame stops\n",
+           static_cast<unsigned long long>(total.presses), static_cast<unsigned long long>(total.keyEvents),
+           static_cast<unsigned long long>(total.cycleWaits));
+    printf("%zu coroutine frames, %zu bytes: %zu bytes a session besides its %zu byte machine\n", frames, bytes,
+           bytes / options.sessions, sizeof(Chip8));
+
+    if (options.check) {
+        bool cancelled = CheckNestedCancel();
+        printf("cancelling a task awaiting nested tasks %s\n", cancelled ? "frees them all" : "FAILED");
+
+        unsigned int mismatches = 0;
+        for (unsigned int i = 0; i < options.sessions; ++i) {
+            if (!Replay(rom, options.seed + i, verified, options.cyclesPerFrame, *sessions[i], logs[i])) {
+                ++mismatches;
+            }
+        }
+        printf("%u of %u sessions differ from a plain replay\n", mismatches, options.sessions);
+        return mismatches == 0 && cancelled ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
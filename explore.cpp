@@ -0,0 +1,159 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <vector>
+#include "Analyzer.h"
+#include "Chip8.h"
+#include "Explorer.h"
+#include "Verifier.h"
+
+struct Options {
+    const char *rom = nullptr;
+    const char *keysOut = nullptr;
+    ExploreOptions explore;
+    uint32_t seed = 1;
+    bool checked = false;
+};
+
+static void Usage(const char *program) {
+    std::cerr << "Usage: " << program << " [options] <ROM>\n"
+              << "  --step N          frames each input is held for before branching again (default 8)\n"
+              << "  --cycles N        instructions per frame (default 11)\n"
+              << "  --states N        stop after N distinct states (default 1000000)\n"
+              << "  --seconds N       stop after N seconds\n"
+              << "  --per-cell N      states expanded per cell (default 32)\n"
+              << "  --cell ADDR[:N]   also tell cells apart by N bytes of memory at ADDR, e.g. a level counter\n"
+              << "  --goal ADDR=V     stop once the byte at ADDR equals V\n"
+              << "  --keys-out FILE   write the keys leading to the goal or the deepest state, as big-endian 16 bit\n"
+              << "                    masks a frame\n"
+              << "  --seed N          random number seed (default 1)\n"
+              << "  --checked         keep the stack and key checks even for verified ROMs\n"
+              << "  --threads N       worker threads (default: one per core)\n"
+              << "Addresses and values may be given in hex with 0x.\n";
+}
+
+static bool ParseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        char *end = nullptr;
+
+        if (strcmp(argv[i], "--step") == 0 && i + 1 < argc) {
+            options.explore.framesPerStep = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+            options.explore.cyclesPerFrame = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--states") == 0 && i + 1 < argc) {
+            options.explore.maxStates = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            options.explore.seconds = std::strtod(argv[++i], nullptr);
+        }
+        else if (strcmp(argv[i], "--per-cell") == 0 && i + 1 < argc) {
+            options.explore.statesPerCell = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--cell") == 0 && i + 1 < argc) {
+            options.explore.cellAddress = static_cast<int32_t>(std::strtoul(argv[++i], &end, 0) & 0xFFFFu);
+            if (*end == ':') {
+                options.explore.cellBytes = std::strtoul(end + 1, &end, 0);
+            }
+            if (*end != '\0') {
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--goal") == 0 && i + 1 < argc) {
+            options.explore.goalAddress = static_cast<int32_t>(std::strtoul(argv[++i], &end, 0) & 0xFFFFu);
+            if (*end != '=') {
+                return false;
+            }
+            options.explore.goalValue = static_cast<uint8_t>(std::strtoul(end + 1, nullptr, 0));
+        }
+        else if (strcmp(argv[i], "--keys-out") == 0 && i + 1 < argc) {
+            options.keysOut = argv[++i];
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            options.seed = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--checked") == 0) {
+            options.checked = true;
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.explore.threads = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (argv[i][0] != '-' && options.rom == nullptr) {
+            options.rom = argv[i];
+        }
+        else {
+            return false;
+        }
+    }
+
+    return options.rom != nullptr && options.explore.framesPerStep > 0 && options.explore.cyclesPerFrame > 0 &&
+           options.explore.maxStates > 0 && options.explore.statesPerCell > 0;
+}
+
+static bool WriteKeys(const char *path, const std::vector<uint16_t> &keys) {
+    std::string temporary = std::string(path) + ".tmp";
+
+    FILE *file = fopen(temporary.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    std::vector<uint8_t> bytes;
+    for (uint16_t mask : keys) {
+        bytes.push_back(static_cast<uint8_t>(mask >> 8u));
+        bytes.push_back(static_cast<uint8_t>(mask));
+    }
+
+    bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    if (fclose(file) != 0 || !written || rename(temporary.c_str(), path) != 0) {
+        remove(temporary.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv) {
+    Options options;
+
+    if (!ParseOptions(argc, argv, options)) {
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::ifstream file(options.rom, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Could not open " << options.rom << "\n";
+        return EXIT_FAILURE;
+    }
+    std::vector<uint8_t> rom((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    auto start = std::make_unique<Chip8>();
+    start->LoadROM(rom.data(), rom.size());
+    start->randGen.seed(options.seed);
+
+    options.explore.unchecked = !options.checked && Verify(Analyze(rom.data(), rom.size())).safe;
+
+    ExploreResult result = Explore(*start, options.explore);
+
+    std::cout << result.states << " states (" << result.duplicates << " duplicate branches) in " << result.cells
+              << " cells, " << result.expanded << " expanded, " << result.terminal << " halted or trapped\n";
+    printf("%llu frames in %.2f s: %.0f states/s, %.0f frames/s\n",
+           static_cast<unsigned long long>(result.frames), result.seconds,
+           result.seconds > 0 ? static_cast<double>(result.states) / result.seconds : 0.0,
+           result.seconds > 0 ? static_cast<double>(result.frames) / result.seconds : 0.0);
+    std::cout << (result.reachedGoal ? "goal reached after " : "deepest state after ") << result.keys.size()
+              << " frames\n";
+
+    if (options.keysOut != nullptr && !WriteKeys(options.keysOut, result.keys)) {
+        std::cerr << "Could not write " << options.keysOut << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return options.explore.goalAddress < 0 || result.reachedGoal ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,247 @@
+/**
+ * Coverage-guided fuzzing harness.
+ *
+ * An input is a key script followed by a ROM image:
+ *
+ *   byte 0           number of frames in the key script, 0 for none
+ *   2 bytes a frame  keys held during that frame, a big-endian mask with bit n for key n; the script repeats
+ *   the rest         the ROM, loaded at 0x200
+ *
+ * With CHIP8_FUZZ_ROM naming a ROM file, that ROM is fixed and the whole input is the key script, to fuzz a game's
+ * input handling rather than the core. Each input runs for a budget of CHIP8_FUZZ_CYCLES instructions (default
+ * 2000) at 11 a frame on the checked core, stopping early on a trap, on 00FD, or on reaching empty memory (0000).
+ *
+ * Coverage is of the emulated program, not just of the emulator: each (previous pc, pc) edge bumps a counter in a
+ * 64KiB table that libFuzzer picks up as extra counters, so inputs reaching new ROM paths count as progress even when
+ * they exercise the same handlers. The machine is reset between inputs by copying a pristine snapshot over it.
+ *
+ * With CHIP8_FUZZ_VERIFIER set, every ROM the Verifier proves safe that then traps aborts the run, turning the fuzzer
+ * on the verifier's soundness.
+ *
+ * Built with Clang the target links libFuzzer. Elsewhere it gets a small driver instead: it replays the files and
+ * directories named on the command line, or with --random N runs N random inputs, and reports execs/s and edges.
+ */
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <vector>
+#include "Analyzer.h"
+#include "Chip8.h"
+#include "Verifier.h"
+
+#ifdef CHIP8_FUZZ_DRIVER
+#include <chrono>
+#include <dirent.h>
+#include <iostream>
+#include <random>
+#include <string>
+#include <sys/stat.h>
+#endif
+
+// A reset is a plain copy of the whole machine
+static_assert(std::is_trivially_copyable<Chip8>::value, "Chip8 must be trivially copyable to snapshot it");
+
+const unsigned int COVERAGE_SIZE = 1u << 16u;
+const unsigned int FUZZ_CYCLES_PER_FRAME = 11;
+
+// libFuzzer treats anything in this section as coverage counters alongside its own instrumentation
+__attribute__((section("__libfuzzer_extra_counters"))) static uint8_t coverage[COVERAGE_SIZE];
+
+struct FuzzConfig {
+    std::vector<uint8_t> rom;
+    unsigned int cycles = 2000;
+    bool verifier = false;
+};
+
+static const FuzzConfig &Config() {
+    static const FuzzConfig config = [] {
+        FuzzConfig loaded;
+
+        if (const char *cycles = getenv("CHIP8_FUZZ_CYCLES")) {
+            loaded.cycles = std::strtoul(cycles, nullptr, 10);
+        }
+
+        if (const char *path = getenv("CHIP8_FUZZ_ROM")) {
+            std::ifstream file(path, std::ios::binary);
+            if (!file.is_open()) {
+                abort();
+            }
+            loaded.rom.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+
+        loaded.verifier = getenv("CHIP8_FUZZ_VERIFIER") != nullptr;
+        return loaded;
+    }();
+
+    return config;
+}
+
+/**
+ * Chip8::Run hook recording pc-to-pc edges, hashed the way AFL does it: the previous location is shifted so A->B and
+ * B->A land in different counters.
+ */
+struct EdgeCoverage {
+    uint16_t previous = 0;
+
+    bool Before(Chip8 &chip8) {
+        uint16_t pc = chip8.pc;
+        ++coverage[(pc ^ previous) & (COVERAGE_SIZE - 1)];
+        previous = pc >> 1u;
+        return false;
+    }
+
+    // 0000 does nothing on this core, so a program that has run off into empty memory would slide through all of
+    // it without reaching anything new; stop it there
+    static bool After(Chip8 &chip8) {
+        return chip8.trap != Trap::None || chip8.halted || chip8.opcode == 0x0000;
+    }
+};
+
+/**
+ * The state every input starts from: power on, with the RNG seeded so reruns of an input behave the same.
+ */
+static const Chip8 &Pristine() {
+    static const std::unique_ptr<Chip8> pristine = [] {
+        auto chip8 = std::make_unique<Chip8>();
+        chip8->randGen.seed(1);
+        return chip8;
+    }();
+
+    return *pristine;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    // A Chip8 is too big for the stack of a fuzzer's worker thread
+    static const std::unique_ptr<Chip8> machine = std::make_unique<Chip8>();
+    const FuzzConfig &config = Config();
+    Chip8 &chip8 = *machine;
+
+    memcpy(static_cast<void *>(&chip8), &Pristine(), sizeof(Chip8));
+
+    const uint8_t *script = data;
+    size_t frames = 0;
+    const uint8_t *rom = config.rom.data();
+    size_t romSize = config.rom.size();
+
+    if (config.rom.empty()) {
+        if (size == 0) {
+            return 0;
+        }
+        frames = std::min<size_t>(data[0], (size - 1) / 2);
+        script = data + 1;
+        rom = data + 1 + 2 * frames;
+        romSize = size - 1 - 2 * frames;
+    }
+    else {
+        frames = size / 2;
+    }
+
+    chip8.LoadROM(rom, romSize);
+
+    bool proven = config.verifier && Verify(Analyze(rom, romSize)).safe;
+
+    EdgeCoverage hook;
+    for (uint64_t frame = 0; chip8.cycles < config.cycles; ++frame) {
+        uint16_t keys = 0;
+        if (frames > 0) {
+            const uint8_t *entry = script + 2 * (frame % frames);
+            keys = static_cast<uint16_t>((entry[0] << 8u) | entry[1]);
+        }
+        for (unsigned int key = 0; key < 16; ++key) {
+            chip8.keys[key] = (keys >> key) & 0x1u;
+        }
+
+        unsigned int budget = std::min<uint64_t>(FUZZ_CYCLES_PER_FRAME, config.cycles - chip8.cycles);
+        if (chip8.Run(budget, hook) < budget) {
+            break;
+        }
+        chip8.TickTimers();
+    }
+
+    if (proven && chip8.trap != Trap::None) {
+        abort();
+    }
+
+    return 0;
+}
+
+#ifdef CHIP8_FUZZ_DRIVER
+
+static void Collect(const std::string &path, std::vector<std::string> &files) {
+    struct stat info{};
+    if (stat(path.c_str(), &info) != 0) {
+        return;
+    }
+
+    if (!S_ISDIR(info.st_mode)) {
+        files.push_back(path);
+        return;
+    }
+
+    DIR *directory = opendir(path.c_str());
+    if (directory == nullptr) {
+        return;
+    }
+    while (dirent *entry = readdir(directory)) {
+        if (entry->d_name[0] != '.') {
+            Collect(path + "/" + entry->d_name, files);
+        }
+    }
+    closedir(directory);
+}
+
+int main(int argc, char **argv) {
+    std::vector<std::string> files;
+    uint64_t random = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--random") == 0 && i + 1 < argc) {
+            random = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else {
+            Collect(argv[i], files);
+        }
+    }
+
+    if (files.empty() && random == 0) {
+        std::cerr << "Usage: " << argv[0] << " [--random N] [FILE|DIR]...\n";
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::vector<uint8_t>> inputs;
+    for (const std::string &path : files) {
+        std::ifstream file(path, std::ios::binary);
+        inputs.emplace_back(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    std::mt19937_64 generator(1);
+    for (uint64_t i = 0; i < random; ++i) {
+        std::vector<uint8_t> input(1 + generator() % 512);
+        for (uint8_t &byte : input) {
+            byte = static_cast<uint8_t>(generator());
+        }
+        inputs.push_back(std::move(input));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (const std::vector<uint8_t> &input : inputs) {
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    size_t edges = 0;
+    for (uint8_t counter : coverage) {
+        edges += counter != 0;
+    }
+
+    std::cerr << inputs.size() << " inputs in " << elapsed.count() << " s: "
+              << static_cast<uint64_t>(inputs.size() / elapsed.count()) << " execs/s, " << edges << " edges\n";
+
+    return EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,111 @@
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include "FrameExport.h"
+#include "SessionHost.h"
+
+static SessionHost *host = nullptr;
+
+static void Stop(int) {
+    if (host != nullptr) {
+        host->Stop();
+    }
+}
+
+struct Options {
+    const char *socket = nullptr;
+    HostOptions host;
+    const char *exportName = nullptr;
+};
+
+static void Usage(const char *program) {
+    std::cerr << "Usage: " << program << " [options] <SOCKET>\n"
+              << "  --sessions N   most sessions at once (default 1024)\n"
+              << "  --rate N       frames a second (default 60)\n"
+              << "  --quantum N    instructions a session runs before the others get a turn (default 1000)\n"
+              << "  --backlog N    frames a session may fall behind (default 4)\n"
+              << "  --threads N    emulation threads (default: one per core)\n"
+              << "  --export NAME  also publish every session's frames to the POSIX shared memory segment NAME\n"
+              << "The protocol is described in HostProtocol.h.\n";
+}
+
+static bool ParseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--sessions") == 0 && i + 1 < argc) {
+            options.host.maxSessions = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            options.host.scheduler.rate = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--quantum") == 0 && i + 1 < argc) {
+            options.host.scheduler.quantum = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--backlog") == 0 && i + 1 < argc) {
+            options.host.scheduler.maxBacklog = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.host.scheduler.threads = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--export") == 0 && i + 1 < argc) {
+            options.exportName = argv[++i];
+        }
+        else if (argv[i][0] != '-' && options.socket == nullptr) {
+            options.socket = argv[i];
+        }
+        else {
+            return false;
+        }
+    }
+
+    const SchedulerOptions &scheduler = options.host.scheduler;
+    return options.socket != nullptr && scheduler.rate > 0 && scheduler.quantum > 0 && scheduler.maxBacklog > 0;
+}
+
+int main(int argc, char **argv) {
+    Options options;
+
+    if (!ParseOptions(argc, argv, options)) {
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // One slot for every session there can be; declared first so it outlives the scheduler writing to it
+    std::unique_ptr<FrameExport> frameExport;
+    if (options.exportName != nullptr) {
+        frameExport = std::make_unique<FrameExport>(options.exportName, options.host.maxSessions);
+        if (!frameExport->IsOpen()) {
+            std::cerr << "Could not export frames to " << options.exportName << "\n";
+            return EXIT_FAILURE;
+        }
+        options.host.scheduler.frameExport = frameExport.get();
+    }
+
+    SessionHost server(options.socket, options.host);
+    if (!server.IsOpen()) {
+        std::cerr << "Could not listen on " << options.socket << "\n";
+        return EXIT_FAILURE;
+    }
+
+    host = &server;
+    std::signal(SIGINT, Stop);
+    std::signal(SIGTERM, Stop);
+
+    server.Run();
+
+    HostStats stats = server.Stats();
+    SchedulerStats scheduler = server.SchedulerStatistics();
+    fprintf(stderr, "%llu connections, %llu sessions created\n", static_cast<unsigned long long>(stats.connections),
+            static_cast<unsigned long long>(stats.created));
+    fprintf(stderr, "%llu ticks (%llu overran), %llu instructions\n",
+            static_cast<unsigned long long>(scheduler.ticks), static_cast<unsigned long long>(scheduler.overruns),
+            static_cast<unsigned long long>(scheduler.instructions));
+    fprintf(stderr, "%llu frames sent, %llu skipped for slow clients, %llu bytes\n",
+            static_cast<unsigned long long>(stats.framesSent), static_cast<unsigned long long>(stats.framesSkipped),
+            static_cast<unsigned long long>(stats.bytesSent));
+
+    host = nullptr;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,276 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <poll.h>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+#include "Chip8.h"
+#include "HostProtocol.h"
+
+struct Options {
+    const char *socket = nullptr;
+    const char *rom = nullptr;
+    unsigned int sessions = 100;
+    unsigned int cyclesPerFrame = 11;
+    double seconds = 5;
+    // Keys pressed a second in each session; none means the displays can be checked against a local run
+    double presses = 0;
+};
+
+static void Usage(const char *program) {
+    std::cerr << "Usage: " << program << " [options] <SOCKET> <ROM>\n"
+              << "  --sessions N   sessions to run (default 100)\n"
+              << "  --cycles N     instructions per frame (default 11)\n"
+              << "  --seconds N    how long to run (default 5)\n"
+              << "  --presses N    random key presses a second per session (default 0)\n"
+              << "Without key presses, every session's display is checked against a local run at the end.\n";
+}
+
+static bool ParseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--sessions") == 0 && i + 1 < argc) {
+            options.sessions = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+            options.cyclesPerFrame = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            options.seconds = std::strtod(argv[++i], nullptr);
+        }
+        else if (strcmp(argv[i], "--presses") == 0 && i + 1 < argc) {
+            options.presses = std::strtod(argv[++i], nullptr);
+        }
+        else if (argv[i][0] != '-' && options.socket == nullptr) {
+            options.socket = argv[i];
+        }
+        else if (argv[i][0] != '-' && options.rom == nullptr) {
+            options.rom = argv[i];
+        }
+        else {
+            return false;
+        }
+    }
+
+    return options.socket != nullptr && options.rom != nullptr && options.sessions > 0 &&
+           options.cyclesPerFrame > 0 && options.cyclesPerFrame <= 0xFFFF;
+}
+
+/**
+ * What a client knows about one session: the display as patched together from deltas.
+ */
+struct View {
+    uint8_t display[DISPLAY_PLANES][HIRES_VIDEO_HEIGHT][DISPLAY_ROW_BYTES]{};
+    uint64_t frame = 0;
+    uint64_t frames = 0;
+    uint64_t rows = 0;
+    uint8_t ended = 0;
+};
+
+static bool SendAll(int fd, const std::string &bytes) {
+    size_t sent = 0;
+    while (sent < bytes.size()) {
+        ssize_t result = send(fd, bytes.data() + sent, bytes.size() - sent, MSG_NOSIGNAL);
+        if (result <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(result);
+    }
+    return true;
+}
+
+/**
+ * Apply every complete message in input, leaving any partial one.
+ */
+static void Consume(std::string &input, std::vector<uint32_t> &created, std::unordered_map<uint32_t, View> &views,
+                    uint64_t &errors) {
+    size_t offset = 0;
+
+    while (input.size() - offset >= 4) {
+        auto bytes = reinterpret_cast<const uint8_t *>(input.data()) + offset;
+        uint32_t length = Get32(bytes);
+        if (input.size() - offset - 4 < length) {
+            break;
+        }
+
+        uint8_t type = bytes[4];
+        const uint8_t *payload = bytes + HOST_HEADER_SIZE;
+
+        if (type == HOST_CREATED) {
+            created.push_back(Get32(payload));
+        }
+        else if (type == HOST_FRAME) {
+            View &view = views[Get32(payload)];
+            view.frame = Get64(payload + 4);
+            uint16_t rows = Get16(payload + 13);
+            const uint8_t *row = payload + 15;
+            for (unsigned int i = 0; i < rows; ++i, row += 2 + DISPLAY_ROW_BYTES) {
+                memcpy(view.display[row[0] % DISPLAY_PLANES][row[1] % HIRES_VIDEO_HEIGHT], row + 2,
+                       DISPLAY_ROW_BYTES);
+            }
+            ++view.frames;
+            view.rows += rows;
+        }
+        else if (type == HOST_ENDED) {
+            views[Get32(payload)].ended = payload[4];
+        }
+        else if (type == HOST_ERROR) {
+            std::cerr << "error for session " << Get32(payload) << ": "
+                      << std::string(reinterpret_cast<const char *>(payload + 4), length - 5) << "\n";
+            ++errors;
+        }
+
+        offset += 4 + length;
+    }
+
+    input.erase(0, offset);
+}
+
+static void Pump(int fd, int timeoutMs, std::string &input, std::vector<uint32_t> &created,
+                 std::unordered_map<uint32_t, View> &views, uint64_t &errors, uint64_t &received) {
+    pollfd descriptor{fd, POLLIN, 0};
+    if (poll(&descriptor, 1, timeoutMs) <= 0) {
+        return;
+    }
+
+    char buffer[65536];
+    ssize_t count = read(fd, buffer, sizeof(buffer));
+    if (count > 0) {
+        input.append(buffer, static_cast<size_t>(count));
+        received += static_cast<uint64_t>(count);
+        Consume(input, created, views, errors);
+    }
+}
+
+int main(int argc, char **argv) {
+    Options options;
+
+    if (!ParseOptions(argc, argv, options)) {
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::ifstream file(options.rom, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Could not open " << options.rom << "\n";
+        return EXIT_FAILURE;
+    }
+    std::vector<uint8_t> rom((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    sockaddr_un address{};
+    if (strlen(options.socket) >= sizeof(address.sun_path)) {
+        return EXIT_FAILURE;
+    }
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, options.socket);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+        std::cerr << "Could not connect to " << options.socket << "\n";
+        return EXIT_FAILURE;
+    }
+
+    std::string input;
+    std::vector<uint32_t> created;
+    std::unordered_map<uint32_t, View> views;
+    uint64_t errors = 0;
+    uint64_t received = 0;
+
+    std::string out;
+    for (unsigned int i = 0; i < options.sessions; ++i) {
+        size_t start = BeginMessage(out, HOST_CREATE);
+        Put16(out, static_cast<uint16_t>(options.cyclesPerFrame));
+        Put32(out, i + 1);
+        out.append(reinterpret_cast<const char *>(rom.data()), rom.size());
+        FinishMessage(out, start);
+    }
+    SendAll(fd, out);
+
+    while (created.size() + errors < options.sessions) {
+        Pump(fd, 1000, input, created, views, errors, received);
+    }
+
+    out.clear();
+    for (uint32_t id : created) {
+        size_t start = BeginMessage(out, HOST_SUBSCRIBE);
+        Put32(out, id);
+        FinishMessage(out, start);
+    }
+    SendAll(fd, out);
+
+    std::minstd_rand random(1);
+    auto begin = std::chrono::steady_clock::now();
+    auto end = begin + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(options.seconds));
+    auto nextPress = begin;
+    uint64_t presses = 0;
+
+    while (std::chrono::steady_clock::now() < end) {
+        Pump(fd, 10, input, created, views, errors, received);
+
+        // Press or release a random key in a random session, at the requested rate overall
+        if (options.presses > 0 && !created.empty()) {
+            auto now = std::chrono::steady_clock::now();
+            auto interval = std::chrono::duration<double>(1.0 / (options.presses * created.size()));
+            out.clear();
+            while (nextPress <= now) {
+                size_t start = BeginMessage(out, HOST_KEYS);
+                Put32(out, created[random() % created.size()]);
+                Put16(out, random() % 2 == 0 ? 0 : static_cast<uint16_t>(1u << (random() % 16)));
+                FinishMessage(out, start);
+                nextPress += std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval);
+                ++presses;
+            }
+            SendAll(fd, out);
+        }
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    uint64_t frames = 0;
+    uint64_t rows = 0;
+    for (const auto &entry : views) {
+        frames += entry.second.frames;
+        rows += entry.second.rows;
+    }
+
+    printf("%zu sessions, %llu key events, %.1f s\n", created.size(), static_cast<unsigned long long>(presses),
+           elapsed);
+    printf("%llu frames (%.0f/s), %.1f rows a frame, %.0f KiB/s\n", static_cast<unsigned long long>(frames),
+           static_cast<double>(frames) / elapsed, frames > 0 ? static_cast<double>(rows) / frames : 0.0,
+           static_cast<double>(received) / elapsed / 1024);
+
+    // With no input the sessions are deterministic: rerun each locally to the frame last received and compare
+    unsigned int mismatches = 0;
+    if (options.presses == 0) {
+        for (unsigned int i = 0; i < created.size(); ++i) {
+            const View &view = views[created[i]];
+            auto chip8 = std::make_unique<Chip8>();
+            chip8->LoadROM(rom.data(), rom.size());
+            chip8->randGen.seed(i + 1);
+
+            for (uint64_t frame = 0; frame < view.frame && !chip8->halted && chip8->trap == Trap::None; ++frame) {
+                for (unsigned int cycle = 0; cycle < options.cyclesPerFrame; ++cycle) {
+                    chip8->Cycle();
+                }
+                chip8->TickTimers();
+            }
+
+            if (memcmp(chip8->display, view.display, sizeof(view.display)) != 0) {
+                ++mismatches;
+            }
+        }
+        printf("%u of %zu displays differ from a local run\n", mismatches, created.size());
+    }
+
+    close(fd);
+    return errors == 0 && mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,181 @@
+#include "libchip8.h"
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include "Analyzer.h"
+#include "Chip8.h"
+#include "Verifier.h"
+
+static_assert(std::is_trivially_copyable<Chip8>::value, "Chip8 must be trivially copyable to snapshot it");
+
+// A snapshot is this header followed by the Chip8 as it is in memory. Bump SNAPSHOT_FORMAT when the handle's own
+// state changes; a change to Chip8 shows up in its size.
+const uint32_t SNAPSHOT_MAGIC = 0x38504843;  // "CHP8"
+const uint32_t SNAPSHOT_FORMAT = 2;
+
+struct SnapshotHeader {
+    uint32_t magic;
+    uint32_t format;
+    uint64_t machineSize;
+    uint32_t cyclesPerFrame;
+};
+
+struct chip8 {
+    std::unique_ptr<Chip8> core = std::make_unique<Chip8>();
+    unsigned int cyclesPerFrame = 11;
+    // The loaded ROM was proven never to go out of bounds, so it runs unchecked
+    bool verified = false;
+};
+
+unsigned int chip8_api_version(void) {
+    return CHIP8_API_VERSION;
+}
+
+chip8 *chip8_create(void) {
+    // Exceptions must not cross the C boundary
+    try {
+        auto machine = new chip8;
+        machine->core->randGen.seed(0);
+        return machine;
+    }
+    catch (const std::bad_alloc &) {
+        return nullptr;
+    }
+}
+
+void chip8_destroy(chip8 *machine) {
+    delete machine;
+}
+
+int chip8_load_rom(chip8 *machine, const uint8_t *rom, size_t size) {
+    if (size > MEMORY_SIZE - ROM_START) {
+        return -1;
+    }
+
+    try {
+        // Reset in place rather than swapping in a new Chip8, so framebuffer pointers handed out stay good
+        auto fresh = std::make_unique<Chip8>();
+        fresh->randGen.seed(0);
+        fresh->LoadROM(rom, size);
+        machine->verified = Verify(Analyze(rom, size)).safe;
+        *machine->core = *fresh;
+    }
+    catch (const std::bad_alloc &) {
+        return -1;
+    }
+
+    return 0;
+}
+
+void chip8_seed(chip8 *machine, uint32_t seed) {
+    machine->core->randGen.seed(seed);
+}
+
+void chip8_set_cycles_per_frame(chip8 *machine, unsigned int cycles) {
+    machine->cyclesPerFrame = cycles > 0 ? cycles : 1;
+}
+
+void chip8_set_keys(chip8 *machine, uint16_t keys) {
+    for (unsigned int key = 0; key < 16; ++key) {
+        machine->core->keys[key] = (keys >> key) & 0x1u;
+    }
+}
+
+unsigned int chip8_run(chip8 *machine, unsigned int count) {
+    return machine->core->Run(count, machine->cyclesPerFrame, machine->verified);
+}
+
+unsigned int chip8_run_frame(chip8 *machine) {
+    return machine->core->RunFrame(machine->cyclesPerFrame, machine->verified);
+}
+
+int chip8_status(const chip8 *machine) {
+    if (machine->core->trap != Trap::None) {
+        return CHIP8_TRAPPED;
+    }
+    return machine->core->halted ? CHIP8_HALTED : CHIP8_RUNNING;
+}
+
+uint64_t chip8_cycles(const chip8 *machine) {
+    return machine->core->cycles;
+}
+
+int chip8_sound_on(const chip8 *machine) {
+    return machine->core->soundTimer > 0;
+}
+
+const uint8_t *chip8_framebuffer(const chip8 *machine, unsigned int plane) {
+    if (plane >= DISPLAY_PLANES) {
+        return nullptr;
+    }
+    return &machine->core->display[plane][0][0];
+}
+
+unsigned int chip8_display_width(const chip8 *machine) {
+    return machine->core->DisplayWidth();
+}
+
+unsigned int chip8_display_height(const chip8 *machine) {
+    return machine->core->DisplayHeight();
+}
+
+size_t chip8_snapshot_size(void) {
+    return sizeof(SnapshotHeader) + sizeof(Chip8);
+}
+
+int chip8_snapshot(const chip8 *machine, void *buffer, size_t size) {
+    if (size < chip8_snapshot_size()) {
+        return -1;
+    }
+
+    SnapshotHeader header{};
+    header.magic = SNAPSHOT_MAGIC;
+    header.format = SNAPSHOT_FORMAT;
+    header.machineSize = sizeof(Chip8);
+    header.cyclesPerFrame = machine->cyclesPerFrame;
+
+    auto bytes = static_cast<uint8_t *>(buffer);
+    memcpy(bytes, &header, sizeof(header));
+    memcpy(bytes + sizeof(header), static_cast<const void *>(machine->core.get()), sizeof(Chip8));
+    return 0;
+}
+
+/**
+ * Whether the bytes of a Chip8 are a state the core can run from: every field the instructions index by in range and
+ * every bool and enum holding one of its values. Anything else in a snapshot is just data.
+ */
+static bool Valid(const uint8_t *bytes) {
+    std::uniform_int_distribution<uint8_t> randByte;
+    memcpy(static_cast<void *>(&randByte), bytes + offsetof(Chip8, randByte), sizeof(randByte));
+
+    return bytes[offsetof(Chip8, sp)] <= 16 && bytes[offsetof(Chip8, selectedPlanes)] <= 0x3u &&
+           bytes[offsetof(Chip8, hires)] <= 1 && bytes[offsetof(Chip8, halted)] <= 1 &&
+           bytes[offsetof(Chip8, hasAudioPattern)] <= 1 &&
+           bytes[offsetof(Chip8, trap)] <= static_cast<uint8_t>(Trap::KeyOutOfRange) &&
+           randByte == std::uniform_int_distribution<uint8_t>();
+}
+
+int chip8_restore(chip8 *machine, const void *buffer, size_t size) {
+    if (size < chip8_snapshot_size()) {
+        return -1;
+    }
+
+    SnapshotHeader header;
+    auto bytes = static_cast<const uint8_t *>(buffer);
+    memcpy(&header, bytes, sizeof(header));
+    if (header.magic != SNAPSHOT_MAGIC || header.format != SNAPSHOT_FORMAT || header.machineSize != sizeof(Chip8) ||
+        header.cyclesPerFrame == 0 || !Valid(bytes + sizeof(header))) {
+        return -1;
+    }
+
+    // Chip8 is trivially copyable, so its bytes are the whole state
+    memcpy(static_cast<void *>(machine->core.get()), bytes + sizeof(header), sizeof(Chip8));
+    machine->core->dirtyPages = ~0ull;
+    machine->core->displayDirty = true;
+    machine->cyclesPerFrame = header.cyclesPerFrame;
+    // The Verifier's proof only covers the states a ROM reaches from its start, which a snapshot needn't be one of,
+    // so a restored machine keeps the checks
+    machine->verified = false;
+    return 0;
+}
@@ -0,0 +1,107 @@
+/*
+ * C interface to the emulator core, for embedding it in other programs.
+ *
+ * A chip8 handle is opaque: nothing about the core's layout is part of this interface, so programs built against it
+ * keep working with a rebuilt libchip8 (static or shared) when the core changes. Only snapshots depend on the build -
+ * they are for saving and restoring within one version of the library, and restoring one from another build fails
+ * cleanly.
+ *
+ * Time is counted in instructions. A frame is cycles_per_frame instructions, after which the delay and sound timers
+ * tick, the way the frontend runs at 60 frames a second; pacing against a real clock is up to the caller.
+ */
+#ifndef LIBCHIP8_H
+#define LIBCHIP8_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define CHIP8_API __attribute__((visibility("default")))
+#else
+#define CHIP8_API
+#endif
+
+/* Bumped whenever a function is added or changes meaning. */
+#define CHIP8_API_VERSION 1
+
+enum {
+    CHIP8_RUNNING = 0,
+    /* 00FD exited the program */
+    CHIP8_HALTED = 1,
+    /* An instruction would have overflowed or underflowed the stack or tested a key above 15 */
+    CHIP8_TRAPPED = 2
+};
+
+/* The display is two bitplanes of 64 rows of 16 bytes, 1 bit per pixel, most significant bit leftmost. In
+ * low resolution (64x32) only the top-left corner of each plane is used. */
+#define CHIP8_FRAMEBUFFER_PLANES 2
+#define CHIP8_FRAMEBUFFER_ROWS 64
+#define CHIP8_FRAMEBUFFER_STRIDE 16
+
+typedef struct chip8 chip8;
+
+CHIP8_API unsigned int chip8_api_version(void);
+
+/* Returns NULL if out of memory. The machine starts with no ROM, 11 instructions a frame and random seed 0. */
+CHIP8_API chip8 *chip8_create(void);
+
+CHIP8_API void chip8_destroy(chip8 *machine);
+
+/* Power-cycle the machine (keys released, random seed back to 0) and load a ROM at 0x200. The ROM is copied. Returns
+ * 0, or -1 if it doesn't fit in memory. The ROM is analysed once here; one proven never to go out of bounds runs
+ * without the per-instruction checks. */
+CHIP8_API int chip8_load_rom(chip8 *machine, const uint8_t *rom, size_t size);
+
+/* Reseed the random number generator behind Cxkk; runs with the same seed and keys are identical. */
+CHIP8_API void chip8_seed(chip8 *machine, uint32_t seed);
+
+CHIP8_API void chip8_set_cycles_per_frame(chip8 *machine, unsigned int cycles);
+
+/* Keys held from now on: bit n for key n. */
+CHIP8_API void chip8_set_keys(chip8 *machine, uint16_t keys);
+
+/* Execute up to count instructions, ticking the timers at every frame boundary crossed. Returns the number executed,
+ * fewer than count if the program halted or trapped. */
+CHIP8_API unsigned int chip8_run(chip8 *machine, unsigned int count);
+
+/* Execute up to the end of the current frame and tick the timers. Returns the number of instructions executed. */
+CHIP8_API unsigned int chip8_run_frame(chip8 *machine);
+
+/* CHIP8_RUNNING, CHIP8_HALTED or CHIP8_TRAPPED. */
+CHIP8_API int chip8_status(const chip8 *machine);
+
+CHIP8_API uint64_t chip8_cycles(const chip8 *machine);
+
+/* Non-zero while the sound timer is running. */
+CHIP8_API int chip8_sound_on(const chip8 *machine);
+
+/* The machine's own display memory for one plane (0 or 1), updated in place as it runs: read it between calls that
+ * run the machine. The pointer stays valid, across ROM loads and restores too, until the machine is destroyed. */
+CHIP8_API const uint8_t *chip8_framebuffer(const chip8 *machine, unsigned int plane);
+
+/* The part of the framebuffer in use: 64x32, or 128x64 in high resolution. */
+CHIP8_API unsigned int chip8_display_width(const chip8 *machine);
+
+CHIP8_API unsigned int chip8_display_height(const chip8 *machine);
+
+/* Bytes a snapshot takes, the same for every machine. */
+CHIP8_API size_t chip8_snapshot_size(void);
+
+/* Write the whole machine into buffer, which must hold chip8_snapshot_size() bytes. Returns 0, or -1 if it's too
+ * small. */
+CHIP8_API int chip8_snapshot(const chip8 *machine, void *buffer, size_t size);
+
+/* Put the machine back in a snapshotted state. Returns 0, or -1 (leaving the machine alone) if the buffer isn't a
+ * snapshot from this build of the library or holds a state the core can't run from, such as a stack pointer past
+ * the stack. A restored machine runs with the stack and key checks until the next chip8_load_rom(). */
+CHIP8_API int chip8_restore(chip8 *machine, const void *buffer, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBCHIP8_H */
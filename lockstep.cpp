@@ -0,0 +1,162 @@
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Chip8.h"
+#include "Lockstep.h"
+#include "ThreadPool.h"
+
+struct Options {
+    std::vector<const char *> roms;
+    const char *keys = nullptr;
+    std::string reference = "checked";
+    std::string candidate = "unchecked";
+    LockstepOptions lockstep;
+    unsigned int threads = 0;
+};
+
+static void Usage(const char *program) {
+    std::cerr << "Usage: " << program << " [options] <ROM>...\n"
+              << "  --engines A,B     reference and candidate engine (default checked,unchecked)\n"
+              << "  --instructions N  instructions to run each ROM for (default 1000000)\n"
+              << "  --interval N      instructions between state comparisons (default 4096)\n"
+              << "  --cycles N        instructions per frame (default 11)\n"
+              << "  --keys FILE       keys held in each frame, as big-endian 16 bit masks\n"
+              << "  --threads N       worker threads (default: one per core)\n"
+              << "  --no-watchdog     keep going when a ROM is stuck in a loop after the keys run out\n"
+              << "Engines:";
+    for (const EngineInfo &engine : Engines()) {
+        std::cerr << " " << engine.name;
+    }
+    std::cerr << "\n";
+}
+
+static bool ParseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--engines") == 0 && i + 1 < argc) {
+            std::string engines = argv[++i];
+            size_t comma = engines.find(',');
+            if (comma == std::string::npos) {
+                return false;
+            }
+            options.reference = engines.substr(0, comma);
+            options.candidate = engines.substr(comma + 1);
+        }
+        else if (strcmp(argv[i], "--instructions") == 0 && i + 1 < argc) {
+            options.lockstep.instructions = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            options.lockstep.interval = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+            options.lockstep.cyclesPerFrame = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--keys") == 0 && i + 1 < argc) {
+            options.keys = argv[++i];
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.threads = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--no-watchdog") == 0) {
+            options.lockstep.watchdog = false;
+        }
+        else if (argv[i][0] != '-') {
+            options.roms.push_back(argv[i]);
+        }
+        else {
+            return false;
+        }
+    }
+
+    return !options.roms.empty() && options.lockstep.interval > 0 && options.lockstep.cyclesPerFrame > 0;
+}
+
+static bool ReadKeys(const char *path, std::vector<uint16_t> &keys) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    for (size_t i = 0; i + 1 < bytes.size(); i += 2) {
+        keys.push_back(static_cast<uint16_t>((bytes[i] << 8u) | bytes[i + 1]));
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv) {
+    Options options;
+
+    if (!ParseOptions(argc, argv, options)) {
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const EngineInfo *reference = FindEngine(options.reference);
+    const EngineInfo *candidate = FindEngine(options.candidate);
+    if (reference == nullptr || candidate == nullptr) {
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<uint16_t> keys;
+    if (options.keys != nullptr && !ReadKeys(options.keys, keys)) {
+        std::cerr << "Could not open " << options.keys << "\n";
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::string> lines(options.roms.size());
+    std::atomic<unsigned int> failures{0};
+
+    auto checkOne = [&](unsigned int i) {
+        auto start = std::make_unique<Chip8>();
+        if (!start->LoadROM(options.roms[i])) {
+            lines[i] = std::string("could not open ") + options.roms[i];
+            ++failures;
+            return;
+        }
+        // Both engines must see the same random numbers, and so must every rerun
+        start->randGen.seed(1);
+
+        LockstepResult result = RunLockstep(*start, keys, reference->run, candidate->run, options.lockstep);
+
+        char line[160];
+        switch (result.status) {
+            case LockstepStatus::Agreed:
+                snprintf(line, sizeof(line), "agreed    %10llu  ", static_cast<unsigned long long>(result.agreed));
+                break;
+            case LockstepStatus::Trapped:
+                snprintf(line, sizeof(line), "trapped   %10llu  ", static_cast<unsigned long long>(result.agreed));
+                break;
+            case LockstepStatus::Hung:
+                snprintf(line, sizeof(line), "hung      %10llu  loop of %llu frames in 0x%03X-0x%03X  ",
+                         static_cast<unsigned long long>(result.agreed),
+                         static_cast<unsigned long long>(result.period), result.low, result.high);
+                break;
+            case LockstepStatus::Diverged:
+                snprintf(line, sizeof(line), "DIVERGED  %10llu  pc 0x%03X opcode %04X: %s  ",
+                         static_cast<unsigned long long>(result.agreed), result.pc, result.opcode,
+                         result.difference.c_str());
+                ++failures;
+                break;
+        }
+        lines[i] = line + std::string(options.roms[i]);
+    };
+
+    auto count = static_cast<unsigned int>(options.roms.size());
+    std::unique_ptr<ThreadPool> pool = ThreadPool::ForThreads(options.threads);
+    ParallelFor(pool.get(), count, checkOne);
+
+    for (const std::string &line : lines) {
+        std::cout << line << "\n";
+    }
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
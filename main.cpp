@@ -1,20 +1,683 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <fstream>
+#include <memory>
+#include <thread>
+#include <unistd.h>
+#include "Analyzer.h"
+#include "Audio.h"
+#include "Chip8.h"
+#include "DebugServer.h"
+#include "Debugger.h"
+#include "Frame.h"
+#include "FrameExport.h"
+#include "Histogram.h"
+#include "Metrics.h"
+#include "MetricsExporter.h"
+#include "Recorder.h"
+#include "Renderer.h"
+#include "TerminalInput.h"
+#include "TerminalRenderer.h"
+#include "Timeline.h"
+#include "Trace.h"
+#include "Tracer.h"
+#include "TripleBuffer.h"
+#include "Verifier.h"
+#include "Watchdog.h"
 
-class NewClass {
-public:
-    int firstVar;
-    int secondVar;
+using Clock = std::chrono::steady_clock;
 
-    NewClass(int firstVar, int secondVar);
+// 60Hz, the rate the timers tick at and the rate the original hardware refreshed the display
+const std::chrono::nanoseconds FRAME_TIME(1000000000 / 60);
+
+struct Options {
+    const char *rom = nullptr;
+    unsigned int cyclesPerFrame = 11;
+    uint64_t frames = 0;
+    bool headless = false;
+    const char *record = nullptr;
+    unsigned int recordScale = 1;
+    // Record .y4m in colour through the CRT post-processor
+    bool postProcess = false;
+    const char *audio = nullptr;
+    unsigned int sampleRate = 48000;
+    const char *debug = nullptr;
+    bool checked = false;
+    bool watchdog = false;
+    const char *exportName = nullptr;
+    const char *trace = nullptr;
+    unsigned long metricsPort = 0;
+    const char *metricsFile = nullptr;
+    unsigned int metricsInterval = 10;
 };
 
-NewClass::NewClass(int firstVar, int secondVar) : firstVar(firstVar), secondVar(secondVar) {
-    std::cout << this->firstVar << " " << this->secondVar << std::endl;
+static std::atomic<bool> running{true};
+
+static void Stop(int) {
+    running = false;
+}
+
+static int64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+static void Usage(const char *program) {
+    std::cerr << "Usage: " << program << " [options] <ROM>\n"
+              << "  --cycles N     instructions executed per 60Hz frame (default 11)\n"
+              << "  --frames N     stop after N frames (default: run until Escape or Ctrl-C)\n"
+              << "  --headless     emulate without drawing anything\n"
+              << "  --record FILE  record every frame; FILE.y4m writes video, anything else raw 1bpp plus FILE.idx\n"
+              << "  --record-scale N  scale factor for .y4m recordings (default 1)\n"
+              << "  --postprocess  record .y4m in colour with phosphor persistence and scanlines\n"
+              << "  --audio FILE   write the beeper to FILE as .wav, or synthesize and discard it with 'null'\n"
+              << "  --sample-rate N  audio sample rate (default 48000)\n"
+              << "  --debug SOCKET serve the GDB remote protocol on a Unix socket; starts stopped until a client attaches\n"
+              << "  --checked      always run with stack and key checks, even when the ROM is proven not to need them\n"
+              << "  --watchdog     once input has ended, stop as soon as the program is stuck in a loop\n"
+              << "  --export NAME  publish every frame to the POSIX shared memory segment NAME for other processes\n"
+              << "  --trace FILE   write a Chrome trace-event JSON timeline of frames, drawing, timers and I/O\n"
+              << "  --metrics PORT serve Prometheus metrics over HTTP on 127.0.0.1:PORT\n"
+              << "  --metrics-file FILE  rewrite FILE with the same metrics every interval\n"
+              << "  --metrics-interval SECONDS  how often --metrics-file is rewritten (default 10)\n";
+}
+
+static bool ParseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+            options.cyclesPerFrame = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            options.frames = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--headless") == 0) {
+            options.headless = true;
+        }
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            options.record = argv[++i];
+        }
+        else if (strcmp(argv[i], "--record-scale") == 0 && i + 1 < argc) {
+            options.recordScale = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--postprocess") == 0) {
+            options.postProcess = true;
+        }
+        else if (strcmp(argv[i], "--audio") == 0 && i + 1 < argc) {
+            options.audio = argv[++i];
+        }
+        else if (strcmp(argv[i], "--sample-rate") == 0 && i + 1 < argc) {
+            options.sampleRate = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--debug") == 0 && i + 1 < argc) {
+            options.debug = argv[++i];
+        }
+        else if (strcmp(argv[i], "--checked") == 0) {
+            options.checked = true;
+        }
+        else if (strcmp(argv[i], "--watchdog") == 0) {
+            options.watchdog = true;
+        }
+        else if (strcmp(argv[i], "--export") == 0 && i + 1 < argc) {
+            options.exportName = argv[++i];
+        }
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            options.trace = argv[++i];
+        }
+        else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+            options.metricsPort = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--metrics-file") == 0 && i + 1 < argc) {
+            options.metricsFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--metrics-interval") == 0 && i + 1 < argc) {
+            options.metricsInterval = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (argv[i][0] != '-' && options.rom == nullptr) {
+            options.rom = argv[i];
+        }
+        else {
+            return false;
+        }
+    }
+
+    // The debugger doesn't follow the sound timer cycle by cycle, so it can't drive the beeper; a program held up in
+    // the debugger isn't hung
+    return options.rom != nullptr && options.cyclesPerFrame > 0 && options.sampleRate > 0 &&
+           options.sampleRate / 60 <= AUDIO_BLOCK_SAMPLES && (options.debug == nullptr || options.audio == nullptr) &&
+           (options.debug == nullptr || !options.watchdog) && options.metricsPort <= 65535 &&
+           options.metricsInterval > 0 && (options.record != nullptr || !options.postProcess);
+}
+
+/**
+ * What --metrics and --metrics-file expose. Each metric is only ever updated by one thread, the emulation thread or
+ * the presentation thread, so relaxed atomics are all they need.
+ */
+struct EmulatorMetrics {
+    explicit EmulatorMetrics(MetricsRegistry &registry)
+            : instructions(registry.AddCounter("chip8_instructions_total", "Instructions executed")),
+              frames(registry.AddCounter("chip8_frames_total", "Frames emulated")),
+              instructionsPerSecond(registry.AddGauge("chip8_instructions_per_second",
+                                                      "Instructions executed per second over the last second")),
+              framesPerSecond(registry.AddGauge("chip8_frames_per_second",
+                                                "Frames emulated per second over the last second")),
+              frameTime(registry.AddHistogram("chip8_frame_execution_seconds",
+                                              "Time spent executing each frame's instructions and timer tick", 1e-9)),
+              frameLateness(registry.AddHistogram("chip8_frame_lateness_seconds",
+                                                  "How long after its 60Hz deadline each frame started", 1e-9)),
+              timerDrift(registry.AddGauge("chip8_timer_drift_seconds",
+                                           "How far the 60Hz timers have fallen behind the wall clock")),
+              inputLatency(registry.AddHistogram("chip8_input_latency_seconds",
+                                                 "From a key event to presenting the first frame whose display changed "
+                                                 "after it", 1e-9)) {}
+
+    Counter &instructions;
+    Counter &frames;
+    Gauge &instructionsPerSecond;
+    Gauge &framesPerSecond;
+    Histogram &frameTime;
+    Histogram &frameLateness;
+    Gauge &timerDrift;
+    Histogram &inputLatency;
+};
+
+/**
+ * Everything --debug needs: the debugger, the history it can travel back through and the server clients attach to.
+ */
+struct DebugSession {
+    DebugSession(Chip8 &chip8, const Options &options)
+            : debugger(chip8), timeline(chip8, options.cyclesPerFrame), server(debugger, options.debug, &timeline) {}
+
+    Debugger debugger;
+    Timeline timeline;
+    DebugServer server;
+};
+
+/**
+ * Runs the rest of the current frame under the debugger, serving the attached client whenever it stops. The client
+ * can move the machine back in time while it's stopped, so the end of the frame is worked out from the cycle count
+ * each time rather than counted down.
+ */
+static void DebugFrame(Chip8 &chip8, DebugSession &debug, unsigned int cyclesPerFrame) {
+    debug.server.Poll();
+
+    while (running) {
+        if (debug.server.Stopped()) {
+            debug.server.WaitWhileStopped(running);
+            continue;
+        }
+
+        uint64_t frameEnd = (chip8.cycles / cyclesPerFrame + 1) * cyclesPerFrame;
+        unsigned int executed = debug.debugger.Run(static_cast<unsigned int>(frameEnd - chip8.cycles));
+
+        if (debug.debugger.Reason() != StopReason::None) {
+            debug.server.ReportStop();
+        }
+
+        if (executed > 0 && chip8.cycles % cyclesPerFrame == 0) {
+            break;
+        }
+    }
+}
+
+/**
+ * Say where a program the watchdog caught is looping, by going round the loop once more.
+ */
+static void ReportHang(Chip8 &chip8, const Watchdog &watchdog, unsigned int cyclesPerFrame, uint64_t frame) {
+    PcRange range;
+    for (uint64_t i = 0; i < watchdog.Period(); ++i) {
+        chip8.Run(cyclesPerFrame, range);
+        chip8.TickTimers();
+    }
+
+    char line[96];
+    snprintf(line, sizeof(line), "hung after %llu frames: loop of %llu frames in 0x%03X-0x%03X\n",
+             static_cast<unsigned long long>(frame + 1), static_cast<unsigned long long>(watchdog.Period()),
+             range.low, range.high);
+    std::cerr << line;
+}
+
+/**
+ * Emulation thread. Runs one frame's worth of instructions, ticks the timers and publishes the frame, then sleeps
+ * until the next 60Hz deadline. Nothing here ever waits on the presentation thread. Instructions run unchecked when
+ * the ROM was verified not to need the checks; a checked ROM that traps ends the run, as does a program exiting with
+ * 00FD and one the watchdog finds stuck once no more input can arrive.
+ *
+ * With metrics on, a change of keys keeps a copy of the display until the display differs from it, and the frames from
+ * then on carry the time of the latest key event for the presentation thread to measure input latency by.
+ */
+static void Emulate(Chip8 &chip8, TripleBuffer<Frame> &frames, const Options &options,
+                    const std::atomic<uint16_t> &keys, const std::atomic<bool> &inputEnded, Recorder *recorder,
+                    Beeper *beeper, DebugSession *debug, Watchdog *watchdog, FrameExport *frameExport,
+                    int exportSlot, bool verified, Histogram &emulationTimes,
+                    const std::atomic<int64_t> &keysNs, EmulatorMetrics *metrics) {
+    Clock::time_point deadline = Clock::now();
+    Trace::NameThread("emulation");
+
+    int64_t firstNs = 0;
+    int64_t rateNs = 0;
+    uint64_t rateCycles = chip8.cycles;
+    uint64_t rateFrames = 0;
+
+    uint16_t lastHeld = 0;
+    int64_t pendingInputNs = 0;
+    int64_t inputNs = 0;
+    // The display as of the last frame published, to tell which frames changed it
+    uint8_t published[sizeof(chip8.display)];
+
+    for (uint64_t number = 0; running && (options.frames == 0 || number < options.frames); ++number) {
+        uint16_t held = keys.load(std::memory_order_acquire);
+        if (metrics != nullptr && held != lastHeld) {
+            // Timed from the latest key event: a program waiting in Fx0A answers the release, not the press
+            pendingInputNs = keysNs.load(std::memory_order_relaxed);
+            lastHeld = held;
+        }
+
+        if (debug != nullptr) {
+            // Frames that ran before the client stepped back get the keys they had the first time
+            debug->timeline.BeginFrame(held);
+        }
+        else {
+            for (unsigned int key = 0; key < 16; ++key) {
+                chip8.keys[key] = (held >> key) & 0x1u;
+            }
+        }
+
+        int64_t start = NowNs();
+        uint64_t cycles = chip8.cycles;
+
+        if (debug != nullptr) {
+            DebugFrame(chip8, *debug, options.cyclesPerFrame);
+            chip8.TickTimers();
+        }
+        else if (beeper == nullptr) {
+            chip8.RunFrame(options.cyclesPerFrame, verified);
+        }
+        else {
+            // Watch for the sound timer switching between zero and non-zero, and for XO-CHIP pattern or pitch
+            // changes, so the sound changes on the exact cycle. The timers tick inside the last step of the frame.
+            bool beeping = chip8.soundTimer > 0;
+            uint32_t audioChanges = chip8.audioChanges;
+
+            for (unsigned int i = 0; i < options.cyclesPerFrame; ++i) {
+                if (chip8.Run(1, options.cyclesPerFrame, verified) == 0) {
+                    break;
+                }
+
+                if (chip8.audioChanges != audioChanges) {
+                    audioChanges = chip8.audioChanges;
+                    if (chip8.hasAudioPattern) {
+                        beeper->SetPattern(chip8.audioPattern, chip8.pitch, chip8.cycles);
+                    }
+                }
+
+                if ((chip8.soundTimer > 0) != beeping) {
+                    beeping = !beeping;
+                    beeper->SetTone(beeping, chip8.cycles);
+                }
+            }
+            beeper->Render(chip8.cycles);
+        }
+
+        int64_t end = NowNs();
+        if (Trace::Enabled()) {
+            Trace::Record("frame", "emulation", static_cast<uint64_t>(start), static_cast<uint64_t>(end), "frame",
+                          number);
+        }
+
+        Frame &frame = frames.WriteBuffer();
+        PackDisplay(chip8, frame);
+        frame.number = number;
+        frame.emulationNs = end - start;
+
+        bool displayChanged = number == 0 || memcmp(published, chip8.display, sizeof(published)) != 0;
+        if (displayChanged) {
+            memcpy(published, chip8.display, sizeof(published));
+        }
+
+        if (metrics != nullptr) {
+            if (pendingInputNs != 0 && displayChanged) {
+                inputNs = pendingInputNs;
+                pendingInputNs = 0;
+            }
+            frame.inputNs = inputNs;
+
+            int64_t deadlineNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    deadline.time_since_epoch()).count();
+            if (number == 0) {
+                firstNs = start;
+                rateNs = start;
+            }
+            metrics->instructions.Add(chip8.cycles - cycles);
+            metrics->frames.Add();
+            metrics->frameTime.Record(static_cast<uint64_t>(end - start));
+            metrics->frameLateness.Record(static_cast<uint64_t>(std::max<int64_t>(start - deadlineNs, 0)));
+            // Frame n's timers should tick n frames after the first frame started
+            metrics->timerDrift.Set(static_cast<double>(start - firstNs - static_cast<int64_t>(number) *
+                                                        FRAME_TIME.count()) / 1e9);
+
+            if (end - rateNs >= 1000000000) {
+                double seconds = static_cast<double>(end - rateNs) / 1e9;
+                metrics->instructionsPerSecond.Set(static_cast<double>(chip8.cycles - rateCycles) / seconds);
+                metrics->framesPerSecond.Set(static_cast<double>(number + 1 - rateFrames) / seconds);
+                rateNs = end;
+                rateCycles = chip8.cycles;
+                rateFrames = number + 1;
+            }
+        }
+        frame.publishedNs = NowNs();
+
+        if (recorder != nullptr) {
+            recorder->Submit(frame);
+        }
+
+        frames.Publish();
+
+        if (frameExport != nullptr) {
+            frameExport->Publish(exportSlot, chip8, number, end, displayChanged);
+        }
+
+        emulationTimes.Record(static_cast<uint64_t>(end - start));
+
+        // Under the debugger a trap or an exit is the client's to deal with
+        if (debug == nullptr && (chip8.trap != Trap::None || chip8.halted)) {
+            break;
+        }
+
+        if (watchdog != nullptr && !inputEnded.load(std::memory_order_relaxed)) {
+            // Keys can still change what the program does, so a repeated state proves nothing yet
+            watchdog->Reset();
+        }
+        else if (watchdog != nullptr && watchdog->Frame(chip8)) {
+            ReportHang(chip8, *watchdog, options.cyclesPerFrame, number);
+            break;
+        }
+
+        // If we fell more than a few frames behind (suspended, debugger) pick up from now instead of racing to catch up
+        deadline += FRAME_TIME;
+        Clock::time_point now = Clock::now();
+        if (now - deadline > 4 * FRAME_TIME) {
+            deadline = now;
+        }
+        std::this_thread::sleep_until(deadline);
+    }
+
+    running = false;
+
+    // Wake the presentation thread so it notices we're done
+    frames.Publish();
+}
+
+/**
+ * Presentation thread. Draws the newest frame whenever one is published; frames published while it was busy are
+ * skipped rather than queued.
+ */
+static void Present(Renderer &renderer, TripleBuffer<Frame> &frames, Histogram &presentIntervals,
+                    Histogram &latencies, EmulatorMetrics *metrics) {
+    int64_t lastPresent = 0;
+    int64_t lastInputNs = 0;
+    uint64_t presented = 0;
+    Trace::NameThread("presentation");
+
+    while (running) {
+        frames.Wait();
+
+        // The wake-up published at shutdown hands back a slot we may have drawn already, or one never written at all
+        if (!frames.Consume() || frames.ReadBuffer().publishedNs == 0 ||
+            (presented > 0 && frames.ReadBuffer().number < presented)) {
+            continue;
+        }
+
+        const Frame &frame = frames.ReadBuffer();
+        {
+            TraceSpan span("present", "render", "frame", frame.number);
+            renderer.Present(frame);
+        }
+        presented = frame.number + 1;
+
+        int64_t now = NowNs();
+        latencies.Record(static_cast<uint64_t>(now - frame.publishedNs));
+
+        // Frames skipped since the display changed carry the same time, so it is counted on whichever is drawn first
+        if (metrics != nullptr && frame.inputNs != lastInputNs) {
+            metrics->inputLatency.Record(static_cast<uint64_t>(now - frame.inputNs));
+            lastInputNs = frame.inputNs;
+        }
+        if (lastPresent != 0) {
+            presentIntervals.Record(static_cast<uint64_t>(now - lastPresent));
+        }
+        lastPresent = now;
+    }
 }
 
-int main() {
-    NewClass myNewClass(7, 6);
-    std::cout << myNewClass.firstVar << " " << myNewClass.secondVar << std::endl;
-    return 0;
+static const char *TrapName(Trap trap) {
+    switch (trap) {
+        case Trap::StackOverflow: return "stack overflow";
+        case Trap::StackUnderflow: return "return with an empty stack";
+        case Trap::KeyOutOfRange: return "key above 15";
+        default: return "none";
+    }
+}
+
+static void Report(const char *name, const Histogram &samples) {
+    if (samples.Count() == 0) {
+        return;
+    }
+
+    std::cerr << name << " (us): p50 " << samples.Percentile(0.50) / 1000.0 << "  p99 "
+              << samples.Percentile(0.99) / 1000.0 << "  max " << samples.Max() / 1000.0 << "  n " << samples.Count()
+              << "\n";
+}
+
+int main(int argc, char **argv) {
+    Options options;
+
+    if (!ParseOptions(argc, argv, options)) {
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    Chip8 chip8;
+
+    if (!chip8.LoadROM(options.rom)) {
+        std::cerr << "Could not open ROM " << options.rom << "\n";
+        return EXIT_FAILURE;
+    }
+
+    // The debugger steps through Cycle() and reports traps itself, so there is nothing to verify for it
+    bool verified = false;
+    if (options.debug == nullptr && !options.checked) {
+        Verification verification = Verify(Analyze(chip8.memory + ROM_START, MEMORY_SIZE - ROM_START));
+        verified = verification.safe;
+
+        if (verified) {
+            std::cerr << "running unchecked: ROM verified in bounds\n";
+        }
+        else {
+            char address[8];
+            snprintf(address, sizeof(address), "0x%03X", verification.address);
+            std::cerr << "running checked: " << verification.reason << " at " << address << "\n";
+        }
+    }
+
+    std::signal(SIGINT, Stop);
+    std::signal(SIGTERM, Stop);
+
+    // Samples for the report at exit, kept as histograms so a long run doesn't grow them
+    Histogram emulationTimes;
+    Histogram presentIntervals;
+    Histogram latencies;
+    uint64_t terminalBytes = 0;
+
+    {
+        // Created first so it finishes the file last, once every thread it traces has stopped
+        std::unique_ptr<Tracer> tracer;
+        if (options.trace != nullptr) {
+            tracer = std::make_unique<Tracer>(options.trace);
+            if (!tracer->IsOpen()) {
+                std::cerr << "Could not open " << options.trace << " for tracing\n";
+                return EXIT_FAILURE;
+            }
+        }
+
+        // Only destroyed once the threads updating them have stopped, so the exporter's last file has the final totals
+        MetricsRegistry registry;
+        std::unique_ptr<EmulatorMetrics> metrics;
+        std::unique_ptr<MetricsExporter> exporter;
+        if (options.metricsPort != 0 || options.metricsFile != nullptr) {
+            metrics = std::make_unique<EmulatorMetrics>(registry);
+            exporter = std::make_unique<MetricsExporter>(registry, static_cast<uint16_t>(options.metricsPort),
+                                                         options.metricsFile != nullptr ? options.metricsFile : "",
+                                                         options.metricsInterval * 1000);
+            if (!exporter->IsOpen()) {
+                std::cerr << "Could not export metrics\n";
+                return EXIT_FAILURE;
+            }
+        }
+
+        auto frames = std::make_unique<TripleBuffer<Frame>>();
+        std::atomic<uint16_t> keys{0};
+        std::atomic<int64_t> keysNs{0};
+        std::atomic<bool> inputEnded{false};
+        TerminalInput input(STDIN_FILENO);
+
+        std::unique_ptr<Recorder> recorder;
+        if (options.record != nullptr) {
+            size_t length = strlen(options.record);
+            bool y4m = length >= 4 && strcmp(options.record + length - 4, ".y4m") == 0;
+            if (options.postProcess && !y4m) {
+                std::cerr << "--postprocess only applies to .y4m recordings\n";
+                return EXIT_FAILURE;
+            }
+
+            PostProcessSettings postProcess;
+            recorder = std::make_unique<Recorder>(options.record, y4m ? RecordFormat::Y4M : RecordFormat::RAW,
+                                                  options.recordScale, options.postProcess ? &postProcess : nullptr);
+            if (!recorder->IsOpen()) {
+                std::cerr << "Could not open " << options.record << " for recording\n";
+                return EXIT_FAILURE;
+            }
+        }
+
+        std::unique_ptr<AudioOutput> audio;
+        std::unique_ptr<Beeper> beeper;
+        if (options.audio != nullptr) {
+            std::unique_ptr<AudioSink> sink;
+
+            if (strcmp(options.audio, "null") == 0) {
+                sink = std::make_unique<NullAudioSink>();
+            }
+            else {
+                auto wav = std::make_unique<WavAudioSink>(options.audio, options.sampleRate);
+                if (!wav->IsOpen()) {
+                    std::cerr << "Could not open " << options.audio << " for audio\n";
+                    return EXIT_FAILURE;
+                }
+                sink = std::move(wav);
+            }
+
+            audio = std::make_unique<AudioOutput>(std::move(sink));
+            beeper = std::make_unique<Beeper>(*audio, options.sampleRate, options.cyclesPerFrame);
+        }
+
+        std::unique_ptr<DebugSession> debug;
+        if (options.debug != nullptr) {
+            debug = std::make_unique<DebugSession>(chip8, options);
+            if (!debug->server.IsOpen()) {
+                std::cerr << "Could not listen on " << options.debug << "\n";
+                return EXIT_FAILURE;
+            }
+        }
+
+        std::unique_ptr<FrameExport> frameExport;
+        int exportSlot = -1;
+        if (options.exportName != nullptr) {
+            frameExport = std::make_unique<FrameExport>(options.exportName, FRAME_EXPORT_DEFAULT_SLOTS);
+            exportSlot = frameExport->IsOpen() ? frameExport->Claim(0) : -1;
+            if (exportSlot < 0) {
+                std::cerr << "Could not export frames to " << options.exportName << "\n";
+                return EXIT_FAILURE;
+            }
+        }
+
+        std::unique_ptr<Renderer> renderer;
+        TerminalRenderer *terminal = nullptr;
+        if (options.headless || !isatty(STDOUT_FILENO)) {
+            renderer = std::make_unique<NullRenderer>();
+        }
+        else {
+            renderer = std::make_unique<TerminalRenderer>(STDOUT_FILENO);
+            terminal = static_cast<TerminalRenderer *>(renderer.get());
+        }
+
+        std::thread presentation(Present, std::ref(*renderer), std::ref(*frames), std::ref(presentIntervals),
+                                 std::ref(latencies), metrics.get());
+        std::unique_ptr<Watchdog> watchdog;
+        if (options.watchdog) {
+            watchdog = std::make_unique<Watchdog>();
+        }
+
+        std::thread emulation(Emulate, std::ref(chip8), std::ref(*frames), std::cref(options), std::cref(keys),
+                              std::cref(inputEnded), recorder.get(), beeper.get(), debug.get(), watchdog.get(),
+                              frameExport.get(), exportSlot, verified, std::ref(emulationTimes),
+                              std::cref(keysNs), metrics.get());
+
+        // The main thread is left with the keyboard
+        Trace::NameThread("input");
+        while (running) {
+            if (!input.Poll(5)) {
+                running = false;
+            }
+            uint16_t pressed = input.Keys();
+            if (pressed != keys.load(std::memory_order_relaxed)) {
+                // The time first, so the emulation thread sees it with the keys it belongs to
+                keysNs.store(NowNs(), std::memory_order_relaxed);
+                keys.store(pressed, std::memory_order_release);
+            }
+            inputEnded.store(input.Ended(), std::memory_order_relaxed);
+        }
+
+        emulation.join();
+        presentation.join();
+
+        if (terminal != nullptr) {
+            terminalBytes = terminal->BytesWritten();
+        }
+
+        if (recorder != nullptr && recorder->Dropped() > 0) {
+            std::cerr << "recorder dropped " << recorder->Dropped() << " frames\n";
+        }
+
+        if (audio != nullptr && audio->Dropped() > 0) {
+            std::cerr << "audio dropped " << audio->Dropped() << " blocks\n";
+        }
+
+        if (tracer != nullptr && tracer->Dropped() > 0) {
+            std::cerr << "trace dropped " << tracer->Dropped() << " events\n";
+        }
+    }
+
+    if (chip8.trap != Trap::None) {
+        char address[8];
+        snprintf(address, sizeof(address), "0x%03X", chip8.pc);
+        std::cerr << "trapped: " << TrapName(chip8.trap) << " at " << address << "\n";
+    }
+    else if (chip8.halted) {
+        char address[8];
+        snprintf(address, sizeof(address), "0x%03X", chip8.pc);
+        std::cerr << "exited: 00FD at " << address << "\n";
+    }
+
+    Report("emulation time per frame", emulationTimes);
+    Report("present interval", presentIntervals);
+    Report("publish to present latency", latencies);
+
+    if (terminalBytes > 0 && latencies.Count() > 0) {
+        std::cerr << "terminal bytes per frame: " << terminalBytes / latencies.Count() << "\n";
+    }
+
+    return EXIT_SUCCESS;
 }
@@ -0,0 +1,373 @@
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "Analyzer.h"
+#include "Frame.h"
+#include "Hash.h"
+#include "Netplay.h"
+#include "TerminalInput.h"
+#include "TerminalRenderer.h"
+#include "Verifier.h"
+
+using Clock = std::chrono::steady_clock;
+
+const std::chrono::nanoseconds FRAME_TIME(1000000000 / 60);
+
+struct Options {
+    const char *rom = nullptr;
+    NetplayOptions netplay;
+    uint16_t port = 7800;
+    uint16_t peerPort = 7801;
+    LinkFaults faults;
+    uint64_t frames = 0;
+    // Play with random keys instead of the keyboard; 0 to use the keyboard when there is one
+    uint32_t bot = 0;
+    bool selfTest = false;
+    bool checked = false;
+};
+
+static std::atomic<bool> running{true};
+
+static void Stop(int) {
+    running = false;
+}
+
+static void Usage(const char *program) {
+    std::cerr << "Usage: " << program << " [options] <ROM>\n"
+              << "  --player N     0 (left half of the keypad) or 1 (right half)\n"
+              << "  --port N       UDP port on 127.0.0.1 to receive on (default 7800)\n"
+              << "  --peer N       UDP port the other player receives on (default 7801)\n"
+              << "  --delay N      frames of input delay (default 2)\n"
+              << "  --rollback N   most frames to roll back (default 8)\n"
+              << "  --whole-keypad both players may use every key\n"
+              << "  --cycles N     instructions per frame (default 11)\n"
+              << "  --seed N       random number seed; player 0's is used (default 0)\n"
+              << "  --latency MS   delay every packet sent\n"
+              << "  --jitter MS    delay packets by up to this much more\n"
+              << "  --loss P       drop this fraction of packets sent\n"
+              << "  --frames N     stop after N frames\n"
+              << "  --bot SEED     press random keys instead of reading the keyboard\n"
+              << "  --self-test    play both sides against each other in this process and check they agree\n"
+              << "  --checked      always run with stack and key checks\n";
+}
+
+static bool ParseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--player") == 0 && i + 1 < argc) {
+            options.netplay.player = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            options.port = static_cast<uint16_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--peer") == 0 && i + 1 < argc) {
+            options.peerPort = static_cast<uint16_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--delay") == 0 && i + 1 < argc) {
+            options.netplay.inputDelay = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--rollback") == 0 && i + 1 < argc) {
+            options.netplay.maxRollback = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--whole-keypad") == 0) {
+            options.netplay.wholeKeypad = true;
+        }
+        else if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+            options.netplay.cyclesPerFrame = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            options.netplay.seed = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--latency") == 0 && i + 1 < argc) {
+            options.faults.latencyMs = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--jitter") == 0 && i + 1 < argc) {
+            options.faults.jitterMs = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--loss") == 0 && i + 1 < argc) {
+            options.faults.loss = std::strtod(argv[++i], nullptr);
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            options.frames = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--bot") == 0 && i + 1 < argc) {
+            options.bot = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--self-test") == 0) {
+            options.selfTest = true;
+        }
+        else if (strcmp(argv[i], "--checked") == 0) {
+            options.checked = true;
+        }
+        else if (argv[i][0] != '-' && options.rom == nullptr) {
+            options.rom = argv[i];
+        }
+        else {
+            return false;
+        }
+    }
+
+    // The input delay and rollback window both bound how many inputs can be unacknowledged in one packet
+    const NetplayOptions &netplay = options.netplay;
+    return options.rom != nullptr && netplay.player <= 1 && netplay.cyclesPerFrame > 0 &&
+           netplay.cyclesPerFrame <= 0xFFFF && netplay.inputDelay <= 30 && netplay.maxRollback > 0 &&
+           netplay.maxRollback <= 60 && options.faults.loss >= 0 && options.faults.loss < 1 &&
+           (!options.selfTest || options.frames > 0);
+}
+
+/**
+ * Random keys from one player's half, each combination held for a random number of frames like a person would.
+ */
+class Bot {
+public:
+    Bot(uint32_t seed, uint16_t mask) : random(seed), mask(mask) {}
+
+    uint16_t Keys() {
+        if (held == 0) {
+            keys = static_cast<uint16_t>(random() & random() & mask);
+            held = 5 + random() % 40;
+        }
+        --held;
+        return keys;
+    }
+
+private:
+    std::minstd_rand random;
+    uint16_t mask;
+    uint16_t keys = 0;
+    unsigned int held = 0;
+};
+
+struct Side {
+    std::unique_ptr<Chip8> chip8;
+    std::unique_ptr<UdpLink> link;
+    std::unique_ptr<Netplay> netplay;
+    std::string error;
+    uint64_t hash = 0;
+};
+
+static bool Verified(const Chip8 &chip8, const Options &options) {
+    return !options.checked && Verify(Analyze(chip8.memory + ROM_START, MEMORY_SIZE - ROM_START)).safe;
+}
+
+/**
+ * Play one side at 60 frames a second until frames have been run (or forever), then keep answering the other side
+ * until every frame is confirmed and it has all our input. With finished, a count of the sides that got that far,
+ * keep answering until both have.
+ */
+static void Play(Side &side, const Options &options, uint64_t romHash, Bot *bot, TerminalInput *input,
+                 TerminalRenderer *renderer, std::atomic<int> *finished) {
+    if (!side.netplay->Connect(romHash, std::chrono::seconds(30), side.error)) {
+        return;
+    }
+
+    Clock::time_point deadline = Clock::now();
+    Frame frame;
+
+    while (running && (options.frames == 0 || side.netplay->Frame() < options.frames)) {
+        if (input != nullptr && !input->Poll(0)) {
+            running = false;
+            break;
+        }
+
+        // A side more than a frame ahead of the other sits a frame out, so neither has to keep rolling back
+        if (side.netplay->FramesAhead() > 1) {
+            side.netplay->Poll();
+        }
+        else {
+            uint16_t keys = bot != nullptr ? bot->Keys() : input != nullptr ? input->Keys() : 0;
+            if (side.netplay->Advance(keys) && renderer != nullptr) {
+                PackDisplay(*side.chip8, frame);
+                renderer->Present(frame);
+            }
+        }
+
+        deadline += FRAME_TIME;
+        if (Clock::now() - deadline > 4 * FRAME_TIME) {
+            deadline = Clock::now();
+        }
+        while (Clock::now() < deadline) {
+            side.netplay->Poll();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    // Settle the last frames, then linger long enough for the other side to get our last inputs too
+    Clock::time_point giveUp = Clock::now() + std::chrono::seconds(5);
+    uint64_t target = side.netplay->Frame();
+    bool settled = false;
+    while (Clock::now() < giveUp && (!settled || (finished != nullptr && finished->load() < 2))) {
+        side.netplay->Poll();
+        if (!settled && side.netplay->Confirmed() >= target && side.netplay->Acknowledged()) {
+            settled = true;
+            if (finished != nullptr) {
+                finished->fetch_add(1);
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    side.hash = Netplay::StateHash(*side.chip8);
+}
+
+static void Report(const char *name, const Side &side) {
+    NetplayStats stats = side.netplay->Stats();
+    LinkStats link = side.link->Stats();
+    fprintf(stderr, "%s: %llu frames, %llu stalls, %llu rollbacks re-running %llu frames (deepest %u, slowest "
+                    "%.3f ms)\n", name, static_cast<unsigned long long>(stats.frames),
+            static_cast<unsigned long long>(stats.stalls), static_cast<unsigned long long>(stats.rollbacks),
+            static_cast<unsigned long long>(stats.resimulated), stats.deepestRollback,
+            static_cast<double>(stats.slowestRollbackNs) / 1e6);
+    fprintf(stderr, "%s: %llu packets sent, %llu dropped, %llu received; %llu state checks, %llu desyncs\n", name,
+            static_cast<unsigned long long>(link.sent), static_cast<unsigned long long>(link.dropped),
+            static_cast<unsigned long long>(link.received), static_cast<unsigned long long>(stats.checks),
+            static_cast<unsigned long long>(stats.desyncs));
+}
+
+static std::unique_ptr<Side> MakeSide(const std::vector<uint8_t> &rom, const Options &options, unsigned int player,
+                                      uint16_t port, uint16_t peerPort, uint32_t faultSeed) {
+    auto side = std::make_unique<Side>();
+    side->chip8 = std::make_unique<Chip8>();
+    side->chip8->LoadROM(rom.data(), rom.size());
+
+    LinkFaults faults = options.faults;
+    faults.seed = faultSeed;
+    side->link = std::make_unique<UdpLink>(port, peerPort, faults);
+
+    NetplayOptions netplay = options.netplay;
+    netplay.player = player;
+    side->netplay = std::make_unique<Netplay>(*side->chip8, Verified(*side->chip8, options), *side->link, netplay);
+    return side;
+}
+
+/**
+ * Both players in one process on two threads, talking over loopback with the faults injected in both directions.
+ * Afterwards both machines, and a third that replays the confirmed inputs without any rollback, must agree.
+ */
+static int SelfTest(const std::vector<uint8_t> &rom, const Options &options, uint64_t romHash) {
+    std::unique_ptr<Side> sides[2] = {
+            MakeSide(rom, options, 0, options.port, options.peerPort, options.faults.seed),
+            MakeSide(rom, options, 1, options.peerPort, options.port, options.faults.seed + 1)};
+    if (!sides[0]->link->IsOpen() || !sides[1]->link->IsOpen()) {
+        std::cerr << "Could not bind UDP ports " << options.port << " and " << options.peerPort << "\n";
+        return EXIT_FAILURE;
+    }
+
+    uint16_t masks[2] = {options.netplay.wholeKeypad ? uint16_t(0xFFFF) : NETPLAY_LEFT_KEYS,
+                         options.netplay.wholeKeypad ? uint16_t(0xFFFF) : NETPLAY_RIGHT_KEYS};
+    Bot bots[2] = {Bot(options.bot + 1, masks[0]), Bot(options.bot + 2, masks[1])};
+    std::atomic<int> finished{0};
+
+    std::thread threads[2];
+    for (unsigned int player = 0; player < 2; ++player) {
+        threads[player] = std::thread(Play, std::ref(*sides[player]), std::cref(options), romHash, &bots[player],
+                                      nullptr, nullptr, &finished);
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    for (const auto &side : sides) {
+        if (!side->error.empty()) {
+            std::cerr << side->error << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    Report("player 0", *sides[0]);
+    Report("player 1", *sides[1]);
+
+    const std::vector<uint16_t> &left = sides[0]->netplay->Inputs(0);
+    const std::vector<uint16_t> &right = sides[0]->netplay->Inputs(1);
+    if (left != sides[1]->netplay->Inputs(0) || right != sides[1]->netplay->Inputs(1)) {
+        std::cerr << "the two sides disagree about the inputs\n";
+        return EXIT_FAILURE;
+    }
+
+    auto replay = std::make_unique<Chip8>();
+    replay->LoadROM(rom.data(), rom.size());
+    replay->randGen.seed(options.netplay.seed);
+    bool verified = Verified(*replay, options);
+    for (uint64_t frame = 0; frame < options.frames; ++frame) {
+        Netplay::RunFrame(*replay, left[frame] | right[frame], options.netplay.cyclesPerFrame, verified);
+    }
+    uint64_t expected = Netplay::StateHash(*replay);
+
+    bool agree = sides[0]->hash == expected && sides[1]->hash == expected &&
+                 sides[0]->netplay->Stats().desyncs == 0 && sides[1]->netplay->Stats().desyncs == 0;
+    printf("after %llu frames: player 0 %016llx, player 1 %016llx, replay %016llx: %s\n",
+           static_cast<unsigned long long>(options.frames), static_cast<unsigned long long>(sides[0]->hash),
+           static_cast<unsigned long long>(sides[1]->hash), static_cast<unsigned long long>(expected),
+           agree ? "in sync" : "DESYNC");
+    return agree ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char **argv) {
+    Options options;
+
+    if (!ParseOptions(argc, argv, options)) {
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::ifstream file(options.rom, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Could not open " << options.rom << "\n";
+        return EXIT_FAILURE;
+    }
+    std::vector<uint8_t> rom((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    uint64_t romHash = HashBytes(0, rom.data(), rom.size());
+
+    if (options.selfTest) {
+        return SelfTest(rom, options, romHash);
+    }
+
+    std::signal(SIGINT, Stop);
+    std::signal(SIGTERM, Stop);
+
+    unsigned int player = options.netplay.player;
+    std::unique_ptr<Side> side = MakeSide(rom, options, player, options.port, options.peerPort, options.faults.seed);
+    if (!side->link->IsOpen()) {
+        std::cerr << "Could not bind UDP port " << options.port << "\n";
+        return EXIT_FAILURE;
+    }
+
+    std::unique_ptr<Bot> bot;
+    std::unique_ptr<TerminalInput> input;
+    std::unique_ptr<TerminalRenderer> renderer;
+    if (options.bot != 0 || !isatty(STDIN_FILENO)) {
+        bot = std::make_unique<Bot>(options.bot, options.netplay.wholeKeypad ? 0xFFFF : player == 0 ?
+                                                                                       NETPLAY_LEFT_KEYS :
+                                                                                       NETPLAY_RIGHT_KEYS);
+    }
+    else {
+        input = std::make_unique<TerminalInput>(STDIN_FILENO);
+    }
+    if (isatty(STDOUT_FILENO)) {
+        renderer = std::make_unique<TerminalRenderer>(STDOUT_FILENO);
+    }
+
+    Play(*side, options, romHash, bot.get(), input.get(), renderer.get(), nullptr);
+    renderer.reset();
+
+    if (!side->error.empty()) {
+        std::cerr << side->error << "\n";
+        return EXIT_FAILURE;
+    }
+
+    Report(player == 0 ? "player 0" : "player 1", *side);
+    // Both sides print the same hash when they stop on the same frame in sync
+    fprintf(stderr, "state after %llu frames: %016llx\n", static_cast<unsigned long long>(side->netplay->Frame()),
+            static_cast<unsigned long long>(side->hash));
+    return side->netplay->Stats().desyncs == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
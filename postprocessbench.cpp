@@ -0,0 +1,119 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include "Histogram.h"
+#include "PostProcessor.h"
+#include "ThreadPool.h"
+
+// The frame time PostProcessor was written to stay under at 1080p
+static const double TARGET_MS = 1.0;
+
+struct Options {
+    double seconds = 2;
+    // Threads for the pooled run, the caller included; 0 for one per core
+    unsigned int threads = 0;
+    // 15 makes 1920x960, the largest whole scale of 128x64 that fits 1080p
+    unsigned int scale = 15;
+    float mask = 0.0f;
+};
+
+static void Usage(const char *program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --seconds N    how long to run each configuration (default 2)\n"
+              << "  --threads N    threads for the pooled run, including the caller (default one per core)\n"
+              << "  --scale N      output scale of the 128x64 source (default 15, 1920x960)\n"
+              << "  --mask F       aperture grille strength, 0 to 1 (default 0)\n";
+}
+
+static bool ParseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            options.seconds = std::strtod(argv[++i], nullptr);
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.threads = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+            options.scale = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--mask") == 0 && i + 1 < argc) {
+            options.mask = std::strtof(argv[++i], nullptr);
+        }
+        else {
+            return false;
+        }
+    }
+
+    return options.seconds > 0 && options.scale > 0 && options.mask >= 0.0f && options.mask <= 1.0f;
+}
+
+/**
+ * Process frames alternating between two random pictures, the worst case for the phosphor, for the given time and
+ * report the time each took.
+ */
+static void Run(const char *name, const Options &options, ThreadPool *pool) {
+    PostProcessSettings settings;
+    settings.mask = options.mask;
+    PostProcessor processor(PixelFormat::RGBA8888, options.scale, settings, pool);
+
+    std::mt19937 random(1);
+    Frame frames[2];
+    for (Frame &frame : frames) {
+        frame.width = HIRES_VIDEO_WIDTH;
+        frame.height = HIRES_VIDEO_HEIGHT;
+        for (auto &row : frame.pixels) {
+            for (uint8_t &byte : row) {
+                byte = static_cast<uint8_t>(random());
+            }
+        }
+    }
+
+    // Aligned like a real framebuffer, so rows take the streaming store path
+    size_t pitch = processor.Width() * sizeof(uint32_t);
+    size_t size = (pitch * processor.Height() + 31) / 32 * 32;
+    std::unique_ptr<uint8_t, decltype(&free)> out(static_cast<uint8_t *>(aligned_alloc(32, size)), free);
+
+    using Clock = std::chrono::steady_clock;
+    Histogram times;
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; std::chrono::duration<double>(Clock::now() - start).count() < options.seconds; ++i) {
+        Clock::time_point before = Clock::now();
+        processor.Process(frames[i % 2], out.get(), pitch);
+        times.Record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now() - before).count()));
+    }
+
+    double p50 = times.Percentile(0.50) / 1e6;
+    double p99 = times.Percentile(0.99) / 1e6;
+    char line[160];
+    snprintf(line, sizeof(line), "%-12s %ux%u: p50 %.3f ms  p99 %.3f ms  mean %.3f ms  (%llu frames)  %s\n", name,
+             processor.Width(), processor.Height(), p50, p99,
+             static_cast<double>(times.Sum()) / static_cast<double>(times.Count()) / 1e6,
+             static_cast<unsigned long long>(times.Count()),
+             p99 < TARGET_MS ? "under the 1 ms target" : "over the 1 ms target");
+    std::cout << line;
+}
+
+int main(int argc, char **argv) {
+    Options options;
+
+    if (!ParseOptions(argc, argv, options)) {
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    Run("1 thread", options, nullptr);
+
+    std::unique_ptr<ThreadPool> pool = ThreadPool::ForThreads(options.threads);
+    if (pool != nullptr && pool->Size() > 1) {
+        char name[32];
+        snprintf(name, sizeof(name), "%u threads", pool->Size());
+        Run(name, options, pool.get());
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,328 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+#include "Analyzer.h"
+#include "Histogram.h"
+#include "Verifier.h"
+#include "WorkStealingScheduler.h"
+
+using Clock = std::chrono::steady_clock;
+
+// Frames a real-time session may owe, as WorkStealingOptions::maxBacklog
+const unsigned int BACKLOG = 4;
+
+struct Options {
+    const char *rom = nullptr;
+    unsigned int realTime = 1000;
+    unsigned int batch = 0;
+    unsigned int workers = 0;
+    double seconds = 5;
+    unsigned int cyclesPerFrame = 11;
+    // Key changes a second for every real-time session
+    double keyRate = 1;
+    uint32_t seed = 1;
+    bool threadPerSession = false;
+    bool checked = false;
+};
+
+static void Usage(const char *program) {
+    std::cerr << "Usage: " << program << " [options] <ROM>\n"
+              << "  --realtime N         real-time sessions, run at 60 frames a second (default 1000)\n"
+              << "  --batch N            batch sessions, run as fast as the time left over allows (default 0)\n"
+              << "  --workers N          worker threads (default one per core)\n"
+              << "  --seconds N          how long to run for (default 5)\n"
+              << "  --cycles N           instructions per frame (default 11)\n"
+              << "  --key-rate N         key presses and releases a second per real-time session (default 1)\n"
+              << "  --seed N             seed for the keys and the machines (default 1)\n"
+              << "  --thread-per-session run every session on a thread of its own instead, to compare\n"
+              << "  --checked            always run with stack and key checks\n";
+}
+
+static bool ParseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--realtime") == 0 && i + 1 < argc) {
+            options.realTime = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            options.batch = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            options.workers = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            options.seconds = std::strtod(argv[++i], nullptr);
+        }
+        else if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+            options.cyclesPerFrame = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--key-rate") == 0 && i + 1 < argc) {
+            options.keyRate = std::strtod(argv[++i], nullptr);
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            options.seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--thread-per-session") == 0) {
+            options.threadPerSession = true;
+        }
+        else if (strcmp(argv[i], "--checked") == 0) {
+            options.checked = true;
+        }
+        else if (argv[i][0] == '-') {
+            return false;
+        }
+        else {
+            options.rom = argv[i];
+        }
+    }
+
+    return options.rom != nullptr && options.realTime + options.batch > 0 && options.cyclesPerFrame > 0;
+}
+
+static std::unique_ptr<Chip8> Boot(const std::vector<uint8_t> &rom, uint32_t seed) {
+    auto chip8 = std::make_unique<Chip8>();
+    chip8->LoadROM(rom.data(), rom.size());
+    chip8->randGen.seed(seed);
+    return chip8;
+}
+
+/**
+ * Toggle a random key on about keyRate of the real-time sessions a second, at 60 frames a second until the end.
+ */
+template <typename SetKeys>
+static void PressKeys(const Options &options, Clock::time_point end, SetKeys setKeys) {
+    std::minstd_rand random(options.seed);
+    std::bernoulli_distribution change(std::min(1.0, options.keyRate / 60));
+    std::vector<uint16_t> keys(options.realTime);
+    auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / 60));
+
+    for (Clock::time_point next = Clock::now(); next < end; next += period) {
+        std::this_thread::sleep_until(next);
+        for (unsigned int i = 0; options.keyRate > 0 && i < options.realTime; ++i) {
+            if (change(random)) {
+                keys[i] = keys[i] != 0 ? 0 : static_cast<uint16_t>(1u << (random() % 16));
+                setKeys(i, keys[i]);
+            }
+        }
+    }
+}
+
+static void Run(unsigned int count, Chip8 &chip8, bool verified) {
+    for (unsigned int i = 0; i < count && !chip8.halted && chip8.trap == Trap::None; ++i) {
+        if (verified) {
+            chip8.CycleUnchecked();
+        }
+        else {
+            chip8.Cycle();
+        }
+    }
+}
+
+static double Ms(uint64_t ns) {
+    return static_cast<double>(ns) / 1e6;
+}
+
+static void ReportSessions(const std::vector<SessionReport> &reports, const Histogram &latency, double seconds) {
+    uint64_t realTimeFrames = 0;
+    uint64_t parkedFrames = 0;
+    uint64_t missed = 0;
+    uint64_t dropped = 0;
+    uint64_t batchFrames = 0;
+    uint64_t batchMin = UINT64_MAX;
+    uint64_t batchMax = 0;
+    unsigned int parked = 0;
+    unsigned int ended = 0;
+    std::vector<uint64_t> p99s;
+    std::vector<uint64_t> p999s;
+
+    for (const SessionReport &report : reports) {
+        parked += report.parked;
+        ended += report.ended;
+        if (report.kind == SessionClass::RealTime) {
+            realTimeFrames += report.frames;
+            parkedFrames += report.parkedFrames;
+            missed += report.missed;
+            dropped += report.dropped;
+            p99s.push_back(report.latencyP99);
+            p999s.push_back(report.latencyP999);
+        }
+        else {
+            batchFrames += report.frames;
+            batchMin = std::min(batchMin, report.frames);
+            batchMax = std::max(batchMax, report.frames);
+        }
+    }
+
+    if (!p99s.empty()) {
+        std::sort(p99s.begin(), p99s.end());
+        std::sort(p999s.begin(), p999s.end());
+        printf("real-time: %llu frames, %.1f%% parked, %llu late (%.2f%%), %llu dropped\n",
+               static_cast<unsigned long long>(realTimeFrames),
+               realTimeFrames > 0 ? 100.0 * static_cast<double>(parkedFrames) / static_cast<double>(realTimeFrames) : 0,
+               static_cast<unsigned long long>(missed),
+               realTimeFrames > 0 ? 100.0 * static_cast<double>(missed) / static_cast<double>(realTimeFrames) : 0,
+               static_cast<unsigned long long>(dropped));
+        printf("  frame latency (ms): p50 %.3f  p99 %.3f  p999 %.3f  max %.3f\n", Ms(latency.Percentile(0.5)),
+               Ms(latency.Percentile(0.99)), Ms(latency.Percentile(0.999)), Ms(latency.Max()));
+        printf("  per session p99 (ms): median %.3f  worst %.3f; p999 worst %.3f\n", Ms(p99s[p99s.size() / 2]),
+               Ms(p99s.back()), Ms(p999s.back()));
+    }
+    if (batchMax > 0) {
+        printf("batch: %llu frames, %.0f frames/s, %llu to %llu a session\n",
+               static_cast<unsigned long long>(batchFrames), static_cast<double>(batchFrames) / seconds,
+               static_cast<unsigned long long>(batchMin), static_cast<unsigned long long>(batchMax));
+    }
+    printf("%u parked and %u ended at the end\n", parked, ended);
+}
+
+/**
+ * The same sessions with a thread each: real-time ones sleep until each frame is due, batch ones never sleep.
+ */
+static void ThreadPerSession(const Options &options, const std::vector<uint8_t> &rom, bool verified) {
+    unsigned int total = options.realTime + options.batch;
+    std::vector<std::unique_ptr<Chip8>> machines;
+    std::vector<std::unique_ptr<Histogram>> latencies;
+    std::vector<std::atomic<uint16_t>> keys(options.realTime);
+    std::vector<uint64_t> frames(total);
+    std::vector<uint64_t> missed(total);
+    std::vector<uint64_t> dropped(total);
+    for (unsigned int i = 0; i < total; ++i) {
+        machines.push_back(Boot(rom, options.seed + i));
+        latencies.push_back(std::make_unique<Histogram>());
+    }
+
+    auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / 60));
+    Clock::time_point start = Clock::now();
+    Clock::time_point end = start + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(options.seconds));
+    std::atomic<bool> stopping{false};
+
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < total; ++i) {
+        threads.emplace_back([&, i]() {
+            Chip8 &chip8 = *machines[i];
+            bool realTime = i < options.realTime;
+            uint64_t tick = 0;
+            while (!stopping && !chip8.halted && chip8.trap == Trap::None) {
+                Clock::time_point released = start + static_cast<Clock::duration::rep>(tick) * period;
+                if (realTime) {
+                    std::this_thread::sleep_until(released);
+                    uint16_t held = keys[i].load(std::memory_order_relaxed);
+                    for (unsigned int key = 0; key < 16; ++key) {
+                        chip8.keys[key] = (held >> key) & 0x1u;
+                    }
+                }
+                Run(options.cyclesPerFrame, chip8, verified);
+                chip8.TickTimers();
+                ++frames[i];
+                ++tick;
+
+                if (realTime) {
+                    Clock::time_point now = Clock::now();
+                    auto latency = now - released;
+                    latencies[i]->Record(static_cast<uint64_t>(std::max<int64_t>(
+                            0, std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count())));
+                    missed[i] += latency > period;
+
+                    // Fall behind by no more than the scheduler lets a session, dropping frames the same way
+                    auto due = static_cast<uint64_t>((now - start) / period) + 1;
+                    if (due > tick + BACKLOG) {
+                        dropped[i] += due - BACKLOG - tick;
+                        tick = due - BACKLOG;
+                    }
+                }
+            }
+        });
+    }
+
+    PressKeys(options, end, [&keys](unsigned int i, uint16_t held) {
+        keys[i].store(held, std::memory_order_relaxed);
+    });
+    stopping = true;
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::vector<SessionReport> reports;
+    Histogram latency;
+    for (unsigned int i = 0; i < total; ++i) {
+        const Histogram &session = *latencies[i];
+        reports.push_back(SessionReport{i < options.realTime ? SessionClass::RealTime : SessionClass::Batch,
+                                        machines[i]->halted || machines[i]->trap != Trap::None, false, frames[i], 0,
+                                        missed[i], dropped[i], session.Percentile(0.5), session.Percentile(0.99),
+                                        session.Percentile(0.999), session.Max()});
+        latency.Add(*latencies[i]);
+    }
+
+    printf("thread per session: %u threads\n", total);
+    ReportSessions(reports, latency, seconds);
+}
+
+int main(int argc, char **argv) {
+    Options options;
+
+    if (!ParseOptions(argc, argv, options)) {
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::ifstream file(options.rom, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Could not open " << options.rom << "\n";
+        return EXIT_FAILURE;
+    }
+    std::vector<uint8_t> rom((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    bool verified = false;
+    if (!options.checked) {
+        std::unique_ptr<Chip8> probe = Boot(rom, 0);
+        verified = Verify(Analyze(probe->memory + ROM_START, MEMORY_SIZE - ROM_START)).safe;
+    }
+
+    if (options.threadPerSession) {
+        ThreadPerSession(options, rom, verified);
+        return EXIT_SUCCESS;
+    }
+
+    WorkStealingOptions schedulerOptions;
+    schedulerOptions.workers = options.workers;
+    schedulerOptions.maxBacklog = BACKLOG;
+    WorkStealingScheduler scheduler(schedulerOptions);
+
+    Clock::time_point start = Clock::now();
+    for (unsigned int i = 0; i < options.realTime + options.batch; ++i) {
+        scheduler.Add(Boot(rom, options.seed + i), verified, options.cyclesPerFrame,
+                      i < options.realTime ? SessionClass::RealTime : SessionClass::Batch);
+    }
+
+    Clock::time_point end = start + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(options.seconds));
+    PressKeys(options, end, [&scheduler](unsigned int i, uint16_t keys) {
+        scheduler.SetKeys(i, keys);
+    });
+    scheduler.Stop();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::vector<WorkerReport> workers = scheduler.Workers();
+    printf("work stealing: %zu workers, %s\n", workers.size(), verified ? "verified" : "checked");
+    for (size_t i = 0; i < workers.size(); ++i) {
+        printf("  worker %zu: %llu frames, %llu stolen, %.1f%% busy\n", i,
+               static_cast<unsigned long long>(workers[i].frames), static_cast<unsigned long long>(workers[i].steals),
+               100.0 * workers[i].utilization);
+    }
+
+    Histogram latency;
+    scheduler.MergeLatency(latency);
+    ReportSessions(scheduler.Sessions(), latency, seconds);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,182 @@
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "FrameExport.h"
+#include "TerminalRenderer.h"
+
+struct Options {
+    const char *name = nullptr;
+    int watch = -1;
+    bool remove = false;
+};
+
+static std::atomic<bool> running{true};
+
+static void Stop(int) {
+    running = false;
+}
+
+static int64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void Usage(const char *program) {
+    std::cerr << "Usage: " << program << " [options] <NAME>\n"
+              << "  --watch SLOT   draw one slot's frames in the terminal until Ctrl-C\n"
+              << "  --remove       remove the segment, e.g. one left behind by a killed emulator\n"
+              << "Without options, lists the sessions publishing to the shared memory segment NAME.\n";
+}
+
+static bool ParseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--watch") == 0 && i + 1 < argc) {
+            options.watch = static_cast<int>(std::strtol(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--remove") == 0) {
+            options.remove = true;
+        }
+        else if (argv[i][0] != '-' && options.name == nullptr) {
+            options.name = argv[i];
+        }
+        else {
+            return false;
+        }
+    }
+
+    return options.name != nullptr;
+}
+
+static void ToFrame(const ExportedFrame &exported, Frame &frame) {
+    for (unsigned int y = 0; y < HIRES_VIDEO_HEIGHT; ++y) {
+        for (unsigned int x = 0; x < FRAME_ROW_BYTES; ++x) {
+            frame.pixels[y][x] = exported.display[0][y][x] | exported.display[1][y][x];
+        }
+    }
+
+    bool hires = exported.flags & FRAME_EXPORT_HIRES;
+    frame.width = hires ? HIRES_VIDEO_WIDTH : VIDEO_WIDTH;
+    frame.height = hires ? HIRES_VIDEO_HEIGHT : VIDEO_HEIGHT;
+    frame.number = exported.frame;
+    frame.publishedNs = exported.publishedNs;
+}
+
+static const char *State(uint32_t flags) {
+    return flags & FRAME_EXPORT_TRAPPED ? "trapped" : flags & FRAME_EXPORT_HALTED ? "halted" : "running";
+}
+
+/**
+ * Sample every slot twice, half a second apart, to show how fast each session is going as well as where it is.
+ */
+static int List(const FrameExport &segment) {
+    std::vector<ExportedFrame> first(segment.Slots());
+    std::vector<bool> seen(segment.Slots());
+    for (unsigned int slot = 0; slot < segment.Slots(); ++slot) {
+        seen[slot] = segment.Owner(slot) != 0 && segment.Read(slot, first[slot]);
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    printf("%5s %8s %8s %12s %8s %9s %8s %s\n", "slot", "pid", "session", "frame", "fps", "age ms", "state",
+           "sound");
+    unsigned int active = 0;
+
+    for (unsigned int slot = 0; slot < segment.Slots(); ++slot) {
+        ExportedFrame now{};
+        uint32_t owner = segment.Owner(slot);
+        if (owner == 0 || !segment.Read(slot, now)) {
+            continue;
+        }
+
+        double fps = 0;
+        if (seen[slot] && first[slot].session == now.session && now.publishedNs > first[slot].publishedNs) {
+            fps = static_cast<double>(now.frame - first[slot].frame) * 1e9 /
+                  static_cast<double>(now.publishedNs - first[slot].publishedNs);
+        }
+
+        printf("%5u %8u %8u %12llu %8.1f %9.2f %8s %s\n", slot, owner, now.session,
+               static_cast<unsigned long long>(now.frame), fps, static_cast<double>(NowNs() - now.publishedNs) / 1e6,
+               State(now.flags), now.flags & FRAME_EXPORT_SOUND ? "on" : "off");
+        ++active;
+    }
+
+    printf("%u of %u slots in use\n", active, segment.Slots());
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Draw a slot whenever it publishes a new frame, polling at twice the emulator's frame rate.
+ */
+static int Watch(const FrameExport &segment, unsigned int slot) {
+    std::signal(SIGINT, Stop);
+    std::signal(SIGTERM, Stop);
+
+    TerminalRenderer renderer(STDOUT_FILENO);
+    Frame frame;
+    ExportedFrame exported{};
+    uint64_t shown = 0;
+    uint64_t missed = 0;
+    int64_t age = 0;
+    uint64_t last = UINT64_MAX;
+
+    while (running && segment.Owner(slot) != 0) {
+        if (segment.Read(slot, exported) && exported.frame != last) {
+            if (last != UINT64_MAX && exported.frame > last + 1) {
+                missed += exported.frame - last - 1;
+            }
+            last = exported.frame;
+
+            ToFrame(exported, frame);
+            renderer.Present(frame);
+            age += NowNs() - exported.publishedNs;
+            ++shown;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(8));
+    }
+
+    fprintf(stderr, "\n%llu frames shown, %llu missed, %.3f ms old on average\n",
+            static_cast<unsigned long long>(shown), static_cast<unsigned long long>(missed),
+            shown > 0 ? static_cast<double>(age) / static_cast<double>(shown) / 1e6 : 0.0);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+    Options options;
+
+    if (!ParseOptions(argc, argv, options)) {
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (options.remove) {
+        if (!FrameExport::Remove(options.name)) {
+            std::cerr << "Could not remove " << options.name << "\n";
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    FrameExport segment(options.name);
+    if (!segment.IsOpen()) {
+        std::cerr << "Could not open " << options.name << "\n";
+        return EXIT_FAILURE;
+    }
+
+    if (options.watch >= 0) {
+        if (static_cast<unsigned int>(options.watch) >= segment.Slots()) {
+            std::cerr << "There are only " << segment.Slots() << " slots\n";
+            return EXIT_FAILURE;
+        }
+        return Watch(segment, static_cast<unsigned int>(options.watch));
+    }
+
+    return List(segment);
+}
@@ -0,0 +1,173 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <vector>
+#include "Upscaler.h"
+
+struct Options {
+    double seconds = 0.2;
+    // Only compare the vector paths with the plain loops, without timing anything
+    bool checkOnly = false;
+};
+
+static const unsigned int MAX_SCALE = 20;
+
+static const PixelFormat FORMATS[] = {PixelFormat::GRAY8, PixelFormat::RGBA8888, PixelFormat::BGRA8888,
+                                      PixelFormat::RGB565};
+
+static const char *FormatName(PixelFormat format) {
+    switch (format) {
+        case PixelFormat::RGBA8888: return "RGBA8888";
+        case PixelFormat::BGRA8888: return "BGRA8888";
+        case PixelFormat::RGB565: return "RGB565";
+        case PixelFormat::GRAY8: return "GRAY8";
+    }
+    return "?";
+}
+
+static void Usage(const char *program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --seconds N    how long to time each format and scale (default 0.2)\n"
+              << "  --check        only check the vector paths against the plain loops\n"
+              << "Every format at scales 1-" << MAX_SCALE << " is checked first; a mismatch fails the run.\n";
+}
+
+static bool ParseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            options.seconds = std::strtod(argv[++i], nullptr);
+        }
+        else if (strcmp(argv[i], "--check") == 0) {
+            options.checkOnly = true;
+        }
+        else {
+            return false;
+        }
+    }
+
+    return options.seconds > 0;
+}
+
+static void RandomFrame(std::mt19937 &random, unsigned int width, unsigned int height, Frame &frame) {
+    frame.width = static_cast<uint16_t>(width);
+    frame.height = static_cast<uint16_t>(height);
+    for (auto &row : frame.pixels) {
+        for (uint8_t &byte : row) {
+            byte = static_cast<uint8_t>(random());
+        }
+    }
+}
+
+/**
+ * Scale() against ScaleReference() for one format over both resolutions and every scale, into buffers whose pitch
+ * leaves a guard gap after each row that neither may write. Returns the number of mismatches.
+ */
+static unsigned int Check(PixelFormat format, std::mt19937 &random) {
+    Upscaler upscaler(format, 0x102030, 0xF0E0D0);
+    size_t pixelBytes = BytesPerPixel(format);
+    unsigned int mismatches = 0;
+
+    for (unsigned int hires = 0; hires < 2; ++hires) {
+        Frame frame;
+        RandomFrame(random, hires ? HIRES_VIDEO_WIDTH : VIDEO_WIDTH, hires ? HIRES_VIDEO_HEIGHT : VIDEO_HEIGHT,
+                    frame);
+
+        for (unsigned int scale = 1; scale <= MAX_SCALE; ++scale) {
+            size_t pitch = frame.width * scale * pixelBytes + 64;
+            size_t size = pitch * frame.height * scale;
+            std::vector<uint8_t> simd(size, 0xA5);
+            std::vector<uint8_t> scalar(size, 0xA5);
+
+            upscaler.Scale(frame, scale, simd.data(), pitch);
+            upscaler.ScaleReference(frame, scale, scalar.data(), pitch);
+
+            if (simd != scalar) {
+                std::cerr << FormatName(format) << " " << frame.width << "x" << frame.height << " at " << scale
+                          << "x: vector output differs from the plain loops\n";
+                ++mismatches;
+            }
+        }
+    }
+
+    return mismatches;
+}
+
+/**
+ * Destination pixels a second written by scale, for a high resolution frame.
+ */
+template <typename ScaleFunction>
+static double Throughput(const Frame &frame, unsigned int scale, size_t pixelBytes, double seconds,
+                         ScaleFunction scaleFrame) {
+    size_t pitch = frame.width * scale * pixelBytes;
+    std::vector<uint8_t> out(pitch * frame.height * scale);
+    uint64_t pixels = static_cast<uint64_t>(frame.width) * scale * frame.height * scale;
+
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+    uint64_t frames = 0;
+    double elapsed;
+    do {
+        for (unsigned int i = 0; i < 16; ++i) {
+            scaleFrame(frame, scale, out.data(), pitch);
+        }
+        frames += 16;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (elapsed < seconds);
+
+    return static_cast<double>(frames * pixels) / elapsed;
+}
+
+int main(int argc, char **argv) {
+    Options options;
+
+    if (!ParseOptions(argc, argv, options)) {
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::mt19937 random(1);
+    unsigned int mismatches = 0;
+    for (PixelFormat format : FORMATS) {
+        mismatches += Check(format, random);
+    }
+    if (mismatches > 0) {
+        std::cerr << mismatches << " of " << std::size(FORMATS) * 2 * MAX_SCALE << " cases differ\n";
+        return EXIT_FAILURE;
+    }
+    std::cout << "vector output matches the plain loops for every format at scales 1-" << MAX_SCALE << "\n";
+
+    if (options.checkOnly) {
+        return EXIT_SUCCESS;
+    }
+
+    Frame frame;
+    RandomFrame(random, HIRES_VIDEO_WIDTH, HIRES_VIDEO_HEIGHT, frame);
+
+    std::cout << "128x64 frame, Gpixel/s written (vector / plain loops):\n";
+    for (PixelFormat format : FORMATS) {
+        Upscaler upscaler(format, 0x000000, 0xFFFFFF);
+        size_t pixelBytes = BytesPerPixel(format);
+
+        for (unsigned int scale : {1u, 2u, 4u, 8u, 10u, 15u, 16u, 20u}) {
+            double simd = Throughput(frame, scale, pixelBytes, options.seconds,
+                                     [&upscaler](const Frame &in, unsigned int s, void *dst, size_t pitch) {
+                                         upscaler.Scale(in, s, dst, pitch);
+                                     });
+            double scalar = Throughput(frame, scale, pixelBytes, options.seconds,
+                                       [&upscaler](const Frame &in, unsigned int s, void *dst, size_t pitch) {
+                                           upscaler.ScaleReference(in, s, dst, pitch);
+                                       });
+
+            char line[96];
+            snprintf(line, sizeof(line), "  %-9s %2ux  %6.2f / %6.2f\n", FormatName(format), scale, simd / 1e9,
+                     scalar / 1e9);
+            std::cout << line;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}